@@ -16,6 +16,13 @@ VERSION_EXEC:=false
 # This setting is only relevant on systems that support symbolic links.
 SYMLINK_FOR_BINARY:=true
 
+# Implementation of the Scheduler queue:
+#   queue: sorted array (default), fastest when there are few sync points
+#   heap:  pairing heap, scales better on machines with many devices
+# Both execute sync points in exactly the same order. Do a 'make clean' after
+# changing this setting.
+SCHEDULER:=queue
+
 # Install content of Contrib/ directory?
 # Currently this contains a version of C-BIOS.
 INSTALL_CONTRIB:=true
@@ -0,0 +1,10 @@
+# Configuration for "bench" flavour:
+# Build executable that runs the emulation benchmarks (see src/bench).
+
+# Start with generic optimisation flags.
+include build/flavour-opt.mk
+
+# Keep symbols, so the benchmark binary can also be used for profiling.
+OPENMSX_STRIP:=false
+
+BENCHMARK:=true
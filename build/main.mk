@@ -63,9 +63,10 @@ endif
 # TODO: "dist" and "createsubs" are missing
 # TODO: more missing?
 # Logical targets which require dependency files.
-DEPEND_TARGETS:=all default install run bindist
+DEPEND_TARGETS:=all default install run run-bench bindist
 # Logical targets which do not require dependency files.
-NODEPEND_TARGETS:=clean config probe 3rdparty run-3rdparty staticbindist
+NODEPEND_TARGETS:=clean config probe 3rdparty run-3rdparty staticbindist \
+	bench
 # Mark all logical targets as such.
 .PHONY: $(DEPEND_TARGETS) $(NODEPEND_TARGETS)
 
@@ -196,6 +197,7 @@ TARGET_FLAGS+=$(shell $(PYTHON) build/cpu2flags.py $(OPENMSX_TARGET_CPU))
 include build/flavour-$(OPENMSX_FLAVOUR).mk
 
 UNITTEST?=false
+BENCHMARK?=false
 
 
 # Paths
@@ -301,6 +303,12 @@ else
 SOURCES_FULL:=$(filter-out src/unittest/%.cc,$(SOURCES_FULL))
 endif
 
+ifeq ($(BENCHMARK),true)
+SOURCES_FULL:=$(filter-out src/main.cc,$(SOURCES_FULL))
+else
+SOURCES_FULL:=$(filter-out src/bench/%.cc,$(SOURCES_FULL))
+endif
+
 # Apply subset to sources list.
 SOURCES_FULL:=$(filter $(SOURCES_PATH)/$(OPENMSX_SUBSET)%,$(SOURCES_FULL))
 ifeq ($(SOURCES_FULL),)
@@ -332,6 +340,14 @@ endif
 COMPILE_FLAGS+=$(TARGET_FLAGS)
 LINK_FLAGS+=$(TARGET_FLAGS)
 
+ifeq ($(SCHEDULER),heap)
+COMPILE_FLAGS+=-DOPENMSX_SCHEDULER_HEAP
+else
+ifneq ($(SCHEDULER),queue)
+$(error Value of SCHEDULER ("$(SCHEDULER)") should be "queue" or "heap")
+endif
+endif
+
 # Determine compiler.
 CXX?=g++
 WINDRES?=windres
@@ -584,6 +600,21 @@ run: all
 	$(SUM) "Running $(notdir $(BINARY_FULL))..."
 	$(CMD)$(BINARY_FULL)
 
+# Recursive invocation with the "bench" flavour.
+bench:
+	$(MAKE) -f build/main.mk run-bench \
+		OPENMSX_TARGET_CPU=$(OPENMSX_TARGET_CPU) \
+		OPENMSX_TARGET_OS=$(OPENMSX_TARGET_OS) \
+		OPENMSX_FLAVOUR=bench \
+		PYTHON=$(PYTHON)
+
+# Run the benchmarks, BENCH_SECONDS is the emulated time per workload.
+# This is an internal target, users should select "bench" instead.
+BENCH_SECONDS?=10
+run-bench: all
+	$(SUM) "Running benchmarks..."
+	$(CMD)$(BINARY_FULL) $(BENCH_SECONDS)
+
 
 # Installation and Binary Packaging
 # =================================
@@ -0,0 +1,51 @@
+namespace eval host_profile {
+
+set_help_text toggle_host_profile \
+{Shows (or hides) an OSD overlay with the host time that was spent in the
+different parts of the emulator in the last frame. This enables the
+'host_profile' setting while the overlay is shown.
+
+Per part it shows the number of calls (or events) and the time of the last
+frame, the average and the maximum time, all in milliseconds. See also
+'openmsx_info host_profile'.
+}
+
+variable after_id
+
+proc display {} {
+	variable after_id
+	set text ""
+	foreach line [openmsx_info host_profile] {
+		lassign $line name calls last avg max
+		append text [format "%-20s %6d %7.2f %7.2f %7.2f\n" $name $calls \
+			[expr {$last / 1000.0}] [expr {$avg / 1000.0}] \
+			[expr {$max / 1000.0}]]
+	}
+	osd configure "host_profile.text" -text $text
+	set after_id [after realtime .5 host_profile::display]
+}
+
+proc toggle_host_profile {} {
+	variable after_id
+	if {[info exists after_id]} {
+		after cancel $after_id
+		osd destroy "host_profile"
+		unset after_id
+		set ::host_profile off
+	} else {
+		set ::host_profile on
+		osd create rectangle "host_profile" \
+			-x 5 -y 30 -w 300 -h 180 -alpha 0x80
+		osd create text "host_profile.text" \
+			-x 5 -y 3 -size 8 -rgb 0xffffff \
+			-font skins/VeraMono.ttf.gz
+		display
+	}
+	return ""
+}
+
+namespace export toggle_host_profile
+
+} ;# namespace host_profile
+
+namespace import host_profile::*
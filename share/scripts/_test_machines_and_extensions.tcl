@@ -82,3 +82,84 @@ proc test_all_extensions {{machine ""} {channel "stdout"}} {
 		}
 	}
 }
+
+set_help_text benchmark_savestates "Measure the time to save and load a savestate of all known machines, both in the binary and in the XML format, and the resulting file sizes. On Linux also the peak memory usage of saving and loading is reported: how much the resident set size (RSS) of the openMSX process grew above its size before the save or load (the largest of both). Pass 'stderr' as channel argument to get the results on the commandline."
+
+proc benchmark_savestates {{channel "stdout"}} {
+	set directory [file normalize $::env(OPENMSX_USER_DATA)/../savestates]
+	file mkdir $directory
+	set files [dict create \
+		binary [file join $directory benchmark.oms] \
+		xml    [file join $directory benchmark.xml.gz]]
+	puts $channel "machine format save(ms) load(ms) size(bytes) peak_rss(kB)"
+	foreach machine [openmsx_info machines] {
+		set id [create_machine]
+		if {[catch {${id}::load_machine $machine} errorText]} {
+			delete_machine $id
+			puts $channel "$machine BROKEN: $errorText"
+			continue
+		}
+		foreach format {binary xml} {
+			set filename [dict get $files $format]
+			set option [expr {($format eq "xml") ? "-xml" : ""}]
+			set rss0 [benchmark_savestates_reset_peak]
+			set t0 [clock microseconds]
+			store_machine {*}$option $id $filename
+			set t1 [clock microseconds]
+			set savePeak [benchmark_savestates_peak $rss0]
+			set rss1 [benchmark_savestates_reset_peak]
+			set t2 [clock microseconds]
+			set newID [restore_machine $filename]
+			set t3 [clock microseconds]
+			set loadPeak [benchmark_savestates_peak $rss1]
+			delete_machine $newID
+			if {$savePeak eq "n/a" || $loadPeak eq "n/a"} {
+				set peak "n/a"
+			} else {
+				set peak [expr {max($savePeak, $loadPeak)}]
+			}
+			puts $channel [format "%s %s %.1f %.1f %d %s" $machine $format \
+				[expr {($t1 - $t0) / 1000.0}] [expr {($t3 - $t2) / 1000.0}] \
+				[file size $filename] $peak]
+			file delete -- $filename
+		}
+		delete_machine $id
+	}
+}
+
+# Reset the peak RSS (VmHWM) of this process to its current RSS, and return
+# that RSS (in kB). Returns "n/a" when not supported (only Linux can do this).
+proc benchmark_savestates_reset_peak {} {
+	if {[catch {
+		set f [open "/proc/self/clear_refs" w]
+		puts -nonewline $f 5
+		close $f
+	}]} {
+		return "n/a"
+	}
+	return [benchmark_savestates_proc_status VmRSS]
+}
+
+# How much (in kB) the peak RSS grew above 'rss' (see above).
+proc benchmark_savestates_peak {rss} {
+	set hwm [benchmark_savestates_proc_status VmHWM]
+	if {$rss eq "n/a" || $hwm eq "n/a"} {
+		return "n/a"
+	}
+	return [expr {max(0, $hwm - $rss)}]
+}
+
+proc benchmark_savestates_proc_status {field} {
+	if {[catch {open "/proc/self/status"} f]} {
+		return "n/a"
+	}
+	set result "n/a"
+	while {[gets $f line] >= 0} {
+		if {[scan $line "$field: %d" kb] == 1} {
+			set result $kb
+			break
+		}
+	}
+	close $f
+	return $result
+}
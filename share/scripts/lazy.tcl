@@ -16,6 +16,7 @@ register_lazy "_disasm.tcl" {
 register_lazy "_example_tools.tcl" {get_screen listing get_color_count toggle_tron}
 register_lazy "_filepool.tcl" {filepool get_paths_for_type}
 register_lazy "_guess_title.tcl" {guess_title guess_rom_title guess_rom_device}
+register_lazy "_host_profile.tcl" toggle_host_profile
 register_lazy "_info_panel.tcl" toggle_info_panel
 register_lazy "_metal_gear_overlay.tcl" {toggle_metal_gear_overlay}
 register_lazy "_mog-overlay.tcl" {toggle_mog_overlay toggle_mog_editor}
@@ -66,7 +67,7 @@ register_lazy "_tas_tools.tcl" {
 	advance_frame reverse_frame toggle_cursors ram_watch
 	toggle_lag_counter reset_lag_counter toggle_movie_length_display}
 register_lazy "_test_machines_and_extensions.tcl" {
-	test_all_machines test_all_extensions}
+	test_all_machines test_all_extensions benchmark_savestates}
 register_lazy "_text_echo.tcl" text_echo
 register_lazy "_tileviewer.tcl" {showtile showall}
 register_lazy "_toggle_freq.tcl" toggle_freq
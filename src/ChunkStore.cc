@@ -0,0 +1,149 @@
+#include "ChunkStore.hh"
+#include "FileOperations.hh"
+#include "FileException.hh"
+#include "MSXException.hh"
+#include "snappy.hh"
+#include <cassert>
+#include <iterator>
+
+namespace openmsx {
+
+// class ChunkStore::Handle
+
+ChunkStore::Handle::Handle(std::shared_ptr<ChunkStore> store_, uint64_t offset_,
+                           size_t storedSize_, size_t size_)
+	: store(std::move(store_))
+	, offset(offset_)
+	, storedSize(storedSize_)
+	, size(size_)
+{
+}
+
+ChunkStore::Handle::~Handle()
+{
+	store->release(offset, storedSize);
+}
+
+MemBuffer<uint8_t> ChunkStore::Handle::read(size_t& size_) const
+{
+	MemBuffer<uint8_t> result(size);
+	auto& file = store->file;
+	// The file can be modified (e.g. truncated) behind our back, so
+	// don't trust its content. File::read() throws on a short read.
+	if ((offset + storedSize) > file.getSize()) {
+		throw FileException("Reverse history file is truncated: " +
+		                    store->filename);
+	}
+	file.seek(offset);
+	if (storedSize == size) {
+		// stored uncompressed
+		file.read(result.data(), size);
+	} else {
+		auto& buf = store->buffer;
+		buf.resize(storedSize);
+		file.read(buf.data(), storedSize);
+		if (!snappy::uncompressChecked(
+				reinterpret_cast<const char*>(buf.data()), storedSize,
+				reinterpret_cast<char*>(result.data()), size)) {
+			throw FileException("Reverse history file is corrupt: " +
+			                    store->filename);
+		}
+	}
+	size_ = size;
+	return result;
+}
+
+
+// class ChunkStore
+
+ChunkStore::ChunkStore()
+	: fileEnd(0)
+	, usedSize(0)
+{
+	// openUniqueFile() only creates the file, reopen it for read/write
+	FileOperations::openUniqueFile(FileOperations::getTempDir(), filename);
+	file = File(filename, File::TRUNCATE);
+}
+
+ChunkStore::~ChunkStore()
+{
+	assert(usedSize == 0); // all handles hold a reference to this object
+	file.close();
+	FileOperations::unlink(filename);
+}
+
+std::shared_ptr<ChunkStore::Handle> ChunkStore::write(
+	const uint8_t* data, size_t size)
+{
+	size_t maxLen = snappy::maxCompressedLength(size);
+	buffer.resize(maxLen);
+	size_t storedSize = maxLen;
+	snappy::compress(reinterpret_cast<const char*>(data), size,
+	                 reinterpret_cast<char*>(buffer.data()), storedSize);
+	const uint8_t* stored = buffer.data();
+	if (storedSize >= size) {
+		// compression isn't beneficial
+		stored = data;
+		storedSize = size;
+	}
+
+	uint64_t offset = allocate(storedSize);
+	try {
+		file.seek(offset);
+		file.write(stored, storedSize);
+	} catch (MSXException&) {
+		release(offset, storedSize);
+		throw;
+	}
+	return std::shared_ptr<Handle>(
+		new Handle(shared_from_this(), offset, storedSize, size));
+}
+
+uint64_t ChunkStore::allocate(size_t size)
+{
+	usedSize += size;
+	// first fit
+	for (auto it = begin(freeSpace); it != end(freeSpace); ++it) {
+		if (it->second >= size) {
+			uint64_t offset = it->first;
+			uint64_t remaining = it->second - size;
+			freeSpace.erase(it);
+			if (remaining) {
+				freeSpace[offset + size] = remaining;
+			}
+			return offset;
+		}
+	}
+	uint64_t offset = fileEnd;
+	fileEnd += size;
+	return offset;
+}
+
+void ChunkStore::release(uint64_t offset, size_t size)
+{
+	assert(usedSize >= size);
+	usedSize -= size;
+
+	// merge with the free ranges before and after
+	uint64_t end_ = offset + size;
+	auto next = freeSpace.lower_bound(offset);
+	if ((next != end(freeSpace)) && (next->first == end_)) {
+		end_ += next->second;
+		next = freeSpace.erase(next);
+	}
+	if (next != begin(freeSpace)) {
+		auto prev = std::prev(next);
+		if ((prev->first + prev->second) == offset) {
+			offset = prev->first;
+			freeSpace.erase(prev);
+		}
+	}
+	if (end_ == fileEnd) {
+		// at the end of the file, no need to keep it as a free range
+		fileEnd = offset;
+	} else {
+		freeSpace[offset] = end_ - offset;
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,81 @@
+#ifndef CHUNKSTORE_HH
+#define CHUNKSTORE_HH
+
+#include "File.hh"
+#include "MemBuffer.hh"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace openmsx {
+
+/** Stores blocks of data (snappy compressed) in a temporary file.
+  *
+  * This is used to move (older) reverse snapshots out of memory, see
+  * ReverseManager. A stored chunk is represented by a Handle, when that
+  * handle is destroyed the space in the file is freed (and can be reused for
+  * later chunks). The file itself is deleted when the store and all handles
+  * are destroyed.
+  */
+class ChunkStore final : public std::enable_shared_from_this<ChunkStore>
+{
+public:
+	class Handle
+	{
+	public:
+		Handle(const Handle&) = delete;
+		Handle& operator=(const Handle&) = delete;
+		~Handle();
+
+		/** Read (and uncompress) the data of this chunk.
+		  * @throws FileException when the file is truncated or corrupt. */
+		MemBuffer<uint8_t> read(size_t& size) const;
+
+		/** Size of this chunk on disk. */
+		size_t getStoredSize() const { return storedSize; }
+
+	private:
+		Handle(std::shared_ptr<ChunkStore> store, uint64_t offset,
+		       size_t storedSize, size_t size);
+
+		const std::shared_ptr<ChunkStore> store;
+		const uint64_t offset;
+		const size_t storedSize;
+		const size_t size;
+
+		friend class ChunkStore;
+	};
+
+	/** Create a new (empty) temporary file.
+	  * @throw FileException when the file can't be created. */
+	ChunkStore();
+	~ChunkStore();
+	ChunkStore(const ChunkStore&) = delete;
+	ChunkStore& operator=(const ChunkStore&) = delete;
+
+	/** Store a chunk. Can be called from a background thread, as long
+	  * as the store and its handles are not used concurrently (except for
+	  * getUsedSize()).
+	  * @throw FileException on write errors (e.g. disk full). */
+	std::shared_ptr<Handle> write(const uint8_t* data, size_t size);
+
+	/** Total size (in bytes) of all chunks currently in the store. */
+	uint64_t getUsedSize() const { return usedSize; }
+
+private:
+	uint64_t allocate(size_t size);
+	void release(uint64_t offset, size_t size);
+
+	std::string filename;
+	File file;
+	std::map<uint64_t, uint64_t> freeSpace; // offset -> size
+	uint64_t fileEnd;
+	std::atomic<uint64_t> usedSize; // also read while writing in a thread
+	MemBuffer<uint8_t> buffer;
+};
+
+} // namespace openmsx
+
+#endif
@@ -0,0 +1,190 @@
+#include "HostProfiler.hh"
+#include "TclObject.hh"
+#include <algorithm>
+#include <chrono>
+#include <cassert>
+
+using std::string;
+using std::vector;
+
+namespace openmsx {
+
+HostProfiler::Entry HostProfiler::entries[HostProfiler::MAX_SECTIONS];
+unsigned HostProfiler::numSections = 0;
+std::atomic<bool> HostProfiler::enabled(false);
+uint64_t HostProfiler::frameStart = 0;
+uint64_t HostProfiler::lastFrame = 0;
+double HostProfiler::avgFrame = 0.0;
+uint64_t HostProfiler::maxFrame = 0;
+
+// The innermost active HostTimer of the current thread.
+static thread_local HostTimer* currentTimer = nullptr;
+
+HostProfiler::HostProfiler(CommandController& commandController,
+                           InfoCommand& openMSXInfoCommand)
+	: setting(commandController, "host_profile",
+	          "measure the time spent in the different parts of the "
+	          "emulator, see 'openmsx_info host_profile'",
+	          false, Setting::DONT_SAVE)
+	, info(openMSXInfoCommand)
+{
+	static const char* const names[NUM_FIXED_SECTIONS] = {
+		"cpu", "scheduler", "render", "post_process", "mixer", "tcl",
+		"reverse_filler",
+		"slot_switch", "slot_cache_miss", "mem_cache_invalidate",
+		"scale_skipped_lines"
+	};
+	if (numSections == 0) {
+		for (auto* name : names) registerSection(name);
+	}
+	setting.attach(*this);
+}
+
+HostProfiler::~HostProfiler()
+{
+	setting.detach(*this);
+	enabled.store(false, std::memory_order_relaxed);
+}
+
+void HostProfiler::update(const Setting& /*setting*/)
+{
+	bool newEnabled = setting.getBoolean();
+	if (newEnabled && !isEnabled()) reset();
+	enabled.store(newEnabled, std::memory_order_relaxed);
+}
+
+unsigned HostProfiler::registerSection(string_ref name)
+{
+	for (unsigned i = 0; i < numSections; ++i) {
+		if (entries[i].name == name) return i;
+	}
+	if (numSections == MAX_SECTIONS) {
+		// Shouldn't happen (there are only a few dozen sound devices),
+		// but in case it does, share the last entry.
+		return MAX_SECTIONS - 1;
+	}
+	entries[numSections].name = name.str();
+	return numSections++;
+}
+
+void HostProfiler::reset()
+{
+	for (unsigned i = 0; i < numSections; ++i) {
+		auto& e = entries[i];
+		e.time = 0;
+		e.calls = 0;
+		e.lastTime = 0;
+		e.lastCalls = 0;
+		e.avgTime = 0.0;
+		e.maxTime = 0;
+	}
+	frameStart = now();
+	lastFrame = 0;
+	avgFrame = 0.0;
+	maxFrame = 0;
+}
+
+// Averages are exponential moving averages, they're updated with weight
+// 1/16 per frame.
+static void updateStats(uint64_t value, double& avg, uint64_t& max)
+{
+	avg += (double(value) - avg) * (1.0 / 16.0);
+	max = std::max(max, value);
+}
+
+void HostProfiler::endFrame()
+{
+	if (!isEnabled()) return;
+	for (unsigned i = 0; i < numSections; ++i) {
+		auto& e = entries[i];
+		e.lastTime  = e.time.exchange(0);
+		e.lastCalls = e.calls.exchange(0);
+		updateStats(e.lastTime, e.avgTime, e.maxTime);
+	}
+	uint64_t t = now();
+	lastFrame = t - frameStart;
+	frameStart = t;
+	updateStats(lastFrame, avgFrame, maxFrame);
+}
+
+void HostProfiler::add(unsigned section, uint64_t ns, unsigned calls)
+{
+	assert(section < MAX_SECTIONS);
+	auto& e = entries[section];
+	e.time.fetch_add(ns, std::memory_order_relaxed);
+	e.calls.fetch_add(calls, std::memory_order_relaxed);
+}
+
+uint64_t HostProfiler::now()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(
+		steady_clock::now().time_since_epoch()).count();
+}
+
+
+// class HostTimer
+
+void HostTimer::begin()
+{
+	if (currentTimer && currentTimer->inclusive) {
+		// measured as part of the enclosing timer
+		return;
+	}
+	parent = currentTimer;
+	currentTimer = this;
+	childTime = 0;
+	start = HostProfiler::now();
+}
+
+void HostTimer::end()
+{
+	uint64_t duration = HostProfiler::now() - start;
+	HostProfiler::add(section, duration - std::min(childTime, duration));
+	currentTimer = parent;
+	if (parent) parent->childTime += duration;
+}
+
+
+// class Info
+
+HostProfiler::Info::Info(InfoCommand& openMSXInfoCommand)
+	: InfoTopic(openMSXInfoCommand, "host_profile")
+{
+}
+
+void HostProfiler::Info::execute(array_ref<TclObject> /*tokens*/,
+                                 TclObject& result) const
+{
+	auto addLine = [&](string_ref section, unsigned calls, uint64_t last,
+	                   double avg, uint64_t max) {
+		TclObject line;
+		line.addListElement(section);
+		line.addListElement(int(calls));
+		line.addListElement(last / 1000.0);
+		line.addListElement(avg  / 1000.0);
+		line.addListElement(max  / 1000.0);
+		result.addListElement(line);
+	};
+	addLine("frame", 1, lastFrame, avgFrame, maxFrame);
+	for (unsigned i = 0; i < numSections; ++i) {
+		auto& e = entries[i];
+		addLine(e.name, e.lastCalls, e.lastTime, e.avgTime, e.maxTime);
+	}
+}
+
+string HostProfiler::Info::help(const vector<string>& /*tokens*/) const
+{
+	return "Shows where the emulator spent its (host) time in the last "
+	       "frame. Only measured while the 'host_profile' setting is "
+	       "enabled.\n"
+	       "Returns a list with for each part of the emulator: "
+	       "{name calls last avg max}, all times are in microseconds. The "
+	       "first element ('frame') is the duration of the frame itself.\n"
+	       "Time spent in nested parts (e.g. rendering triggered by the "
+	       "CPU) is not included in the enclosing part.\n"
+	       "Some elements only count events (e.g. 'slot_switch'), for "
+	       "those all times are zero.\n";
+}
+
+} // namespace openmsx
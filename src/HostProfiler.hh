@@ -0,0 +1,142 @@
+#ifndef HOSTPROFILER_HH
+#define HOSTPROFILER_HH
+
+#include "InfoTopic.hh"
+#include "BooleanSetting.hh"
+#include "Observer.hh"
+#include "string_ref.hh"
+#include "likely.hh"
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+namespace openmsx {
+
+class CommandController;
+
+/** Measures how much (host) time is spent in the main parts of the emulator
+  * (CPU emulation, rendering, sound generation, ...), per host frame.
+  *
+  * The parts are measured with HostTimer objects, placed at the entry
+  * points of those parts. When profiling is disabled (the default) a
+  * HostTimer only costs a test of a global flag.
+  *
+  * Sections can be nested (e.g. the CPU executes a sync point that renders
+  * a part of the VDP frame). The time of a nested section is subtracted
+  * from the enclosing section, so each section only reports its own time.
+  * Sections that run in a worker thread (e.g. sound devices that are
+  * generated in parallel) are not subtracted from the section that waits
+  * for them.
+  *
+  * The emulation of a different board (the reverse filler, which rebuilds
+  * snapshots in the background) is measured as a whole, it doesn't count
+  * as cpu or scheduler time of the active board.
+  */
+class HostProfiler final : private Observer<Setting>
+{
+public:
+	enum Section : unsigned {
+		CPU, SCHEDULER, RENDER, POST_PROCESS, MIXER, TCL,
+		REVERSE_FILLER,
+		// only counted, see count()
+		SLOT_SWITCH, SLOT_CACHE_MISS, MEM_CACHE_INVALIDATE,
+		SCALE_SKIPPED_LINES,
+		NUM_FIXED_SECTIONS
+	};
+
+	HostProfiler(CommandController& commandController,
+	             InfoCommand& openMSXInfoCommand);
+	~HostProfiler();
+
+	static bool isEnabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/** Get the section with the given name, it's created if it doesn't
+	  * exist yet. Only called from the main thread. */
+	static unsigned registerSection(string_ref name);
+
+	/** Called once per host frame, from the main thread. */
+	static void endFrame();
+
+	/** Add 'ns' nanoseconds (and 'calls' calls) to the given section.
+	  * Thread safe. */
+	static void add(unsigned section, uint64_t ns, unsigned calls = 1);
+
+	/** Count 'n' events in the given section (without measuring time). */
+	static void count(unsigned section, unsigned n = 1) {
+		if (unlikely(isEnabled())) add(section, 0, n);
+	}
+
+	/** Current (host) time in nanoseconds. */
+	static uint64_t now();
+
+private:
+	// Observer<Setting>
+	void update(const Setting& setting) override;
+
+	static void reset();
+
+	struct Entry {
+		std::string name;
+		std::atomic<uint64_t> time; // in current frame, ns
+		std::atomic<unsigned> calls;
+		uint64_t lastTime;
+		unsigned lastCalls;
+		double avgTime;
+		uint64_t maxTime;
+	};
+	static const unsigned MAX_SECTIONS = 64;
+	static Entry entries[MAX_SECTIONS];
+	static unsigned numSections;
+	static std::atomic<bool> enabled; // also read from other threads
+	// duration of the host frames
+	static uint64_t frameStart;
+	static uint64_t lastFrame;
+	static double avgFrame;
+	static uint64_t maxFrame;
+
+	BooleanSetting setting;
+
+	struct Info final : InfoTopic {
+		explicit Info(InfoCommand& openMSXInfoCommand);
+		void execute(array_ref<TclObject> tokens,
+		             TclObject& result) const override;
+		std::string help(const std::vector<std::string>& tokens) const override;
+	} info;
+};
+
+/** Measures the time between construction and destruction, when host
+  * profiling is enabled. An 'inclusive' timer also includes the time of
+  * all timers nested in it (in the same thread), those aren't measured
+  * separately. */
+class HostTimer
+{
+public:
+	explicit HostTimer(unsigned section_, bool inclusive_ = false)
+		: section(section_), start(0), inclusive(inclusive_)
+	{
+		if (unlikely(HostProfiler::isEnabled())) begin();
+	}
+	~HostTimer()
+	{
+		if (unlikely(start != 0)) end();
+	}
+
+	HostTimer(const HostTimer&) = delete;
+	HostTimer& operator=(const HostTimer&) = delete;
+
+private:
+	void begin();
+	void end();
+
+	HostTimer* parent;
+	uint64_t childTime;
+	const unsigned section;
+	uint64_t start;
+	const bool inclusive;
+};
+
+} // namespace openmsx
+
+#endif
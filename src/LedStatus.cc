@@ -2,6 +2,8 @@
 #include "MSXCliComm.hh"
 #include "ReadOnlySetting.hh"
 #include "CommandController.hh"
+#include "Reactor.hh"
+#include "Thread.hh"
 #include "Timer.hh"
 #include "memory.hh"
 
@@ -16,10 +18,12 @@ static std::string getLedName(LedStatus::Led led)
 }
 
 LedStatus::LedStatus(
+		Reactor& reactor_,
 		RTScheduler& rtScheduler,
 		CommandController& commandController,
 		MSXCliComm& msxCliComm_)
 	: RTSchedulable(rtScheduler)
+	, reactor(reactor_)
 	, msxCliComm(msxCliComm_)
 	, interp(commandController.getInterpreter())
 {
@@ -38,6 +42,11 @@ LedStatus::~LedStatus() = default;
 
 void LedStatus::setLed(Led led, bool status)
 {
+	if (!Thread::isMainThread()) {
+		reactor.invokeInMainThread(
+			[this, led, status] { setLed(led, status); });
+		return;
+	}
 	if (ledValue[led] == status) return;
 	ledValue[led] = status;
 
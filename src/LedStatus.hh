@@ -9,6 +9,7 @@ namespace openmsx {
 
 class CommandController;
 class MSXCliComm;
+class Reactor;
 class ReadOnlySetting;
 class RTScheduler;
 class Interpreter;
@@ -26,11 +27,16 @@ public:
 		NUM_LEDS // must be last
 	};
 
-	LedStatus(RTScheduler& rtScheduler,
+	LedStatus(Reactor& reactor,
+	          RTScheduler& rtScheduler,
 	          CommandController& commandController,
 	          MSXCliComm& msxCliComm);
 	~LedStatus();
 
+	/** Can be called from any thread. When not called from the main
+	  * thread (see Reactor::runMachines()), the change is handled later
+	  * in the main thread (it updates a setting and uses the RTScheduler).
+	  */
 	void setLed(Led led, bool status);
 
 private:
@@ -39,6 +45,7 @@ private:
 	// RTSchedulable
 	void executeRT() override;
 
+	Reactor& reactor;
 	MSXCliComm& msxCliComm;
 	Interpreter& interp;
 	std::unique_ptr<ReadOnlySetting> ledStatus[NUM_LEDS];
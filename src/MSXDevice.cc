@@ -465,6 +465,11 @@ void MSXDevice::invalidateMemCache(word start, unsigned size)
 	getCPU().invalidateMemCache(start, size);
 }
 
+void MSXDevice::fillMemReadCache(word start, unsigned size, const byte* rData)
+{
+	getCPUInterface().fillReadCache(*this, start, size, rData);
+}
+
 template<typename Archive>
 void MSXDevice::serialize(Archive& ar, unsigned /*version*/)
 {
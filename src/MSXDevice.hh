@@ -208,6 +208,15 @@ public:
 	  */
 	void invalidateMemCache(word start, unsigned size);
 
+	/** Like invalidateMemCache(), but for when only the data that is
+	  * read from [start, start + size) changed, and it's now the data at
+	  * 'rData' (what getReadCacheLine() returns for 'start'). When
+	  * possible the CPU read cache is directly updated, so the cache lines
+	  * don't have to be looked up again.
+	  * See MSXCPUInterface::fillReadCache().
+	  */
+	void fillMemReadCache(word start, unsigned size, const byte* rData);
+
 	/** Get the mother board this device belongs to
 	  */
 	MSXMotherBoard& getMotherBoard() const;
@@ -194,6 +194,8 @@ MSXMotherBoard::MSXMotherBoard(Reactor& reactor_)
 	, powered(false)
 	, active(false)
 	, fastForwarding(false)
+	, replayHelper(false)
+	, discardedWrites(false)
 {
 	slotManager = make_unique<CartridgeSlotManager>(*this);
 	reverseManager = make_unique<ReverseManager>(*this);
@@ -467,6 +469,7 @@ LedStatus& MSXMotherBoard::getLedStatus()
 	if (!ledStatus) {
 		getMSXCliComm(); // force init, to be on the safe side
 		ledStatus = make_unique<LedStatus>(
+			reactor,
 			reactor.getRTScheduler(),
 			*msxCommandController,
 			*msxCliComm);
@@ -90,12 +90,24 @@ public:
 	void unpause();
 
 	void powerUp();
+	bool isPowered() const { return powered; }
 
 	void doReset();
 	void activate(bool active);
 	bool isActive() const { return active; }
 	bool isFastForwarding() const { return fastForwarding; }
 
+	/** This machine is only used to recreate reverse snapshots (see
+	  * ReverseManager::Filler). It must not have effects outside the
+	  * emulation: SRAM files aren't saved and writes to disk images are
+	  * dropped. Must be called before the devices are created.
+	  */
+	void setReplayHelper() { replayHelper = true; }
+	bool isReplayHelper() const { return replayHelper; }
+	/** (Only for replay helpers) Set when a write to a disk image was
+	  * dropped, from then on the emulation differs from the original. */
+	bool& getDiscardedWritesFlag() { return discardedWrites; }
+
 	byte readIRQVector();
 
 	const HardwareConfig* getMachineConfig() const { return machineConfig; }
@@ -271,6 +283,8 @@ private:
 	bool powered;
 	bool active;
 	bool fastForwarding;
+	bool replayHelper;
+	bool discardedWrites;
 };
 SERIALIZE_CLASS_VERSION(MSXMotherBoard, 4);
 
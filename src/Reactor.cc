@@ -13,6 +13,8 @@
 #include "RomDatabase.hh"
 #include "TclCallbackMessages.hh"
 #include "MSXMotherBoard.hh"
+#include "MSXCPUInterface.hh"
+#include "Debugger.hh"
 #include "StateChangeDistributor.hh"
 #include "Command.hh"
 #include "AfterCommand.hh"
@@ -23,6 +25,7 @@
 #include "Display.hh"
 #include "Mixer.hh"
 #include "AviRecorder.hh"
+#include "HostProfiler.hh"
 #include "GlobalSettings.hh"
 #include "BooleanSetting.hh"
 #include "EnumSetting.hh"
@@ -45,6 +48,7 @@
 #include "memory.hh"
 #include "build-info.hh"
 #include <cassert>
+#include <thread>
 
 using std::string;
 using std::vector;
@@ -148,6 +152,16 @@ private:
 	Reactor& reactor;
 };
 
+class RunMachinesCommand final : public Command
+{
+public:
+	RunMachinesCommand(CommandController& commandController, Reactor& reactor);
+	void execute(array_ref<TclObject> tokens, TclObject& result) override;
+	string help(const vector<string>& tokens) const override;
+private:
+	Reactor& reactor;
+};
+
 class ConfigInfo final : public InfoTopic
 {
 public:
@@ -174,6 +188,7 @@ private:
 
 Reactor::Reactor()
 	: activeBoard(nullptr)
+	, busyWorkers(0)
 	, blockedCounter(0)
 	, paused(false)
 	, running(true)
@@ -228,6 +243,8 @@ void Reactor::init()
 		*globalCommandController, *this);
 	restoreMachineCommand = make_unique<RestoreMachineCommand>(
 		*globalCommandController, *this);
+	runMachinesCommand = make_unique<RunMachinesCommand>(
+		*globalCommandController, *this);
 	aviRecordCommand = make_unique<AviRecorder>(*this);
 	extensionInfo = make_unique<ConfigInfo>(
 		getOpenMSXInfoCommand(), "extensions");
@@ -235,6 +252,8 @@ void Reactor::init()
 		getOpenMSXInfoCommand(), "machines");
 	realTimeInfo = make_unique<RealTimeInfo>(
 		getOpenMSXInfoCommand());
+	hostProfiler = make_unique<HostProfiler>(
+		*globalCommandController, getOpenMSXInfoCommand());
 	tclCallbackMessages = make_unique<TclCallbackMessages>(
 		*globalCliComm, *globalCommandController);
 
@@ -534,6 +553,7 @@ void Reactor::run(CommandLineParser& parser)
 
 	while (running) {
 		eventDistributor->deliverEvents();
+		executeMainThreadTasks();
 		assert(garbageBoards.empty());
 		bool blocked = (blockedCounter > 0) || !activeBoard;
 		if (!blocked) blocked = !activeBoard->execute();
@@ -549,6 +569,130 @@ void Reactor::run(CommandLineParser& parser)
 	}
 }
 
+void Reactor::runMachines(EmuDuration::param duration)
+{
+	assert(Thread::isMainThread());
+	assert(busyWorkers == 0);
+
+	// Breakpoints, watchpoints and conditions execute Tcl, that can only
+	// be done in the main thread. Machines that use them run in the main
+	// thread, after all worker threads are done (so that the Tcl scripts
+	// never run concurrently with another machine). Breakpoints and
+	// conditions are shared by all machines.
+	bool anyBreakPoints = MSXCPUInterface::anyBreakPoints();
+	auto needsMainThread = [&](MSXMotherBoard& board) {
+		return anyBreakPoints ||
+		       !board.getCPUInterface().getWatchPoints().empty() ||
+		       board.getDebugger().hasProbeBreakPoints();
+	};
+
+	vector<MSXMotherBoard*> batch;
+	vector<EmuTime> targets;
+	size_t numWorkers = 0;
+	for (auto& b : boards) {
+		if (b->isPowered()) {
+			batch.push_back(b.get());
+			targets.push_back(b->getCurrentTime() + duration);
+		}
+	}
+	if (batch.empty()) return;
+	// worker machines first
+	for (size_t i = 0; i < batch.size(); ++i) {
+		if (!needsMainThread(*batch[i])) {
+			std::swap(batch[i], batch[numWorkers]);
+			std::swap(targets[i], targets[numWorkers]);
+			++numWorkers;
+		}
+	}
+
+	// MSXMotherBoard::fastForward() (un)mutes the MSXMixer. Mute here
+	// already, so that the worker threads don't (un)register with the
+	// shared Mixer.
+	for (auto* b : batch) {
+		b->getMSXMixer().mute();
+	}
+
+	vector<string> errors(batch.size());
+	vector<std::thread> workers;
+	busyWorkers = unsigned(numWorkers);
+	for (size_t i = 0; i < numWorkers; ++i) {
+		workers.emplace_back([&, i] {
+			Thread::setEmulationThread();
+			try {
+				batch[i]->fastForward(targets[i], true);
+			} catch (MSXException& e) {
+				errors[i] = e.getMessage();
+			}
+			{
+				std::lock_guard<std::mutex> lock(taskMutex);
+				--busyWorkers;
+			}
+			taskCondition.notify_all();
+		});
+	}
+
+	// Serve the requests of the worker threads until they're all done.
+	while (true) {
+		std::unique_lock<std::mutex> lock(taskMutex);
+		taskCondition.wait(lock, [&] {
+			return (busyWorkers == 0) || !mainThreadTasks.empty(); });
+		bool done = busyWorkers == 0;
+		lock.unlock();
+		executeMainThreadTasks();
+		if (done) break;
+	}
+	for (auto& w : workers) {
+		w.join();
+	}
+	executeMainThreadTasks();
+
+	for (size_t i = numWorkers; i < batch.size(); ++i) {
+		try {
+			batch[i]->fastForward(targets[i], true);
+		} catch (MSXException& e) {
+			errors[i] = e.getMessage();
+		}
+	}
+
+	for (auto* b : batch) {
+		b->getMSXMixer().unmute();
+	}
+	for (size_t i = 0; i < batch.size(); ++i) {
+		if (!errors[i].empty()) {
+			throw CommandException(
+				"Error while running machine " +
+				batch[i]->getMachineID() + ": " + errors[i]);
+		}
+	}
+}
+
+void Reactor::invokeInMainThread(std::function<void()> func)
+{
+	if (Thread::isMainThread()) {
+		func();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(taskMutex);
+		mainThreadTasks.push_back(std::move(func));
+	}
+	taskCondition.notify_all();
+}
+
+void Reactor::executeMainThreadTasks()
+{
+	assert(Thread::isMainThread());
+	vector<std::function<void()>> tasks;
+	{
+		std::lock_guard<std::mutex> lock(taskMutex);
+		if (mainThreadTasks.empty()) return;
+		swap(tasks, mainThreadTasks);
+	}
+	for (auto& t : tasks) {
+		t();
+	}
+}
+
 void Reactor::unpause()
 {
 	if (paused) {
@@ -876,20 +1020,34 @@ StoreMachineCommand::StoreMachineCommand(
 
 void StoreMachineCommand::execute(array_ref<TclObject> tokens, TclObject& result)
 {
+	// By default store in the (fast) binary format, XML is still available
+	// as an export option.
+	bool xml = false;
+	vector<string_ref> args;
+	for (auto& t : tokens) {
+		string_ref arg = t.getString();
+		if (arg == "-xml") {
+			xml = true;
+		} else {
+			args.push_back(arg);
+		}
+	}
+
+	const char* extension = xml ? ".xml.gz" : ".oms";
 	string filename;
 	string_ref machineID;
-	switch (tokens.size()) {
+	switch (args.size()) {
 	case 1:
 		machineID = reactor.getMachineID();
-		filename = FileOperations::getNextNumberedFileName("savestates", "openmsxstate", ".xml.gz");
+		filename = FileOperations::getNextNumberedFileName("savestates", "openmsxstate", extension);
 		break;
 	case 2:
-		machineID = tokens[1].getString();
-		filename = FileOperations::getNextNumberedFileName("savestates", "openmsxstate", ".xml.gz");
+		machineID = args[1];
+		filename = FileOperations::getNextNumberedFileName("savestates", "openmsxstate", extension);
 		break;
 	case 3:
-		machineID = tokens[1].getString();
-		filename = tokens[2].getString().str();
+		machineID = args[1];
+		filename = args[2].str();
 		break;
 	default:
 		throw SyntaxError();
@@ -897,18 +1055,27 @@ void StoreMachineCommand::execute(array_ref<TclObject> tokens, TclObject& result
 
 	auto& board = reactor.getMachine(machineID);
 
-	XmlOutputArchive out(filename);
-	out.serialize("machine", board);
+	if (xml) {
+		XmlOutputArchive out(filename);
+		out.serialize("machine", board);
+	} else {
+		BinOutputArchive out(filename);
+		out.serialize("machine", board);
+	}
 	result.setString(filename);
 }
 
 string StoreMachineCommand::help(const vector<string>& /*tokens*/) const
 {
 	return
-		"store_machine                       Save state of current machine to file \"openmsxNNNN.xml.gz\"\n"
-		"store_machine machineID             Save state of machine \"machineID\" to file \"openmsxNNNN.xml.gz\"\n"
+		"store_machine                       Save state of current machine to file \"openmsxNNNN.oms\"\n"
+		"store_machine machineID             Save state of machine \"machineID\" to file \"openmsxNNNN.oms\"\n"
                 "store_machine machineID <filename>  Save state of machine \"machineID\" to indicated file\n"
 		"\n"
+		"By default the state is stored in a compact binary format. Add the option\n"
+		"-xml to store it as (gzipped) XML instead (e.g. to inspect it, or to load\n"
+		"it on a different platform).\n"
+		"\n"
 		"This is a low-level command, the 'savestate' script is easier to use.";
 }
 
@@ -966,8 +1133,13 @@ void RestoreMachineCommand::execute(array_ref<TclObject> tokens,
 
 	//std::cerr << "Loading " << filename << std::endl;
 	try {
-		XmlInputArchive in(filename);
-		in.serialize("machine", *newBoard);
+		if (BinInputArchive::isBinArchive(filename)) {
+			BinInputArchive in(filename);
+			in.serialize("machine", *newBoard);
+		} else {
+			XmlInputArchive in(filename);
+			in.serialize("machine", *newBoard);
+		}
 	} catch (XMLException& e) {
 		throw CommandException("Cannot load state, bad file format: " + e.getMessage());
 	} catch (MSXException& e) {
@@ -999,6 +1171,40 @@ void RestoreMachineCommand::tabCompletion(vector<string>& tokens) const
 }
 
 
+// class RunMachinesCommand
+
+RunMachinesCommand::RunMachinesCommand(
+	CommandController& commandController_, Reactor& reactor_)
+	: Command(commandController_, "run_machines")
+	, reactor(reactor_)
+{
+}
+
+void RunMachinesCommand::execute(array_ref<TclObject> tokens,
+                                 TclObject& /*result*/)
+{
+	if (tokens.size() != 2) {
+		throw SyntaxError();
+	}
+	double duration = tokens[1].getDouble(getInterpreter());
+	if (duration <= 0.0) {
+		throw CommandException("Duration must be positive");
+	}
+	reactor.runMachines(EmuDuration(duration));
+}
+
+string RunMachinesCommand::help(const vector<string>& /*tokens*/) const
+{
+	return "run_machines <seconds>\n"
+	       "Run all powered machines concurrently (each in its own "
+	       "thread) for the given amount of emulated time. The machines "
+	       "run as fast as possible, without sound and without "
+	       "rendering. This command only returns when all machines "
+	       "are done. Intended for batch jobs, e.g. in combination "
+	       "with '-script'.";
+}
+
+
 // class ConfigInfo
 
 ConfigInfo::ConfigInfo(InfoCommand& openMSXInfoCommand,
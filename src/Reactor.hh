@@ -3,8 +3,11 @@
 
 #include "Observer.hh"
 #include "EventListener.hh"
+#include "EmuDuration.hh"
 #include "string_ref.hh"
 #include "openmsx.hh"
+#include <condition_variable>
+#include <functional>
 #include <string>
 #include <memory>
 #include <mutex>
@@ -47,16 +50,19 @@ class ListMachinesCommand;
 class ActivateMachineCommand;
 class StoreMachineCommand;
 class RestoreMachineCommand;
+class RunMachinesCommand;
 class AviRecorder;
 class ConfigInfo;
 class RealTimeInfo;
+class HostProfiler;
 template <typename T> class EnumSetting;
 
 /**
  * Contains the main loop of openMSX.
  * openMSX is almost single threaded: the main thread does most of the work,
  * we create additional threads only if we need blocking calls for
- * communicating with peripherals.
+ * communicating with peripherals, and for running machines in parallel (see
+ * runMachines()).
  * This class serializes all incoming requests so they can be handled by the
  * main thread.
  */
@@ -96,6 +102,24 @@ public:
 	void block();
 	void unblock();
 
+	/** Run all powered machines concurrently, each in its own thread,
+	  * until every machine has advanced 'duration' in emulated time.
+	  * The machines run unthrottled, without sound and without rendering
+	  * (like during a reverse fast-forward). Meanwhile the main thread
+	  * executes the functions passed to invokeInMainThread(). Machines
+	  * with breakpoints, watchpoints or conditions (these execute Tcl)
+	  * run in the main thread once the other machines are done.
+	  * Must be called from the main thread.
+	  */
+	void runMachines(EmuDuration::param duration);
+
+	/** Execute the given function in the main thread. When called from
+	  * the main thread the function is executed immediately, otherwise
+	  * it's queued and executed asynchronously. Can be called from any
+	  * thread.
+	  */
+	void invokeInMainThread(std::function<void()> func);
+
 	// convenience methods
 	GlobalSettings& getGlobalSettings() { return *globalSettings; }
 	InfoCommand& getOpenMSXInfoCommand();
@@ -126,6 +150,8 @@ private:
 	void unpause();
 	void pause();
 
+	void executeMainThreadTasks();
+
 	std::mutex mbMutex; // this should come first, because it's still used by
 	                    // the destructors of the unique_ptr below
 
@@ -163,10 +189,12 @@ private:
 	std::unique_ptr<ActivateMachineCommand> activateMachineCommand;
 	std::unique_ptr<StoreMachineCommand> storeMachineCommand;
 	std::unique_ptr<RestoreMachineCommand> restoreMachineCommand;
+	std::unique_ptr<RunMachinesCommand> runMachinesCommand;
 	std::unique_ptr<AviRecorder> aviRecordCommand;
 	std::unique_ptr<ConfigInfo> extensionInfo;
 	std::unique_ptr<ConfigInfo> machineInfo;
 	std::unique_ptr<RealTimeInfo> realTimeInfo;
+	std::unique_ptr<HostProfiler> hostProfiler;
 	std::unique_ptr<TclCallbackMessages> tclCallbackMessages;
 
 	// Locking rules for activeBoard access:
@@ -180,6 +208,12 @@ private:
 	Boards garbageBoards;
 	MSXMotherBoard* activeBoard; // either nullptr or a board inside 'boards'
 
+	// Functions queued by invokeInMainThread(), protected by taskMutex.
+	std::vector<std::function<void()>> mainThreadTasks;
+	std::mutex taskMutex;
+	std::condition_variable taskCondition;
+	unsigned busyWorkers; // number of running runMachines() threads
+
 	int blockedCounter;
 	bool paused;
 
@@ -200,6 +234,7 @@ private:
 	friend class ActivateMachineCommand;
 	friend class StoreMachineCommand;
 	friend class RestoreMachineCommand;
+	friend class RunMachinesCommand;
 };
 
 } // namespace openmsx
@@ -0,0 +1,170 @@
+#include "ReplayFile.hh"
+#include "MSXMotherBoard.hh"
+#include "StateChange.hh"
+#include "MSXException.hh"
+#include "serialize.hh"
+#include "serialize_stl.hh"
+#include <cassert>
+#include <cstring>
+
+using std::string;
+
+namespace openmsx {
+
+// Layout of a binary replay file:
+//  - a file header (see BinOutputArchive::writeHeader())
+//  - for each snapshot a binary archive stream containing a "machine"
+//  - a binary archive stream containing the event log
+//  - a binary archive stream containing the index (see ReplayIndex)
+//  - the (64-bit) position of the index stream
+static const char REPLAY_MAGIC[] = "openMSX-bin-replay";
+
+struct ReplayIndex
+{
+	explicit ReplayIndex(std::vector<ReplayFile::Snapshot>& snapshots_)
+		: snapshots(snapshots_), eventsOffset(0)
+		, currentTime(EmuTime::zero), reRecordCount(0) {}
+
+	std::vector<ReplayFile::Snapshot>& snapshots;
+	uint64_t eventsOffset;
+	EmuTime currentTime;
+	unsigned reRecordCount;
+
+	template<typename Archive>
+	void serialize(Archive& ar, unsigned /*version*/)
+	{
+		ar.serialize("snapshots", snapshots);
+		ar.serialize("eventsOffset", eventsOffset);
+		ar.serialize("currentTime", currentTime);
+		ar.serialize("reRecordCount", reRecordCount);
+	}
+};
+
+template<typename Archive>
+void ReplayFile::Snapshot::serialize(Archive& ar, unsigned /*version*/)
+{
+	ar.serialize("time", time);
+	ar.serialize("offset", offset);
+	ar.serialize("eventCount", eventCount);
+}
+
+
+ReplayFile::ReplayFile(const string& filename_)
+	: filename(filename_)
+	, file(filename, "rb")
+	, snapshotsEnd(0)
+	, currentTime(EmuTime::zero)
+	, reRecordCount(0)
+{
+	data = file.mmap(size);
+	auto error = [](const string& msg) {
+		throw MSXException("Bad replay file: " + msg);
+	};
+
+	size_t headerSize = BinInputArchive::checkHeader(
+		data, size, string_ref(REPLAY_MAGIC, sizeof(REPLAY_MAGIC) - 1));
+	uint64_t indexOffset;
+	if ((size - headerSize) < sizeof(indexOffset)) error("file truncated");
+	memcpy(&indexOffset, data + size - sizeof(indexOffset), sizeof(indexOffset));
+	size_t dataEnd = size - sizeof(indexOffset);
+	if ((indexOffset < headerSize) || (indexOffset >= dataEnd)) {
+		error("corrupt index position");
+	}
+
+	ReplayIndex index(snapshots);
+	{
+		BinInputArchive in(data + indexOffset, dataEnd - indexOffset);
+		in.serialize("index", index);
+	}
+	if (snapshots.empty()) error("no snapshots");
+	if ((index.eventsOffset < headerSize) ||
+	    (index.eventsOffset >= indexOffset)) {
+		error("corrupt event log position");
+	}
+	// the snapshots are stored before the event log
+	snapshotsEnd = index.eventsOffset;
+	for (auto& s : snapshots) {
+		if ((s.offset < headerSize) || (s.offset >= snapshotsEnd)) {
+			error("corrupt snapshot position");
+		}
+	}
+	currentTime = index.currentTime;
+	reRecordCount = index.reRecordCount;
+
+	// The events are small compared to the snapshots, load them now.
+	BinInputArchive in(data + index.eventsOffset,
+	                   indexOffset - index.eventsOffset);
+	in.serialize("events", events);
+
+	EmuTime prevTime = EmuTime::zero;
+	unsigned prevCount = 0;
+	for (auto& s : snapshots) {
+		if ((s.time < prevTime) || (s.eventCount < prevCount) ||
+		    (s.eventCount > events.size())) {
+			error("corrupt index");
+		}
+		prevTime = s.time;
+		prevCount = s.eventCount;
+	}
+}
+
+bool ReplayFile::isReplayFile(const string& filename)
+{
+	return BinInputArchive::hasMagic(
+		filename, string_ref(REPLAY_MAGIC, sizeof(REPLAY_MAGIC) - 1));
+}
+
+void ReplayFile::loadSnapshot(const Snapshot& snapshot,
+                              MSXMotherBoard& board) const
+{
+	// BinInputArchive validates each (compressed) block, it can't read
+	// past the end of the snapshot area.
+	assert(snapshot.offset < snapshotsEnd);
+	BinInputArchive in(data + snapshot.offset, snapshotsEnd - snapshot.offset);
+	in.serialize("machine", board);
+}
+
+
+ReplayFile::Writer::Writer(const string& filename)
+	: file(filename, "wb")
+{
+	BinOutputArchive::writeHeader(
+		file, string_ref(REPLAY_MAGIC, sizeof(REPLAY_MAGIC) - 1));
+}
+
+void ReplayFile::Writer::addSnapshot(MSXMotherBoard& board, unsigned eventCount)
+{
+	Snapshot snapshot;
+	snapshot.time = board.getCurrentTime();
+	snapshot.offset = file.getPos();
+	snapshot.eventCount = eventCount;
+	{
+		BinOutputArchive out(file);
+		out.serialize("machine", board);
+	} // destructor terminates the stream
+	snapshots.push_back(snapshot);
+}
+
+void ReplayFile::Writer::finish(const Events& events,
+                                EmuTime::param currentTime,
+                                unsigned reRecordCount)
+{
+	ReplayIndex index(snapshots);
+	index.currentTime = currentTime;
+	index.reRecordCount = reRecordCount;
+
+	index.eventsOffset = file.getPos();
+	{
+		BinOutputArchive out(file);
+		out.serialize("events", events);
+	}
+	uint64_t indexOffset = file.getPos();
+	{
+		BinOutputArchive out(file);
+		out.serialize("index", index);
+	}
+	file.write(&indexOffset, sizeof(indexOffset));
+	file.flush();
+}
+
+} // namespace openmsx
@@ -0,0 +1,96 @@
+#ifndef REPLAYFILE_HH
+#define REPLAYFILE_HH
+
+#include "EmuTime.hh"
+#include "File.hh"
+#include "openmsx.hh"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace openmsx {
+
+class MSXMotherBoard;
+class StateChange;
+
+/** Binary replay files.
+  *
+  * Such a file contains a number of snapshots, the event log and an index.
+  * Each snapshot and the event log are stored as separate binary archive
+  * streams (see BinOutputArchive). The index lists for each snapshot its time,
+  * its position in the file and the number of events that happened before it.
+  * The position of the index itself is stored in the last 8 bytes of the file.
+  *
+  * Opening a replay file only reads the index and the event log. The file
+  * remains memory mapped and a snapshot is only decoded when it's actually
+  * needed (see ReverseManager::goTo()). So opening a long replay with many
+  * snapshots is fast and doesn't require much memory.
+  */
+class ReplayFile
+{
+public:
+	using Events = std::vector<std::shared_ptr<StateChange>>;
+
+	struct Snapshot {
+		Snapshot() : time(EmuTime::zero), offset(0), eventCount(0) {}
+
+		EmuTime time;
+		uint64_t offset;
+		unsigned eventCount;
+
+		template<typename Archive>
+		void serialize(Archive& ar, unsigned version);
+	};
+
+	/** Open an existing replay file. This reads the index and the events.
+	  * @throw MSXException when the file can't be read or is corrupt. */
+	explicit ReplayFile(const std::string& filename);
+
+	/** Does the given file look like a binary replay file? */
+	static bool isReplayFile(const std::string& filename);
+
+	const std::string& getFilename() const { return filename; }
+	const std::vector<Snapshot>& getSnapshots() const { return snapshots; }
+	EmuTime::param getCurrentTime() const { return currentTime; }
+	unsigned getReRecordCount() const { return reRecordCount; }
+
+	/** Take the event log out of this object (can only be done once). */
+	Events releaseEvents() { return std::move(events); }
+
+	/** Restore the given snapshot in an empty motherboard.
+	  * @throw MSXException when the snapshot data is corrupt. */
+	void loadSnapshot(const Snapshot& snapshot, MSXMotherBoard& board) const;
+
+	/** Helper to create a binary replay file. First add all snapshots (in
+	  * chronological order), then call finish(). */
+	class Writer
+	{
+	public:
+		explicit Writer(const std::string& filename);
+
+		void addSnapshot(MSXMotherBoard& board, unsigned eventCount);
+		void finish(const Events& events, EmuTime::param currentTime,
+		            unsigned reRecordCount);
+
+	private:
+		File file;
+		std::vector<Snapshot> snapshots;
+	};
+
+private:
+	const std::string filename;
+	File file;
+	const byte* data;
+	size_t size;
+	size_t snapshotsEnd; // offset of the event log
+
+	std::vector<Snapshot> snapshots;
+	Events events;
+	EmuTime currentTime;
+	unsigned reRecordCount;
+};
+
+} // namespace openmsx
+
+#endif
@@ -1,5 +1,6 @@
 #include "ReverseManager.hh"
 #include "MSXMotherBoard.hh"
+#include "MSXCPU.hh"
 #include "EventDistributor.hh"
 #include "StateChangeDistributor.hh"
 #include "Keyboard.hh"
@@ -12,17 +13,24 @@
 #include "FileOperations.hh"
 #include "FileContext.hh"
 #include "StateChange.hh"
+#include "RecordedCommand.hh"
 #include "Timer.hh"
+#include "HostProfiler.hh"
+#include "RTSchedulable.hh"
 #include "CliComm.hh"
 #include "Display.hh"
 #include "Reactor.hh"
+#include "ReplayFile.hh"
 #include "CommandException.hh"
 #include "MemBuffer.hh"
 #include "StringOp.hh"
 #include "serialize.hh"
 #include "serialize_stl.hh"
 #include "xrange.hh"
+#include <algorithm>
+#include <cstring>
 #include <functional>
+#include <chrono>
 #include <cassert>
 #include <cmath>
 
@@ -45,6 +53,9 @@ static const EmuDuration MIN_PARTITION_LENGTH = EmuDuration(60.0);
 // Max distance of one before last snapshot before the end time in replay file (in seconds)
 static const EmuDuration MAX_DIST_1_BEFORE_LAST_SNAPSHOT = EmuDuration(30.0);
 
+// Max number of snapshots that are filled in in the background after a jump
+static const size_t MAX_FILL_SNAPSHOTS = 100;
+
 static const char* const REPLAY_DIR = "replays";
 
 // A replay is a struct that contains a vector of motherboards and an MSX event
@@ -99,12 +110,50 @@ struct Replay
 SERIALIZE_CLASS_VERSION(Replay, 4);
 
 
+// struct ReverseChunk
+
+void ReverseManager::ReverseChunk::restore(MSXMotherBoard& board) const
+{
+	if (replayFile) {
+		replayFile->loadSnapshot(
+			replayFile->getSnapshots()[replaySnapshot], board);
+	} else if (spilled) {
+		// see ReverseManager::spillChunk() for the layout
+		size_t totalSize;
+		auto buf = spilled->read(totalSize);
+		const uint8_t* p = buf.data();
+		uint64_t header[2]; // savestate size, number of blocks
+		memcpy(header, p, sizeof(header));
+		p += sizeof(header);
+		vector<uint64_t> sizes(header[1]);
+		memcpy(sizes.data(), p, sizes.size() * sizeof(uint64_t));
+		p += sizes.size() * sizeof(uint64_t);
+		const uint8_t* state = p;
+		p += header[0];
+		vector<shared_ptr<DeltaBlock>> blocks;
+		for (auto& s : sizes) {
+			blocks.push_back(std::make_shared<DeltaBlockCopy>(p, s));
+			p += s;
+		}
+		assert(p == (buf.data() + totalSize));
+		MemInputArchive in(state, header[0], blocks);
+		in.serialize("machine", board);
+	} else {
+		MemInputArchive in(savestate.data(), size, deltaBlocks);
+		in.serialize("machine", board);
+	}
+}
+
+
 // struct ReverseHistory
 
 void ReverseManager::ReverseHistory::swap(ReverseHistory& other)
 {
 	std::swap(chunks, other.chunks);
 	std::swap(events, other.events);
+	std::swap(store, other.store);
+	std::swap(blockUsage, other.blockUsage);
+	std::swap(ramUsage, other.ramUsage);
 }
 
 void ReverseManager::ReverseHistory::clear()
@@ -112,6 +161,88 @@ void ReverseManager::ReverseHistory::clear()
 	// clear() and free storage capacity
 	Chunks().swap(chunks);
 	Events().swap(events);
+	store.reset();
+	decltype(blockUsage)().swap(blockUsage);
+	ramUsage = 0;
+}
+
+void ReverseManager::ReverseHistory::addChunk(
+	unsigned seqNum, ReverseChunk&& chunk)
+{
+	auto it = chunks.find(seqNum);
+	if (it != end(chunks)) {
+		removeRamUsage(it->second);
+		it->second = move(chunk);
+	} else {
+		it = chunks.insert(std::make_pair(seqNum, move(chunk))).first;
+	}
+	addRamUsage(it->second);
+}
+
+void ReverseManager::ReverseHistory::eraseChunks(
+	Chunks::iterator first, Chunks::iterator last)
+{
+	for (auto it = first; it != last; ++it) {
+		removeRamUsage(it->second);
+	}
+	chunks.erase(first, last);
+}
+
+void ReverseManager::ReverseHistory::addRamUsage(const ReverseChunk& chunk)
+{
+	if (chunk.spilled || chunk.replayFile) return;
+	ramUsage += chunk.size;
+	for (auto& b : chunk.deltaBlocks) {
+		addBlock(b.get());
+	}
+}
+
+size_t ReverseManager::ReverseHistory::removeRamUsage(const ReverseChunk& chunk)
+{
+	if (chunk.spilled || chunk.replayFile) return 0;
+	size_t freed = chunk.size;
+	for (auto& b : chunk.deltaBlocks) {
+		freed += removeBlock(b.get());
+	}
+	assert(ramUsage >= freed);
+	ramUsage -= freed;
+	return freed;
+}
+
+void ReverseManager::ReverseHistory::updateRamUsage(const Blocks& blocks)
+{
+	for (auto& b : blocks) {
+		auto it = blockUsage.find(b.get());
+		if (it == end(blockUsage)) continue;
+		auto& usage = it->second;
+		ramUsage -= usage.memUsage;
+		usage.memUsage = b->getMemUsage();
+		ramUsage += usage.memUsage;
+	}
+}
+
+void ReverseManager::ReverseHistory::addBlock(const DeltaBlock* block)
+{
+	auto& usage = blockUsage[block];
+	if (usage.count++) return; // already counted
+	usage.memUsage = block->getMemUsage();
+	ramUsage += usage.memUsage;
+	if (auto ref = block->getReference()) {
+		addBlock(ref);
+	}
+}
+
+size_t ReverseManager::ReverseHistory::removeBlock(const DeltaBlock* block)
+{
+	auto it = blockUsage.find(block);
+	assert(it != end(blockUsage));
+	if (--it->second.count) return 0; // still used
+	size_t freed = it->second.memUsage;
+	blockUsage.erase(it);
+	if (auto ref = block->getReference()) {
+		freed += removeBlock(ref);
+	}
+	return freed;
 }
 
 
@@ -131,6 +262,119 @@ public:
 };
 REGISTER_POLYMORPHIC_CLASS(StateChange, EndLogEvent, "EndLog");
 
+
+// struct Filler
+
+// The Filler emulates in the main thread, in slices of (at most) this much
+// host time (in us) every FILL_INTERVAL, so that the live machine and the
+// GUI stay responsive.
+static const uint64_t FILL_SLICE = 5000;
+static const uint64_t FILL_INTERVAL = 20000;
+// Emulated time per fastForward() step, a slice can only end after a step.
+static const double FILL_STEP = 0.01;
+
+struct ReverseManager::Filler final : public RTSchedulable
+{
+	// Emulate 'board' (see executeRT()) and take a snapshot at each of
+	// the 'targets'. The board must be a replay helper, see
+	// MSXMotherBoard::setReplayHelper().
+	Filler(RTScheduler& rtScheduler, Reactor::Board board_,
+	       vector<EmuTime> targets_, unsigned eventBase_);
+	~Filler();
+
+	// Returns the snapshots that are ready so far, and the blocks (of
+	// earlier results) that got compressed in the mean time.
+	vector<ReverseChunk> takeResults(Blocks& compressed);
+	bool isDone() const { return done; }
+
+	void executeRT() override;
+
+	Reactor::Board board;
+	const vector<EmuTime> targets;
+	size_t nextTarget;
+	const unsigned eventBase;
+	LastDeltaBlocks lastDeltaBlocks;
+	vector<ReverseChunk> results;
+	Blocks compressedBlocks;
+	bool done;
+};
+
+ReverseManager::Filler::Filler(RTScheduler& rtScheduler, Reactor::Board board_,
+                               vector<EmuTime> targets_, unsigned eventBase_)
+	: RTSchedulable(rtScheduler)
+	, board(move(board_))
+	, targets(move(targets_))
+	, nextTarget(0)
+	, eventBase(eventBase_)
+	, done(false)
+{
+	assert(board->isReplayHelper());
+	assert(!targets.empty());
+	// MSXMotherBoard::fastForward() (un)mutes the MSXMixer, keep it muted
+	// so that it isn't (un)registered in the global Mixer for each step.
+	board->getMSXMixer().mute();
+	scheduleRT(0);
+}
+
+ReverseManager::Filler::~Filler()
+{
+	board->getMSXMixer().unmute();
+}
+
+vector<ReverseManager::ReverseChunk> ReverseManager::Filler::takeResults(
+	Blocks& compressed)
+{
+	vector<ReverseChunk> result;
+	swap(result, results);
+	swap(compressed, compressedBlocks);
+	return result;
+}
+
+void ReverseManager::Filler::executeRT()
+{
+	// Don't count the emulation of 'board' as cpu/scheduler time.
+	HostTimer timer(HostProfiler::REVERSE_FILLER, true);
+	auto& manager = board->getReverseManager();
+	uint64_t sliceEnd = Timer::getTime() + FILL_SLICE;
+	do {
+		auto& target = targets[nextTarget];
+		if (board->getCurrentTime() < target) {
+			try {
+				board->fastForward(std::min(target,
+					board->getCurrentTime() + EmuDuration(FILL_STEP)),
+					true);
+			} catch (MSXException&) {
+				done = true;
+				return;
+			}
+			if (board->getDiscardedWritesFlag()) {
+				// A write to a disk image was dropped, from now on
+				// the emulation differs from the original. Only
+				// keep the snapshots taken so far.
+				done = true;
+				return;
+			}
+			continue;
+		}
+		ReverseChunk chunk;
+		chunk.time = board->getCurrentTime();
+		MemOutputArchive out(lastDeltaBlocks, chunk.deltaBlocks, true);
+		out.serialize("machine", *board);
+		chunk.savestate = out.releaseBuffer(chunk.size);
+		auto compressed = lastDeltaBlocks.finalize();
+		compressedBlocks.insert(end(compressedBlocks),
+		                        begin(compressed), end(compressed));
+		chunk.eventCount = eventBase + manager.replayIndex;
+		results.push_back(move(chunk));
+		if (++nextTarget == targets.size()) {
+			done = true;
+			return;
+		}
+	} while (Timer::getTime() < sliceEnd);
+	scheduleRT(FILL_INTERVAL);
+}
+
+
 // class ReverseManager
 
 ReverseManager::ReverseManager(MSXMotherBoard& motherBoard_)
@@ -141,6 +385,12 @@ ReverseManager::ReverseManager(MSXMotherBoard& motherBoard_)
 	, reverseCmd(motherBoard.getCommandController())
 	, keyboard(nullptr)
 	, eventDelay(nullptr)
+	, pendingSeqNum(0)
+	, abortSpill(false)
+	, ramBudgetSetting(motherBoard.getCommandController(),
+		"reverse_ram_budget", "Maximum amount of memory (in MB) used "
+		"for the reverse history, older snapshots are moved to disk "
+		"when it gets bigger. 0 means unlimited.", 0, 0, 1 << 20)
 	, replayIndex(0)
 	, collecting(false)
 	, pendingTakeSnapshot(false)
@@ -179,6 +429,9 @@ void ReverseManager::start()
 
 void ReverseManager::stop()
 {
+	stopFiller();
+	abortSpill = true; // the history is discarded, don't move it to disk
+	finishSnapshot();
 	if (isCollecting()) {
 		motherBoard.getStateChangeDistributor().unregisterRecorder(*this);
 		syncNewSnapshot.removeSyncPoint(); // don't schedule new snapshot takings
@@ -219,8 +472,11 @@ void ReverseManager::status(TclObject& result) const
 	}
 
 	result.addListElement("begin");
-	EmuTime b(isCollecting() ? begin(history.chunks)->second.time
-	                         : EmuTime::zero);
+	// Note: the first snapshot might still be in the process of being
+	// finalized (see pollSnapshot()).
+	EmuTime b((isCollecting() && !history.chunks.empty())
+	          ? begin(history.chunks)->second.time
+	          : EmuTime::zero);
 	result.addListElement((b - EmuTime::zero).toDouble());
 
 	result.addListElement("end");
@@ -246,6 +502,12 @@ void ReverseManager::status(TclObject& result) const
 	}
 	EmuTime le(isCollecting() && (lastEvent != history.events.rend()) ? (*lastEvent)->getTime() : EmuTime::zero);
 	result.addListElement((le - EmuTime::zero).toDouble());
+
+	// memory and disk usage (in bytes) of the snapshots
+	result.addListElement("ram_usage");
+	result.addListElement(double(isCollecting() ? history.ramUsage : 0));
+	result.addListElement("disk_usage");
+	result.addListElement(double(history.store ? history.store->getUsedSize() : 0));
 }
 
 void ReverseManager::debugInfo(TclObject& result) const
@@ -260,10 +522,15 @@ void ReverseManager::debugInfo(TclObject& result) const
 		    << (chunk.time - EmuTime::zero).toDouble() << ' '
 		    << ((chunk.time - EmuTime::zero).toDouble() / (getCurrentTime() - EmuTime::zero).toDouble()) * 100 << '%'
 		    << " (" << chunk.size << ')'
+		    << (chunk.replayFile ? " (in replay file)" : "")
+		    << (chunk.spilled ? " (on disk)" : "")
 		    << " (next event index: " << chunk.eventCount << ")\n";
 		totalSize += chunk.size;
 	}
 	res << "total size: " << totalSize << '\n';
+	if (filler) {
+		res << "filling in snapshots in the background\n";
+	}
 	result.setString(string(res));
 }
 
@@ -415,10 +682,7 @@ void ReverseManager::goTo(
 			// -- restore old snapshot --
 			newBoard_ = reactor.createEmptyMotherBoard();
 			newBoard = newBoard_.get();
-			MemInputArchive in(chunk.savestate.data(),
-					   chunk.size,
-					   chunk.deltaBlocks);
-			in.serialize("machine", *newBoard);
+			chunk.restore(*newBoard);
 
 			if (eventDelay) {
 				// Handle all events that are scheduled, but not yet
@@ -493,6 +757,13 @@ void ReverseManager::goTo(
 		// re-enable automatic snapshots
 		schedule(getCurrentTime());
 
+		// Above we only took a few snapshots, fill in the others in
+		// the background. That makes later jumps in this region fast.
+		if (newBoard_) {
+			newBoard->getReverseManager().startFiller(
+				snapshotTime, preTarget);
+		}
+
 		// switch to the new MSXMotherBoard
 		//  Note: this deletes the current MSXMotherBoard and
 		//  ReverseManager. So we can't access those objects anymore.
@@ -537,6 +808,9 @@ void ReverseManager::transferState(MSXMotherBoard& newBoard)
 	// transfer watchpoints
 	newBoard.getDebugger().transfer(motherBoard.getDebugger());
 
+	// transfer cpu_profile state
+	newBoard.getCPU().transferProfiler(motherBoard.getCPU());
+
 	// copy rerecord count
 	newManager.reRecordCount = reRecordCount;
 
@@ -555,55 +829,30 @@ void ReverseManager::saveReplay(
 
 	string filename;
 	int maxNofExtraSnapshots = MAX_NOF_SNAPSHOTS;
-	switch (tokens.size()) {
-	case 2:
-		// nothing
-		break;
-	case 3:
-		filename = tokens[2].getString().str();
-		break;
-	case 4:
-	case 5:
-		size_t tn;
-		for (tn = 2; tn < (tokens.size() - 1); ++tn) {
-			if (tokens[tn] == "-maxnofextrasnapshots") {
-				maxNofExtraSnapshots = tokens[tn + 1].getInt(interp);
-				break;
+	bool xml = false;
+	for (size_t i = 2; i < tokens.size(); ++i) {
+		string_ref token = tokens[i].getString();
+		if (token == "-maxnofextrasnapshots") {
+			if (++i == tokens.size()) throw SyntaxError();
+			maxNofExtraSnapshots = tokens[i].getInt(interp);
+			if (maxNofExtraSnapshots < 0) {
+				throw CommandException("Maximum number of snapshots should be at least 0");
 			}
+		} else if (token == "-xml") {
+			xml = true;
+		} else {
+			if (!filename.empty()) throw SyntaxError();
+			filename = token.str();
 		}
-		if (tn == (tokens.size() - 1)) throw SyntaxError();
-		if (tokens.size() == 5) {
-			filename = tokens[tn == 2 ? 4 : 2].getString().str();
-		}
-		if (maxNofExtraSnapshots < 0) {
-			throw CommandException("Maximum number of snapshots should be at least 0");
-		}
-
-		break;
-	default:
-		throw SyntaxError();
 	}
 	filename = FileOperations::parseCommandFileArgument(
 		filename, REPLAY_DIR, "openmsx", ".omr");
 
-	auto& reactor = motherBoard.getReactor();
-	Replay replay(reactor);
-	replay.reRecordCount = reRecordCount;
-
-	// store current time (possibly somewhere in the middle of the timeline)
-	// so that on load we can go back there
-	replay.currentTime = getCurrentTime();
-
-	// restore first snapshot to be able to serialize it to a file
-	auto initialBoard = reactor.createEmptyMotherBoard();
-	MemInputArchive in(begin(chunks)->second.savestate.data(),
-	                   begin(chunks)->second.size,
-			   begin(chunks)->second.deltaBlocks);
-	in.serialize("machine", *initialBoard);
-	replay.motherBoards.push_back(move(initialBoard));
-
+	// determine which snapshots to put in the replay, the first one is
+	// always included
+	vector<const ReverseChunk*> selected;
+	selected.push_back(&begin(chunks)->second);
 	if (maxNofExtraSnapshots > 0) {
-		// determine which extra snapshots to put in the replay
 		const auto& startTime = begin(chunks)->second.time;
 		// for the end time, try to take MAX_DIST_1_BEFORE_LAST_SNAPSHOT
 		// seconds before the normal end time so that we get an extra snapshot
@@ -624,12 +873,7 @@ void ReverseManager::saveReplay(
 				assert(it->second.time <= nextPartitionEnd);
 				if (it != lastAddedIt) {
 					// this is a new one, add it to the list of snapshots
-					Reactor::Board board = reactor.createEmptyMotherBoard();
-					MemInputArchive in2(it->second.savestate.data(),
-							    it->second.size,
-							    it->second.deltaBlocks);
-					in2.serialize("machine", *board);
-					replay.motherBoards.push_back(move(board));
+					selected.push_back(&it->second);
 					lastAddedIt = it;
 				}
 				++it;
@@ -650,9 +894,11 @@ void ReverseManager::saveReplay(
 			getCurrentTime()));
 	}
 	try {
-		XmlOutputArchive out(filename);
-		replay.events = &history.events;
-		out.serialize("replay", replay);
+		if (xml) {
+			saveXmlReplay(filename, selected);
+		} else {
+			saveBinReplay(filename, selected);
+		}
 	} catch (MSXException&) {
 		if (addSentinel) {
 			history.events.pop_back();
@@ -671,6 +917,58 @@ void ReverseManager::saveReplay(
 	result.setString("Saved replay to " + filename);
 }
 
+void ReverseManager::saveXmlReplay(const string& filename,
+                                   const vector<const ReverseChunk*>& selected)
+{
+	auto& reactor = motherBoard.getReactor();
+	Replay replay(reactor);
+	replay.reRecordCount = reRecordCount;
+
+	// store current time (possibly somewhere in the middle of the timeline)
+	// so that on load we can go back there
+	replay.currentTime = getCurrentTime();
+
+	// restore the snapshots to be able to serialize them to a file
+	for (auto* chunk : selected) {
+		Reactor::Board board = reactor.createEmptyMotherBoard();
+		chunk->restore(*board);
+		replay.motherBoards.push_back(move(board));
+	}
+
+	XmlOutputArchive out(filename);
+	replay.events = &history.events;
+	out.serialize("replay", replay);
+}
+
+void ReverseManager::saveBinReplay(const string& filename,
+                                   const vector<const ReverseChunk*>& selected)
+{
+	// The snapshots could be read from (a memory mapped) 'filename'
+	// itself, so don't overwrite it in place.
+	string tmpName = filename + ".tmp";
+	try {
+		auto& reactor = motherBoard.getReactor();
+		ReplayFile::Writer writer(tmpName);
+		for (auto* chunk : selected) {
+			// only one snapshot needs to be in memory at a time
+			Reactor::Board board = reactor.createEmptyMotherBoard();
+			chunk->restore(*board);
+			writer.addSnapshot(*board, chunk->eventCount);
+		}
+		// also store the current time (see saveXmlReplay())
+		writer.finish(history.events, getCurrentTime(), reRecordCount);
+	} catch (MSXException&) {
+		FileOperations::unlink(tmpName);
+		throw;
+	}
+	FileOperations::unlink(filename);
+	if (FileOperations::rename(tmpName, filename) != 0) {
+		FileOperations::unlink(tmpName);
+		throw MSXException("couldn't rename " + tmpName + " to " +
+		                   filename);
+	}
+}
+
 void ReverseManager::loadReplay(
 	Interpreter& interp, array_ref<TclObject> tokens, TclObject& result)
 {
@@ -720,9 +1018,19 @@ void ReverseManager::loadReplay(
 	Replay replay(reactor);
 	Events events;
 	replay.events = &events;
+	std::shared_ptr<ReplayFile> replayFile;
 	try {
-		XmlInputArchive in(filename);
-		in.serialize("replay", replay);
+		if (ReplayFile::isReplayFile(filename)) {
+			// only reads the index and the events, the snapshots
+			// are decoded when needed
+			replayFile = std::make_shared<ReplayFile>(filename);
+			events = replayFile->releaseEvents();
+			replay.currentTime = replayFile->getCurrentTime();
+			replay.reRecordCount = replayFile->getReRecordCount();
+		} else {
+			XmlInputArchive in(filename);
+			in.serialize("replay", replay);
+		}
 	} catch (XMLException& e) {
 		throw CommandException("Cannot load replay, bad file format: " + e.getMessage());
 	} catch (MSXException& e) {
@@ -747,48 +1055,63 @@ void ReverseManager::loadReplay(
 	// now we can change the view only mode
 	motherBoard.getStateChangeDistributor().setViewOnlyMode(enableViewOnly);
 
-	assert(!replay.motherBoards.empty());
-	auto& newReverseManager = replay.motherBoards[0]->getReverseManager();
-	auto& newHistory = newReverseManager.history;
-
-	if (newReverseManager.reRecordCount == 0) {
-		// serialize Replay version >= 4
-		newReverseManager.reRecordCount = replay.reRecordCount;
-	} else {
-		// newReverseManager.reRecordCount is initialized via
-		// call from MSXMotherBoard to setReRecordCount()
-	}
+	ReverseHistory newHistory;
+	unsigned newReRecordCount = replay.reRecordCount;
 
 	// Restore event log
 	swap(newHistory.events, events);
 	auto& newEvents = newHistory.events;
 
 	// Restore snapshots
-	unsigned replayIdx = 0;
-	for (auto& m : replay.motherBoards) {
-		ReverseChunk newChunk;
-		newChunk.time = m->getCurrentTime();
-
-		MemOutputArchive out(newHistory.lastDeltaBlocks,
-		                     newChunk.deltaBlocks, false);
-		out.serialize("machine", *m);
-		newChunk.savestate = out.releaseBuffer(newChunk.size);
-
-		// update replayIdx
-		// TODO: should we use <= instead??
-		while (replayIdx < newEvents.size() &&
-		       (newEvents[replayIdx]->getTime() < newChunk.time)) {
-			replayIdx++;
+	if (replayFile) {
+		auto& snapshots = replayFile->getSnapshots();
+		for (auto i : xrange(snapshots.size())) {
+			ReverseChunk newChunk;
+			newChunk.time = snapshots[i].time;
+			newChunk.eventCount = snapshots[i].eventCount;
+			newChunk.replayFile = replayFile;
+			newChunk.replaySnapshot = unsigned(i);
+			newHistory.addChunk(newHistory.getNextSeqNum(newChunk.time),
+			                    move(newChunk));
 		}
-		newChunk.eventCount = replayIdx;
+	} else {
+		assert(!replay.motherBoards.empty());
+		auto& newReverseManager = replay.motherBoards[0]->getReverseManager();
+		if (newReverseManager.reRecordCount != 0) {
+			// For serialize Replay version < 4, reRecordCount is
+			// initialized via call from MSXMotherBoard to
+			// setReRecordCount()
+			newReRecordCount = newReverseManager.reRecordCount;
+		}
+
+		unsigned replayIdx = 0;
+		for (auto& m : replay.motherBoards) {
+			ReverseChunk newChunk;
+			newChunk.time = m->getCurrentTime();
+
+			MemOutputArchive out(newHistory.lastDeltaBlocks,
+			                     newChunk.deltaBlocks, false);
+			out.serialize("machine", *m);
+			newChunk.savestate = out.releaseBuffer(newChunk.size);
+			newHistory.updateRamUsage(
+				newHistory.lastDeltaBlocks.finalize());
+
+			// update replayIdx
+			// TODO: should we use <= instead??
+			while (replayIdx < newEvents.size() &&
+			       (newEvents[replayIdx]->getTime() < newChunk.time)) {
+				replayIdx++;
+			}
+			newChunk.eventCount = replayIdx;
 
-		newHistory.chunks[newHistory.getNextSeqNum(newChunk.time)] =
-			move(newChunk);
+			newHistory.addChunk(newHistory.getNextSeqNum(newChunk.time),
+			                    move(newChunk));
+		}
 	}
 
 	// Note: untill this point we didn't make any changes to the current
 	// ReverseManager/MSXMotherBoard yet
-	reRecordCount = newReverseManager.reRecordCount;
+	reRecordCount = newReRecordCount;
 	bool novideo = false;
 	goTo(destination, novideo, newHistory, false); // move to different time-line
 
@@ -879,6 +1202,7 @@ int ReverseManager::signalEvent(const shared_ptr<const Event>& event)
 	// machine that requested the snapshot.
 	if (pendingTakeSnapshot) {
 		pendingTakeSnapshot = false;
+		pollFiller();
 		takeSnapshot(getCurrentTime());
 		// schedule creation of next snapshot
 		schedule(getCurrentTime());
@@ -898,6 +1222,10 @@ unsigned ReverseManager::ReverseHistory::getNextSeqNum(EmuTime::param time) cons
 
 void ReverseManager::takeSnapshot(EmuTime::param time)
 {
+	// Normally the previous snapshot was finalized long ago, if not we
+	// have to wait for it here.
+	finishSnapshot();
+
 	// (possibly) drop old snapshots
 	// TODO does snapshot pruning still happen correctly (often enough)
 	//      when going back/forward in time?
@@ -910,13 +1238,243 @@ void ReverseManager::takeSnapshot(EmuTime::param time)
 	// the same moment in time).
 
 	// actually create new snapshot
-	ReverseChunk& newChunk = history.chunks[seqNum];
-	newChunk.deltaBlocks.clear();
-	MemOutputArchive out(history.lastDeltaBlocks, newChunk.deltaBlocks, true);
+	// This only copies the (changed) memory blocks, the expensive part
+	// (calculating deltas and compression) happens in a background thread.
+	pendingChunk.deltaBlocks.clear();
+	MemOutputArchive out(history.lastDeltaBlocks, pendingChunk.deltaBlocks, true);
 	out.serialize("machine", motherBoard);
-	newChunk.time = time;
-	newChunk.savestate = out.releaseBuffer(newChunk.size);
-	newChunk.eventCount = replayIndex;
+	pendingChunk.time = time;
+	pendingChunk.savestate = out.releaseBuffer(pendingChunk.size);
+	pendingChunk.eventCount = replayIndex;
+	pendingSeqNum = seqNum;
+
+	// Also move older chunks to disk (in the same background thread) when
+	// the history (without this new chunk) uses too much memory.
+	selectSpillChunks();
+	pendingFinalize = std::async(std::launch::async, [this]() {
+		compressedBlocks = history.lastDeltaBlocks.finalize();
+		for (auto* chunk : spillChunks) {
+			if (abortSpill) break;
+			spillResults.push_back(spillChunk(*history.store, *chunk));
+		}
+	});
+}
+
+void ReverseManager::finishSnapshot()
+{
+	if (!pendingFinalize.valid()) return;
+
+	string spillError;
+	try {
+		pendingFinalize.get();
+	} catch (MSXException& e) {
+		spillError = e.getMessage();
+	}
+	abortSpill = false;
+
+	history.updateRamUsage(compressedBlocks);
+	compressedBlocks.clear();
+	for (auto i : xrange(spillChunks.size())) {
+		auto& chunk = *spillChunks[i];
+		if (i < spillResults.size()) {
+			chunk.spilled = move(spillResults[i]);
+			MemBuffer<uint8_t>().swap(chunk.savestate);
+			chunk.deltaBlocks.clear();
+		} else {
+			// aborted or failed, it stays in memory
+			history.addRamUsage(chunk);
+		}
+	}
+	spillChunks.clear();
+	spillResults.clear();
+
+	history.addChunk(pendingSeqNum, move(pendingChunk));
+	pendingChunk = ReverseChunk();
+
+	if (!spillError.empty()) {
+		disableRamBudget(spillError);
+	}
+}
+
+// Select the oldest chunks that should move to disk to get the history
+// within the memory budget. They're written by the background thread (see
+// takeSnapshot()), they're already uncounted from 'ramUsage' here.
+void ReverseManager::selectSpillChunks()
+{
+	assert(spillChunks.empty());
+	size_t budget = size_t(ramBudgetSetting.getInt()) * 1024 * 1024;
+	if ((budget == 0) || (history.ramUsage <= budget)) return;
+
+	// The Filler (in the main thread) compresses blocks of the snapshots
+	// it already delivered, those can't be written at the same time.
+	if (filler) return;
+
+	// Always keep the most recent chunks in memory: the next snapshot
+	// uses their blocks as reference.
+	static const size_t KEEP_IN_RAM = 2;
+	if (history.chunks.size() <= KEEP_IN_RAM) return;
+
+	if (!history.store) {
+		try {
+			history.store = std::make_shared<ChunkStore>();
+		} catch (MSXException& e) {
+			disableRamBudget(e.getMessage());
+			return;
+		}
+	}
+	auto last = std::prev(end(history.chunks), KEEP_IN_RAM);
+	for (auto it = begin(history.chunks);
+	     (it != last) && (history.ramUsage > budget); ++it) {
+		auto& chunk = it->second;
+		if (chunk.spilled || chunk.replayFile) continue;
+		// only counts the blocks that aren't shared with other chunks
+		history.removeRamUsage(chunk);
+		spillChunks.push_back(&chunk);
+	}
+}
+
+void ReverseManager::disableRamBudget(const string& reason)
+{
+	motherBoard.getMSXCliComm().printWarning(
+		"Couldn't move reverse history to disk, disabling "
+		"reverse_ram_budget: " + reason);
+	ramBudgetSetting.setInt(0);
+}
+
+// Called from the background thread.
+std::shared_ptr<ChunkStore::Handle> ReverseManager::spillChunk(
+	ChunkStore& store, const ReverseChunk& chunk)
+{
+	// Layout: savestate size, number of delta blocks, the size of each
+	// block (all as 64-bit values), the savestate, the (uncompressed)
+	// content of each block.
+	size_t numBlocks = chunk.deltaBlocks.size();
+	size_t total = (2 + numBlocks) * sizeof(uint64_t) + chunk.size;
+	for (auto& b : chunk.deltaBlocks) total += b->getSize();
+	MemBuffer<uint8_t> buf(total);
+	uint8_t* p = buf.data();
+	uint64_t header[2] = { chunk.size, numBlocks };
+	memcpy(p, header, sizeof(header));
+	p += sizeof(header);
+	for (auto& b : chunk.deltaBlocks) {
+		uint64_t size = b->getSize();
+		memcpy(p, &size, sizeof(size));
+		p += sizeof(size);
+	}
+	memcpy(p, chunk.savestate.data(), chunk.size);
+	p += chunk.size;
+	for (auto& b : chunk.deltaBlocks) {
+		b->apply(p, b->getSize());
+		p += b->getSize();
+	}
+	assert(p == (buf.data() + total));
+
+	return store.write(buf.data(), total);
+}
+
+void ReverseManager::pollSnapshot()
+{
+	if (pendingFinalize.valid() &&
+	    (pendingFinalize.wait_for(std::chrono::seconds(0)) ==
+	     std::future_status::ready)) {
+		finishSnapshot();
+	}
+}
+
+// Only used for the helper board of a Filler: replay the given events, but
+// don't take snapshots.
+void ReverseManager::replayEvents(Events&& events)
+{
+	assert(!isCollecting());
+	assert(!events.empty());
+	history.events = std::move(events);
+	replayIndex = 0;
+	collecting = true; // so that stop() cleans up
+	motherBoard.getStateChangeDistributor().registerRecorder(*this);
+	replayNextEvent();
+}
+
+void ReverseManager::startFiller(EmuTime::param from, EmuTime::param to)
+{
+	stopFiller();
+	finishSnapshot(); // all chunks must be finalized before we restore one
+
+	// Which snapshots are missing? Only fill in the ones closest to 'to'.
+	auto& chunks = history.chunks;
+	if (chunks.empty()) return;
+	auto startTime = begin(chunks)->second.time;
+	unsigned first = history.getNextSeqNum(from) + 1;
+	unsigned last  = history.getNextSeqNum(to);
+	vector<EmuTime> targets;
+	for (unsigned seqNum = last; seqNum-- > first; ) {
+		if (chunks.find(seqNum) != end(chunks)) continue;
+		targets.push_back(startTime + EmuDuration(seqNum * SNAPSHOT_PERIOD));
+		if (targets.size() == MAX_FILL_SNAPSHOTS) break;
+	}
+	if (targets.empty()) return;
+	std::reverse(begin(targets), end(targets));
+
+	// start from the last snapshot before the first target
+	auto it = std::find_if(chunks.rbegin(), chunks.rend(),
+		[&](const Chunks::value_type& p) {
+			return p.second.time <= targets.front(); });
+	if (it == chunks.rend()) return;
+	const auto& chunk = it->second;
+
+	// The events between that snapshot and the last target. Recorded
+	// commands are executed via Tcl, they can have effects outside the
+	// emulated machine, so stop before the first one.
+	auto& events = history.events;
+	EmuTime endTime = targets.back() + EmuDuration(SNAPSHOT_PERIOD);
+	unsigned idx = chunk.eventCount;
+	for (/**/; idx < events.size(); ++idx) {
+		auto& e = events[idx];
+		if (e->getTime() >= endTime) break;
+		if (dynamic_cast<const EndLogEvent*>(e.get())) break;
+		if (dynamic_cast<const MSXCommandEvent*>(e.get())) {
+			endTime = e->getTime();
+			break;
+		}
+	}
+	while (!targets.empty() && (targets.back() >= endTime)) {
+		targets.pop_back();
+	}
+	if (targets.empty()) return;
+	Events fillEvents(begin(events) + chunk.eventCount, begin(events) + idx);
+	fillEvents.push_back(std::make_shared<EndLogEvent>(endTime));
+
+	auto& reactor = motherBoard.getReactor();
+	auto board = reactor.createEmptyMotherBoard();
+	board->setReplayHelper(); // before restore() creates the devices
+	chunk.restore(*board);
+	if (!board->isPowered()) return;
+	board->getReverseManager().replayEvents(move(fillEvents));
+	filler.reset(new Filler(reactor.getRTScheduler(), move(board),
+	                        move(targets), chunk.eventCount));
+}
+
+void ReverseManager::pollFiller()
+{
+	if (!filler) return;
+	bool done = filler->isDone(); // check before taking the results
+	Blocks compressed;
+	auto results = filler->takeResults(compressed);
+	for (auto& chunk : results) {
+		// only add snapshots that weren't created in the mean time
+		unsigned seqNum = history.getNextSeqNum(chunk.time);
+		if (history.chunks.find(seqNum) == end(history.chunks)) {
+			history.addChunk(seqNum, move(chunk));
+		}
+	}
+	history.updateRamUsage(compressed);
+	if (done) {
+		filler.reset();
+	}
+}
+
+void ReverseManager::stopFiller()
+{
+	filler.reset();
 }
 
 void ReverseManager::replayNextEvent()
@@ -954,6 +1512,7 @@ void ReverseManager::signalStopReplay(EmuTime::param time)
 
 void ReverseManager::stopReplay(EmuTime::param time)
 {
+	finishSnapshot();
 	if (isReplaying()) {
 		// if we're replaying, stop it and erase remainder of event log
 		syncInputEvent.removeSyncPoint();
@@ -962,7 +1521,7 @@ void ReverseManager::stopReplay(EmuTime::param time)
 		// search snapshots that are newer than 'time' and erase them
 		auto it = find_if(begin(history.chunks), end(history.chunks),
 			[&](Chunks::value_type& p) { return p.second.time > time; });
-		history.chunks.erase(it, end(history.chunks));
+		history.eraseChunks(it, end(history.chunks));
 		// this also means someone is changing history, record that
 		reRecordCount++;
 	}
@@ -990,7 +1549,10 @@ void ReverseManager::dropOldSnapshots(unsigned count)
 	while (true) {
 		y >>= 1;
 		if ((y == 0) || (count < d)) return;
-		history.chunks.erase(count - d);
+		auto it = history.chunks.find(count - d);
+		if (it != end(history.chunks)) {
+			history.eraseChunks(it, std::next(it));
+		}
 		d += d2;
 		d2 *= 2;
 	}
@@ -1017,6 +1579,14 @@ void ReverseManager::ReverseCmd::execute(array_ref<TclObject> tokens, TclObject&
 	auto& manager = OUTER(ReverseManager, reverseCmd);
 	auto& interp = getInterpreter();
 	string_ref subcommand = tokens[1].getString();
+	// 'status' is queried very often (e.g. by the reverse bar), don't
+	// block on a snapshot that's still being finalized for it.
+	if ((subcommand == "status") || (subcommand == "debug")) {
+		manager.pollSnapshot();
+	} else {
+		manager.finishSnapshot();
+	}
+	manager.pollFiller();
 	if        (subcommand == "start") {
 		manager.start();
 	} else if (subcommand == "stop") {
@@ -1063,7 +1633,7 @@ string ReverseManager::ReverseCmd::help(const vector<string>& /*tokens*/) const
 	       "goto <time>         go to an absolute moment in time\n"
 	       "viewonlymode <bool> switch viewonly mode on or off\n"
 	       "truncatereplay      stop replaying and remove all 'future' data\n"
-	       "savereplay [<name>] save the first snapshot and all replay data as a 'replay' (with optional name)\n"
+	       "savereplay [-xml] [-maxnofextrasnapshots <n>] [<name>] save the first snapshot, some extra snapshots and all replay data as a 'replay' (with optional name)\n"
 	       "loadreplay [-goto <begin|end|savetime|<n>>] [-viewonly] <name>   load a replay (snapshot and replay data) with given name and start replaying\n";
 }
 
@@ -1076,11 +1646,14 @@ void ReverseManager::ReverseCmd::tabCompletion(vector<string>& tokens) const
 			"truncatereplay",
 		};
 		completeString(tokens, subCommands);
-	} else if ((tokens.size() == 3) || (tokens[1] == "loadreplay")) {
+	} else if ((tokens.size() == 3) || (tokens[1] == "loadreplay") ||
+	           (tokens[1] == "savereplay")) {
 		if (tokens[1] == "loadreplay" || tokens[1] == "savereplay") {
 			std::vector<const char*> cmds;
 			if (tokens[1] == "loadreplay") {
 				cmds = { "-goto", "-viewonly" };
+			} else {
+				cmds = { "-xml", "-maxnofextrasnapshots" };
 			}
 			completeFileName(tokens, userDataFileContext(REPLAY_DIR), cmds);
 		} else if (tokens[1] == "viewonlymode") {
@@ -8,16 +8,22 @@
 #include "EmuTime.hh"
 #include "MemBuffer.hh"
 #include "DeltaBlock.hh"
+#include "ChunkStore.hh"
+#include "IntegerSetting.hh"
 #include "array_ref.hh"
 #include "outer.hh"
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <memory>
+#include <future>
+#include <atomic>
 #include <cstdint>
 
 namespace openmsx {
 
 class MSXMotherBoard;
+class ReplayFile;
 class Keyboard;
 class EventDelay;
 class EventDistributor;
@@ -52,7 +58,10 @@ public:
 
 private:
 	struct ReverseChunk {
-		ReverseChunk() : time(EmuTime::zero) {}
+		ReverseChunk() : time(EmuTime::zero), size(0), replaySnapshot(0) {}
+
+		/** Restore this snapshot in an empty motherboard. */
+		void restore(MSXMotherBoard& board) const;
 
 		EmuTime time;
 		std::vector<std::shared_ptr<DeltaBlock>> deltaBlocks;
@@ -63,18 +72,61 @@ private:
 		// snapshot was created. So when going back replay should
 		// start at this index.
 		unsigned eventCount;
+
+		// Snapshots loaded from a binary replay file are only decoded
+		// when needed. For such chunks 'savestate' is empty and the
+		// data is taken from snapshot 'replaySnapshot' in this file.
+		std::shared_ptr<ReplayFile> replayFile;
+		unsigned replaySnapshot;
+
+		// When the history uses more memory than allowed, older
+		// chunks are moved to disk. Then 'savestate' and 'deltaBlocks'
+		// are empty and the data is stored in this ChunkStore entry.
+		std::shared_ptr<ChunkStore::Handle> spilled;
 	};
 	using Chunks = std::map<unsigned, ReverseChunk>;
 	using Events = std::vector<std::shared_ptr<StateChange>>;
 
+	using Blocks = std::vector<std::shared_ptr<DeltaBlock>>;
+
 	struct ReverseHistory {
+		ReverseHistory() : ramUsage(0) {}
 		void swap(ReverseHistory& other);
 		void clear();
 		unsigned getNextSeqNum(EmuTime::param time) const;
 
+		// Add a chunk, replaces an existing chunk with the same number.
+		void addChunk(unsigned seqNum, ReverseChunk&& chunk);
+		void eraseChunks(Chunks::iterator first, Chunks::iterator last);
+		// (Un)count the memory of a chunk that stays in 'chunks' (e.g.
+		// because it's moved to disk). removeRamUsage() returns the
+		// number of bytes that are freed, that's less than the size of
+		// the chunk when it shares delta blocks with other chunks.
+		void addRamUsage(const ReverseChunk& chunk);
+		size_t removeRamUsage(const ReverseChunk& chunk);
+		// The memory usage of these blocks changed (they got compressed).
+		void updateRamUsage(const Blocks& blocks);
+
 		Chunks chunks;
 		Events events;
 		LastDeltaBlocks lastDeltaBlocks;
+		std::shared_ptr<ChunkStore> store; // created on first use
+
+		// Memory used by the chunks that are in memory (so not moved to
+		// disk or in a replay file). Kept up to date by the methods
+		// above. Blocks shared by several chunks and the reference
+		// blocks of deltas are counted once: 'blockUsage' holds for
+		// each counted block the number of users and the counted size.
+		struct BlockUsage {
+			unsigned count;
+			size_t memUsage;
+		};
+		std::unordered_map<const DeltaBlock*, BlockUsage> blockUsage;
+		size_t ramUsage;
+
+	private:
+		void addBlock(const DeltaBlock* block);
+		size_t removeBlock(const DeltaBlock* block);
 	};
 
 	bool isCollecting() const { return collecting; }
@@ -87,6 +139,10 @@ private:
 	void goTo(array_ref<TclObject> tokens);
 	void saveReplay(Interpreter& interp,
 	                array_ref<TclObject> tokens, TclObject& result);
+	void saveXmlReplay(const std::string& filename,
+	                   const std::vector<const ReverseChunk*>& selected);
+	void saveBinReplay(const std::string& filename,
+	                   const std::vector<const ReverseChunk*>& selected);
 	void loadReplay(Interpreter& interp,
 	                array_ref<TclObject> tokens, TclObject& result);
 
@@ -99,6 +155,16 @@ private:
 	                     unsigned oldEventCount);
 	void transferState(MSXMotherBoard& newBoard);
 	void takeSnapshot(EmuTime::param time);
+	void finishSnapshot();
+	void pollSnapshot();
+	void replayEvents(Events&& events);
+	void startFiller(EmuTime::param from, EmuTime::param to);
+	void pollFiller();
+	void stopFiller();
+	void selectSpillChunks();
+	void disableRamBudget(const std::string& reason);
+	static std::shared_ptr<ChunkStore::Handle> spillChunk(
+		ChunkStore& store, const ReverseChunk& chunk);
 	void schedule(EmuTime::param time);
 	void replayNextEvent();
 	template<unsigned N> void dropOldSnapshots(unsigned count);
@@ -146,6 +212,29 @@ private:
 	Keyboard* keyboard;
 	EventDelay* eventDelay;
 	ReverseHistory history;
+
+	// The most recently taken snapshot. Its delta blocks are still being
+	// finalized in a background thread, only once that's done it gets
+	// added to 'history'.
+	ReverseChunk pendingChunk;
+	unsigned pendingSeqNum;
+	std::future<void> pendingFinalize;
+	// The background thread also moves these chunks to disk, when the
+	// history uses more memory than 'reverse_ram_budget' allows. The
+	// results are only applied in finishSnapshot().
+	std::vector<ReverseChunk*> spillChunks;
+	std::vector<std::shared_ptr<ChunkStore::Handle>> spillResults;
+	Blocks compressedBlocks; // returned by LastDeltaBlocks::finalize()
+	std::atomic<bool> abortSpill;
+
+	// A helper board that, in the background (in short time slices in the
+	// main thread), fills in the snapshots that were skipped during the
+	// fast-forward of a 'reverse goto'.
+	struct Filler;
+	std::unique_ptr<Filler> filler;
+
+	IntegerSetting ramBudgetSetting; // in MB, 0 means unlimited
+
 	unsigned replayIndex;
 	bool collecting;
 	bool pendingTakeSnapshot;
@@ -6,6 +6,9 @@ namespace openmsx {
 
 Schedulable::Schedulable(Scheduler& scheduler_)
 	: scheduler(scheduler_)
+#ifdef OPENMSX_SCHEDULER_HEAP
+	, syncPointNodes(nullptr)
+#endif
 {
 }
 
@@ -9,6 +9,7 @@
 namespace openmsx {
 
 class Scheduler;
+struct SchedulerHeapNode;
 
 // For backwards-compatible savestates
 struct SyncPointBW
@@ -99,6 +100,10 @@ protected:
 
 private:
 	Scheduler& scheduler;
+#ifdef OPENMSX_SCHEDULER_HEAP
+	SchedulerHeapNode* syncPointNodes; // owned by SchedulerHeap
+	friend class SchedulerHeap;
+#endif
 };
 REGISTER_BASE_CLASS(Schedulable, "Schedulable");
 
@@ -1,7 +1,9 @@
 #include "Scheduler.hh"
 #include "Schedulable.hh"
+#include "SchedulerTrace.hh"
 #include "Thread.hh"
 #include "MSXCPU.hh"
+#include "HostProfiler.hh"
 #include "serialize.hh"
 #include <cassert>
 #include <algorithm>
@@ -22,6 +24,7 @@ struct EqualSchedulable {
 Scheduler::Scheduler()
 	: scheduleTime(EmuTime::zero)
 	, cpu(nullptr)
+	, trace(nullptr)
 	, scheduleInProgress(false)
 {
 }
@@ -29,24 +32,42 @@ Scheduler::Scheduler()
 Scheduler::~Scheduler()
 {
 	assert(!cpu);
+#ifdef OPENMSX_SCHEDULER_HEAP
+	for (auto* device : queue.getDevices()) {
+		// a device can occur multiple times
+		EmuTime dummy = EmuTime::zero;
+		if (queue.findFirst(*device, dummy)) {
+			device->schedulerDeleted();
+		}
+	}
+#else
 	SyncPoints copy(std::begin(queue), std::end(queue));
 	for (auto& s : copy) {
 		s.getDevice()->schedulerDeleted();
 	}
+#endif
 
 	assert(queue.empty());
 }
 
 void Scheduler::setSyncPoint(EmuTime::param time, Schedulable& device)
 {
-	assert(Thread::isMainThread());
+	assert(Thread::isEmulationThread());
 	assert(time >= scheduleTime);
 
+	if (unlikely(trace != nullptr)) {
+		trace->record(SchedulerTrace::SET, device, time);
+	}
+
 	// Push sync point into queue.
+#ifdef OPENMSX_SCHEDULER_HEAP
+	queue.insert(time, device);
+#else
 	queue.insert(SynchronizationPoint(time, &device),
 	             [](SynchronizationPoint& sp) { sp.setTime(EmuTime::infinity); },
 	             [](const SynchronizationPoint& x, const SynchronizationPoint& y) {
 	                     return x.getTime() < y.getTime(); });
+#endif
 
 	if (!scheduleInProgress && cpu) {
 		// only when scheduleHelper() is not being executed
@@ -58,28 +79,58 @@ void Scheduler::setSyncPoint(EmuTime::param time, Schedulable& device)
 
 Scheduler::SyncPoints Scheduler::getSyncPoints(const Schedulable& device) const
 {
+	if (unlikely(trace != nullptr)) {
+		trace->record(SchedulerTrace::GET, device, scheduleTime);
+	}
+
 	SyncPoints result;
+#ifdef OPENMSX_SCHEDULER_HEAP
+	for (auto& time : queue.getTimes(device)) {
+		result.emplace_back(time, const_cast<Schedulable*>(&device));
+	}
+#else
 	copy_if(std::begin(queue), std::end(queue), back_inserter(result),
 	        EqualSchedulable(device));
+#endif
 	return result;
 }
 
 bool Scheduler::removeSyncPoint(Schedulable& device)
 {
-	assert(Thread::isMainThread());
+	assert(Thread::isEmulationThread());
+	if (unlikely(trace != nullptr)) {
+		trace->record(SchedulerTrace::REMOVE, device, scheduleTime);
+	}
+#ifdef OPENMSX_SCHEDULER_HEAP
+	return queue.removeOne(device);
+#else
 	return queue.remove(EqualSchedulable(device));
+#endif
 }
 
 void Scheduler::removeSyncPoints(Schedulable& device)
 {
-	assert(Thread::isMainThread());
+	assert(Thread::isEmulationThread());
+	if (unlikely(trace != nullptr)) {
+		trace->record(SchedulerTrace::REMOVE_ALL, device, scheduleTime);
+	}
+#ifdef OPENMSX_SCHEDULER_HEAP
+	queue.removeAll(device);
+#else
 	queue.remove_all(EqualSchedulable(device));
+#endif
 }
 
 bool Scheduler::pendingSyncPoint(const Schedulable& device,
                                  EmuTime& result) const
 {
-	assert(Thread::isMainThread());
+	assert(Thread::isEmulationThread());
+	if (unlikely(trace != nullptr)) {
+		trace->record(SchedulerTrace::PENDING, device, scheduleTime);
+	}
+#ifdef OPENMSX_SCHEDULER_HEAP
+	return queue.findFirst(device, result);
+#else
 	auto it = std::find_if(std::begin(queue), std::end(queue),
 	                       EqualSchedulable(device));
 	if (it != std::end(queue)) {
@@ -88,35 +139,69 @@ bool Scheduler::pendingSyncPoint(const Schedulable& device,
 	} else {
 		return false;
 	}
+#endif
+}
+
+void Scheduler::setTrace(SchedulerTrace* trace_)
+{
+	trace = trace_;
+	if (!trace) return;
+#ifdef OPENMSX_SCHEDULER_HEAP
+	// In execution order: when replayed, sync points with the same time
+	// must again be executed in this order.
+	for (auto& sp : queue.getAll()) {
+		trace->record(SchedulerTrace::SET, *sp.second, sp.first);
+	}
+#else
+	for (auto& sp : queue) {
+		trace->record(SchedulerTrace::SET, *sp.getDevice(), sp.getTime());
+	}
+#endif
 }
 
 EmuTime::param Scheduler::getCurrentTime() const
 {
-	assert(Thread::isMainThread());
+	assert(Thread::isEmulationThread());
 	return scheduleTime;
 }
 
 void Scheduler::scheduleHelper(EmuTime::param limit, EmuTime next)
 {
 	assert(!scheduleInProgress);
+	HostTimer timer(HostProfiler::SCHEDULER);
 	scheduleInProgress = true;
+	if (unlikely(trace != nullptr)) {
+		trace->record(SchedulerTrace::SCHEDULE, limit);
+	}
 	while (true) {
 		assert(scheduleTime <= next);
 		scheduleTime = next;
 
+#ifdef OPENMSX_SCHEDULER_HEAP
+		auto* device = queue.getNextDevice();
+		queue.removeFront();
+#else
 		const auto& sp = queue.front();
 		auto* device = sp.getDevice();
 
 		queue.remove_front();
+#endif
 
-		device->executeUntil(next);
+		if (unlikely(trace != nullptr)) {
+			trace->record(SchedulerTrace::EXECUTE, *device, next);
+			device->executeUntil(next);
+			trace->record(SchedulerTrace::EXECUTE_END, next);
+		} else {
+			device->executeUntil(next);
+		}
 
 		next = getNext();
 		if (likely(next > limit)) break;
 	}
 	scheduleInProgress = false;
 
-	cpu->setNextSyncPoint(next);
+	// Note: there's no CPU when replaying a SchedulerTrace.
+	if (cpu) cpu->setNextSyncPoint(next);
 }
 
 
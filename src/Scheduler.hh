@@ -2,7 +2,11 @@
 #define SCHEDULER_HH
 
 #include "EmuTime.hh"
+#ifdef OPENMSX_SCHEDULER_HEAP
+#include "SchedulerHeap.hh"
+#else
 #include "SchedulerQueue.hh"
+#endif
 #include "likely.hh"
 #include <vector>
 
@@ -10,6 +14,7 @@ namespace openmsx {
 
 class Schedulable;
 class MSXCPU;
+class SchedulerTrace;
 
 class SynchronizationPoint
 {
@@ -54,7 +59,11 @@ public:
 	 */
 	inline EmuTime::param getNext() const
 	{
+#ifdef OPENMSX_SCHEDULER_HEAP
+		return queue.getNextTime();
+#else
 		return queue.front().getTime();
+#endif
 	}
 
 	/**
@@ -69,6 +78,12 @@ public:
 		scheduleTime = limit;
 	}
 
+	/** Record all sync point operations in the given trace, or stop
+	  * recording when nullptr. The sync points that are already pending
+	  * are recorded first. See SchedulerTrace.
+	  */
+	void setTrace(SchedulerTrace* trace);
+
 	template <typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -109,12 +124,17 @@ private: // -> intended for Schedulable
 private:
 	void scheduleHelper(EmuTime::param limit, EmuTime next);
 
+#ifdef OPENMSX_SCHEDULER_HEAP
+	SchedulerHeap queue;
+#else
 	/** Vector used as heap, not a priority queue because that
 	  * doesn't allow removal of non-top element.
 	  */
 	SchedulerQueue<SynchronizationPoint> queue;
+#endif
 	EmuTime scheduleTime;
 	MSXCPU* cpu;
+	SchedulerTrace* trace;
 	bool scheduleInProgress;
 };
 
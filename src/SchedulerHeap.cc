@@ -0,0 +1,201 @@
+#ifdef OPENMSX_SCHEDULER_HEAP
+
+#include "SchedulerHeap.hh"
+#include "Schedulable.hh"
+#include <algorithm>
+#include <cassert>
+
+namespace openmsx {
+
+SchedulerHeap::SchedulerHeap()
+	: freeList(nullptr)
+	, root(nullptr)
+	, counter(0)
+{
+}
+
+// Both x and y must be roots (no siblings, no parent).
+SchedulerHeap::Node* SchedulerHeap::meld(Node* x, Node* y)
+{
+	if (less(y, x)) std::swap(x, y);
+	// y becomes the first child of x
+	y->prev = x;
+	y->next = x->child;
+	if (x->child) x->child->prev = y;
+	x->child = y;
+	return x;
+}
+
+// Standard two-pass pairing, but iterative (a recursive implementation can
+// overflow the stack for long sibling lists).
+SchedulerHeap::Node* SchedulerHeap::mergePairs(Node* first)
+{
+	if (!first) return nullptr;
+
+	// first pass: left to right, meld pairs, build a (reversed) list of
+	// the results
+	Node* list = nullptr;
+	while (first) {
+		Node* x = first;
+		Node* y = x->next;
+		x->prev = x->next = nullptr;
+		Node* m;
+		if (y) {
+			first = y->next;
+			y->prev = y->next = nullptr;
+			m = meld(x, y);
+		} else {
+			first = nullptr;
+			m = x;
+		}
+		m->next = list;
+		list = m;
+	}
+
+	// second pass: right to left, meld everything into one tree
+	Node* result = list;
+	list = list->next;
+	result->next = nullptr;
+	while (list) {
+		Node* n = list->next;
+		list->next = nullptr;
+		result = meld(result, list);
+		list = n;
+	}
+	return result;
+}
+
+SchedulerHeap::Node*& SchedulerHeap::deviceList(const Schedulable& device)
+{
+	return const_cast<Schedulable&>(device).syncPointNodes;
+}
+
+SchedulerHeap::Node* SchedulerHeap::findFirstNode(const Schedulable& device)
+{
+	Node* result = deviceList(device);
+	if (!result) return nullptr;
+	for (Node* n = result->devNext; n; n = n->devNext) {
+		if (less(n, result)) result = n;
+	}
+	return result;
+}
+
+void SchedulerHeap::insert(EmuTime::param time, Schedulable& device)
+{
+	Node* node;
+	if (freeList) {
+		node = freeList;
+		freeList = node->next;
+	} else {
+		nodes.emplace_back();
+		node = &nodes.back();
+	}
+	node->time = time;
+	node->order = counter++;
+	node->device = &device;
+	node->child = node->next = node->prev = nullptr;
+
+	Node*& list = deviceList(device);
+	node->devPrev = nullptr;
+	node->devNext = list;
+	if (list) list->devPrev = node;
+	list = node;
+
+	root = root ? meld(root, node) : node;
+}
+
+void SchedulerHeap::removeNode(Node* node)
+{
+	if (node == root) {
+		root = mergePairs(root->child);
+	} else {
+		// detach the subtree rooted at 'node' ...
+		if (node->prev->child == node) {
+			node->prev->child = node->next;
+		} else {
+			node->prev->next = node->next;
+		}
+		if (node->next) node->next->prev = node->prev;
+		// ... and put its children back
+		if (Node* sub = mergePairs(node->child)) {
+			root = meld(root, sub);
+		}
+	}
+
+	if (node->devPrev) {
+		node->devPrev->devNext = node->devNext;
+	} else {
+		deviceList(*node->device) = node->devNext;
+	}
+	if (node->devNext) node->devNext->devPrev = node->devPrev;
+
+	node->device = nullptr;
+	node->next = freeList;
+	freeList = node;
+}
+
+void SchedulerHeap::removeFront()
+{
+	assert(!empty());
+	removeNode(root);
+}
+
+bool SchedulerHeap::removeOne(Schedulable& device)
+{
+	Node* node = findFirstNode(device);
+	if (!node) return false;
+	removeNode(node);
+	return true;
+}
+
+void SchedulerHeap::removeAll(Schedulable& device)
+{
+	while (Node* node = deviceList(device)) {
+		removeNode(node);
+	}
+}
+
+bool SchedulerHeap::findFirst(const Schedulable& device, EmuTime& result) const
+{
+	Node* node = findFirstNode(device);
+	if (!node) return false;
+	result = node->time;
+	return true;
+}
+
+std::vector<EmuTime> SchedulerHeap::getTimes(const Schedulable& device) const
+{
+	std::vector<const Node*> list;
+	for (Node* n = deviceList(device); n; n = n->devNext) {
+		list.push_back(n);
+	}
+	std::sort(list.begin(), list.end(), less);
+	std::vector<EmuTime> result;
+	for (auto* n : list) result.push_back(n->time);
+	return result;
+}
+
+std::vector<Schedulable*> SchedulerHeap::getDevices() const
+{
+	std::vector<Schedulable*> result;
+	for (auto& n : nodes) {
+		if (n.device) result.push_back(n.device);
+	}
+	return result;
+}
+
+std::vector<std::pair<EmuTime, Schedulable*>> SchedulerHeap::getAll() const
+{
+	std::vector<const Node*> list;
+	for (auto& n : nodes) {
+		if (n.device) list.push_back(&n);
+	}
+	std::sort(list.begin(), list.end(), less);
+	std::vector<std::pair<EmuTime, Schedulable*>> result;
+	for (auto* n : list) result.emplace_back(n->time, n->device);
+	return result;
+}
+
+} // namespace openmsx
+
+#endif // OPENMSX_SCHEDULER_HEAP
@@ -0,0 +1,93 @@
+#ifndef SCHEDULERHEAP_HH
+#define SCHEDULERHEAP_HH
+
+#include "EmuTime.hh"
+#include <deque>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace openmsx {
+
+class Schedulable;
+
+struct SchedulerHeapNode
+{
+	SchedulerHeapNode() : time(EmuTime::zero) {}
+
+	EmuTime time;
+	uint64_t order; // insertion order, see SchedulerHeap::less()
+	Schedulable* device; // nullptr for nodes on the free list
+	SchedulerHeapNode* child; // first child
+	SchedulerHeapNode* next;  // next sibling (or next free node)
+	SchedulerHeapNode* prev;  // previous sibling, or parent for first child
+	SchedulerHeapNode* devNext; // other sync points of the same device
+	SchedulerHeapNode* devPrev;
+};
+
+/** Alternative for SchedulerQueue, selected at build time (see SCHEDULER in
+  * build/custom.mk).
+  *
+  * This is a pairing heap. Each Schedulable has a handle to (a list of) its
+  * own sync points, so removing the sync points of a device doesn't require
+  * searching the queue. Insert is O(1), removing the front or an arbitrary
+  * sync point is O(log N) amortized. SchedulerQueue inserts and removes in
+  * O(N), though it's very fast for small queues.
+  *
+  * Sync points with the same time are executed in insertion order, and
+  * removeOne() removes the earliest sync point of a device. So both
+  * backends always execute the sync points in exactly the same order
+  * (that's required for replays).
+  */
+class SchedulerHeap
+{
+public:
+	SchedulerHeap();
+	SchedulerHeap(const SchedulerHeap&) = delete;
+	SchedulerHeap& operator=(const SchedulerHeap&) = delete;
+
+	bool empty() const { return root == nullptr; }
+
+	/** Time of the earliest sync point, infinity if there are none. */
+	EmuTime::param getNextTime() const {
+		return root ? root->time : EmuTime::infinity;
+	}
+	/** Device of the earliest sync point. Heap may not be empty. */
+	Schedulable* getNextDevice() const { return root->device; }
+
+	void insert(EmuTime::param time, Schedulable& device);
+	void removeFront();
+	/** Remove the earliest sync point of the given device.
+	  * Returns false if the device has no sync points. */
+	bool removeOne(Schedulable& device);
+	void removeAll(Schedulable& device);
+	bool findFirst(const Schedulable& device, EmuTime& result) const;
+	/** All sync point times of the given device, sorted. */
+	std::vector<EmuTime> getTimes(const Schedulable& device) const;
+	/** All devices that have at least one sync point (with duplicates). */
+	std::vector<Schedulable*> getDevices() const;
+	/** All sync points (time and device), in execution order. */
+	std::vector<std::pair<EmuTime, Schedulable*>> getAll() const;
+
+private:
+	using Node = SchedulerHeapNode;
+
+	static bool less(const Node* x, const Node* y) {
+		return (x->time < y->time) ||
+		       ((x->time == y->time) && (x->order < y->order));
+	}
+	static Node* meld(Node* x, Node* y);
+	static Node* mergePairs(Node* first);
+	static Node*& deviceList(const Schedulable& device);
+	static Node* findFirstNode(const Schedulable& device);
+	void removeNode(Node* node);
+
+	std::deque<Node> nodes; // never moves its elements
+	Node* freeList;
+	Node* root;
+	uint64_t counter;
+};
+
+} // namespace openmsx
+
+#endif
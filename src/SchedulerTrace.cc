@@ -0,0 +1,84 @@
+#include "SchedulerTrace.hh"
+#include "File.hh"
+#include "MSXException.hh"
+#include "MemBuffer.hh"
+#include <cstring>
+
+namespace openmsx {
+
+// The trace is stored in native byte order, it's only meant to be replayed
+// on the same host. The fields of each entry are stored one after the other
+// (without the padding of the Entry struct).
+static const char MAGIC[8] = { 'O','M','S','C','H','E','D','2' };
+using Entry = SchedulerTrace::Entry;
+static const size_t ENTRY_SIZE =
+	sizeof(Entry::time) + sizeof(Entry::device) + sizeof(Entry::op);
+
+static uint64_t toUint64(EmuTime::param time)
+{
+	return (time - EmuTime::zero).length();
+}
+
+void SchedulerTrace::record(Op op, const Schedulable& device, EmuTime::param time)
+{
+	auto it = deviceIds.find(&device);
+	if (it == deviceIds.end()) {
+		it = deviceIds.emplace(&device, numDevices++).first;
+	}
+	entries.push_back({toUint64(time), it->second, op});
+}
+
+void SchedulerTrace::record(Op op, EmuTime::param time)
+{
+	entries.push_back({toUint64(time), uint32_t(-1), op});
+}
+
+void SchedulerTrace::save(string_ref filename) const
+{
+	File file(filename, File::TRUNCATE);
+	file.write(MAGIC, sizeof(MAGIC));
+	uint32_t header[2] = { numDevices, uint32_t(entries.size()) };
+	file.write(header, sizeof(header));
+
+	MemBuffer<uint8_t> buf(entries.size() * ENTRY_SIZE);
+	uint8_t* p = buf.data();
+	for (auto& e : entries) {
+		memcpy(p, &e.time,   sizeof(e.time));   p += sizeof(e.time);
+		memcpy(p, &e.device, sizeof(e.device)); p += sizeof(e.device);
+		memcpy(p, &e.op,     sizeof(e.op));     p += sizeof(e.op);
+	}
+	file.write(buf.data(), entries.size() * ENTRY_SIZE);
+}
+
+void SchedulerTrace::load(string_ref filename)
+{
+	File file(filename);
+	char magic[sizeof(MAGIC)];
+	uint32_t header[2];
+	if (file.getSize() < (sizeof(magic) + sizeof(header))) {
+		throw MSXException("Not a scheduler trace: " + filename);
+	}
+	file.read(magic, sizeof(magic));
+	if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw MSXException("Not a scheduler trace: " + filename);
+	}
+	file.read(header, sizeof(header));
+	if (file.getSize() != (sizeof(magic) + sizeof(header) +
+	                       header[1] * ENTRY_SIZE)) {
+		throw MSXException("Corrupt scheduler trace: " + filename);
+	}
+	MemBuffer<uint8_t> buf(header[1] * ENTRY_SIZE);
+	file.read(buf.data(), header[1] * ENTRY_SIZE);
+
+	numDevices = header[0];
+	entries.resize(header[1]);
+	const uint8_t* p = buf.data();
+	for (auto& e : entries) {
+		memcpy(&e.time,   p, sizeof(e.time));   p += sizeof(e.time);
+		memcpy(&e.device, p, sizeof(e.device)); p += sizeof(e.device);
+		memcpy(&e.op,     p, sizeof(e.op));     p += sizeof(e.op);
+	}
+	deviceIds.clear();
+}
+
+} // namespace openmsx
@@ -0,0 +1,57 @@
+#ifndef SCHEDULERTRACE_HH
+#define SCHEDULERTRACE_HH
+
+#include "EmuTime.hh"
+#include "string_ref.hh"
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace openmsx {
+
+class Schedulable;
+
+/** A recording of all calls to the Scheduler (sync points that are set,
+  * removed, queried and executed). Such a trace, recorded from a real
+  * session, can be replayed by the benchmark harness to measure the speed
+  * of the Scheduler implementation in isolation.
+  */
+class SchedulerTrace
+{
+public:
+	enum Op : uint8_t {
+		SET,          // setSyncPoint(time)
+		REMOVE,       // removeSyncPoint()
+		REMOVE_ALL,   // removeSyncPoints()
+		PENDING,      // pendingSyncPoint()
+		GET,          // getSyncPoints()
+		SCHEDULE,     // schedule(time) that executes at least one sync point
+		EXECUTE,      // begin of executeUntil(time)
+		EXECUTE_END,  // end of executeUntil()
+	};
+	struct Entry {
+		uint64_t time;
+		uint32_t device;
+		uint8_t op;
+	};
+
+	void record(Op op, const Schedulable& device, EmuTime::param time);
+	void record(Op op, EmuTime::param time);
+
+	const std::vector<Entry>& getEntries() const { return entries; }
+	unsigned getNumDevices() const { return numDevices; }
+
+	/** Save/load the trace to/from a (binary) file.
+	  * @throws MSXException */
+	void save(string_ref filename) const;
+	void load(string_ref filename);
+
+private:
+	std::vector<Entry> entries;
+	std::unordered_map<const Schedulable*, uint32_t> deviceIds;
+	unsigned numDevices = 0;
+};
+
+} // namespace openmsx
+
+#endif
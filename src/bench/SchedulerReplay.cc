@@ -0,0 +1,115 @@
+#include "SchedulerReplay.hh"
+#include "Schedulable.hh"
+#include "MSXException.hh"
+#include "memory.hh"
+
+namespace openmsx {
+
+class ReplayDevice final : public Schedulable
+{
+public:
+	ReplayDevice(Scheduler& scheduler_, SchedulerReplay& replay_, unsigned id_)
+		: Schedulable(scheduler_), replay(replay_), id(id_) {}
+
+	void set(EmuTime::param time) { setSyncPoint(time); }
+	void remove() { removeSyncPoint(); }
+	void removeAll() { removeSyncPoints(); }
+	void pending() {
+		auto dummy = EmuTime::dummy();
+		pendingSyncPoint(dummy);
+	}
+
+	void executeUntil(EmuTime::param time) override {
+		replay.execute(id, time);
+	}
+
+private:
+	SchedulerReplay& replay;
+	const unsigned id;
+};
+
+
+static EmuTime toEmuTime(uint64_t time)
+{
+	return EmuTime::makeEmuTime(time);
+}
+
+static void diverged()
+{
+	throw MSXException("Replay doesn't follow the scheduler trace.");
+}
+
+SchedulerReplay::SchedulerReplay(const SchedulerTrace& trace)
+	: entries(trace.getEntries())
+	, pos(0)
+{
+	for (unsigned i = 0; i < trace.getNumDevices(); ++i) {
+		devices.push_back(make_unique<ReplayDevice>(scheduler, *this, i));
+	}
+}
+
+SchedulerReplay::~SchedulerReplay()
+{
+	// devices remove their sync points before the scheduler is deleted
+	devices.clear();
+}
+
+const SchedulerTrace::Entry& SchedulerReplay::nextEntry()
+{
+	if (pos == entries.size()) diverged();
+	return entries[pos++];
+}
+
+void SchedulerReplay::run()
+{
+	while (pos != entries.size()) {
+		replay(nextEntry());
+	}
+}
+
+void SchedulerReplay::execute(unsigned device, EmuTime::param time)
+{
+	const auto& begin = nextEntry();
+	if ((begin.op != SchedulerTrace::EXECUTE) || (begin.device != device) ||
+	    (toEmuTime(begin.time) != time)) {
+		diverged();
+	}
+	while (true) {
+		const auto& entry = nextEntry();
+		if (entry.op == SchedulerTrace::EXECUTE_END) break;
+		replay(entry);
+	}
+}
+
+void SchedulerReplay::replay(const SchedulerTrace::Entry& entry)
+{
+	if (entry.op == SchedulerTrace::SCHEDULE) {
+		// executes sync points, see execute()
+		scheduler.schedule(toEmuTime(entry.time));
+		return;
+	}
+	if (entry.device >= devices.size()) diverged();
+	auto& device = *devices[entry.device];
+	switch (entry.op) {
+	case SchedulerTrace::SET:
+		device.set(toEmuTime(entry.time));
+		break;
+	case SchedulerTrace::REMOVE:
+		device.remove();
+		break;
+	case SchedulerTrace::REMOVE_ALL:
+		device.removeAll();
+		break;
+	case SchedulerTrace::PENDING:
+	case SchedulerTrace::GET:
+		// getSyncPoints() is only accessible for Schedulable itself
+		// (for serialization), it costs about the same as a
+		// pendingSyncPoint() query.
+		device.pending();
+		break;
+	default:
+		diverged();
+	}
+}
+
+} // namespace openmsx
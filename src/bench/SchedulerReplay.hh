@@ -0,0 +1,44 @@
+#ifndef SCHEDULERREPLAY_HH
+#define SCHEDULERREPLAY_HH
+
+#include "Scheduler.hh"
+#include "SchedulerTrace.hh"
+#include <memory>
+#include <vector>
+
+namespace openmsx {
+
+class ReplayDevice;
+
+/** Replays a SchedulerTrace on a Scheduler that's not part of an MSX
+  * machine. The devices from the trace are replaced by dummy devices that
+  * only repeat the recorded Scheduler calls. So this measures the speed of
+  * the Scheduler itself.
+  */
+class SchedulerReplay
+{
+public:
+	explicit SchedulerReplay(const SchedulerTrace& trace);
+	~SchedulerReplay();
+
+	/** Replay the whole trace.
+	  * @throws MSXException when the replay doesn't follow the trace
+	  *         (e.g. the trace is corrupt). */
+	void run();
+
+	// for ReplayDevice
+	void execute(unsigned device, EmuTime::param time);
+
+private:
+	void replay(const SchedulerTrace::Entry& entry);
+	const SchedulerTrace::Entry& nextEntry();
+
+	Scheduler scheduler;
+	std::vector<std::unique_ptr<ReplayDevice>> devices;
+	const std::vector<SchedulerTrace::Entry>& entries;
+	size_t pos;
+};
+
+} // namespace openmsx
+
+#endif
@@ -0,0 +1,728 @@
+/*
+ *  Headless benchmark harness for openMSX.
+ *
+ *  Boots the 'Bench_turboR' machine (no BIOS, just RAM) without video and
+ *  without sound output, loads a number of fixed test programs and runs each
+ *  of them for a fixed amount of emulated time, as fast as possible. The
+ *  results are printed as one JSON object per line, so they can easily be
+ *  collected and compared between different versions.
+ *
+ *  Build and run via 'make bench' (optionally 'make bench BENCH_SECONDS=n').
+ *
+ *  The Scheduler can also be measured in isolation: first record a trace of
+ *  all Scheduler calls while running a machine (preferably a real MSX with
+ *  system ROMs, e.g. with a lot of devices), then replay that trace:
+ *    <binary> --record-scheduler <file> [<machine> [<emulated-seconds>]]
+ *    <binary> --replay-scheduler <file> [<repeat-count>]
+ *  Do this for a build with each Scheduler backend (see SCHEDULER in
+ *  build/custom.mk) to compare them.
+ *
+ *  The (software) scalers are measured separately, on a fixed test image,
+ *  for each scale algorithm and factor, with 1, 2, 4 and 8 threads (see the
+ *  'scale_threads' setting):
+ *    <binary> --scalers [<frames>]
+ *
+ *  Parallel sound generation (see the 'sound_render_threads' setting) is
+ *  measured by running the 'sound' workload with 0 (serial), 1, 2 and 4
+ *  render threads:
+ *    <binary> --sound [<emulated-seconds>]
+ *
+ *  The pre-decoded block tier of the CPU (see the 'z80_block_cache' and
+ *  'r800_block_cache' settings) is compared against the normal interpreter
+ *  loop by running all workloads with the block cache off and on:
+ *    <binary> --block-cache [<emulated-seconds>]
+ *
+ *  The overhead of recording a CPU trace (see the 'cpu_trace' command) is
+ *  measured by running all workloads without and with a trace being
+ *  recorded (to a file in the temp directory). Both runs use normal (not
+ *  fast-forward) emulation, because fast-forward doesn't record a trace:
+ *    <binary> --cpu-trace [<emulated-seconds>]
+ *
+ *  Rasterizing in a separate thread (see the 'render_thread' setting) is
+ *  measured by running the 'vdp_hmmv' workload with the SDL renderer, with
+ *  the render thread off and on. Once the VDP command fills the displayed
+ *  page (so the emulation must often wait for the render thread) and once
+ *  a page that is not displayed. This needs a video driver, on a headless
+ *  machine use SDL_VIDEODRIVER=dummy:
+ *    <binary> --render-thread [<emulated-seconds>]
+ */
+
+#include "openmsx.hh"
+#include "Reactor.hh"
+#include "MSXMotherBoard.hh"
+#include "Debugger.hh"
+#include "Debuggable.hh"
+#include "Display.hh"
+#include "RenderSettings.hh"
+#include "RawFrame.hh"
+#include "SDLOffScreenSurface.hh"
+#include "SDLSurfacePtr.hh"
+#include "ParallelScaler.hh"
+#include "StretchScalerOutput.hh"
+#include "ScalerOutput.hh"
+#include "PixelOperations.hh"
+#include "CommandController.hh"
+#include "GlobalCliComm.hh"
+#include "StdioMessages.hh"
+#include "Interpreter.hh"
+#include "EmuDuration.hh"
+#include "File.hh"
+#include "FileOperations.hh"
+#include "Scheduler.hh"
+#include "SchedulerReplay.hh"
+#include "SchedulerTrace.hh"
+#include "MSXException.hh"
+#include "StringOp.hh"
+#include "Thread.hh"
+#include "Timer.hh"
+#include "Version.hh"
+#include "memory.hh"
+#include "build-info.hh"
+#include <iostream>
+#include <cassert>
+#include <exception>
+#include <cstdio>
+#include <cstdlib>
+#include <SDL.h>
+
+using std::cerr;
+using std::endl;
+
+namespace openmsx {
+
+// All test programs are loaded at address 0x0000 and keep a 32-bit iteration
+// counter at address 0xC000. They only count completed iterations, so the
+// (partial) iteration that is running when the emulated time runs out is
+// not included in the result.
+static const unsigned COUNTER_ADDR = 0xC000;
+
+// Mix of common Z80 instructions: 8 and 16 bit arithmetic, (IX+d) and (HL)
+// memory accesses, a block transfer, stack operations, calls and jumps.
+// Runs unmodified on the Z80 and on the R800.
+static const byte cpuMixProgram[] = {
+	0xF3,             // 0000  di
+	0x31, 0x00, 0xF0, // 0001  ld   sp,0xF000
+	0x21, 0x00, 0x00, // 0004  ld   hl,0
+	0x22, 0x00, 0xC0, // 0007  ld   (0xC000),hl
+	0x22, 0x02, 0xC0, // 000A  ld   (0xC002),hl
+	0x06, 0x10,       // 000D  loop: ld b,16
+	0x80,             // 000F  inner: add a,b
+	0xA9,             // 0010  xor  c
+	0x07,             // 0011  rlca
+	0x13,             // 0012  inc  de
+	0x10, 0xFA,       // 0013  djnz inner
+	0x21, 0x00, 0xD0, // 0015  ld   hl,0xD000
+	0x11, 0x00, 0xD1, // 0018  ld   de,0xD100
+	0x01, 0x20, 0x00, // 001B  ld   bc,0x0020
+	0xED, 0xB0,       // 001E  ldir
+	0xDD, 0x21, 0x00, 0xD0, // 0020  ld ix,0xD000
+	0xDD, 0x7E, 0x05, // 0024  ld   a,(ix+5)
+	0xDD, 0x86, 0x06, // 0027  add  a,(ix+6)
+	0xDD, 0x77, 0x07, // 002A  ld   (ix+7),a
+	0xCB, 0xDE,       // 002D  set  3,(hl)
+	0xCB, 0x5E,       // 002F  bit  3,(hl)
+	0xC5,             // 0031  push bc
+	0xD5,             // 0032  push de
+	0xCD, 0x4E, 0x00, // 0033  call sub
+	0xD1,             // 0036  pop  de
+	0xC1,             // 0037  pop  bc
+	0x2A, 0x00, 0xC0, // 0038  ld   hl,(0xC000)
+	0x23,             // 003B  inc  hl
+	0x22, 0x00, 0xC0, // 003C  ld   (0xC000),hl
+	0x7C,             // 003F  ld   a,h
+	0xB5,             // 0040  or   l
+	0xC2, 0x0D, 0x00, // 0041  jp   nz,loop
+	0x2A, 0x02, 0xC0, // 0044  ld   hl,(0xC002)
+	0x23,             // 0047  inc  hl
+	0x22, 0x02, 0xC0, // 0048  ld   (0xC002),hl
+	0xC3, 0x0D, 0x00, // 004B  jp   loop
+	0xEB,             // 004E  sub: ex de,hl
+	0x19,             // 004F  add  hl,de
+	0xED, 0x42,       // 0050  sbc  hl,bc
+	0xC9,             // 0052  ret
+};
+// Executed instructions per iteration (each repetition of ldir counts as one
+// instruction). On a carry into the upper half of the counter there are 4
+// additional instructions.
+static const unsigned CPU_MIX_INSTRUCTIONS = 137;
+static const unsigned CPU_MIX_CARRY_INSTRUCTIONS = 4;
+
+// Repeatedly fill the screen (SCREEN 5, 256x212) with a HMMV VDP command
+// and wait for the command to finish.
+static const byte vdpProgram[] = {
+	0xF3,             // 0000  di
+	0x31, 0x00, 0xF0, // 0001  ld   sp,0xF000
+	0x21, 0x00, 0x00, // 0004  ld   hl,0
+	0x22, 0x00, 0xC0, // 0007  ld   (0xC000),hl
+	0x22, 0x02, 0xC0, // 000A  ld   (0xC002),hl
+	0x21, 0x56, 0x00, // 000D  ld   hl,regs
+	0x01, 0x99, 0x08, // 0010  ld   bc,0x0899
+	0xED, 0xB3,       // 0013  otir
+	0x3E, 0x24,       // 0015  loop: ld a,36
+	0xD3, 0x99,       // 0017  out  (0x99),a
+	0x3E, 0x91,       // 0019  ld   a,0x80+17
+	0xD3, 0x99,       // 001B  out  (0x99),a
+	0x21, 0x5E, 0x00, // 001D  ld   hl,cmd
+	0x01, 0x9B, 0x0B, // 0020  ld   bc,0x0B9B
+	0xED, 0xB3,       // 0023  otir
+	0x3E, 0x02,       // 0025  ld   a,2
+	0xD3, 0x99,       // 0027  out  (0x99),a
+	0x3E, 0x8F,       // 0029  ld   a,0x80+15
+	0xD3, 0x99,       // 002B  out  (0x99),a
+	0xDB, 0x99,       // 002D  wait: in a,(0x99)
+	0x0F,             // 002F  rrca
+	0x38, 0xFB,       // 0030  jr   c,wait
+	0xAF,             // 0032  xor  a
+	0xD3, 0x99,       // 0033  out  (0x99),a
+	0x3E, 0x8F,       // 0035  ld   a,0x80+15
+	0xD3, 0x99,       // 0037  out  (0x99),a
+	0x3A, 0x66, 0x00, // 0039  ld   a,(cmd+8)
+	0x3C,             // 003C  inc  a
+	0x32, 0x66, 0x00, // 003D  ld   (cmd+8),a
+	0x2A, 0x00, 0xC0, // 0040  ld   hl,(0xC000)
+	0x23,             // 0043  inc  hl
+	0x22, 0x00, 0xC0, // 0044  ld   (0xC000),hl
+	0x7C,             // 0047  ld   a,h
+	0xB5,             // 0048  or   l
+	0xC2, 0x15, 0x00, // 0049  jp   nz,loop
+	0x2A, 0x02, 0xC0, // 004C  ld   hl,(0xC002)
+	0x23,             // 004F  inc  hl
+	0x22, 0x02, 0xC0, // 0050  ld   (0xC002),hl
+	0xC3, 0x15, 0x00, // 0053  jp   loop
+	// 0056  regs: R#0=0x06 (G4), R#1=0x40 (display on),
+	//             R#8=0x08 (64kB VRAM chips), R#9=0x80 (212 lines)
+	0x06, 0x80, 0x40, 0x81, 0x08, 0x88, 0x80, 0x89,
+	// 005E  cmd: R#36-R#46: DX=0, DY=0, NX=256, NY=212, CLR=0x55, ARG=0,
+	//            CMD=HMMV
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xD4, 0x00, 0x55, 0x00, 0xC0,
+};
+
+// Enable three PSG tone channels and all five SCC channels, then keep
+// changing the frequencies.
+static const byte soundProgram[] = {
+	0xF3,             // 0000  di
+	0x31, 0x00, 0xF0, // 0001  ld   sp,0xF000
+	0x21, 0x00, 0x00, // 0004  ld   hl,0
+	0x22, 0x00, 0xC0, // 0007  ld   (0xC000),hl
+	0x22, 0x02, 0xC0, // 000A  ld   (0xC002),hl
+	0x21, 0x61, 0x00, // 000D  ld   hl,psg
+	0x06, 0x07,       // 0010  ld   b,7
+	0x7E,             // 0012  init: ld a,(hl)
+	0xD3, 0xA0,       // 0013  out  (0xA0),a
+	0x23,             // 0015  inc  hl
+	0x7E,             // 0016  ld   a,(hl)
+	0xD3, 0xA1,       // 0017  out  (0xA1),a
+	0x23,             // 0019  inc  hl
+	0x10, 0xF6,       // 001A  djnz init
+	0x3E, 0x10,       // 001C  ld   a,0x10
+	0xD3, 0xA8,       // 001E  out  (0xA8),a      ; page 2 -> slot 1
+	0x3E, 0x3F,       // 0020  ld   a,0x3F
+	0x32, 0x00, 0x90, // 0022  ld   (0x9000),a    ; enable SCC
+	0x21, 0x00, 0x98, // 0025  ld   hl,0x9800
+	0x06, 0x80,       // 0028  ld   b,0x80
+	0x75,             // 002A  wave: ld (hl),l
+	0x23,             // 002B  inc  hl
+	0x10, 0xFC,       // 002C  djnz wave
+	0x21, 0x8A, 0x98, // 002E  ld   hl,0x988A
+	0x06, 0x05,       // 0031  ld   b,5
+	0x36, 0x0F,       // 0033  vol: ld (hl),0x0F
+	0x23,             // 0035  inc  hl
+	0x10, 0xFB,       // 0036  djnz vol
+	0x36, 0x1F,       // 0038  ld   (hl),0x1F
+	0x3A, 0x00, 0xC0, // 003A  loop: ld a,(0xC000)
+	0x47,             // 003D  ld   b,a
+	0xAF,             // 003E  xor  a
+	0xD3, 0xA0,       // 003F  out  (0xA0),a
+	0x78,             // 0041  ld   a,b
+	0xD3, 0xA1,       // 0042  out  (0xA1),a
+	0x32, 0x80, 0x98, // 0044  ld   (0x9880),a
+	0x06, 0x00,       // 0047  ld   b,0
+	0x10, 0xFE,       // 0049  delay: djnz delay
+	0x2A, 0x00, 0xC0, // 004B  ld   hl,(0xC000)
+	0x23,             // 004E  inc  hl
+	0x22, 0x00, 0xC0, // 004F  ld   (0xC000),hl
+	0x7C,             // 0052  ld   a,h
+	0xB5,             // 0053  or   l
+	0xC2, 0x3A, 0x00, // 0054  jp   nz,loop
+	0x2A, 0x02, 0xC0, // 0057  ld   hl,(0xC002)
+	0x23,             // 005A  inc  hl
+	0x22, 0x02, 0xC0, // 005B  ld   (0xC002),hl
+	0xC3, 0x3A, 0x00, // 005E  jp   loop
+	// 0061  psg: (register, value) pairs
+	0x07, 0xB8, 0x08, 0x0F, 0x09, 0x0F, 0x0A, 0x0F,
+	0x00, 0x55, 0x02, 0x77, 0x04, 0x99,
+};
+
+struct Workload
+{
+	const char* name;
+	const byte* program;
+	unsigned size;
+	bool r800;
+	// Number of instructions per iteration, 0 if not known (e.g. because
+	// the program contains a wait loop).
+	unsigned instructions;
+};
+
+static const Workload workloads[] = {
+	{ "z80_mix",  cpuMixProgram, sizeof(cpuMixProgram), false,
+	  CPU_MIX_INSTRUCTIONS },
+	{ "r800_mix", cpuMixProgram, sizeof(cpuMixProgram), true,
+	  CPU_MIX_INSTRUCTIONS },
+	{ "vdp_hmmv", vdpProgram,    sizeof(vdpProgram),    false, 0 },
+	{ "sound",    soundProgram,  sizeof(soundProgram),  false, 0 },
+};
+
+static void initializeSDL()
+{
+	int flags = 0;
+#ifndef NDEBUG
+	flags |= SDL_INIT_NOPARACHUTE;
+#endif
+	if (SDL_Init(flags) < 0) {
+		throw FatalError(StringOp::Builder() <<
+			"Couldn't init SDL: " << SDL_GetError());
+	}
+}
+
+static Debuggable& getDebuggable(MSXMotherBoard& motherBoard, string_ref name)
+{
+	auto* debuggable = motherBoard.getDebugger().findDebuggable(name);
+	if (!debuggable) {
+		throw FatalError("Missing debuggable: " + name);
+	}
+	return *debuggable;
+}
+
+// Start the workload on a freshly booted machine.
+static MSXMotherBoard& loadWorkload(Reactor& reactor, const Workload& workload)
+{
+	reactor.switchMachine("Bench_turboR");
+	auto& motherBoard = *reactor.getMotherBoard();
+	motherBoard.powerUp();
+
+	auto& memory = getDebuggable(motherBoard, "memory");
+	for (unsigned i = 0; i < workload.size; ++i) {
+		memory.write(i, workload.program[i]);
+	}
+	if (workload.r800) {
+		// S1990 register 6: select R800 (ROM mode)
+		getDebuggable(motherBoard, "S1990 regs").write(6, 0x40);
+	}
+	return motherBoard;
+}
+
+// Returns the wall time (in seconds) needed to emulate 'seconds'.
+static double runFor(MSXMotherBoard& motherBoard, double seconds,
+                     bool fast = true)
+{
+	uint64_t start = Timer::getTime();
+	motherBoard.fastForward(
+		motherBoard.getCurrentTime() + EmuDuration(seconds), fast);
+	uint64_t stop = Timer::getTime();
+	return (stop - start) / 1000000.0;
+}
+
+// Runs the workload, with the CPU block cache enabled or not. When 'cpuTrace'
+// is true, a CPU trace is recorded to 'traceFile'. When 'traceFile' is not
+// empty, normal (not fast-forward) emulation is used.
+static void runWorkload(Reactor& reactor, const Workload& workload,
+                        double seconds, bool blockCache,
+                        const std::string& traceFile = {},
+                        bool cpuTrace = false)
+{
+	auto& motherBoard = loadWorkload(reactor, workload);
+	auto& controller = motherBoard.getCommandController();
+	if (blockCache) {
+		// machine settings, so set them after loading the machine
+		controller.executeCommand("set z80_block_cache on");
+		controller.executeCommand("set r800_block_cache on");
+	}
+	if (cpuTrace) {
+		controller.executeCommand("cpu_trace start " + traceFile);
+	}
+	double wall = runFor(motherBoard, seconds, traceFile.empty());
+	uint64_t traceBytes = 0;
+	if (cpuTrace) {
+		// includes writing the remaining records to disk
+		uint64_t start = Timer::getTime();
+		controller.executeCommand("cpu_trace stop");
+		wall += (Timer::getTime() - start) / 1000000.0;
+		traceBytes = File(traceFile).getSize();
+		FileOperations::unlink(traceFile);
+	}
+
+	auto& memory = getDebuggable(motherBoard, "memory");
+	uint32_t low  = memory.read(COUNTER_ADDR + 0) +
+	               (memory.read(COUNTER_ADDR + 1) << 8);
+	uint32_t high = memory.read(COUNTER_ADDR + 2) +
+	               (memory.read(COUNTER_ADDR + 3) << 8);
+	uint64_t iterations = (uint64_t(high) << 16) + low;
+
+	printf("{\"version\":\"%s\",\"workload\":\"%s\",\"emu_seconds\":%g,"
+	       "\"wall_seconds\":%.6f,\"emu_seconds_per_wall_second\":%.6f,"
+	       "\"iterations\":%llu,\"block_cache\":%s,\"cpu_trace\":%s",
+	       Version::full().c_str(), workload.name, seconds,
+	       wall, seconds / wall, (unsigned long long)iterations,
+	       blockCache ? "true" : "false", cpuTrace ? "true" : "false");
+	if (cpuTrace) {
+		printf(",\"trace_bytes\":%llu", (unsigned long long)traceBytes);
+	}
+	if (workload.instructions) {
+		uint64_t instructions = iterations * workload.instructions +
+		                        high * CPU_MIX_CARRY_INSTRUCTIONS;
+		printf(",\"instructions\":%llu,\"instructions_per_second\":%.0f",
+		       (unsigned long long)instructions, instructions / wall);
+	}
+	printf("}\n");
+	fflush(stdout);
+}
+
+// Normal (not fast-forward) emulation, because during fast-forward frames
+// are not rendered.
+static void benchRenderThread(Reactor& reactor, double seconds)
+{
+	auto& controller = reactor.getCommandController();
+	const auto& workload = workloads[2];
+	assert(string_ref(workload.name) == "vdp_hmmv");
+	controller.executeCommand("set renderer SDL");
+	for (bool hidden : {false, true}) {
+		for (bool thread : {false, true}) {
+			controller.executeCommand(StringOp::Builder() <<
+				"set render_thread " << (thread ? "on" : "off"));
+			auto& motherBoard = loadWorkload(reactor, workload);
+			if (hidden) {
+				// R#39 (DY high) of the HMMV command: fill
+				// page 1, page 0 is displayed.
+				getDebuggable(motherBoard, "memory").write(
+					0x5E + 3, 0x01);
+			}
+			runFor(motherBoard, 0.1, false); // warm up
+			double wall = runFor(motherBoard, seconds, false);
+
+			printf("{\"version\":\"%s\",\"workload\":\"%s\","
+			       "\"vram_writes\":\"%s\",\"render_thread\":%s,"
+			       "\"emu_seconds\":%g,\"wall_seconds\":%.6f,"
+			       "\"emu_seconds_per_wall_second\":%.6f}\n",
+			       Version::full().c_str(), workload.name,
+			       hidden ? "hidden_page" : "displayed_page",
+			       thread ? "true" : "false", seconds,
+			       wall, seconds / wall);
+			fflush(stdout);
+		}
+	}
+}
+
+static const unsigned soundThreads[] = { 0, 1, 2, 4 };
+
+// The mixer also generates the sound (but doesn't output it) during
+// fastForward(), so this measures the sound generation as in normal
+// emulation. Note that the emulation itself (which is the same for each
+// thread count) is included in the wall time.
+static void benchSound(Reactor& reactor, double seconds)
+{
+	auto& controller = reactor.getCommandController();
+	const auto& workload = workloads[3];
+	assert(string_ref(workload.name) == "sound");
+	for (auto threads : soundThreads) {
+		controller.executeCommand(StringOp::Builder() <<
+			"set sound_render_threads " << threads);
+		auto& motherBoard = loadWorkload(reactor, workload);
+		runFor(motherBoard, 0.1); // create the worker threads
+		double wall = runFor(motherBoard, seconds);
+
+		printf("{\"version\":\"%s\",\"workload\":\"sound_render\","
+		       "\"threads\":%u,\"emu_seconds\":%g,"
+		       "\"wall_seconds\":%.6f,"
+		       "\"emu_seconds_per_wall_second\":%.6f}\n",
+		       Version::full().c_str(), threads, seconds,
+		       wall, seconds / wall);
+		fflush(stdout);
+	}
+}
+
+static void recordSchedulerTrace(Reactor& reactor, const char* filename,
+                                 const char* machine, double seconds)
+{
+	reactor.switchMachine(machine);
+	auto& motherBoard = *reactor.getMotherBoard();
+	motherBoard.powerUp();
+
+	SchedulerTrace trace;
+	auto& scheduler = motherBoard.getScheduler();
+	scheduler.setTrace(&trace);
+	motherBoard.fastForward(
+		motherBoard.getCurrentTime() + EmuDuration(seconds), true);
+	scheduler.setTrace(nullptr);
+	trace.save(filename);
+
+	printf("{\"machine\":\"%s\",\"emu_seconds\":%g,\"devices\":%u,"
+	       "\"operations\":%llu}\n",
+	       machine, seconds, trace.getNumDevices(),
+	       (unsigned long long)trace.getEntries().size());
+}
+
+static void replaySchedulerTrace(const char* filename, unsigned repeat)
+{
+	SchedulerTrace trace;
+	trace.load(filename);
+
+	uint64_t start = Timer::getTime();
+	for (unsigned i = 0; i < repeat; ++i) {
+		SchedulerReplay replay(trace);
+		replay.run();
+	}
+	uint64_t stop = Timer::getTime();
+	double wall = (stop - start) / 1000000.0;
+	uint64_t operations = uint64_t(trace.getEntries().size()) * repeat;
+
+#ifdef OPENMSX_SCHEDULER_HEAP
+	const char* backend = "heap";
+#else
+	const char* backend = "queue";
+#endif
+	printf("{\"version\":\"%s\",\"workload\":\"scheduler_replay\","
+	       "\"backend\":\"%s\",\"operations\":%llu,"
+	       "\"wall_seconds\":%.6f,\"operations_per_second\":%.0f}\n",
+	       Version::full().c_str(), backend,
+	       (unsigned long long)operations, wall, operations / wall);
+	fflush(stdout);
+}
+
+static const char* const scalerNames[] = {
+	"simple", "SaI", "ScaleNx", "hq", "hqlite", "RGBtriplet", "TV", "MLAA"
+};
+static const unsigned scalerThreads[] = { 1, 2, 4, 8 };
+
+#if HAVE_32BPP
+// Fill the frame with 8x8 blocks in a few colors (like the characters on a
+// typical MSX screen), so that the scalers find plenty of edges.
+static void fillTestFrame(RawFrame& frame, unsigned width)
+{
+	static const uint32_t colors[] = {
+		0x000000, 0xFFFFFF, 0x21C842, 0x5455ED,
+		0xD4524D, 0x42EBF5, 0xCCC35E, 0x3AA241,
+	};
+	for (unsigned y = 0; y < frame.getHeight(); ++y) {
+		auto* line = frame.getLinePtrDirect<uint32_t>(y);
+		for (unsigned x = 0; x < width; ++x) {
+			unsigned block = (x / 8) * 7 + (y / 8) * 3;
+			unsigned pattern = ((x ^ y) & 4) ? 0 : 1;
+			line[x] = colors[(block + pattern) % 8];
+		}
+		frame.setLineWidth(y, width);
+	}
+}
+
+static void benchScalers(Reactor& reactor, unsigned frames)
+{
+	// Only needed for the RenderSettings.
+	reactor.switchMachine("Bench_turboR");
+	auto& renderSettings = reactor.getDisplay().getRenderSettings();
+	auto& controller = reactor.getCommandController();
+
+	for (unsigned factor = MIN_SCALE_FACTOR; factor <= MAX_SCALE_FACTOR;
+	     ++factor) {
+		controller.executeCommand(
+			StringOp::Builder() << "set scale_factor " << factor);
+		SDLSurfacePtr proto(320 * factor, 240 * factor, 32,
+		                    0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+		SDLOffScreenSurface output(*proto.get());
+		PixelOperations<uint32_t> pixelOps(output.getSDLFormat());
+		RawFrame frame(output.getSDLFormat(), 320, 240);
+		fillTestFrame(frame, 320);
+		std::vector<ParallelScaler<uint32_t>::Region> regions = {
+			{ 0, 240, 320, 0, 240 * factor }
+		};
+		output.lock();
+
+		for (auto* name : scalerNames) {
+			try {
+				controller.executeCommand(StringOp::Builder() <<
+					"set scale_algorithm " << name);
+			} catch (MSXException&) {
+				continue; // not available in this build
+			}
+			for (auto threads : scalerThreads) {
+				controller.executeCommand(StringOp::Builder() <<
+					"set scale_threads " << (threads - 1));
+				ParallelScaler<uint32_t> scaler(renderSettings);
+				auto scaleFrame = [&] {
+					scaler.scaleImage(
+						frame, nullptr, regions, 1, factor,
+						pixelOps, [&] {
+							return StretchScalerOutputFactory<uint32_t>::create(
+								output, pixelOps, 320); });
+				};
+				scaleFrame(); // create scalers and threads
+
+				uint64_t start = Timer::getTime();
+				for (unsigned i = 0; i < frames; ++i) scaleFrame();
+				uint64_t stop = Timer::getTime();
+				double wall = (stop - start) / 1000000.0;
+
+				printf("{\"version\":\"%s\",\"workload\":\"scaler\","
+				       "\"algorithm\":\"%s\",\"factor\":%u,"
+				       "\"threads\":%u,\"frames\":%u,"
+				       "\"wall_seconds\":%.6f,\"ms_per_frame\":%.3f}\n",
+				       Version::full().c_str(), name, factor,
+				       threads, frames, wall,
+				       wall * 1000.0 / frames);
+				fflush(stdout);
+			}
+		}
+	}
+}
+#else
+static void benchScalers(Reactor& /*reactor*/, unsigned /*frames*/)
+{
+	throw FatalError("The scaler benchmark needs 32bpp support.");
+}
+#endif
+
+static int usage(const char* name)
+{
+	cerr << "Usage: " << name << " [<emulated-seconds>]\n"
+	     << "       " << name << " --record-scheduler <file> "
+	                             "[<machine> [<emulated-seconds>]]\n"
+	     << "       " << name << " --replay-scheduler <file> "
+	                             "[<repeat-count>]\n"
+	     << "       " << name << " --scalers [<frames>]\n"
+	     << "       " << name << " --sound [<emulated-seconds>]\n"
+	     << "       " << name << " --block-cache [<emulated-seconds>]\n"
+	     << "       " << name << " --cpu-trace [<emulated-seconds>]\n"
+	     << "       " << name << " --render-thread [<emulated-seconds>]"
+	     << endl;
+	return 1;
+}
+
+static int main(int argc, char **argv)
+{
+	double seconds = 10.0;
+	const char* recordFile = nullptr;
+	const char* machine = "Bench_turboR";
+	int scalerFrames = 0;
+	bool sound = false;
+	bool blockCache = false;
+	bool cpuTrace = false;
+	bool renderThread = false;
+	if ((argc > 1) && (string_ref(argv[1]) == "--replay-scheduler")) {
+		if ((argc < 3) || (argc > 4)) return usage(argv[0]);
+		int repeat = (argc == 4) ? atoi(argv[3]) : 10;
+		if (repeat <= 0) return usage(argv[0]);
+		try {
+			replaySchedulerTrace(argv[2], repeat);
+		} catch (MSXException& e) {
+			cerr << "Error: " << e.getMessage() << endl;
+			return 1;
+		}
+		return 0;
+	} else if ((argc > 1) && (string_ref(argv[1]) == "--record-scheduler")) {
+		if ((argc < 3) || (argc > 5)) return usage(argv[0]);
+		recordFile = argv[2];
+		if (argc > 3) machine = argv[3];
+		if (argc > 4) {
+			seconds = atof(argv[4]);
+			if (seconds <= 0.0) return usage(argv[0]);
+		}
+	} else if ((argc > 1) && (string_ref(argv[1]) == "--scalers")) {
+		if (argc > 3) return usage(argv[0]);
+		scalerFrames = (argc == 3) ? atoi(argv[2]) : 100;
+		if (scalerFrames <= 0) return usage(argv[0]);
+	} else if ((argc > 1) && (string_ref(argv[1]) == "--sound")) {
+		if (argc > 3) return usage(argv[0]);
+		sound = true;
+		if (argc == 3) {
+			seconds = atof(argv[2]);
+			if (seconds <= 0.0) return usage(argv[0]);
+		}
+	} else if ((argc > 1) && (string_ref(argv[1]) == "--block-cache")) {
+		if (argc > 3) return usage(argv[0]);
+		blockCache = true;
+		if (argc == 3) {
+			seconds = atof(argv[2]);
+			if (seconds <= 0.0) return usage(argv[0]);
+		}
+	} else if ((argc > 1) && (string_ref(argv[1]) == "--cpu-trace")) {
+		if (argc > 3) return usage(argv[0]);
+		cpuTrace = true;
+		if (argc == 3) {
+			seconds = atof(argv[2]);
+			if (seconds <= 0.0) return usage(argv[0]);
+		}
+	} else if ((argc > 1) && (string_ref(argv[1]) == "--render-thread")) {
+		if (argc > 3) return usage(argv[0]);
+		renderThread = true;
+		if (argc == 3) {
+			seconds = atof(argv[2]);
+			if (seconds <= 0.0) return usage(argv[0]);
+		}
+	} else if (argc > 1) {
+		seconds = atof(argv[1]);
+		if ((argc > 2) || (seconds <= 0.0)) return usage(argv[0]);
+	}
+
+	int err = 0;
+	try {
+		initializeSDL();
+
+		Thread::setMainThread();
+		Reactor reactor;
+		reactor.init();
+		reactor.getInterpreter().init(argv[0]);
+		reactor.getGlobalCliComm().addListener(
+			make_unique<StdioMessages>());
+		// Don't load settings.xml: the results shouldn't depend on
+		// the user's settings. The renderer stays at 'none'.
+		reactor.getCommandController().executeCommand(
+			"set sound_driver null");
+
+		if (recordFile) {
+			recordSchedulerTrace(reactor, recordFile, machine, seconds);
+		} else if (scalerFrames) {
+			benchScalers(reactor, scalerFrames);
+		} else if (sound) {
+			benchSound(reactor, seconds);
+		} else if (renderThread) {
+			benchRenderThread(reactor, seconds);
+		} else if (blockCache) {
+			for (auto& workload : workloads) {
+				runWorkload(reactor, workload, seconds, false);
+				runWorkload(reactor, workload, seconds, true);
+			}
+		} else if (cpuTrace) {
+			std::string traceFile = FileOperations::join(
+				FileOperations::getTempDir(), "openmsx-bench.trace");
+			for (auto& workload : workloads) {
+				runWorkload(reactor, workload, seconds, false,
+				            traceFile, false);
+				runWorkload(reactor, workload, seconds, false,
+				            traceFile, true);
+			}
+		} else {
+			for (auto& workload : workloads) {
+				runWorkload(reactor, workload, seconds, false);
+			}
+		}
+	} catch (FatalError& e) {
+		cerr << "Fatal error: " << e.getMessage() << endl;
+		err = 1;
+	} catch (MSXException& e) {
+		cerr << "Uncaught exception: " << e.getMessage() << endl;
+		err = 1;
+	} catch (std::exception& e) {
+		cerr << "Uncaught std::exception: " << e.what() << endl;
+		err = 1;
+	}
+	if (SDL_WasInit(SDL_INIT_EVERYTHING)) {
+		SDL_Quit();
+	}
+	return err;
+}
+
+} // namespace openmsx
+
+int main(int argc, char **argv)
+{
+	exit(openmsx::main(argc, argv)); // need exit() iso return on win32/SDL
+}
@@ -9,6 +9,7 @@
 #include "InterpreterOutput.hh"
 #include "MSXCPUInterface.hh"
 #include "FileOperations.hh"
+#include "HostProfiler.hh"
 #include "array_ref.hh"
 #include "stl.hh"
 #include "unreachable.hh"
@@ -150,6 +151,7 @@ void Interpreter::unregisterCommand(Command& command)
 int Interpreter::commandProc(ClientData clientData, Tcl_Interp* interp,
                            int objc, Tcl_Obj* const objv[])
 {
+	HostTimer timer(HostProfiler::TCL);
 	try {
 		auto& command = *static_cast<Command*>(clientData);
 		auto tokens = make_array_ref(
@@ -66,6 +66,18 @@ void TclObject::setBinary(byte* buf, unsigned length)
 	}
 }
 
+byte* TclObject::allocBinary(unsigned length)
+{
+	if (Tcl_IsShared(obj)) {
+		Tcl_DecrRefCount(obj);
+		obj = Tcl_NewByteArrayObj(nullptr, 0);
+		Tcl_IncrRefCount(obj);
+	} else {
+		Tcl_SetByteArrayObj(obj, nullptr, 0);
+	}
+	return Tcl_SetByteArrayLength(obj, length);
+}
+
 void TclObject::addListElement(string_ref element)
 {
 	addListElement(Tcl_NewStringObj(element.data(), int(element.size())));
@@ -89,6 +89,9 @@ public:
 	void setBoolean(bool value);
 	void setDouble(double value);
 	void setBinary(byte* buf, unsigned length);
+	/** Turn this object into a byte array of the given length and return
+	  * a pointer to its (uninitialized) content. */
+	byte* allocBinary(unsigned length);
 	void addListElement(string_ref element);
 	void addListElement(int value);
 	void addListElement(double value);
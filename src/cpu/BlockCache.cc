@@ -0,0 +1,40 @@
+#include "BlockCache.hh"
+#include "memory.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace openmsx {
+
+const BlockCache::Block& BlockCache::add(
+	unsigned address, const byte* line, Block&& block)
+{
+	assert(block.size <= CacheLine::SIZE - (address & CacheLine::LOW));
+	auto& l = lines[address >> CacheLine::BITS];
+	if (l && (memcmp(l->code, line, CacheLine::SIZE) != 0)) {
+		// memory changed since the other blocks in this line were
+		// decoded, those blocks are no longer valid
+		l.reset();
+	}
+	if (!l) {
+		l = make_unique<Line>();
+		memcpy(l->code, line, CacheLine::SIZE);
+		std::fill(std::begin(l->index), std::end(l->index), -1);
+	}
+	unsigned offset = address & CacheLine::LOW;
+	assert(l->index[offset] == -1);
+	l->index[offset] = int16_t(l->blocks.size());
+	l->blocks.push_back(std::move(block));
+	return l->blocks.back();
+}
+
+void BlockCache::invalidate(unsigned start, unsigned size)
+{
+	unsigned first = start / CacheLine::SIZE;
+	unsigned num = (size + CacheLine::SIZE - 1) / CacheLine::SIZE;
+	for (unsigned i = first; i < first + num; ++i) {
+		lines[i].reset();
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,96 @@
+#ifndef BLOCKCACHE_HH
+#define BLOCKCACHE_HH
+
+#include "CacheLine.hh"
+#include "openmsx.hh"
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+namespace openmsx {
+
+/** One pre-decoded instruction of a translated block. */
+struct MicroOp
+{
+	byte opcode; // main opcode, selects the implementation
+	byte length; // instruction length in bytes
+	word imm;    // immediate operand (already fetched), if any
+	int cycles;  // total cost, only used for instructions with an operand
+};
+
+/** Storage for the pre-decoded (straight-line) instruction blocks of
+  * CPUCore, see CPUCore::executeBlock().
+  *
+  * A block is decoded from a single cacheable read line and never crosses
+  * the border of such a line. Together with each line we keep a copy of the
+  * memory content it was decoded from. Most changes to the memory layout
+  * are signaled via invalidate() (the same moments the CPU read/write cache
+  * is invalidated). But memory can also change without going through the
+  * CPU write cache (e.g. a memory mapper segment that's visible in two
+  * pages, or a write from the debugger). Therefore find() also verifies the
+  * bytes of the block are still unchanged.
+  */
+class BlockCache
+{
+public:
+	/** Upper limit for the number of instructions in one block. */
+	static const unsigned MAX_OPS = 32;
+
+	struct Block
+	{
+		std::vector<MicroOp> ops; // empty means: not translatable
+		unsigned size; // number of bytes the block was decoded from
+	};
+
+	BlockCache() = default;
+	BlockCache(const BlockCache&) = delete;
+	BlockCache& operator=(const BlockCache&) = delete;
+
+	/** Find the block that starts at the given address.
+	  * @param address Start address of the block.
+	  * @param line Content of the cache line that contains this address
+	  *             (pointer to the first byte of that line).
+	  * @result Pointer to the block or nullptr when there's no (valid)
+	  *         block for this address.
+	  */
+	const Block* find(unsigned address, const byte* line)
+	{
+		auto& l = lines[address >> CacheLine::BITS];
+		if (!l) return nullptr;
+		unsigned offset = address & CacheLine::LOW;
+		int idx = l->index[offset];
+		if (idx < 0) return nullptr;
+		const Block& block = l->blocks[idx];
+		if (memcmp(&l->code[offset], &line[offset], block.size) != 0) {
+			l.reset();
+			return nullptr;
+		}
+		return &block;
+	}
+
+	/** Add a newly decoded block.
+	  * @param address Start address of the block.
+	  * @param line Content of the cache line the block was decoded from.
+	  * @param block The decoded block.
+	  * @result Reference to the stored block.
+	  */
+	const Block& add(unsigned address, const byte* line, Block&& block);
+
+	/** Drop all blocks in the given address range. */
+	void invalidate(unsigned start, unsigned size);
+
+private:
+	struct Line
+	{
+		byte code[CacheLine::SIZE]; // memory content when decoded
+		int16_t index[CacheLine::SIZE]; // offset -> block, or -1
+		std::vector<Block> blocks;
+	};
+
+	std::unique_ptr<Line> lines[CacheLine::NUM];
+};
+
+} // namespace openmsx
+
+#endif
@@ -5,10 +5,13 @@ namespace openmsx {
 
 unsigned BreakPoint::lastId = 0;
 
-BreakPoint::BreakPoint(word address_, TclObject command_, TclObject condition_)
+BreakPoint::BreakPoint(word address_, TclObject command_, TclObject condition_,
+                       int primarySlot_, int secondarySlot_)
 	: BreakPointBase(command_, condition_)
 	, id(++lastId)
 	, address(address_)
+	, primarySlot(primarySlot_)
+	, secondarySlot(secondarySlot_)
 {
 }
 
@@ -9,18 +9,29 @@ namespace openmsx {
 /** Base class for CPU breakpoints.
  *  For performance reasons every bp is associated with exactly one
  *  (immutable) address.
+ *  Optionally a bp can be restricted to a specific slot: it then only
+ *  triggers when that slot is selected in the page of the address.
  */
 class BreakPoint final : public BreakPointBase
 {
 public:
-	BreakPoint(word address, TclObject command, TclObject condition);
+	/** @param primarySlot Primary slot, -1 means any slot.
+	  * @param secondarySlot Secondary slot, -1 means any subslot.
+	  */
+	BreakPoint(word address, TclObject command, TclObject condition,
+	           int primarySlot = -1, int secondarySlot = -1);
 
 	word getAddress() const { return address; }
 	unsigned getId() const { return id; }
+	int getPrimarySlot() const { return primarySlot; }
+	int getSecondarySlot() const { return secondarySlot; }
+	bool hasSlot() const { return primarySlot != -1; }
 
 private:
 	unsigned id;
 	word address;
+	signed char primarySlot;
+	signed char secondarySlot;
 
 	static unsigned lastId;
 };
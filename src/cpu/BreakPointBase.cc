@@ -1,4 +1,5 @@
 #include "BreakPointBase.hh"
+#include "CompiledCondition.hh"
 #include "CommandException.hh"
 #include "GlobalCliComm.hh"
 #include "ScopedAssign.hh"
@@ -7,16 +8,29 @@ namespace openmsx {
 
 BreakPointBase::BreakPointBase(TclObject command_, TclObject condition_)
 	: command(std::move(command_)), condition(std::move(condition_))
+	, compiled(CompiledCondition::compile(condition.getString()))
 	, executing(false)
 {
 }
 
-bool BreakPointBase::isTrue(GlobalCliComm& cliComm, Interpreter& interp) const
+bool BreakPointBase::isNative() const
+{
+	return condition.getString().empty() || compiled;
+}
+
+bool BreakPointBase::isTrue(GlobalCliComm& cliComm, Interpreter& interp,
+                            MSXMotherBoard& motherBoard) const
 {
 	if (condition.getString().empty()) {
 		// unconditional bp
 		return true;
 	}
+	bool result;
+	if (compiled && compiled->evaluate(motherBoard, result)) {
+		return result;
+	}
+	// Not compiled, or failed to evaluate natively (e.g. division by
+	// zero). In the latter case Tcl will report the error.
 	try {
 		return condition.evalBool(interp);
 	} catch (CommandException& e) {
@@ -25,14 +39,15 @@ bool BreakPointBase::isTrue(GlobalCliComm& cliComm, Interpreter& interp) const
 	}
 }
 
-void BreakPointBase::checkAndExecute(GlobalCliComm& cliComm, Interpreter& interp)
+void BreakPointBase::checkAndExecute(GlobalCliComm& cliComm, Interpreter& interp,
+                                     MSXMotherBoard& motherBoard)
 {
 	if (executing) {
 		// no recursive execution
 		return;
 	}
 	ScopedAssign<bool> sa(executing, true);
-	if (isTrue(cliComm, interp)) {
+	if (isTrue(cliComm, interp, motherBoard)) {
 		try {
 			command.executeCommand(interp, true); // compile command
 		} catch (CommandException& e) {
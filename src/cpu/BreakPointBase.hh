@@ -3,11 +3,14 @@
 
 #include "TclObject.hh"
 #include "string_ref.hh"
+#include <memory>
 
 namespace openmsx {
 
 class Interpreter;
 class GlobalCliComm;
+class MSXMotherBoard;
+class CompiledCondition;
 
 /** Base class for CPU break and watch points.
  */
@@ -19,7 +22,12 @@ public:
 	TclObject getConditionObj() const { return condition; }
 	TclObject getCommandObj()   const { return command; }
 
-	void checkAndExecute(GlobalCliComm& cliComm, Interpreter& interp);
+	/** Is the condition evaluated natively (see CompiledCondition),
+	  * or does it require the Tcl interpreter? */
+	bool isNative() const;
+
+	void checkAndExecute(GlobalCliComm& cliComm, Interpreter& interp,
+	                     MSXMotherBoard& motherBoard);
 
 protected:
 	// Note: we require GlobalCliComm here because breakpoint objects can
@@ -28,10 +36,14 @@ protected:
 	BreakPointBase(TclObject command, TclObject condition);
 
 private:
-	bool isTrue(GlobalCliComm& cliComm, Interpreter& interp) const;
+	bool isTrue(GlobalCliComm& cliComm, Interpreter& interp,
+	            MSXMotherBoard& motherBoard) const;
 
 	TclObject command;
 	TclObject condition;
+	// shared between copies of this object (e.g. see
+	// MSXCPUInterface::checkBreakPoints())
+	std::shared_ptr<const CompiledCondition> compiled;
 	bool executing;
 };
 
@@ -165,6 +165,9 @@
 #include "CliComm.hh"
 #include "TclCallback.hh"
 #include "Dasm.hh"
+#include "TraceRecorder.hh"
+#include "SamplingProfiler.hh"
+#include "HostProfiler.hh"
 #include "Z80.hh"
 #include "R800.hh"
 #include "Thread.hh"
@@ -306,12 +309,27 @@ template<class T> CPUCore<T>::CPUCore(
 	, motherboard(motherboard_)
 	, scheduler(motherboard.getScheduler())
 	, interface(nullptr)
+	, traceRecorder(nullptr)
+	, profiler(nullptr)
 	, traceSetting(traceSetting_)
 	, diHaltCallback(diHaltCallback_)
 	, IRQStatus(motherboard.getDebugger(), name + ".pendingIRQ",
 	            "Non-zero if there are pending IRQs (thus CPU would enter "
 	            "interrupt routine in EI mode).",
 	            0)
+	, memCacheInvalidations(motherboard.getDebugger(),
+	            name + ".memCacheInvalidations",
+	            "Number of times (a part of) the memory cache was "
+	            "invalidated, e.g. because of a slot or mapper switch.",
+	            0)
+	, memCacheFills(motherboard.getDebugger(), name + ".memCacheFills",
+	            "Number of times a device directly filled (a part of) the "
+	            "read cache, e.g. on a ROM bank switch.",
+	            0)
+	, memCacheRefills(motherboard.getDebugger(), name + ".memCacheRefills",
+	            "Number of cache lines that had to be looked up (again) "
+	            "after they were invalidated.",
+	            0)
 	, IRQAccept(motherboard.getDebugger(), name + ".acceptIRQ",
 	            "This probe is only useful to set a breakpoint on (the value "
 		    "return by read is meaningless). The breakpoint gets triggered "
@@ -325,16 +343,26 @@ template<class T> CPUCore<T>::CPUCore(
 		"custom " + name + " frequency (only valid when unlocked)",
 		T::CLOCK_FREQ, 1000000, 1000000000)
 	, freq(T::CLOCK_FREQ)
+	, blockCacheSetting(
+		motherboard.getCommandController(), name + "_block_cache",
+		"execute pre-decoded blocks of " + name + " instructions "
+		"(faster, but has no effect when breakpoints are set)",
+		false)
 	, NMIStatus(0)
 	, nmiEdge(false)
 	, exitLoop(false)
 	, tracingEnabled(traceSetting.getBoolean())
+	, blockTier(false)
 	, isTurboR(motherboard.isTurboR())
 {
 	static_assert(!std::is_polymorphic<CPUCore<T>>::value,
 		"keep CPUCore non-virtual to keep PC at offset 0");
+	for (int page = 0; page < 4; ++page) {
+		visibleSlot[page] = -1;
+		visibleDevice[page] = nullptr;
+	}
 	doSetFreq();
-	doReset(time);
+	doReset(time); // also invalidates slotCache
 }
 
 template<class T> void CPUCore<T>::warp(EmuTime::param time)
@@ -349,13 +377,95 @@ template<class T> EmuTime::param CPUCore<T>::getCurrentTime() const
 }
 
 template<class T> void CPUCore<T>::invalidateMemCache(unsigned start, unsigned size)
+{
+	unsigned first = start / CacheLine::SIZE;
+	unsigned num = (size + CacheLine::SIZE - 1) / CacheLine::SIZE;
+	memset(&writeCacheLine [first], 0, num * sizeof(byte*)); // nullptr
+	memset(&writeCacheTried[first], 0, num * sizeof(bool));  // FALSE
+	invalidateReadCache(start, size);
+}
+
+template<class T> void CPUCore<T>::invalidateReadCache(unsigned start, unsigned size)
 {
 	unsigned first = start / CacheLine::SIZE;
 	unsigned num = (size + CacheLine::SIZE - 1) / CacheLine::SIZE;
 	memset(&readCacheLine  [first], 0, num * sizeof(byte*)); // nullptr
-	memset(&writeCacheLine [first], 0, num * sizeof(byte*)); //
 	memset(&readCacheTried [first], 0, num * sizeof(bool));  // FALSE
-	memset(&writeCacheTried[first], 0, num * sizeof(bool));  //
+	blockCache.invalidate(start, size);
+	invalidateSlotCache(first, num);
+	memCacheInvalidations = memCacheInvalidations + 1;
+	HostProfiler::count(HostProfiler::MEM_CACHE_INVALIDATE);
+}
+
+template<class T> void CPUCore<T>::fillReadCache(
+	unsigned start, unsigned size, const byte* rData)
+{
+	assert((start % CacheLine::SIZE) == 0);
+	assert((size  % CacheLine::SIZE) == 0);
+	unsigned first = start / CacheLine::SIZE;
+	unsigned num = size / CacheLine::SIZE;
+	// Same (biased) pointers as RDMEMslow() would store, so for all lines
+	// in this region it's 'rData - start'.
+	const byte* line = rData ? (rData - start) : nullptr;
+	for (unsigned i = 0; i < num; ++i) {
+		readCacheLine  [first + i] = line;
+		readCacheTried [first + i] = true;
+	}
+	blockCache.invalidate(start, size);
+	invalidateSlotCache(first, num);
+	memCacheFills = memCacheFills + 1;
+}
+
+template<class T> void CPUCore<T>::invalidateSlotCache(unsigned first, unsigned num)
+{
+	// Drop the cache lines of the non-visible slots in these pages.
+	if (num == 0) return;
+	unsigned firstPage = first / LINES_PER_PAGE;
+	unsigned endPage = std::min(first + num - 1, CacheLine::NUM - 1)
+	                / LINES_PER_PAGE;
+	for (unsigned page = firstPage; page <= endPage; ++page) {
+		for (auto& s : slotCache[page]) s.valid = false;
+	}
+}
+
+template<class T> bool CPUCore<T>::switchVisibleSlot(
+	unsigned page, unsigned primarySlot, unsigned secondarySlot,
+	const MSXDevice& device)
+{
+	unsigned first = page * LINES_PER_PAGE;
+	int oldSlot = visibleSlot[page];
+	if (oldSlot != -1) {
+		auto& s = slotCache[page][oldSlot];
+		memcpy(s.readCacheLine,   &readCacheLine  [first], sizeof(s.readCacheLine));
+		memcpy(s.writeCacheLine,  &writeCacheLine [first], sizeof(s.writeCacheLine));
+		memcpy(s.readCacheTried,  &readCacheTried [first], sizeof(s.readCacheTried));
+		memcpy(s.writeCacheTried, &writeCacheTried[first], sizeof(s.writeCacheTried));
+		s.device = visibleDevice[page];
+		s.valid = true;
+	}
+	int newSlot = primarySlot * 4 + secondarySlot;
+	visibleSlot[page] = newSlot;
+	visibleDevice[page] = &device;
+
+	// Pre-decoded blocks are not kept per slot.
+	blockCache.invalidate(page * 0x4000, 0x4000);
+
+	// The same slot can contain a different device by now (or, when a
+	// page switch didn't change the visible device, 'oldSlot' was not
+	// accurate), so also check the device.
+	auto& s = slotCache[page][newSlot];
+	if (s.valid && (s.device == &device)) {
+		memcpy(&readCacheLine  [first], s.readCacheLine,   sizeof(s.readCacheLine));
+		memcpy(&writeCacheLine [first], s.writeCacheLine,  sizeof(s.writeCacheLine));
+		memcpy(&readCacheTried [first], s.readCacheTried,  sizeof(s.readCacheTried));
+		memcpy(&writeCacheTried[first], s.writeCacheTried, sizeof(s.writeCacheTried));
+		return true;
+	}
+	memset(&readCacheLine  [first], 0, LINES_PER_PAGE * sizeof(byte*)); // nullptr
+	memset(&writeCacheLine [first], 0, LINES_PER_PAGE * sizeof(byte*)); //
+	memset(&readCacheTried [first], 0, LINES_PER_PAGE * sizeof(bool));  // FALSE
+	memset(&writeCacheTried[first], 0, LINES_PER_PAGE * sizeof(bool));  //
+	return false;
 }
 
 template<class T> void CPUCore<T>::doReset(EmuTime::param time)
@@ -429,7 +539,7 @@ template<class T> void CPUCore<T>::exitCPULoopAsync()
 }
 template<class T> void CPUCore<T>::exitCPULoopSync()
 {
-	assert(Thread::isMainThread());
+	assert(Thread::isEmulationThread());
 	exitLoop = true;
 	T::disableLimit();
 }
@@ -560,10 +670,16 @@ template<class T> void CPUCore<T>::update(const Setting& setting)
 	} else if (&setting == &freqValue) {
 		doSetFreq();
 	} else if (&setting == &traceSetting) {
-		tracingEnabled = traceSetting.getBoolean();
+		tracingEnabled = traceSetting.getBoolean() || traceRecorder;
 	}
 }
 
+template<class T> void CPUCore<T>::setTraceRecorder(TraceRecorder* recorder)
+{
+	traceRecorder = recorder;
+	tracingEnabled = traceSetting.getBoolean() || traceRecorder;
+}
+
 template<class T> void CPUCore<T>::setFreq(unsigned freq_)
 {
 	freq = freq_;
@@ -599,13 +715,14 @@ template<class T> inline void CPUCore<T>::WRITE_PORT(unsigned port, byte value,
 	// note: no forced page-break after IO
 }
 
-template<class T> template<bool PRE_PB, bool POST_PB>
+template<class T> template<bool PRE_PB, bool POST_PB, bool OPCODE>
 NEVER_INLINE byte CPUCore<T>::RDMEMslow(unsigned address, unsigned cc)
 {
 	// not cached
 	unsigned high = address >> CacheLine::BITS;
 	if (!readCacheTried[high]) {
 		// try to cache now
+		memCacheRefills = memCacheRefills + 1;
 		unsigned addrBase = address & CacheLine::HIGH;
 		if (const byte* line = interface->getReadCacheLine(addrBase)) {
 			// cached ok
@@ -621,10 +738,13 @@ NEVER_INLINE byte CPUCore<T>::RDMEMslow(unsigned address, unsigned cc)
 	EmuTime time = T::getTimeFast(cc);
 	scheduler.schedule(time);
 	byte result = interface->readMem(address, time);
+	if (!OPCODE && unlikely(isRecordingTrace())) {
+		traceRecorder->memRead(address, result);
+	}
 	T::template POST_MEM<POST_PB>(address);
 	return result;
 }
-template<class T> template<bool PRE_PB, bool POST_PB>
+template<class T> template<bool PRE_PB, bool POST_PB, bool OPCODE>
 ALWAYS_INLINE byte CPUCore<T>::RDMEM_impl2(unsigned address, unsigned cc)
 {
 	const byte* line = readCacheLine[address >> CacheLine::BITS];
@@ -634,15 +754,15 @@ ALWAYS_INLINE byte CPUCore<T>::RDMEM_impl2(unsigned address, unsigned cc)
 		T::template POST_MEM<       POST_PB>(address);
 		return line[address];
 	} else {
-		return RDMEMslow<PRE_PB, POST_PB>(address, cc); // not inlined
+		return RDMEMslow<PRE_PB, POST_PB, OPCODE>(address, cc); // not inlined
 	}
 }
-template<class T> template<bool PRE_PB, bool POST_PB>
+template<class T> template<bool PRE_PB, bool POST_PB, bool OPCODE>
 ALWAYS_INLINE byte CPUCore<T>::RDMEM_impl(unsigned address, unsigned cc)
 {
 	static const bool PRE  = T::template Normalize<PRE_PB >::value;
 	static const bool POST = T::template Normalize<POST_PB>::value;
-	return RDMEM_impl2<PRE, POST>(address, cc);
+	return RDMEM_impl2<PRE, POST, OPCODE>(address, cc);
 }
 template<class T> template<unsigned PC_OFFSET> ALWAYS_INLINE byte CPUCore<T>::RDMEM_OPCODE(unsigned cc)
 {
@@ -656,21 +776,21 @@ template<class T> template<unsigned PC_OFFSET> ALWAYS_INLINE byte CPUCore<T>::RD
 	// faster to only update PC once per instruction instead of after each
 	// fetch.
 	unsigned address = (getPC() + PC_OFFSET) & 0xFFFF;
-	return RDMEM_impl<false, false>(address, cc);
+	return RDMEM_impl<false, false, true>(address, cc);
 }
 template<class T> ALWAYS_INLINE byte CPUCore<T>::RDMEM(unsigned address, unsigned cc)
 {
 	return RDMEM_impl<true, true>(address, cc);
 }
 
-template<class T> template<bool PRE_PB, bool POST_PB>
+template<class T> template<bool PRE_PB, bool POST_PB, bool OPCODE>
 NEVER_INLINE unsigned CPUCore<T>::RD_WORD_slow(unsigned address, unsigned cc)
 {
-	unsigned res = RDMEM_impl<PRE_PB,  false>(address, cc);
-	res         += RDMEM_impl<false, POST_PB>((address + 1) & 0xFFFF, cc + T::CC_RDMEM) << 8;
+	unsigned res = RDMEM_impl<PRE_PB,  false,   OPCODE>(address, cc);
+	res         += RDMEM_impl<false, POST_PB, OPCODE>((address + 1) & 0xFFFF, cc + T::CC_RDMEM) << 8;
 	return res;
 }
-template<class T> template<bool PRE_PB, bool POST_PB>
+template<class T> template<bool PRE_PB, bool POST_PB, bool OPCODE>
 ALWAYS_INLINE unsigned CPUCore<T>::RD_WORD_impl2(unsigned address, unsigned cc)
 {
 	const byte* line = readCacheLine[address >> CacheLine::BITS];
@@ -681,20 +801,20 @@ ALWAYS_INLINE unsigned CPUCore<T>::RD_WORD_impl2(unsigned address, unsigned cc)
 		return Endian::read_UA_L16(&line[address]);
 	} else {
 		// slow path, not inline
-		return RD_WORD_slow<PRE_PB, POST_PB>(address, cc);
+		return RD_WORD_slow<PRE_PB, POST_PB, OPCODE>(address, cc);
 	}
 }
-template<class T> template<bool PRE_PB, bool POST_PB>
+template<class T> template<bool PRE_PB, bool POST_PB, bool OPCODE>
 ALWAYS_INLINE unsigned CPUCore<T>::RD_WORD_impl(unsigned address, unsigned cc)
 {
 	static const bool PRE  = T::template Normalize<PRE_PB >::value;
 	static const bool POST = T::template Normalize<POST_PB>::value;
-	return RD_WORD_impl2<PRE, POST>(address, cc);
+	return RD_WORD_impl2<PRE, POST, OPCODE>(address, cc);
 }
 template<class T> template<unsigned PC_OFFSET> ALWAYS_INLINE unsigned CPUCore<T>::RD_WORD_PC(unsigned cc)
 {
 	unsigned addr = (getPC() + PC_OFFSET) & 0xFFFF;
-	return RD_WORD_impl<false, false>(addr, cc);
+	return RD_WORD_impl<false, false, true>(addr, cc);
 }
 template<class T> ALWAYS_INLINE unsigned CPUCore<T>::RD_WORD(
 	unsigned address, unsigned cc)
@@ -709,6 +829,7 @@ NEVER_INLINE void CPUCore<T>::WRMEMslow(unsigned address, byte value, unsigned c
 	unsigned high = address >> CacheLine::BITS;
 	if (!writeCacheTried[high]) {
 		// try to cache now
+		memCacheRefills = memCacheRefills + 1;
 		unsigned addrBase = address & CacheLine::HIGH;
 		if (byte* line = interface->getWriteCacheLine(addrBase)) {
 			// cached ok
@@ -725,6 +846,9 @@ NEVER_INLINE void CPUCore<T>::WRMEMslow(unsigned address, byte value, unsigned c
 	EmuTime time = T::getTimeFast(cc);
 	scheduler.schedule(time);
 	interface->writeMem(address, value, time);
+	if (unlikely(isRecordingTrace())) {
+		traceRecorder->memWrite(address, value);
+	}
 	T::template POST_MEM<POST_PB>(address);
 }
 template<class T> template<bool PRE_PB, bool POST_PB>
@@ -817,6 +941,7 @@ template<class T> inline void CPUCore<T>::nmi()
 	setIFF1(false);
 	PUSH<T::EE_NMI_1>(getPC());
 	setPC(0x0066);
+	if (unlikely(profiler != nullptr)) profiler->call(getSP(), getPC());
 	T::add(T::CC_NMI);
 }
 
@@ -832,6 +957,7 @@ template<class T> inline void CPUCore<T>::irq0()
 	setIFF2(false);
 	PUSH<T::EE_IRQ0_1>(getPC());
 	setPC(0x0038);
+	if (unlikely(profiler != nullptr)) profiler->call(getSP(), getPC());
 	T::setMemPtr(getPC());
 	T::add(T::CC_IRQ0);
 }
@@ -845,6 +971,7 @@ template<class T> inline void CPUCore<T>::irq1()
 	setIFF2(false);
 	PUSH<T::EE_IRQ1_1>(getPC());
 	setPC(0x0038);
+	if (unlikely(profiler != nullptr)) profiler->call(getSP(), getPC());
 	T::setMemPtr(getPC());
 	T::add(T::CC_IRQ1);
 }
@@ -859,6 +986,7 @@ template<class T> inline void CPUCore<T>::irq2()
 	PUSH<T::EE_IRQ2_1>(getPC());
 	unsigned x = interface->readIRQVector() | (getI() << 8);
 	setPC(RD_WORD(x, T::CC_IRQ2_2));
+	if (unlikely(profiler != nullptr)) profiler->call(getSP(), getPC());
 	T::setMemPtr(getPC());
 	T::add(T::CC_IRQ2);
 }
@@ -912,6 +1040,7 @@ void CPUCore<T>::executeInstructions()
 	T::add(ii.cycles); \
 	T::R800Refresh(*this); \
 	if (likely(!T::limitReached())) { \
+		if (blockTier) goto start; \
 		incR(1); \
 		unsigned address = getPC(); \
 		const byte* line = readCacheLine[address >> CacheLine::BITS]; \
@@ -973,9 +1102,11 @@ void CPUCore<T>::executeInstructions()
 
 #endif // USE_COMPUTED_GOTO
 
-#ifndef USE_COMPUTED_GOTO
 start:
-#endif
+	if (blockTier && executeBlock()) {
+		if (T::limitReached()) return;
+		goto start;
+	}
 	unsigned ixy; // for dd_cb/fd_cb
 	byte opcodeMain = RDMEM_OPCODE<0>(T::CC_MAIN);
 	incR(1);
@@ -984,7 +1115,7 @@ start:
 
 fetchSlow: {
 	unsigned address = getPC();
-	byte opcodeSlow = RDMEMslow<false, false>(address, T::CC_MAIN);
+	byte opcodeSlow = RDMEMslow<false, false, true>(address, T::CC_MAIN);
 	goto *(opcodeTable[opcodeSlow]);
 }
 #endif
@@ -2460,9 +2591,341 @@ xx_cb: {
 	}
 }
 
+// Block translation cache (second execution tier)
+//
+// In the fast path of execute2() (no breakpoints, no tracing) the CPU can
+// execute pre-decoded blocks of instructions instead of fetching and decoding
+// each instruction again and again. A block is a straight-line sequence of
+// simple instructions (no memory or IO access apart from fetching the
+// instruction itself, no stack access, no instructions that change the
+// interrupt state) that ends at a jump or at the first instruction that
+// can't be translated. Immediate operands are fetched during decoding, so
+// for those instructions the complete cost is precomputed. Other
+// instructions are executed via the same routines as the interpreter.
+//
+// Executing a block must give exactly the same result (including timing) as
+// interpreting the same instructions. That's why each instruction still does
+// the R800 page-break and refresh bookkeeping for its opcode fetch and why we
+// still test for T::limitReached() after each instruction.
+//
+// Blocks are only decoded from (and never cross) a cacheable read line. On a
+// change of the memory layout invalidateMemCache() (or fillReadCache()) drops
+// the corresponding blocks. Memory watchpoints make the read cache line unavailable, so such
+// code is always interpreted.
+
+enum BlockOpType { BLOCK_NONE, BLOCK_PLAIN, BLOCK_N, BLOCK_NN, BLOCK_JUMP };
+struct BlockOpInfo { BlockOpType type; unsigned length; };
+
+static BlockOpInfo getBlockOpInfo(byte opcode)
+{
+	switch (opcode) {
+	case 0x06: case 0x0E: case 0x16: case 0x1E: // ld r,n
+	case 0x26: case 0x2E: case 0x3E:
+	case 0xC6: case 0xCE: case 0xD6: case 0xDE: // alu a,n
+	case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+		return {BLOCK_N, 2};
+	case 0x01: case 0x11: case 0x21: case 0x31: // ld ss,nn
+		return {BLOCK_NN, 3};
+	case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // djnz/jr
+		return {BLOCK_JUMP, 2};
+	case 0xC2: case 0xC3: case 0xCA: case 0xD2: // jp (cc,)nn
+	case 0xDA: case 0xE2: case 0xEA: case 0xF2: case 0xFA:
+		return {BLOCK_JUMP, 3};
+	case 0xE9: // jp (hl)
+		return {BLOCK_JUMP, 1};
+	case 0x00: case 0x07: case 0x0F: case 0x17: case 0x1F: // nop/rotate A
+	case 0x08: case 0x27: case 0x2F: case 0x37: case 0x3F: // ex af,af'/daa/cpl/scf/ccf
+	case 0xD9: case 0xEB: // exx/ex de,hl
+		return {BLOCK_PLAIN, 1};
+	}
+	if (((opcode & 0xCF) == 0x03) || // inc ss
+	    ((opcode & 0xCF) == 0x0B) || // dec ss
+	    ((opcode & 0xCF) == 0x09)) { // add hl,ss
+		return {BLOCK_PLAIN, 1};
+	}
+	if ((((opcode & 0xC7) == 0x04) || ((opcode & 0xC7) == 0x05)) && // inc/dec r
+	    ((opcode & 0x38) != 0x30)) { // but not (hl)
+		return {BLOCK_PLAIN, 1};
+	}
+	if ((0x40 <= opcode) && (opcode < 0xC0) && // ld r,r / alu a,r
+	    ((opcode & 0x07) != 0x06) && // but not (hl) as source
+	    ((opcode & 0xF8) != 0x70)) { // nor as destination (nor halt)
+		return {BLOCK_PLAIN, 1};
+	}
+	return {BLOCK_NONE, 0};
+}
+
+template<class T> const BlockCache::Block& CPUCore<T>::decodeBlock(
+	unsigned address, const byte* line)
+{
+	BlockCache::Block block;
+	unsigned offset = address & CacheLine::LOW;
+	unsigned pos = offset;
+	unsigned fetchCost = T::samePageFetchCost(address);
+	while (block.ops.size() < BlockCache::MAX_OPS) {
+		byte opcode = line[pos];
+		auto info = getBlockOpInfo(opcode);
+		if ((info.type == BLOCK_NONE) ||
+		    ((pos + info.length) > CacheLine::SIZE)) {
+			break;
+		}
+		MicroOp op;
+		op.opcode = opcode;
+		op.length = info.length;
+		op.imm = 0;
+		op.cycles = 0;
+		if (info.type == BLOCK_N) {
+			op.imm = line[pos + 1];
+			op.cycles = (((opcode & 0xC7) == 0x06) ? T::CC_LD_R_N
+			                                       : T::CC_CP_N)
+			          + fetchCost;
+		} else if (info.type == BLOCK_NN) {
+			op.imm = line[pos + 1] | (line[pos + 2] << 8);
+			op.cycles = T::CC_LD_SS_NN + 2 * fetchCost;
+		}
+		block.ops.push_back(op);
+		pos += info.length;
+		if (info.type == BLOCK_JUMP) break;
+	}
+	// An untranslatable first instruction is remembered as an empty block,
+	// check its opcode so that we notice when it changes.
+	block.size = block.ops.empty() ? 1 : (pos - offset);
+	return blockCache.add(address, line, std::move(block));
+}
+
+template<class T> inline bool CPUCore<T>::executeBlock()
+{
+	unsigned address = getPC();
+	const byte* cached = readCacheLine[address >> CacheLine::BITS];
+	if (unlikely(cached == nullptr)) {
+		// not (yet) cached, let the interpreter fetch this instruction
+		return false;
+	}
+	const byte* line = &cached[address & CacheLine::HIGH];
+	const BlockCache::Block* block = blockCache.find(address, line);
+	if (unlikely(block == nullptr)) {
+		block = &decodeBlock(address, line);
+	}
+	if (block->ops.empty()) return false;
+
+	for (auto& op : block->ops) {
+		// same bookkeeping as for the opcode fetch in the interpreter
+		unsigned pc = getPC();
+		T::template PRE_MEM<false, false>(pc);
+		T::template POST_MEM<      false>(pc);
+		incR(1);
+
+		II ii;
+		switch (op.opcode) {
+		case 0x01: set16<BC>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x03: ii = inc_SS<BC,0>(); break;
+		case 0x04: ii = inc_R<B,0>(); break;
+		case 0x05: ii = dec_R<B,0>(); break;
+		case 0x06: set8<B>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x07: ii = rlca(); break;
+		case 0x08: ii = ex_af_af(); break;
+		case 0x09: ii = add_SS_TT<HL,BC,0>(); break;
+		case 0x0B: ii = dec_SS<BC,0>(); break;
+		case 0x0C: ii = inc_R<C,0>(); break;
+		case 0x0D: ii = dec_R<C,0>(); break;
+		case 0x0E: set8<C>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x0F: ii = rrca(); break;
+		case 0x10: ii = djnz(); break;
+		case 0x11: set16<DE>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x13: ii = inc_SS<DE,0>(); break;
+		case 0x14: ii = inc_R<D,0>(); break;
+		case 0x15: ii = dec_R<D,0>(); break;
+		case 0x16: set8<D>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x17: ii = rla(); break;
+		case 0x18: ii = jr(CondTrue()); break;
+		case 0x19: ii = add_SS_TT<HL,DE,0>(); break;
+		case 0x1B: ii = dec_SS<DE,0>(); break;
+		case 0x1C: ii = inc_R<E,0>(); break;
+		case 0x1D: ii = dec_R<E,0>(); break;
+		case 0x1E: set8<E>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x1F: ii = rra(); break;
+		case 0x20: ii = jr(CondNZ()); break;
+		case 0x21: set16<HL>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x23: ii = inc_SS<HL,0>(); break;
+		case 0x24: ii = inc_R<H,0>(); break;
+		case 0x25: ii = dec_R<H,0>(); break;
+		case 0x26: set8<H>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x27: ii = daa(); break;
+		case 0x28: ii = jr(CondZ()); break;
+		case 0x29: ii = add_SS_SS<HL,0>(); break;
+		case 0x2B: ii = dec_SS<HL,0>(); break;
+		case 0x2C: ii = inc_R<L,0>(); break;
+		case 0x2D: ii = dec_R<L,0>(); break;
+		case 0x2E: set8<L>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x2F: ii = cpl(); break;
+		case 0x30: ii = jr(CondNC()); break;
+		case 0x31: set16<SP>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x33: ii = inc_SS<SP,0>(); break;
+		case 0x37: ii = scf(); break;
+		case 0x38: ii = jr(CondC()); break;
+		case 0x39: ii = add_SS_TT<HL,SP,0>(); break;
+		case 0x3B: ii = dec_SS<SP,0>(); break;
+		case 0x3C: ii = inc_R<A,0>(); break;
+		case 0x3D: ii = dec_R<A,0>(); break;
+		case 0x3E: set8<A>(op.imm); ii = {op.length, op.cycles}; break;
+		case 0x3F: ii = ccf(); break;
+		case 0x40: // ld r,r (same register)
+		case 0x41: ii = ld_R_R<B,C,0>(); break;
+		case 0x42: ii = ld_R_R<B,D,0>(); break;
+		case 0x43: ii = ld_R_R<B,E,0>(); break;
+		case 0x44: ii = ld_R_R<B,H,0>(); break;
+		case 0x45: ii = ld_R_R<B,L,0>(); break;
+		case 0x47: ii = ld_R_R<B,A,0>(); break;
+		case 0x48: ii = ld_R_R<C,B,0>(); break;
+		case 0x49: // ld r,r (same register)
+		case 0x4A: ii = ld_R_R<C,D,0>(); break;
+		case 0x4B: ii = ld_R_R<C,E,0>(); break;
+		case 0x4C: ii = ld_R_R<C,H,0>(); break;
+		case 0x4D: ii = ld_R_R<C,L,0>(); break;
+		case 0x4F: ii = ld_R_R<C,A,0>(); break;
+		case 0x50: ii = ld_R_R<D,B,0>(); break;
+		case 0x51: ii = ld_R_R<D,C,0>(); break;
+		case 0x52: // ld r,r (same register)
+		case 0x53: ii = ld_R_R<D,E,0>(); break;
+		case 0x54: ii = ld_R_R<D,H,0>(); break;
+		case 0x55: ii = ld_R_R<D,L,0>(); break;
+		case 0x57: ii = ld_R_R<D,A,0>(); break;
+		case 0x58: ii = ld_R_R<E,B,0>(); break;
+		case 0x59: ii = ld_R_R<E,C,0>(); break;
+		case 0x5A: ii = ld_R_R<E,D,0>(); break;
+		case 0x5B: // ld r,r (same register)
+		case 0x5C: ii = ld_R_R<E,H,0>(); break;
+		case 0x5D: ii = ld_R_R<E,L,0>(); break;
+		case 0x5F: ii = ld_R_R<E,A,0>(); break;
+		case 0x60: ii = ld_R_R<H,B,0>(); break;
+		case 0x61: ii = ld_R_R<H,C,0>(); break;
+		case 0x62: ii = ld_R_R<H,D,0>(); break;
+		case 0x63: ii = ld_R_R<H,E,0>(); break;
+		case 0x64: // ld r,r (same register)
+		case 0x65: ii = ld_R_R<H,L,0>(); break;
+		case 0x67: ii = ld_R_R<H,A,0>(); break;
+		case 0x68: ii = ld_R_R<L,B,0>(); break;
+		case 0x69: ii = ld_R_R<L,C,0>(); break;
+		case 0x6A: ii = ld_R_R<L,D,0>(); break;
+		case 0x6B: ii = ld_R_R<L,E,0>(); break;
+		case 0x6C: ii = ld_R_R<L,H,0>(); break;
+		case 0x6D: // ld r,r (same register)
+		case 0x6F: ii = ld_R_R<L,A,0>(); break;
+		case 0x78: ii = ld_R_R<A,B,0>(); break;
+		case 0x79: ii = ld_R_R<A,C,0>(); break;
+		case 0x7A: ii = ld_R_R<A,D,0>(); break;
+		case 0x7B: ii = ld_R_R<A,E,0>(); break;
+		case 0x7C: ii = ld_R_R<A,H,0>(); break;
+		case 0x7D: ii = ld_R_R<A,L,0>(); break;
+		case 0x7F: // ld r,r (same register)
+		case 0x00: ii = nop(); break;
+		case 0x80: ii = add_a_R<B,0>(); break;
+		case 0x81: ii = add_a_R<C,0>(); break;
+		case 0x82: ii = add_a_R<D,0>(); break;
+		case 0x83: ii = add_a_R<E,0>(); break;
+		case 0x84: ii = add_a_R<H,0>(); break;
+		case 0x85: ii = add_a_R<L,0>(); break;
+		case 0x87: ii = add_a_a(); break;
+		case 0x88: ii = adc_a_R<B,0>(); break;
+		case 0x89: ii = adc_a_R<C,0>(); break;
+		case 0x8A: ii = adc_a_R<D,0>(); break;
+		case 0x8B: ii = adc_a_R<E,0>(); break;
+		case 0x8C: ii = adc_a_R<H,0>(); break;
+		case 0x8D: ii = adc_a_R<L,0>(); break;
+		case 0x8F: ii = adc_a_a(); break;
+		case 0x90: ii = sub_R<B,0>(); break;
+		case 0x91: ii = sub_R<C,0>(); break;
+		case 0x92: ii = sub_R<D,0>(); break;
+		case 0x93: ii = sub_R<E,0>(); break;
+		case 0x94: ii = sub_R<H,0>(); break;
+		case 0x95: ii = sub_R<L,0>(); break;
+		case 0x97: ii = sub_a(); break;
+		case 0x98: ii = sbc_a_R<B,0>(); break;
+		case 0x99: ii = sbc_a_R<C,0>(); break;
+		case 0x9A: ii = sbc_a_R<D,0>(); break;
+		case 0x9B: ii = sbc_a_R<E,0>(); break;
+		case 0x9C: ii = sbc_a_R<H,0>(); break;
+		case 0x9D: ii = sbc_a_R<L,0>(); break;
+		case 0x9F: ii = sbc_a_a(); break;
+		case 0xA0: ii = and_R<B,0>(); break;
+		case 0xA1: ii = and_R<C,0>(); break;
+		case 0xA2: ii = and_R<D,0>(); break;
+		case 0xA3: ii = and_R<E,0>(); break;
+		case 0xA4: ii = and_R<H,0>(); break;
+		case 0xA5: ii = and_R<L,0>(); break;
+		case 0xA7: ii = and_a(); break;
+		case 0xA8: ii = xor_R<B,0>(); break;
+		case 0xA9: ii = xor_R<C,0>(); break;
+		case 0xAA: ii = xor_R<D,0>(); break;
+		case 0xAB: ii = xor_R<E,0>(); break;
+		case 0xAC: ii = xor_R<H,0>(); break;
+		case 0xAD: ii = xor_R<L,0>(); break;
+		case 0xAF: ii = xor_a(); break;
+		case 0xB0: ii = or_R<B,0>(); break;
+		case 0xB1: ii = or_R<C,0>(); break;
+		case 0xB2: ii = or_R<D,0>(); break;
+		case 0xB3: ii = or_R<E,0>(); break;
+		case 0xB4: ii = or_R<H,0>(); break;
+		case 0xB5: ii = or_R<L,0>(); break;
+		case 0xB7: ii = or_a(); break;
+		case 0xB8: ii = cp_R<B,0>(); break;
+		case 0xB9: ii = cp_R<C,0>(); break;
+		case 0xBA: ii = cp_R<D,0>(); break;
+		case 0xBB: ii = cp_R<E,0>(); break;
+		case 0xBC: ii = cp_R<H,0>(); break;
+		case 0xBD: ii = cp_R<L,0>(); break;
+		case 0xBF: ii = cp_a(); break;
+		case 0xC2: ii = jp(CondNZ()); break;
+		case 0xC3: ii = jp(CondTrue()); break;
+		case 0xC6: ADD(op.imm); ii = {op.length, op.cycles}; break;
+		case 0xCA: ii = jp(CondZ()); break;
+		case 0xCE: ADC(op.imm); ii = {op.length, op.cycles}; break;
+		case 0xD2: ii = jp(CondNC()); break;
+		case 0xD6: SUB(op.imm); ii = {op.length, op.cycles}; break;
+		case 0xD9: ii = exx(); break;
+		case 0xDA: ii = jp(CondC()); break;
+		case 0xDE: SBC(op.imm); ii = {op.length, op.cycles}; break;
+		case 0xE2: ii = jp(CondPO()); break;
+		case 0xE6: AND(op.imm); ii = {op.length, op.cycles}; break;
+		case 0xE9: ii = jp_SS<HL,0>(); break;
+		case 0xEA: ii = jp(CondPE()); break;
+		case 0xEB: ii = ex_de_hl(); break;
+		case 0xEE: XOR(op.imm); ii = {op.length, op.cycles}; break;
+		case 0xF2: ii = jp(CondP()); break;
+		case 0xF6: OR(op.imm); ii = {op.length, op.cycles}; break;
+		case 0xFA: ii = jp(CondM ()); break;
+		case 0xFE: CP(op.imm); ii = {op.length, op.cycles}; break;
+		default:
+			UNREACHABLE; ii = {0, 0};
+		}
+		setPC(getPC() + ii.length);
+		T::add(ii.cycles);
+		T::R800Refresh(*this);
+		if (T::limitReached()) break;
+	}
+	return true;
+}
+
+template<class T> inline bool CPUCore<T>::isRecordingTrace() const
+{
+	return (traceRecorder != nullptr) && !interface->isFastForward();
+}
 template<class T> inline void CPUCore<T>::cpuTracePre()
 {
 	start_pc = getPC();
+	if (unlikely(isRecordingTrace())) {
+		cpuTracePre_slow();
+	}
+}
+template<class T> void CPUCore<T>::cpuTracePre_slow()
+{
+	EmuTime time = T::getTimeFast();
+	byte opbuf[4];
+	for (unsigned i = 0; i < 4; ++i) {
+		opbuf[i] = interface->peekMem((start_pc + i) & 0xFFFF, time);
+	}
+	traceRecorder->instruction(time, start_pc, opbuf,
+	                           instructionLength(opbuf));
 }
 template<class T> inline void CPUCore<T>::cpuTracePost()
 {
@@ -2472,26 +2935,56 @@ template<class T> inline void CPUCore<T>::cpuTracePost()
 }
 template<class T> void CPUCore<T>::cpuTracePost_slow()
 {
-	byte opbuf[4];
-	string dasmOutput;
-	dasm(*interface, start_pc, opbuf, dasmOutput, T::getTimeFast());
-	std::cout << std::setfill('0') << std::hex << std::setw(4) << start_pc
-	     << " : " << dasmOutput
-	     << " AF=" << std::setw(4) << getAF()
-	     << " BC=" << std::setw(4) << getBC()
-	     << " DE=" << std::setw(4) << getDE()
-	     << " HL=" << std::setw(4) << getHL()
-	     << " IX=" << std::setw(4) << getIX()
-	     << " IY=" << std::setw(4) << getIY()
-	     << " SP=" << std::setw(4) << getSP()
-	     << std::endl << std::dec;
+	if (traceSetting.getBoolean()) {
+		byte opbuf[4];
+		string dasmOutput;
+		dasm(*interface, start_pc, opbuf, dasmOutput, T::getTimeFast());
+		std::cout << std::setfill('0') << std::hex << std::setw(4) << start_pc
+		     << " : " << dasmOutput
+		     << " AF=" << std::setw(4) << getAF()
+		     << " BC=" << std::setw(4) << getBC()
+		     << " DE=" << std::setw(4) << getDE()
+		     << " HL=" << std::setw(4) << getHL()
+		     << " IX=" << std::setw(4) << getIX()
+		     << " IY=" << std::setw(4) << getIY()
+		     << " SP=" << std::setw(4) << getSP()
+		     << std::endl << std::dec;
+	}
+	if (isRecordingTrace()) {
+		cpuTraceRegisters();
+	}
+}
+template<class T> void CPUCore<T>::cpuTraceRegisters()
+{
+	word regs[TraceRecorder::NUM_REGS] = {
+		word(getAF()),  word(getBC()),  word(getDE()),  word(getHL()),
+		word(getAF2()), word(getBC2()), word(getDE2()), word(getHL2()),
+		word(getIX()),  word(getIY()),  word(getSP()),  word(getI())
+	};
+	traceRecorder->registers(regs);
+}
+template<class T> inline void CPUCore<T>::cpuTraceInterruptPre(bool isNMI)
+{
+	if (unlikely(isRecordingTrace())) {
+		traceRecorder->interrupt(T::getTimeFast(), isNMI
+			? TraceRecorder::NMI
+			: TraceRecorder::Interrupt(TraceRecorder::IRQ_IM0 + getIM()));
+	}
+}
+template<class T> inline void CPUCore<T>::cpuTraceInterruptPost()
+{
+	if (unlikely(isRecordingTrace())) {
+		cpuTraceRegisters();
+	}
 }
 
 template<class T> void CPUCore<T>::executeSlow()
 {
 	if (unlikely(nmiEdge)) {
 		nmiEdge = false;
+		cpuTraceInterruptPre(true);
 		nmi(); // NMI occured
+		cpuTraceInterruptPost();
 	} else if (unlikely(IRQStatus && getIFF1() && !prevWasEI())) {
 		// normal interrupt
 		if (unlikely(prevWasLDAI())) {
@@ -2516,6 +3009,7 @@ template<class T> void CPUCore<T>::executeSlow()
 			setF(getF() & ~V_FLAG);
 		}
 		IRQAccept.signal();
+		cpuTraceInterruptPre(false);
 		switch (getIM()) {
 			case 0: irq0();
 				break;
@@ -2526,6 +3020,7 @@ template<class T> void CPUCore<T>::executeSlow()
 			default:
 				UNREACHABLE;
 		}
+		cpuTraceInterruptPost();
 	} else if (unlikely(getHALT())) {
 		// in halt mode
 		incR(T::advanceHalt(T::haltStates(), scheduler.getNext()));
@@ -2560,6 +3055,7 @@ template<class T> void CPUCore<T>::execute(bool fastForward)
 	// won't trigger. It is possible we already are in break mode, but
 	// break is ignored in fast-forward mode.
 	assert(fastForward || !interface->isBreaked());
+	HostTimer timer(HostProfiler::CPU);
 	if (fastForward) {
 		interface->setFastForward(true);
 	}
@@ -2575,6 +3071,7 @@ template<class T> void CPUCore<T>::execute2(bool fastForward)
 	//       once in this method is enough.
 	scheduler.schedule(T::getTime());
 	setSlowInstructions();
+	blockTier = false;
 
 	if (!fastForward && (interface->isContinue() || interface->isStep())) {
 		// at least one instruction
@@ -2595,6 +3092,7 @@ template<class T> void CPUCore<T>::execute2(bool fastForward)
 	if (fastForward ||
 	    (!interface->anyBreakPoints() && !tracingEnabled)) {
 		// fast path, no breakpoints, no tracing
+		blockTier = blockCacheSetting.getBoolean();
 		while (!needExitCPULoop()) {
 			if (slowInstructions) {
 				--slowInstructions;
@@ -3866,6 +4364,7 @@ template<class T> template<typename COND> II CPUCore<T>::call(COND cond) {
 	if (cond(getF())) {
 		PUSH<T::EE_CALL>(getPC() + 3); /**/
 		setPC(addr);
+		if (unlikely(profiler != nullptr)) profiler->call(getSP(), addr);
 		if (T::isR800()) {
 			setCurrentCall();
 			setSlowInstructions();
@@ -3882,6 +4381,7 @@ template<class T> template<unsigned ADDR> II CPUCore<T>::rst() {
 	PUSH<0>(getPC() + 1); /**/
 	T::setMemPtr(ADDR);
 	setPC(ADDR);
+	if (unlikely(profiler != nullptr)) profiler->call(getSP(), ADDR);
 	if (T::isR800()) {
 		setCurrentCall();
 		setSlowInstructions();
@@ -3896,6 +4396,7 @@ template<class T> template<int EE, typename COND> inline II CPUCore<T>::RET(COND
 		unsigned addr = POP<EE>();
 		T::setMemPtr(addr);
 		setPC(addr);
+		if (unlikely(profiler != nullptr)) profiler->ret(getSP());
 		return {0/*1*/, T::CC_RET_A + EE};
 	} else {
 		return {1, T::CC_RET_B + EE};
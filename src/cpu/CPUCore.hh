@@ -3,6 +3,7 @@
 
 #include "CPURegs.hh"
 #include "CacheLine.hh"
+#include "BlockCache.hh"
 #include "Probe.hh"
 #include "EmuTime.hh"
 #include "BooleanSetting.hh"
@@ -17,11 +18,14 @@
 namespace openmsx {
 
 class MSXCPUInterface;
+class MSXDevice;
 class Scheduler;
 class MSXMotherBoard;
 class TclCallback;
 class TclObject;
 class Interpreter;
+class TraceRecorder;
+class SamplingProfiler;
 enum Reg8  : int;
 enum Reg16 : int;
 
@@ -50,6 +54,13 @@ public:
 
 	void setInterface(MSXCPUInterface* interf) { interface = interf; }
 
+	/** Record executed instructions in the given recorder, nullptr to
+	  * stop recording. */
+	void setTraceRecorder(TraceRecorder* recorder);
+
+	/** Report calls and returns to the given profiler, nullptr to stop. */
+	void setProfiler(SamplingProfiler* profiler_) { profiler = profiler_; }
+
 	/**
 	 * Reset the CPU.
 	 */
@@ -75,6 +86,21 @@ public:
 	EmuTime waitCycles(EmuTime::param time, unsigned cycles);
 	void setNextSyncPoint(EmuTime::param time);
 	void invalidateMemCache(unsigned start, unsigned size);
+	/** Like invalidateMemCache(), but only for the read cache. */
+	void invalidateReadCache(unsigned start, unsigned size);
+	/** Reads in the region [start, start + size) now return the data at
+	  * 'rData' (nullptr means that region is not cacheable). This avoids
+	  * looking up each cache line again after e.g. a bank switch. The
+	  * write cache is not changed. 'start' and 'size' must be multiples
+	  * of CacheLine::SIZE. */
+	void fillReadCache(unsigned start, unsigned size, const byte* rData);
+	/** The slot (and thus device) that is visible in the given page has
+	  * changed. The cache lines of the old slot are kept, so that when
+	  * switching back to that slot they can be reused instead of being
+	  * looked up again.
+	  * @result true iff the cache lines of the new slot were reused. */
+	bool switchVisibleSlot(unsigned page, unsigned primarySlot,
+	                       unsigned secondarySlot, const MSXDevice& device);
 	bool isM1Cycle(unsigned address) const;
 
 	void disasmCommand(Interpreter& interp,
@@ -115,9 +141,12 @@ public:
 
 private:
 	void execute2(bool fastForward);
+	inline bool executeBlock();
+	const BlockCache::Block& decodeBlock(unsigned address, const byte* line);
 	bool needExitCPULoop();
 	void setSlowInstructions();
 	void doSetFreq();
+	void invalidateSlotCache(unsigned first, unsigned num);
 
 	// Observer<Setting>  !! non-virtual !!
 	void update(const Setting& setting);
@@ -128,14 +157,38 @@ private:
 	bool readCacheTried [CacheLine::NUM];
 	bool writeCacheTried[CacheLine::NUM];
 
+	// Cache lines of the slots that are not visible at the moment, per
+	// page and per slot (see switchVisibleSlot()). An entry stays valid
+	// until the memory cache of (a part of) that page is invalidated.
+	static const unsigned LINES_PER_PAGE = CacheLine::NUM / 4;
+	struct SlotCache {
+		const byte* readCacheLine[LINES_PER_PAGE];
+		byte* writeCacheLine[LINES_PER_PAGE];
+		bool readCacheTried [LINES_PER_PAGE];
+		bool writeCacheTried[LINES_PER_PAGE];
+		const MSXDevice* device; // device these lines belong to
+		bool valid;
+	};
+	SlotCache slotCache[4][4 * 4]; // [page][primary * 4 + secondary]
+	int visibleSlot[4]; // primary * 4 + secondary, -1 when unknown
+	const MSXDevice* visibleDevice[4];
+
+	// pre-decoded instruction blocks, see executeBlock()
+	BlockCache blockCache;
+
 	MSXMotherBoard& motherboard;
 	Scheduler& scheduler;
 	MSXCPUInterface* interface;
+	TraceRecorder* traceRecorder;
+	SamplingProfiler* profiler;
 
 	const BooleanSetting& traceSetting;
 	TclCallback& diHaltCallback;
 
 	Probe<int> IRQStatus;
+	Probe<unsigned> memCacheInvalidations;
+	Probe<unsigned> memCacheFills;
+	Probe<unsigned> memCacheRefills;
 	Probe<void> IRQAccept;
 
 	// dynamic freq
@@ -143,6 +196,8 @@ private:
 	IntegerSetting freqValue;
 	unsigned freq;
 
+	BooleanSetting blockCacheSetting;
+
 	// state machine variables
 	int slowInstructions;
 	int NMIStatus;
@@ -156,35 +211,52 @@ private:
 
 	std::atomic<bool> exitLoop;
 
-	/** In sync with traceSetting.getBoolean(). */
+	/** In sync with traceSetting.getBoolean() || traceRecorder. */
 	bool tracingEnabled;
 
+	/** Execute pre-decoded blocks (when possible) instead of interpreting
+	  * instruction per instruction. Only enabled in the fast path of
+	  * execute2(), so never when there are breakpoints or when tracing. */
+	bool blockTier;
+
 	/** 'normal' Z80 and Z80 in a turboR behave slightly different */
 	const bool isTurboR;
 
 
+	/** Is there a TraceRecorder that should record now? Nothing is
+	  * recorded while fast-forwarding (reverse, replay): then most
+	  * instructions take the fast path, which doesn't record them, so
+	  * their memory accesses would be attached to the wrong instruction.
+	  */
+	inline bool isRecordingTrace() const;
 	inline void cpuTracePre();
+	void cpuTracePre_slow();
 	inline void cpuTracePost();
 	void cpuTracePost_slow();
+	void cpuTraceRegisters();
+	inline void cpuTraceInterruptPre(bool isNMI);
+	inline void cpuTraceInterruptPost();
 
 	inline byte READ_PORT(unsigned port, unsigned cc);
 	inline void WRITE_PORT(unsigned port, byte value, unsigned cc);
 
-	template<bool PRE_PB, bool POST_PB>
+	// OPCODE: the read is an opcode fetch (so it's not recorded by the
+	// TraceRecorder)
+	template<bool PRE_PB, bool POST_PB, bool OPCODE = false>
 	byte RDMEMslow(unsigned address, unsigned cc);
-	template<bool PRE_PB, bool POST_PB>
+	template<bool PRE_PB, bool POST_PB, bool OPCODE = false>
 	inline byte RDMEM_impl2(unsigned address, unsigned cc);
-	template<bool PRE_PB, bool POST_PB>
+	template<bool PRE_PB, bool POST_PB, bool OPCODE = false>
 	inline byte RDMEM_impl (unsigned address, unsigned cc);
 	template<unsigned PC_OFFSET>
 	inline byte RDMEM_OPCODE(unsigned cc);
 	inline byte RDMEM(unsigned address, unsigned cc);
 
-	template<bool PRE_PB, bool POST_PB>
+	template<bool PRE_PB, bool POST_PB, bool OPCODE = false>
 	unsigned RD_WORD_slow(unsigned address, unsigned cc);
-	template<bool PRE_PB, bool POST_PB>
+	template<bool PRE_PB, bool POST_PB, bool OPCODE = false>
 	inline unsigned RD_WORD_impl2(unsigned address, unsigned cc);
-	template<bool PRE_PB, bool POST_PB>
+	template<bool PRE_PB, bool POST_PB, bool OPCODE = false>
 	inline unsigned RD_WORD_impl (unsigned address, unsigned cc);
 	template<unsigned PC_OFFSET>
 	inline unsigned RD_WORD_PC(unsigned cc);
@@ -0,0 +1,708 @@
+#include "CompiledCondition.hh"
+#include "MSXMotherBoard.hh"
+#include "MSXCPU.hh"
+#include "MSXCPUInterface.hh"
+#include "CPURegs.hh"
+#include "Debugger.hh"
+#include "Debuggable.hh"
+#include "unreachable.hh"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using std::string;
+using std::vector;
+
+namespace openmsx {
+
+using Op = CompiledCondition::Op;
+using Instr = CompiledCondition::Instr;
+using Code = vector<Instr>;
+
+// Tcl integers have arbitrary precision. We use 64-bit integers and refuse
+// (fall back to Tcl) when intermediate values grow beyond this limit. This
+// limit is chosen so that the sum of two such values, or the product of
+// two values below 2^31, can't overflow.
+static const int64_t LIMIT = int64_t(1) << 61;
+
+static inline bool inRange(int64_t v)
+{
+	return (-LIMIT <= v) && (v <= LIMIT);
+}
+
+// Same names (and indices) as in the 'reg' proc (see _cpuregs.tcl).
+struct RegInfo { const char* name; int index; };
+static const RegInfo regB[] = {
+	{ "A",    0 }, { "F",    1 }, { "B",    2 }, { "C",    3 },
+	{ "D",    4 }, { "E",    5 }, { "H",    6 }, { "L",    7 },
+	{ "A2",   8 }, { "F2",   9 }, { "B2",  10 }, { "C2",  11 },
+	{ "D2",  12 }, { "E2",  13 }, { "H2",  14 }, { "L2",  15 },
+	{ "IXH", 16 }, { "IXL", 17 }, { "IYH", 18 }, { "IYL", 19 },
+	{ "PCH", 20 }, { "PCL", 21 }, { "SPH", 22 }, { "SPL", 23 },
+	{ "I",   24 }, { "R",   25 }, { "IM",  26 }, { "IFF", 27 },
+};
+static const RegInfo regW[] = {
+	{ "AF",   0 }, { "BC",   2 }, { "DE",   4 }, { "HL",   6 },
+	{ "AF2",  8 }, { "BC2", 10 }, { "DE2", 12 }, { "HL2", 14 },
+	{ "IX",  16 }, { "IY",  18 }, { "PC",  20 }, { "SP",  22 },
+};
+
+// Same as MSXCPU::Debuggable::read(), so the same as the 'reg' proc.
+static unsigned readReg8(const CPURegs& regs, int index)
+{
+	switch (index) {
+	case  0: return regs.getA();
+	case  1: return regs.getF();
+	case  2: return regs.getB();
+	case  3: return regs.getC();
+	case  4: return regs.getD();
+	case  5: return regs.getE();
+	case  6: return regs.getH();
+	case  7: return regs.getL();
+	case  8: return regs.getA2();
+	case  9: return regs.getF2();
+	case 10: return regs.getB2();
+	case 11: return regs.getC2();
+	case 12: return regs.getD2();
+	case 13: return regs.getE2();
+	case 14: return regs.getH2();
+	case 15: return regs.getL2();
+	case 16: return regs.getIXh();
+	case 17: return regs.getIXl();
+	case 18: return regs.getIYh();
+	case 19: return regs.getIYl();
+	case 20: return regs.getPCh();
+	case 21: return regs.getPCl();
+	case 22: return regs.getSPh();
+	case 23: return regs.getSPl();
+	case 24: return regs.getI();
+	case 25: return regs.getR();
+	case 26: return regs.getIM();
+	case 27: return 1 *  regs.getIFF1() +
+	                2 *  regs.getIFF2() +
+	                4 * (regs.getIFF1() && !regs.prevWasEI());
+	default: UNREACHABLE; return 0;
+	}
+}
+
+static unsigned readReg16(const CPURegs& regs, int index)
+{
+	switch (index) {
+	case  0: return regs.getAF();
+	case  2: return regs.getBC();
+	case  4: return regs.getDE();
+	case  6: return regs.getHL();
+	case  8: return regs.getAF2();
+	case 10: return regs.getBC2();
+	case 12: return regs.getDE2();
+	case 14: return regs.getHL2();
+	case 16: return regs.getIX();
+	case 18: return regs.getIY();
+	case 20: return regs.getPC();
+	case 22: return regs.getSP();
+	default: UNREACHABLE; return 0;
+	}
+}
+
+namespace {
+
+class MotherBoardContext final : public CompiledCondition::Context
+{
+public:
+	explicit MotherBoardContext(MSXMotherBoard& motherBoard_)
+		: motherBoard(motherBoard_) {}
+
+	const CPURegs& getRegisters() override
+	{
+		return motherBoard.getCPU().getRegisters();
+	}
+
+	bool peek(const string& name, int64_t address, int64_t& value) override
+	{
+		if (name.empty()) {
+			if ((address < 0) || (address > 0xFFFF)) return false;
+			value = motherBoard.getCPUInterface().peekMem(
+				word(address), motherBoard.getCurrentTime());
+		} else {
+			auto* debuggable =
+				motherBoard.getDebugger().findDebuggable(name);
+			if (!debuggable || (address < 0) ||
+			    (address >= int64_t(debuggable->getSize()))) {
+				return false;
+			}
+			value = debuggable->read(unsigned(address));
+		}
+		return true;
+	}
+
+private:
+	MSXMotherBoard& motherBoard;
+};
+
+} // namespace
+
+static unsigned digitValue(char c)
+{
+	if (('0' <= c) && (c <= '9')) return c - '0';
+	c = tolower(c);
+	if (('a' <= c) && (c <= 'z')) return c - 'a' + 10;
+	return 99;
+}
+
+// Parse an (unsigned) Tcl integer literal. Literals that Tcl would interpret
+// differently from what's supported here (e.g. octal '010' or floating point
+// numbers) are rejected.
+static bool parseNumber(const char*& p, const char* end, int64_t& value)
+{
+	if ((p == end) || !isdigit(static_cast<unsigned char>(*p))) return false;
+	unsigned base = 10;
+	if ((*p == '0') && ((p + 1) != end) &&
+	    isalnum(static_cast<unsigned char>(p[1]))) {
+		switch (tolower(p[1])) {
+			case 'x': base = 16; break;
+			case 'o': base =  8; break;
+			case 'b': base =  2; break;
+			default: return false;
+		}
+		p += 2;
+		if ((p == end) || (digitValue(*p) >= base)) return false;
+	}
+	int64_t v = 0;
+	while ((p != end) && isalnum(static_cast<unsigned char>(*p))) {
+		unsigned d = digitValue(*p);
+		if (d >= base) return false;
+		v = v * base + d;
+		if (v > LIMIT) return false;
+		++p;
+	}
+	if ((p != end) && (*p == '.')) return false;
+	value = v;
+	return true;
+}
+
+namespace {
+
+class Parser
+{
+public:
+	Parser(const char* begin, const char* end_, Code& code_)
+		: p(begin), end(end_), code(code_) {}
+
+	bool parseAll()
+	{
+		if (!parseTernary()) return false;
+		skipSpace();
+		return p == end;
+	}
+
+private:
+	struct Word {
+		bool isText;
+		string text; // if isText
+		Code code;   // otherwise (command substitution)
+	};
+
+	void skipSpace()
+	{
+		while ((p != end) && isspace(static_cast<unsigned char>(*p))) ++p;
+	}
+	void skipBlanks()
+	{
+		while ((p != end) && ((*p == ' ') || (*p == '\t'))) ++p;
+	}
+	bool atWordEnd() const
+	{
+		return (p == end) || (*p == ' ') || (*p == '\t') || (*p == ']');
+	}
+	char next() const
+	{
+		return ((p + 1) < end) ? p[1] : '\0';
+	}
+	void emit(Op op, int64_t value = 0, string debuggable = {})
+	{
+		code.push_back(Instr{op, value, std::move(debuggable)});
+	}
+
+	bool parseTernary();
+	bool parseBinary(unsigned level);
+	bool matchOperator(unsigned level, Op& op, unsigned& len) const;
+	bool parseUnary();
+	bool parsePrimary();
+	bool parseCommand();
+	bool parseWord(Word& word);
+	bool compileCommand(vector<Word>& words);
+	bool compileAddress(Word& word);
+
+	const char* p;
+	const char* end;
+	Code& code;
+};
+
+static const unsigned NUM_LEVELS = 10;
+
+bool Parser::parseTernary()
+{
+	if (!parseBinary(0)) return false;
+	skipSpace();
+	if ((p != end) && (*p == '?')) {
+		++p;
+		if (!parseTernary()) return false;
+		skipSpace();
+		if ((p == end) || (*p != ':')) return false;
+		++p;
+		if (!parseTernary()) return false;
+		emit(CompiledCondition::SELECT);
+	}
+	return true;
+}
+
+bool Parser::parseBinary(unsigned level)
+{
+	if (level == NUM_LEVELS) return parseUnary();
+	if (!parseBinary(level + 1)) return false;
+	while (true) {
+		skipSpace();
+		Op op;
+		unsigned len;
+		if (!matchOperator(level, op, len)) return true;
+		p += len;
+		if (!parseBinary(level + 1)) return false;
+		emit(op);
+	}
+}
+
+// Operators ordered from low to high precedence, like in Tcl.
+bool Parser::matchOperator(unsigned level, Op& op, unsigned& len) const
+{
+	if (p == end) return false;
+	char c0 = *p;
+	char c1 = next();
+	len = 1;
+	switch (level) {
+	case 0:
+		if ((c0 == '|') && (c1 == '|')) { op = CompiledCondition::OR; len = 2; return true; }
+		break;
+	case 1:
+		if ((c0 == '&') && (c1 == '&')) { op = CompiledCondition::AND; len = 2; return true; }
+		break;
+	case 2:
+		if ((c0 == '|') && (c1 != '|')) { op = CompiledCondition::BIT_OR; return true; }
+		break;
+	case 3:
+		if (c0 == '^') { op = CompiledCondition::BIT_XOR; return true; }
+		break;
+	case 4:
+		if ((c0 == '&') && (c1 != '&')) { op = CompiledCondition::BIT_AND; return true; }
+		break;
+	case 5:
+		if (c1 != '=') break;
+		len = 2;
+		if (c0 == '=') { op = CompiledCondition::EQ; return true; }
+		if (c0 == '!') { op = CompiledCondition::NE; return true; }
+		break;
+	case 6:
+		if ((c0 != '<') && (c0 != '>')) break;
+		if (c1 == '=') {
+			op = (c0 == '<') ? CompiledCondition::LE : CompiledCondition::GE;
+			len = 2;
+			return true;
+		}
+		if (c1 != c0) {
+			op = (c0 == '<') ? CompiledCondition::LT : CompiledCondition::GT;
+			return true;
+		}
+		break;
+	case 7:
+		if (((c0 == '<') || (c0 == '>')) && (c1 == c0)) {
+			op = (c0 == '<') ? CompiledCondition::SHL : CompiledCondition::SHR;
+			len = 2;
+			return true;
+		}
+		break;
+	case 8:
+		if (c0 == '+') { op = CompiledCondition::ADD; return true; }
+		if (c0 == '-') { op = CompiledCondition::SUB; return true; }
+		break;
+	case 9:
+		// note: '**' (exponentiation) is not supported
+		if ((c0 == '*') && (c1 != '*')) { op = CompiledCondition::MUL; return true; }
+		if (c0 == '/') { op = CompiledCondition::DIV; return true; }
+		if (c0 == '%') { op = CompiledCondition::MOD; return true; }
+		break;
+	default:
+		UNREACHABLE;
+	}
+	return false;
+}
+
+bool Parser::parseUnary()
+{
+	skipSpace();
+	if (p == end) return false;
+	switch (*p) {
+	case '-':
+		++p;
+		if (!parseUnary()) return false;
+		emit(CompiledCondition::NEG);
+		return true;
+	case '+':
+		++p;
+		return parseUnary();
+	case '~':
+		++p;
+		if (!parseUnary()) return false;
+		emit(CompiledCondition::BIT_NOT);
+		return true;
+	case '!':
+		++p;
+		if (!parseUnary()) return false;
+		emit(CompiledCondition::NOT);
+		return true;
+	default:
+		return parsePrimary();
+	}
+}
+
+bool Parser::parsePrimary()
+{
+	skipSpace();
+	if (p == end) return false;
+	if (*p == '(') {
+		++p;
+		if (!parseTernary()) return false;
+		skipSpace();
+		if ((p == end) || (*p != ')')) return false;
+		++p;
+		return true;
+	}
+	if (*p == '[') {
+		return parseCommand();
+	}
+	int64_t value;
+	if (!parseNumber(p, end, value)) return false;
+	emit(CompiledCondition::PUSH, value);
+	return true;
+}
+
+bool Parser::parseCommand()
+{
+	assert(*p == '[');
+	++p;
+	vector<Word> words;
+	while (true) {
+		skipBlanks();
+		if (p == end) return false;
+		if (*p == ']') {
+			++p;
+			break;
+		}
+		Word word;
+		if (!parseWord(word)) return false;
+		words.push_back(std::move(word));
+	}
+	return compileCommand(words);
+}
+
+bool Parser::parseWord(Word& word)
+{
+	if (*p == '[') {
+		word.isText = false;
+		Parser sub(p, end, word.code);
+		if (!sub.parseCommand()) return false;
+		p = sub.p;
+		return atWordEnd();
+	}
+	word.isText = true;
+	if (*p == '{') {
+		const char* begin = ++p;
+		int depth = 1;
+		for (/**/; p != end; ++p) {
+			if (*p == '\\') return false;
+			if (*p == '{') ++depth;
+			if ((*p == '}') && (--depth == 0)) break;
+		}
+		if (p == end) return false;
+		word.text.assign(begin, p);
+		++p;
+		return atWordEnd();
+	}
+	if (*p == '"') {
+		const char* begin = ++p;
+		for (/**/; (p != end) && (*p != '"'); ++p) {
+			if (strchr("$[\\", *p)) return false;
+		}
+		if (p == end) return false;
+		word.text.assign(begin, p);
+		++p;
+		return atWordEnd();
+	}
+	const char* begin = p;
+	for (/**/; !atWordEnd(); ++p) {
+		if (strchr("$[{}\"\\;\n", *p)) return false;
+	}
+	word.text.assign(begin, p);
+	return true;
+}
+
+bool Parser::compileAddress(Word& word)
+{
+	if (!word.isText) {
+		code.insert(code.end(), word.code.begin(), word.code.end());
+		return true;
+	}
+	const char* q = word.text.data();
+	const char* e = q + word.text.size();
+	int64_t value;
+	if (!parseNumber(q, e, value) || (q != e)) return false;
+	emit(CompiledCondition::PUSH, value);
+	return true;
+}
+
+struct PeekInfo { const char* name; Op op; bool isSigned; };
+static const PeekInfo peekProcs[] = {
+	{ "peek",        CompiledCondition::PEEK,      false },
+	{ "peek8",       CompiledCondition::PEEK,      false },
+	{ "peek_u8",     CompiledCondition::PEEK,      false },
+	{ "peek_s8",     CompiledCondition::PEEK,      true  },
+	{ "peek16",      CompiledCondition::PEEK16,    false },
+	{ "peek16_LE",   CompiledCondition::PEEK16,    false },
+	{ "peek_u16",    CompiledCondition::PEEK16,    false },
+	{ "peek_u16LE",  CompiledCondition::PEEK16,    false },
+	{ "peek_s16",    CompiledCondition::PEEK16,    true  },
+	{ "peek_s16LE",  CompiledCondition::PEEK16,    true  },
+	{ "peek16_BE",   CompiledCondition::PEEK16_BE, false },
+	{ "peek_u16BE",  CompiledCondition::PEEK16_BE, false },
+	{ "peek_s16BE",  CompiledCondition::PEEK16_BE, true  },
+};
+
+bool Parser::compileCommand(vector<Word>& words)
+{
+	if (words.empty() || !words[0].isText) return false;
+	const string& command = words[0].text;
+
+	if (command == "reg") {
+		if ((words.size() != 2) || !words[1].isText) return false;
+		string name = words[1].text;
+		std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+		for (auto& r : regB) {
+			if (name == r.name) {
+				emit(CompiledCondition::REG8, r.index);
+				return true;
+			}
+		}
+		for (auto& r : regW) {
+			if (name == r.name) {
+				emit(CompiledCondition::REG16, r.index);
+				return true;
+			}
+		}
+		return false;
+
+	} else if (command == "expr") {
+		if ((words.size() != 2) || !words[1].isText) return false;
+		const string& text = words[1].text;
+		Parser sub(text.data(), text.data() + text.size(), code);
+		return sub.parseAll();
+
+	} else if (command == "debug") {
+		if ((words.size() != 4) ||
+		    !words[1].isText || (words[1].text != "read") ||
+		    !words[2].isText) {
+			return false;
+		}
+		string name = words[2].text;
+		if (name == "memory") name.clear();
+		if (!compileAddress(words[3])) return false;
+		emit(CompiledCondition::PEEK, 0, std::move(name));
+		return true;
+	}
+
+	for (auto& info : peekProcs) {
+		if (command != info.name) continue;
+		if ((words.size() < 2) || (words.size() > 3)) return false;
+		string name;
+		if (words.size() == 3) {
+			if (!words[2].isText) return false;
+			name = words[2].text;
+			if (name == "memory") name.clear();
+		}
+		if (!compileAddress(words[1])) return false;
+		emit(info.op, 0, std::move(name));
+		if (info.isSigned) {
+			emit((info.op == CompiledCondition::PEEK)
+			     ? CompiledCondition::SIGN8 : CompiledCondition::SIGN16);
+		}
+		return true;
+	}
+	return false;
+}
+
+} // namespace
+
+
+std::unique_ptr<CompiledCondition> CompiledCondition::compile(string_ref expression)
+{
+	Code code;
+	Parser parser(expression.data(), expression.data() + expression.size(),
+	              code);
+	if (!parser.parseAll()) return nullptr;
+
+	// check stack depth
+	int depth = 0;
+	int maxDepth = 0;
+	for (auto& i : code) {
+		switch (i.op) {
+		case PUSH: case REG8: case REG16:
+			++depth;
+			break;
+		case PEEK: case PEEK16: case PEEK16_BE: case SIGN8: case SIGN16:
+		case NEG: case NOT: case BIT_NOT:
+			break;
+		case SELECT:
+			depth -= 2;
+			break;
+		default:
+			--depth;
+			break;
+		}
+		maxDepth = std::max(maxDepth, depth);
+	}
+	assert(depth == 1);
+	if (maxDepth > int(MAX_STACK)) return nullptr;
+
+	return std::unique_ptr<CompiledCondition>(
+		new CompiledCondition(std::move(code)));
+}
+
+CompiledCondition::CompiledCondition(vector<Instr> code_)
+	: code(std::move(code_))
+{
+}
+
+bool CompiledCondition::evaluate(MSXMotherBoard& motherBoard, bool& result) const
+{
+	MotherBoardContext context(motherBoard);
+	return evaluate(context, result);
+}
+
+bool CompiledCondition::evaluate(Context& context, bool& result) const
+{
+	int64_t stack[MAX_STACK];
+	int64_t* sp = stack; // points past top-of-stack
+	const CPURegs& regs = context.getRegisters();
+
+	for (auto& i : code) {
+		switch (i.op) {
+		case PUSH:
+			*sp++ = i.value;
+			break;
+		case REG8:
+			*sp++ = readReg8(regs, int(i.value));
+			break;
+		case REG16:
+			*sp++ = readReg16(regs, int(i.value));
+			break;
+		case PEEK:
+			if (!context.peek(i.debuggable, sp[-1], sp[-1])) {
+				return false;
+			}
+			break;
+		case PEEK16:
+		case PEEK16_BE: {
+			int64_t addr = sp[-1];
+			int64_t lo, hi;
+			if (!context.peek(i.debuggable, addr + 0, lo) ||
+			    !context.peek(i.debuggable, addr + 1, hi)) {
+				return false;
+			}
+			if (i.op == PEEK16_BE) std::swap(lo, hi);
+			sp[-1] = lo + 256 * hi;
+			break;
+		}
+		case SIGN8:
+			if (sp[-1] >= 128) sp[-1] -= 256;
+			break;
+		case SIGN16:
+			if (sp[-1] >= 32768) sp[-1] -= 65536;
+			break;
+		case NEG:
+			sp[-1] = -sp[-1];
+			break;
+		case NOT:
+			sp[-1] = !sp[-1];
+			break;
+		case BIT_NOT:
+			sp[-1] = ~sp[-1];
+			break;
+		case SELECT: {
+			int64_t b = *--sp;
+			int64_t a = *--sp;
+			sp[-1] = sp[-1] ? a : b;
+			break;
+		}
+		default: {
+			int64_t b = *--sp;
+			int64_t& a = sp[-1];
+			switch (i.op) {
+			case MUL:
+				if ((std::abs(a) >= (int64_t(1) << 31)) ||
+				    (std::abs(b) >= (int64_t(1) << 31))) {
+					return false;
+				}
+				a *= b;
+				break;
+			case DIV: {
+				if (b == 0) return false;
+				// Tcl rounds towards negative infinity
+				int64_t q = a / b;
+				if (((a % b) != 0) && ((a < 0) != (b < 0))) --q;
+				a = q;
+				break;
+			}
+			case MOD: {
+				if (b == 0) return false;
+				// Tcl: the result has the same sign as the divisor
+				int64_t r = a % b;
+				if ((r != 0) && ((r < 0) != (b < 0))) r += b;
+				a = r;
+				break;
+			}
+			case ADD: a += b; break;
+			case SUB: a -= b; break;
+			case SHL:
+				if ((b < 0) || (b >= 32) ||
+				    (std::abs(a) >= (int64_t(1) << 31))) {
+					return false;
+				}
+				a *= int64_t(1) << b;
+				break;
+			case SHR:
+				if (b < 0) return false;
+				a = (b >= 63) ? ((a < 0) ? -1 : 0) : (a >> b);
+				break;
+			case LT: a = a <  b; break;
+			case GT: a = a >  b; break;
+			case LE: a = a <= b; break;
+			case GE: a = a >= b; break;
+			case EQ: a = a == b; break;
+			case NE: a = a != b; break;
+			case BIT_AND: a &= b; break;
+			case BIT_XOR: a ^= b; break;
+			case BIT_OR:  a |= b; break;
+			case AND: a = a && b; break;
+			case OR:  a = a || b; break;
+			default: UNREACHABLE;
+			}
+			if (!inRange(a)) return false;
+			break;
+		}
+		}
+	}
+	assert(sp == (stack + 1));
+	result = stack[0] != 0;
+	return true;
+}
+
+} // namespace openmsx
@@ -0,0 +1,94 @@
+#ifndef COMPILEDCONDITION_HH
+#define COMPILEDCONDITION_HH
+
+#include "string_ref.hh"
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace openmsx {
+
+class MSXMotherBoard;
+class CPURegs;
+
+/** Native (non-Tcl) evaluation of break/watchpoint and debug conditions.
+ *
+ * Conditions are Tcl expressions that get evaluated very often (e.g. a
+ * debug condition after every instruction). Evaluating them via the Tcl
+ * interpreter is slow. This class recognizes the common subset of these
+ * expressions:
+ *   - integer literals (decimal, 0x, 0o, 0b)
+ *   - the operators  ?: || && | ^ & == != < > <= >= << >> + - * / % ! ~
+ *   - [reg <name>]
+ *   - [peek <addr> [<debuggable>]] and the peek8/peek16/peek_s8/... variants
+ *   - [debug read <debuggable> <addr>]
+ *   - [expr {...}]
+ * where the address can itself be such a (nested) command. Such an
+ * expression is compiled once into a small postfix program that's evaluated
+ * directly on the CPU registers and the debuggables. Anything else (Tcl
+ * variables, other procs, string or floating point operations, ...) is not
+ * compiled, such conditions keep being evaluated by Tcl.
+ */
+class CompiledCondition
+{
+public:
+	/** The machine state an expression is evaluated on. */
+	class Context
+	{
+	public:
+		virtual const CPURegs& getRegisters() = 0;
+		/** Like 'debug read <debuggable> <address>', an empty name
+		  * means 'memory'.
+		  * @result false if there's no such debuggable or the address
+		  *         is out of range. */
+		virtual bool peek(const std::string& debuggable,
+		                  int64_t address, int64_t& value) = 0;
+	protected:
+		~Context() {}
+	};
+
+	/** Compile the given expression.
+	  * @result The compiled expression or nullptr when the expression is
+	  *         not (completely) in the supported subset.
+	  */
+	static std::unique_ptr<CompiledCondition> compile(string_ref expression);
+
+	/** Evaluate the expression in the context of the given machine.
+	  * @param motherBoard The machine whose registers/memory are used.
+	  * @param result Output parameter, the (boolean) result.
+	  * @result Whether the evaluation succeeded. On failure (e.g. division
+	  *         by zero or an address out of range) the caller should fall
+	  *         back to Tcl, which also reports the error.
+	  */
+	bool evaluate(MSXMotherBoard& motherBoard, bool& result) const;
+	/** Same as above, but takes the registers and debuggables from the
+	  * given context (e.g. a fake machine in a unit test). */
+	bool evaluate(Context& context, bool& result) const;
+
+	enum Op {
+		PUSH, REG8, REG16,
+		PEEK, PEEK16, PEEK16_BE, SIGN8, SIGN16,
+		NEG, NOT, BIT_NOT,
+		MUL, DIV, MOD, ADD, SUB, SHL, SHR,
+		LT, GT, LE, GE, EQ, NE,
+		BIT_AND, BIT_XOR, BIT_OR, AND, OR, SELECT
+	};
+	struct Instr {
+		Op op;
+		int64_t value; // PUSH: the value, REGx: register index
+		std::string debuggable; // PEEKx: empty means 'memory'
+	};
+
+	/** Maximum stack depth needed to evaluate a compiled expression. */
+	static const unsigned MAX_STACK = 32;
+
+private:
+	explicit CompiledCondition(std::vector<Instr> code);
+
+	std::vector<Instr> code;
+};
+
+} // namespace openmsx
+
+#endif
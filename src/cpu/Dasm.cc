@@ -15,66 +15,88 @@ static int abs(unsigned char a)
 	return (a & 128) ? (256 - a) : a;
 }
 
-unsigned dasm(const MSXCPUInterface& interf, word pc, byte buf[4],
-              std::string& dest, EmuTime::param time)
+// Returns the mnemonic template for the given opcode. 'i' is set to the
+// number of prefix/opcode bytes, 'r' to the index register (if any).
+static const char* getMnemonic(const byte buf[4], unsigned& i, const char*& r)
 {
-	const char* s;
-	unsigned i = 0;
-	const char* r = nullptr;
-
-	buf[0] = interf.peekMem(pc, time);
+	r = nullptr;
 	switch (buf[0]) {
 		case 0xCB:
-			buf[1] = interf.peekMem(pc + 1, time);
-			s = mnemonic_cb[buf[1]];
 			i = 2;
-			break;
+			return mnemonic_cb[buf[1]];
 		case 0xED:
-			buf[1] = interf.peekMem(pc + 1, time);
-			s = mnemonic_ed[buf[1]];
 			i = 2;
-			break;
+			return mnemonic_ed[buf[1]];
 		case 0xDD:
 		case 0xFD:
 			r = (buf[0] == 0xDD) ? "ix" : "iy";
-			buf[1] = interf.peekMem(pc + 1, time);
 			if (buf[1] != 0xcb) {
-				s = mnemonic_xx[buf[1]];
 				i = 2;
+				return mnemonic_xx[buf[1]];
 			} else {
-				buf[2] = interf.peekMem(pc + 2, time);
-				buf[3] = interf.peekMem(pc + 3, time);
-				s = mnemonic_xx_cb[buf[3]];
 				i = 4;
+				return mnemonic_xx_cb[buf[3]];
 			}
-			break;
 		default:
-			s = mnemonic_main[buf[0]];
 			i = 1;
+			return mnemonic_main[buf[0]];
+	}
+}
+
+unsigned dasm(const MSXCPUInterface& interf, word pc, byte buf[4],
+              std::string& dest, EmuTime::param time)
+{
+	for (unsigned i = 0; i < 4; ++i) {
+		buf[i] = interf.peekMem(pc + i, time);
 	}
+	return dasm(buf, pc, dest);
+}
+
+unsigned instructionLength(const byte buf[4])
+{
+	unsigned i;
+	const char* r;
+	const char* s = getMnemonic(buf, i, r);
+	for (int j = 0; s[j]; ++j) {
+		switch (s[j]) {
+		case 'B': case 'R': case 'X':
+			i += 1;
+			break;
+		case 'W':
+			i += 2;
+			break;
+		case '!': case '#':
+			return 2;
+		case '@':
+			return 1;
+		}
+	}
+	return i;
+}
+
+unsigned dasm(const byte buf[4], word pc, std::string& dest)
+{
+	unsigned i;
+	const char* r;
+	const char* s = getMnemonic(buf, i, r);
 
 	for (int j = 0; s[j]; ++j) {
 		switch (s[j]) {
 		case 'B':
-			buf[i] = interf.peekMem(pc + i, time);
 			dest += '#' + StringOp::toHexString(
 				static_cast<uint16_t>(buf[i]), 2);
 			i += 1;
 			break;
 		case 'R':
-			buf[i] = interf.peekMem(pc + i, time);
 			dest += '#' + StringOp::toHexString(
 				(pc + 2 + static_cast<int8_t>(buf[i])) & 0xFFFF, 4);
 			i += 1;
 			break;
 		case 'W':
-			buf[i + 0] = interf.peekMem(pc + i + 0, time);
-			buf[i + 1] = interf.peekMem(pc + i + 1, time);
 			dest += '#' + StringOp::toHexString(buf[i] + buf[i + 1] * 256, 4);
 			i += 2;
 			break;
 		case 'X':
-			buf[i] = interf.peekMem(pc + i, time);
 			dest += '(' + std::string(r) + sign(buf[i]) + '#'
 			     + StringOp::toHexString(abs(buf[i]), 2) + ')';
 			i += 1;
@@ -12,8 +12,9 @@ class MSXCPUInterface;
 /** Disassemble
   * @param interf The CPU interface, used to peek bytes from memory
   * @param pc The position (program counter) where to start disassembling
-  * @param buf The bytes that form this opcode (max 4). The buffer is only
-  *            filled with the min required bytes (see return value)
+  * @param buf The bytes that form this opcode (max 4). The buffer is always
+  *            filled with 4 bytes, only the first ones are part of the
+  *            opcode (see return value)
   * @param dest String representation of the disassembled opcode
   * @param time TODO
   * @return Length of the disassembled opcode in bytes
@@ -21,6 +22,19 @@ class MSXCPUInterface;
 unsigned dasm(const MSXCPUInterface& interf, word pc, byte buf[4],
               std::string& dest, EmuTime::param time);
 
+/** Disassemble the given opcode bytes, e.g. from a CPU trace.
+  * @param buf The opcode, 4 bytes (more than the opcode length is fine)
+  * @param pc The address of the opcode (needed for relative jumps)
+  * @param dest String representation of the disassembled opcode
+  * @return Length of the disassembled opcode in bytes
+  */
+unsigned dasm(const byte buf[4], word pc, std::string& dest);
+
+/** Length of the instruction formed by the given bytes. Same as the return
+  * value of dasm(), but much faster.
+  */
+unsigned instructionLength(const byte buf[4]);
+
 } // namespace openmsx
 
 #endif
@@ -1,5 +1,6 @@
 #include "MSXCPU.hh"
 #include "MSXMotherBoard.hh"
+#include "MSXCPUInterface.hh"
 #include "Debugger.hh"
 #include "Scheduler.hh"
 #include "IntegerSetting.hh"
@@ -7,6 +8,15 @@
 #include "Z80.hh"
 #include "R800.hh"
 #include "TclObject.hh"
+#include "TraceRecorder.hh"
+#include "SamplingProfiler.hh"
+#include "HostProfiler.hh"
+#include "CommandException.hh"
+#include "Interpreter.hh"
+#include "FileContext.hh"
+#include "FileException.hh"
+#include "FileOperations.hh"
+#include "StringOp.hh"
 #include "memory.hh"
 #include "outer.hh"
 #include "serialize.hh"
@@ -41,6 +51,9 @@ MSXCPU::MSXCPU(MSXMotherBoard& motherboard_)
 			motherboard.getMachineInfoCommand(), "r800_freq", *r800)
 		: nullptr)
 	, debuggable(motherboard_)
+	, traceCmd(motherboard.getCommandController())
+	, profileCmd(motherboard.getCommandController())
+	, interface(nullptr)
 	, reference(EmuTime::zero)
 {
 	z80Active = true; // setActiveCPU(CPU_Z80);
@@ -71,12 +84,53 @@ MSXCPU::~MSXCPU()
 	motherboard.getDebugger() .setCPU(nullptr);
 }
 
-void MSXCPU::setInterface(MSXCPUInterface* interface)
+void MSXCPU::setInterface(MSXCPUInterface* interf)
 {
+	if (!interf) {
+		// the interface is about to be destroyed
+		setTraceRecorder(nullptr);
+		setProfilerActive(false);
+		profiler.reset();
+	}
+	interface = interf;
 	          z80 ->setInterface(interface);
 	if (r800) r800->setInterface(interface);
 }
 
+void MSXCPU::setTraceRecorder(std::unique_ptr<TraceRecorder> recorder)
+{
+	assert(!recorder || interface);
+	TraceRecorder* r = recorder.get();
+	          z80 ->setTraceRecorder(r);
+	if (r800) r800->setTraceRecorder(r);
+	if (interface) interface->setTraceRecording(r != nullptr);
+	// the old recorder (if any) flushes its data to disk when deleted
+	traceRecorder = std::move(recorder);
+	exitCPULoopSync();
+}
+
+void MSXCPU::transferProfiler(MSXCPU& other)
+{
+	assert(!profiler);
+	symbols = std::move(other.symbols);
+	if (!other.profiler) return;
+	assert(interface);
+	profiler = make_unique<SamplingProfiler>(
+		motherboard.getScheduler(), *this, *interface,
+		motherboard.getDebugger(), symbols);
+	profiler->transfer(*other.profiler);
+	setProfilerActive(profiler->isRunning());
+	other.setProfilerActive(false);
+	other.profiler.reset();
+}
+
+void MSXCPU::setProfilerActive(bool active)
+{
+	SamplingProfiler* p = active ? profiler.get() : nullptr;
+	          z80 ->setProfiler(p);
+	if (r800) r800->setProfiler(p);
+}
+
 void MSXCPU::doReset(EmuTime::param time)
 {
 	          z80 ->doReset(time);
@@ -138,10 +192,22 @@ void MSXCPU::setNextSyncPoint(EmuTime::param time)
 	          : r800->setNextSyncPoint(time);
 }
 
-void MSXCPU::updateVisiblePage(byte page, byte primarySlot, byte secondarySlot)
+void MSXCPU::updateVisiblePage(byte page, byte primarySlot, byte secondarySlot,
+                               const MSXDevice& device)
 {
-	invalidateMemCache(page * 0x4000, 0x4000);
-	if (r800) r800->updateVisiblePage(page, primarySlot, secondarySlot);
+	// Both CPUs keep track of the visible slots, otherwise the inactive
+	// one would store its cache lines for the wrong slot.
+	bool reused = z80->switchVisibleSlot(
+		page, primarySlot, secondarySlot, device);
+	if (r800) {
+		bool r800Reused = r800->switchVisibleSlot(
+			page, primarySlot, secondarySlot, device);
+		if (!z80Active) reused = r800Reused;
+		r800->updateVisiblePage(page, primarySlot, secondarySlot);
+	}
+	if (profiler) profiler->slotChanged(page);
+	HostProfiler::count(HostProfiler::SLOT_SWITCH);
+	if (!reused) HostProfiler::count(HostProfiler::SLOT_CACHE_MISS);
 }
 
 void MSXCPU::invalidateMemCache(word start, unsigned size)
@@ -150,6 +216,18 @@ void MSXCPU::invalidateMemCache(word start, unsigned size)
 	          : r800->invalidateMemCache(start, size);
 }
 
+void MSXCPU::invalidateReadCache(word start, unsigned size)
+{
+	z80Active ? z80 ->invalidateReadCache(start, size)
+	          : r800->invalidateReadCache(start, size);
+}
+
+void MSXCPU::fillReadCache(word start, unsigned size, const byte* rData)
+{
+	z80Active ? z80 ->fillReadCache(start, size, rData)
+	          : r800->fillReadCache(start, size, rData);
+}
+
 void MSXCPU::raiseIRQ()
 {
 	          z80 ->raiseIRQ();
@@ -182,6 +260,12 @@ void MSXCPU::setZ80Freq(unsigned freq)
 	z80->setFreq(freq);
 }
 
+unsigned MSXCPU::getFreq() const
+{
+	return z80Active ? z80 ->getFreq()
+	                 : r800->getFreq();
+}
+
 void MSXCPU::wait(EmuTime::param time)
 {
 	z80Active ? z80 ->wait(time)
@@ -390,6 +474,268 @@ void MSXCPU::Debuggable::write(unsigned address, byte value)
 	}
 }
 
+
+// class TraceCmd
+
+MSXCPU::TraceCmd::TraceCmd(CommandController& commandController_)
+	: Command(commandController_, "cpu_trace")
+{
+}
+
+void MSXCPU::TraceCmd::execute(array_ref<TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() < 2) {
+		throw CommandException("Missing subcommand");
+	}
+	auto& cpu = OUTER(MSXCPU, traceCmd);
+	string_ref subcommand = tokens[1].getString();
+	if (subcommand == "start") {
+		if (tokens.size() != 3) throw SyntaxError();
+		if (!cpu.interface) {
+			throw CommandException("No CPU interface present");
+		}
+		string filename = FileOperations::expandTilde(
+			tokens[2].getString());
+		try {
+			cpu.setTraceRecorder(make_unique<TraceRecorder>(filename));
+		} catch (FileException& e) {
+			throw CommandException("Couldn't start CPU trace: " +
+			                       e.getMessage());
+		}
+		result.setString("Recording CPU trace to " + filename);
+	} else if (subcommand == "stop") {
+		if (tokens.size() != 2) throw SyntaxError();
+		if (!cpu.traceRecorder) {
+			throw CommandException("Not recording a CPU trace");
+		}
+		string filename = cpu.traceRecorder->getFilename();
+		string error = cpu.traceRecorder->getError();
+		cpu.setTraceRecorder(nullptr);
+		if (!error.empty()) {
+			throw CommandException("Error while writing " + filename +
+			                       ": " + error);
+		}
+		result.setString("CPU trace written to " + filename);
+	} else if (subcommand == "status") {
+		if (tokens.size() != 2) throw SyntaxError();
+		auto* recorder = cpu.traceRecorder.get();
+		result.addListElement("recording");
+		result.addListElement(recorder != nullptr);
+		if (recorder) {
+			result.addListElement("file");
+			result.addListElement(recorder->getFilename());
+			result.addListElement("instructions");
+			result.addListElement(double(recorder->getNumInstructions()));
+			result.addListElement("bytes");
+			result.addListElement(double(recorder->getBytesWritten()));
+			string error = recorder->getError();
+			if (!error.empty()) {
+				result.addListElement("error");
+				result.addListElement(error);
+			}
+		}
+	} else if (subcommand == "decode") {
+		if (tokens.size() != 4) throw SyntaxError();
+		try {
+			TraceRecorder::decode(
+				FileOperations::expandTilde(tokens[2].getString()),
+				FileOperations::expandTilde(tokens[3].getString()));
+		} catch (MSXException& e) {
+			throw CommandException(e.getMessage());
+		}
+	} else {
+		throw CommandException("Invalid subcommand: " + subcommand);
+	}
+}
+
+string MSXCPU::TraceCmd::help(const vector<string>& /*tokens*/) const
+{
+	return "Records a trace of all executed CPU instructions in a compact "
+	       "binary file.\n"
+	       "cpu_trace start <file>           start recording\n"
+	       "cpu_trace stop                   stop recording\n"
+	       "cpu_trace status                 show recording status\n"
+	       "cpu_trace decode <trace> <text>  convert a recorded trace to a "
+	       "readable (disassembled) text file\n"
+	       "For each instruction the trace contains the time, the address, "
+	       "the opcode, the memory accesses (except opcode fetches) and the "
+	       "changed registers. Accepted interrupts (NMI, IRQ) are recorded "
+	       "as separate entries, with their own memory accesses and "
+	       "register changes. Nothing is recorded while fast-forwarding "
+	       "(e.g. during a reverse jump). While recording the CPU runs "
+	       "noticeably slower.\n";
+}
+
+void MSXCPU::TraceCmd::tabCompletion(vector<string>& tokens) const
+{
+	if (tokens.size() == 2) {
+		static const char* const subCommands[] = {
+			"start", "stop", "status", "decode",
+		};
+		completeString(tokens, subCommands);
+	} else if ((tokens[1] == "start") || (tokens[1] == "decode")) {
+		completeFileName(tokens, userFileContext());
+	}
+}
+
+// class ProfileCmd
+
+MSXCPU::ProfileCmd::ProfileCmd(CommandController& commandController_)
+	: Command(commandController_, "cpu_profile")
+{
+}
+
+void MSXCPU::ProfileCmd::execute(array_ref<TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() < 2) {
+		throw CommandException("Missing subcommand");
+	}
+	auto& cpu = OUTER(MSXCPU, profileCmd);
+	auto& interp = getInterpreter();
+	string_ref subcommand = tokens[1].getString();
+	if (subcommand == "start") {
+		if (tokens.size() > 3) throw SyntaxError();
+		int interval = (tokens.size() == 3) ? tokens[2].getInt(interp)
+		                                    : 1000;
+		if (interval <= 0) {
+			throw CommandException("Interval must be positive");
+		}
+		if (!cpu.interface) {
+			throw CommandException("No CPU interface present");
+		}
+		if (!cpu.profiler) {
+			cpu.profiler = make_unique<SamplingProfiler>(
+				cpu.motherboard.getScheduler(), cpu,
+				*cpu.interface, cpu.motherboard.getDebugger(),
+				cpu.symbols);
+		}
+		cpu.profiler->start(interval);
+		cpu.setProfilerActive(true);
+	} else if (subcommand == "stop") {
+		if (tokens.size() != 2) throw SyntaxError();
+		if (cpu.profiler) cpu.profiler->stop();
+		cpu.setProfilerActive(false);
+	} else if (subcommand == "clear") {
+		if (tokens.size() != 2) throw SyntaxError();
+		if (cpu.profiler) cpu.profiler->clear();
+	} else if (subcommand == "status") {
+		if (tokens.size() != 2) throw SyntaxError();
+		auto* profiler = cpu.profiler.get();
+		result.addListElement("running");
+		result.addListElement(profiler && profiler->isRunning());
+		result.addListElement("interval");
+		result.addListElement(int(profiler ? profiler->getInterval() : 0));
+		result.addListElement("samples");
+		result.addListElement(double(profiler ? profiler->getNumSamples() : 0));
+		result.addListElement("symbols");
+		result.addListElement(double(cpu.symbols.size()));
+	} else if (subcommand == "report") {
+		if (tokens.size() > 3) throw SyntaxError();
+		int count = (tokens.size() == 3) ? tokens[2].getInt(interp) : 20;
+		if (cpu.profiler && (count > 0)) {
+			cpu.profiler->report(result, count);
+		}
+	} else if (subcommand == "save_folded") {
+		if (tokens.size() != 3) throw SyntaxError();
+		if (!cpu.profiler) {
+			throw CommandException("No profile data");
+		}
+		try {
+			cpu.profiler->saveFolded(
+				FileOperations::expandTilde(tokens[2].getString()));
+		} catch (MSXException& e) {
+			throw CommandException(e.getMessage());
+		}
+	} else if (subcommand == "load_symbols") {
+		if (tokens.size() < 3) throw SyntaxError();
+		int ps = -1;
+		int ss = -1;
+		int segment = -1;
+		for (size_t i = 3; i < tokens.size(); i += 2) {
+			if (i + 1 == tokens.size()) {
+				throw CommandException("Missing argument for " +
+				                       tokens[i].getString());
+			}
+			string_ref option = tokens[i].getString();
+			if (option == "-slot") {
+				const auto& slot = tokens[i + 1];
+				unsigned len = slot.getListLength(interp);
+				if ((len != 1) && (len != 2)) {
+					throw CommandException("Invalid slot: " +
+					                       slot.getString());
+				}
+				ps = slot.getListIndex(interp, 0).getInt(interp);
+				ss = (len == 2)
+				   ? slot.getListIndex(interp, 1).getInt(interp)
+				   : -1;
+				if ((ps < 0) || (ps > 3) || (ss < -1) || (ss > 3)) {
+					throw CommandException("Invalid slot: " +
+					                       slot.getString());
+				}
+			} else if (option == "-segment") {
+				segment = tokens[i + 1].getInt(interp);
+				if ((segment < 0) || (segment > 255)) {
+					throw CommandException("Invalid segment: " +
+					                       tokens[i + 1].getString());
+				}
+			} else {
+				throw CommandException("Invalid option: " + option);
+			}
+		}
+		try {
+			unsigned num = cpu.symbols.load(
+				FileOperations::expandTilde(tokens[2].getString()),
+				ps, ss, segment);
+			result.setInt(num);
+		} catch (MSXException& e) {
+			throw CommandException(e.getMessage());
+		}
+	} else if (subcommand == "clear_symbols") {
+		if (tokens.size() != 2) throw SyntaxError();
+		cpu.symbols.clear();
+	} else {
+		throw CommandException("Invalid subcommand: " + subcommand);
+	}
+}
+
+string MSXCPU::ProfileCmd::help(const vector<string>& /*tokens*/) const
+{
+	return "Sampling profiler for the emulated MSX code.\n"
+	       "cpu_profile start [<interval>]  start taking a sample every "
+	       "<interval> CPU cycles (default 1000)\n"
+	       "cpu_profile stop                stop sampling, the samples are "
+	       "kept\n"
+	       "cpu_profile clear               remove all samples\n"
+	       "cpu_profile status              show profiler status\n"
+	       "cpu_profile report [<count>]    list the <count> (default 20) "
+	       "most sampled addresses as {location symbol samples}\n"
+	       "cpu_profile save_folded <file>  save the samples with their call "
+	       "stacks as 'folded stacks' (input for flame graph tools)\n"
+	       "cpu_profile load_symbols <file> [-slot <slot>] [-segment <n>]\n"
+	       "                                load symbols from an assembler "
+	       "symbol file, optionally only valid for the given slot and/or "
+	       "mapper segment (or ROM block)\n"
+	       "cpu_profile clear_symbols       remove all symbols\n"
+	       "A location is written as <slot>[-<subslot>][/<segment>]:<address>.\n";
+}
+
+void MSXCPU::ProfileCmd::tabCompletion(vector<string>& tokens) const
+{
+	if (tokens.size() == 2) {
+		static const char* const subCommands[] = {
+			"start", "stop", "clear", "status", "report",
+			"save_folded", "load_symbols", "clear_symbols",
+		};
+		completeString(tokens, subCommands);
+	} else if (tokens[1] == "load_symbols") {
+		static const char* const options[] = { "-slot", "-segment" };
+		completeFileName(tokens, userFileContext(), options);
+	} else if (tokens[1] == "save_folded") {
+		completeFileName(tokens, userFileContext());
+	}
+}
+
+
 // version 1: initial version
 // version 2: activeCPU,newCPU -> z80Active,newZ80Active
 template<typename Archive>
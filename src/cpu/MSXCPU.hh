@@ -2,6 +2,8 @@
 #define MSXCPU_HH
 
 #include "InfoTopic.hh"
+#include "Command.hh"
+#include "SymbolTable.hh"
 #include "SimpleDebuggable.hh"
 #include "Observer.hh"
 #include "BooleanSetting.hh"
@@ -16,6 +18,9 @@ namespace openmsx {
 
 class MSXMotherBoard;
 class MSXCPUInterface;
+class MSXDevice;
+class TraceRecorder;
+class SamplingProfiler;
 class CPUClock;
 class CPURegs;
 class Z80TYPE;
@@ -44,15 +49,27 @@ public:
 	/** Sets DRAM or ROM mode (influences memory access speed for R800). */
 	void setDRAMmode(bool dram);
 
-	/** Inform CPU of bank switch. This will invalidate memory cache and
-	  * update memory timings on R800. */
-	void updateVisiblePage(byte page, byte primarySlot, byte secondarySlot);
+	/** Inform CPU of bank switch. This will switch the memory cache to
+	  * the new slot and update memory timings on R800. */
+	void updateVisiblePage(byte page, byte primarySlot, byte secondarySlot,
+	                       const MSXDevice& device);
 
 	/** Invalidate the CPU its cache for the interval [start, start + size)
 	  * For example MSXMemoryMapper and MSXGameCartrigde need to call this
 	  * method when a 'memory switch' occurs. */
 	void invalidateMemCache(word start, unsigned size);
 
+	/** Like invalidateMemCache(), but only the read cache is invalidated.
+	  * For when only the readable content of that interval changed. */
+	void invalidateReadCache(word start, unsigned size);
+
+	/** Directly fill the read cache for the interval [start, start + size)
+	  * instead of invalidating it, 'rData' points to the data at address
+	  * 'start' (or is nullptr for uncacheable memory). The caller must
+	  * make sure the memory is readable like that, usually this is done
+	  * via MSXCPUInterface::fillReadCache(). */
+	void fillReadCache(word start, unsigned size, const byte* rData);
+
 	/** This method raises a maskable interrupt. A device may call this
 	  * method more than once. If the device wants to lower the
 	  * interrupt again it must call the lowerIRQ() method exactly as
@@ -97,8 +114,17 @@ public:
 	/** Switch the Z80 clock freq. */
 	void setZ80Freq(unsigned freq);
 
+	/** The clock frequency of the active CPU. */
+	unsigned getFreq() const;
+
 	void setInterface(MSXCPUInterface* interf);
 
+	/** Move the cpu_profile state (symbols, samples and a running
+	  * profiler) of the CPU of another motherboard to this CPU. Used
+	  * when switching to a new board after a reverse jump, similar to
+	  * Debugger::transfer(). */
+	void transferProfiler(MSXCPU& other);
+
 	void disasmCommand(Interpreter& interp,
 	                   array_ref<TclObject> tokens,
                            TclObject& result) const;
@@ -133,6 +159,12 @@ private:
 	// Observer<Setting>
 	void update(const Setting& setting) override;
 
+	/** Start (non-null) or stop (nullptr) recording an execution trace,
+	  * see TraceRecorder. */
+	void setTraceRecorder(std::unique_ptr<TraceRecorder> recorder);
+	/** Start or stop reporting calls and returns to the profiler. */
+	void setProfilerActive(bool active);
+
 	MSXMotherBoard& motherboard;
 	BooleanSetting traceSetting;
 	TclCallback diHaltCallback;
@@ -165,6 +197,27 @@ private:
 		void write(unsigned address, byte value) override;
 	} debuggable;
 
+	struct TraceCmd final : Command {
+		explicit TraceCmd(CommandController& commandController);
+		void execute(array_ref<TclObject> tokens,
+		             TclObject& result) override;
+		std::string help(const std::vector<std::string>& tokens) const override;
+		void tabCompletion(std::vector<std::string>& tokens) const override;
+	} traceCmd;
+
+	struct ProfileCmd final : Command {
+		explicit ProfileCmd(CommandController& commandController);
+		void execute(array_ref<TclObject> tokens,
+		             TclObject& result) override;
+		std::string help(const std::vector<std::string>& tokens) const override;
+		void tabCompletion(std::vector<std::string>& tokens) const override;
+	} profileCmd;
+
+	MSXCPUInterface* interface; // can be nullptr
+	std::unique_ptr<TraceRecorder> traceRecorder; // can be nullptr
+	SymbolTable symbols;
+	std::unique_ptr<SamplingProfiler> profiler; // can be nullptr
+
 	EmuTime reference;
 	bool z80Active;
 	bool newZ80Active;
@@ -44,6 +44,7 @@ bool MSXCPUInterface::breaked = false;
 bool MSXCPUInterface::continued = false;
 bool MSXCPUInterface::step = false;
 MSXCPUInterface::BreakPoints MSXCPUInterface::breakPoints;
+std::bitset<0x10000> MSXCPUInterface::breakPointAddresses;
 //TODO watchpoints
 MSXCPUInterface::Conditions  MSXCPUInterface::conditions;
 
@@ -55,6 +56,7 @@ static unsigned breakedSettingCount = 0;
 static const byte SECONDARY_SLOT_BIT = 0x01;
 static const byte MEMORY_WATCH_BIT   = 0x02;
 static const byte GLOBAL_RW_BIT      = 0x04;
+static const byte TRACE_BIT          = 0x08;
 
 
 MSXCPUInterface::MSXCPUInterface(MSXMotherBoard& motherBoard_)
@@ -472,6 +474,8 @@ void MSXCPUInterface::registerSlot(
 			assert(false);
 		}
 	}
+	// the CPU may have cached lines of this slot, even when not visible
+	msxcpu.invalidateMemCache(page * 0x4000, 0x4000);
 	updateVisible(page);
 }
 
@@ -492,6 +496,7 @@ void MSXCPUInterface::unregisterSlot(
 		assert(slot == &device);
 		slot = dummyDevice.get();
 	}
+	msxcpu.invalidateMemCache(page * 0x4000, 0x4000);
 	updateVisible(page);
 }
 
@@ -585,12 +590,25 @@ void MSXCPUInterface::unregisterGlobalRead(MSXDevice& device, word address)
 	msxcpu.invalidateMemCache(address & CacheLine::HIGH, 0x100);
 }
 
+void MSXCPUInterface::fillReadCache(const MSXDevice& device, word start,
+                                    unsigned size, const byte* rData)
+{
+	for (unsigned addr = start; addr < (start + size); addr += CacheLine::SIZE) {
+		if ((visibleDevices[addr >> 14] != &device) ||
+		    disallowReadCache[addr >> CacheLine::BITS]) {
+			msxcpu.invalidateReadCache(start, size);
+			return;
+		}
+	}
+	msxcpu.fillReadCache(start, size, rData);
+}
+
 ALWAYS_INLINE void MSXCPUInterface::updateVisible(int page, int ps, int ss)
 {
 	MSXDevice* newDevice = slotLayout[ps][ss][page];
 	if (visibleDevices[page] != newDevice) {
 		visibleDevices[page] = newDevice;
-		msxcpu.updateVisiblePage(page, ps, ss);
+		msxcpu.updateVisiblePage(page, ps, ss, *newDevice);
 	}
 }
 void MSXCPUInterface::updateVisible(int page)
@@ -738,14 +756,28 @@ void MSXCPUInterface::insertBreakPoint(const BreakPoint& bp)
 	auto it = upper_bound(begin(breakPoints), end(breakPoints),
 	                      bp, CompareBreakpoints());
 	breakPoints.insert(it, bp);
+	breakPointAddresses[bp.getAddress()] = true;
 }
 
 void MSXCPUInterface::removeBreakPoint(const BreakPoint& bp)
 {
+	word address = bp.getAddress(); // bp is dead after erase()
 	auto range = equal_range(begin(breakPoints), end(breakPoints),
-	                         bp.getAddress(), CompareBreakpoints());
+	                         address, CompareBreakpoints());
 	breakPoints.erase(find_if_unguarded(range.first, range.second,
 		[&](const BreakPoint& i) { return &i == &bp; }));
+	breakPointAddresses[address] =
+		binary_search(begin(breakPoints), end(breakPoints),
+		              address, CompareBreakpoints());
+}
+
+bool MSXCPUInterface::isSlotSelected(unsigned address, int ps, int ss) const
+{
+	if (ps == -1) return true;
+	int page = address >> 14;
+	if (primarySlotState[page] != ps) return false;
+	if (ss == -1) return true;
+	return isExpanded(ps) && (secondarySlotState[page] == ss);
 }
 
 void MSXCPUInterface::checkBreakPoints(
@@ -759,12 +791,16 @@ void MSXCPUInterface::checkBreakPoints(
 	BreakPoints bpCopy(range.first, range.second);
 	auto& globalCliComm = motherBoard.getReactor().getGlobalCliComm();
 	auto& interp        = motherBoard.getReactor().getInterpreter();
+	auto& cpuInterface  = motherBoard.getCPUInterface();
 	for (auto& p : bpCopy) {
-		p.checkAndExecute(globalCliComm, interp);
+		if (!cpuInterface.isSlotSelected(p.getAddress(),
+		                                 p.getPrimarySlot(),
+		                                 p.getSecondarySlot())) continue;
+		p.checkAndExecute(globalCliComm, interp, motherBoard);
 	}
 	auto condCopy = conditions;
 	for (auto& c : condCopy) {
-		c.checkAndExecute(globalCliComm, interp);
+		c.checkAndExecute(globalCliComm, interp, motherBoard);
 	}
 }
 
@@ -865,20 +901,44 @@ void MSXCPUInterface::unregisterIOWatch(WatchPoint& watchPoint, MSXDevice** devi
 
 void MSXCPUInterface::updateMemWatch(WatchPoint::Type type)
 {
+	int idx = (type == WatchPoint::READ_MEM) ? 0 : 1;
+	auto& ranges = memWatches[idx];
+	auto& maxEnd = memWatchMaxEnd[idx];
+	ranges.clear();
+	for (auto& w : watchPoints) {
+		if (w->getType() == type) ranges.push_back(w);
+	}
+	std::stable_sort(begin(ranges), end(ranges),
+		[](const shared_ptr<WatchPoint>& x, const shared_ptr<WatchPoint>& y) {
+			return x->getBeginAddress() < y->getBeginAddress(); });
+	maxEnd.clear();
+	unsigned m = 0;
+	for (auto& w : ranges) {
+		m = std::max(m, w->getEndAddress());
+		maxEnd.push_back(m);
+	}
+
 	std::bitset<CacheLine::SIZE>* watchSet =
 		(type == WatchPoint::READ_MEM) ? readWatchSet : writeWatchSet;
 	for (unsigned i = 0; i < CacheLine::NUM; ++i) {
 		watchSet[i].reset();
 	}
-	for (auto& w : watchPoints) {
-		if (w->getType() == type) {
-			unsigned beginAddr = w->getBeginAddress();
-			unsigned endAddr   = w->getEndAddress();
-			assert(beginAddr <= endAddr);
-			assert(endAddr < 0x10000);
-			for (unsigned addr = beginAddr; addr <= endAddr; ++addr) {
-				watchSet[addr >> CacheLine::BITS].set(
-				         addr  & CacheLine::LOW);
+	for (auto& w : ranges) {
+		unsigned beginAddr = w->getBeginAddress();
+		unsigned endAddr   = w->getEndAddress();
+		assert(beginAddr <= endAddr);
+		assert(endAddr < 0x10000);
+		unsigned addr = beginAddr;
+		while (addr <= endAddr) {
+			unsigned line = addr >> CacheLine::BITS;
+			unsigned low  = addr  & CacheLine::LOW;
+			if ((low == 0) && ((endAddr - addr) >= CacheLine::LOW)) {
+				// whole cache line is watched
+				watchSet[line].set();
+				addr += CacheLine::SIZE;
+			} else {
+				watchSet[line].set(low);
+				++addr;
 			}
 		}
 	}
@@ -897,6 +957,22 @@ void MSXCPUInterface::updateMemWatch(WatchPoint::Type type)
 	msxcpu.invalidateMemCache(0x0000, 0x10000);
 }
 
+void MSXCPUInterface::setTraceRecording(bool recording)
+{
+	// Memory accesses can only be observed when they don't go via the
+	// CPU cache.
+	for (unsigned i = 0; i < CacheLine::NUM; ++i) {
+		if (recording) {
+			disallowReadCache [i] |=  TRACE_BIT;
+			disallowWriteCache[i] |=  TRACE_BIT;
+		} else {
+			disallowReadCache [i] &= ~TRACE_BIT;
+			disallowWriteCache[i] &= ~TRACE_BIT;
+		}
+	}
+	msxcpu.invalidateMemCache(0x0000, 0x10000);
+}
+
 void MSXCPUInterface::executeMemWatch(WatchPoint::Type type,
                                       unsigned address, unsigned value)
 {
@@ -912,14 +988,33 @@ void MSXCPUInterface::executeMemWatch(WatchPoint::Type type,
 		                   TclObject(int(value)));
 	}
 
-	auto wpCopy = watchPoints;
-	for (auto& w : wpCopy) {
-		if ((w->getBeginAddress() <= address) &&
-		    (w->getEndAddress()   >= address) &&
-		    (w->getType()         == type)) {
-			w->checkAndExecute(globalCliComm, interp);
+	// Collect the matching watchpoints: only the ones that start at or
+	// before 'address' can match, and we can stop searching (backwards)
+	// as soon as none of the remaining ones reaches up to 'address'.
+	// This also makes a copy, for the case that a watchpoint removes
+	// itself.
+	int idx = (type == WatchPoint::READ_MEM) ? 0 : 1;
+	auto& ranges = memWatches[idx];
+	auto& maxEnd = memWatchMaxEnd[idx];
+	auto n = std::upper_bound(begin(ranges), end(ranges), address,
+		[](unsigned a, const shared_ptr<WatchPoint>& w) {
+			return a < w->getBeginAddress(); }) - begin(ranges);
+	WatchPoints wpCopy;
+	while ((n > 0) && (maxEnd[n - 1] >= address)) {
+		auto& w = ranges[--n];
+		if ((w->getEndAddress() >= address) &&
+		    isSlotSelected(address, w->getPrimarySlot(),
+		                   w->getSecondarySlot())) {
+			wpCopy.push_back(w);
 		}
 	}
+	// execute in creation order
+	std::sort(begin(wpCopy), end(wpCopy),
+		[](const shared_ptr<WatchPoint>& x, const shared_ptr<WatchPoint>& y) {
+			return x->getId() < y->getId(); });
+	for (auto& w : wpCopy) {
+		w->checkAndExecute(globalCliComm, interp, motherBoard);
+	}
 
 	interp.unsetVariable("wp_last_address");
 	interp.unsetVariable("wp_last_value");
@@ -976,10 +1071,34 @@ void MSXCPUInterface::cleanup()
 	// TODO it would be nicer if breakpoints and conditions were not
 	//      global objects.
 	breakPoints.clear();
+	breakPointAddresses.reset();
 	conditions.clear();
 }
 
 
+// Helper for the memory debuggables: copies whole cache lines when the
+// device allows it, other bytes are peeked one by one.
+template<typename GetLine, typename Peek>
+static void readCached(unsigned start, byte* output, unsigned num,
+                       GetLine getLine, Peek peek)
+{
+	while (num) {
+		unsigned offset = start & CacheLine::LOW;
+		unsigned n = std::min(num, CacheLine::SIZE - offset);
+		if (const byte* line = getLine(start - offset)) {
+			memcpy(output, line + offset, n);
+		} else {
+			for (unsigned i = 0; i < n; ++i) {
+				output[i] = peek(start + i);
+			}
+		}
+		start += n;
+		output += n;
+		num -= n;
+	}
+}
+
+
 // class MemoryDebug
 
 MSXCPUInterface::MemoryDebug::MemoryDebug(MSXMotherBoard& motherBoard_)
@@ -1001,6 +1120,18 @@ void MSXCPUInterface::MemoryDebug::write(unsigned address, byte value,
 	return interface.writeMem(address, value, time);
 }
 
+void MSXCPUInterface::MemoryDebug::readBlock(
+	unsigned start, byte* output, unsigned num)
+{
+	auto& interface = OUTER(MSXCPUInterface, memoryDebug);
+	EmuTime time = getMotherBoard().getCurrentTime();
+	readCached(start, output, num,
+		[&](unsigned address) {
+			return interface.getReadCacheLine(address); },
+		[&](unsigned address) {
+			return interface.peekMem(address, time); });
+}
+
 
 // class SlottedMemoryDebug
 
@@ -1024,6 +1155,27 @@ void MSXCPUInterface::SlottedMemoryDebug::write(unsigned address, byte value,
 	return interface.writeSlottedMem(address, value, time);
 }
 
+void MSXCPUInterface::SlottedMemoryDebug::readBlock(
+	unsigned start, byte* output, unsigned num)
+{
+	auto& interface = OUTER(MSXCPUInterface, slottedMemoryDebug);
+	EmuTime time = getMotherBoard().getCurrentTime();
+	readCached(start, output, num,
+		[&](unsigned address) -> const byte* {
+			int ps = (address >> 18) & 3;
+			int ss = (address >> 16) & 3;
+			word offset = address & 0xFFFF;
+			if (!interface.isExpanded(ps)) {
+				ss = 0;
+			} else if (offset == (0xFFFF & CacheLine::HIGH)) {
+				return nullptr; // contains the subslot register
+			}
+			return interface.slotLayout[ps][ss][offset >> 14]
+				->getReadCacheLine(offset); },
+		[&](unsigned address) {
+			return interface.peekSlottedMem(address, time); });
+}
+
 
 // class SlotInfo
 
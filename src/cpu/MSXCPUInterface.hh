@@ -183,6 +183,16 @@ public:
 		return visibleDevices[start >> 14]->getWriteCacheLine(start);
 	}
 
+	/**
+	 * Used by a device that switched the memory in the interval
+	 * [start, start + size) to the data at 'rData'. When the device is
+	 * visible in that interval (and the interval is cacheable for
+	 * reading) the CPU read cache is filled directly, otherwise it's
+	 * invalidated. The write cache is not affected.
+	 */
+	void fillReadCache(const MSXDevice& device, word start, unsigned size,
+	                   const byte* rData);
+
 	/**
 	 * CPU uses this method to read 'extra' data from the databus
 	 * used in interrupt routines. In MSX this returns always 255.
@@ -213,6 +223,18 @@ public:
 
 	DummyDevice& getDummyDevice() { return *dummyDevice; }
 
+	/** The primary slot, the secondary slot (-1 when the primary slot is
+	  * not expanded) and the device that are selected in the given page.
+	  */
+	int getPrimarySlot(int page) const { return primarySlotState[page]; }
+	int getSecondarySlot(int page) const {
+		int ps = primarySlotState[page];
+		return isExpanded(ps) ? secondarySlotState[page] : -1;
+	}
+	MSXDevice* getVisibleMSXDevice(int page) const {
+		return visibleDevices[page];
+	}
+
 	static void insertBreakPoint(const BreakPoint& bp);
 	static void removeBreakPoint(const BreakPoint& bp);
 	using BreakPoints = std::vector<BreakPoint>;
@@ -247,11 +269,13 @@ public:
 	}
 	static bool checkBreakPoints(unsigned pc, MSXMotherBoard& motherBoard)
 	{
-		auto range = equal_range(begin(breakPoints), end(breakPoints),
-		                         pc, CompareBreakpoints());
-		if (conditions.empty() && (range.first == range.second)) {
+		// Most instructions are not on a breakpoint, a single bit test
+		// is much cheaper than a binary search in 'breakPoints'.
+		if (conditions.empty() && !breakPointAddresses[pc]) {
 			return false;
 		}
+		auto range = equal_range(begin(breakPoints), end(breakPoints),
+		                         pc, CompareBreakpoints());
 
 		// slow path non-inlined
 		checkBreakPoints(range, motherBoard);
@@ -261,6 +285,11 @@ public:
 	// cleanup global variables
 	static void cleanup();
 
+	/** While a TraceRecorder is active, the CPU memory cache is disabled,
+	  * so that the CPU can report all memory accesses.
+	  */
+	void setTraceRecording(bool recording);
+
 	// In fast-forward mode, breakpoints, watchpoints and conditions should
 	// not trigger.
 	void setFastForward(bool fastForward_) { fastForward = fastForward_; }
@@ -289,6 +318,7 @@ private:
 	static void checkBreakPoints(std::pair<BreakPoints::const_iterator,
 	                                       BreakPoints::const_iterator> range,
 	                             MSXMotherBoard& motherBoard);
+	bool isSlotSelected(unsigned address, int ps, int ss) const;
 
 	void removeAllWatchPoints();
 	void registerIOWatch  (WatchPoint& watchPoint, MSXDevice** devices);
@@ -303,12 +333,14 @@ private:
 		explicit MemoryDebug(MSXMotherBoard& motherBoard);
 		byte read(unsigned address, EmuTime::param time) override;
 		void write(unsigned address, byte value, EmuTime::param time) override;
+		void readBlock(unsigned start, byte* output, unsigned num) override;
 	} memoryDebug;
 
 	struct SlottedMemoryDebug final : SimpleDebuggable {
 		explicit SlottedMemoryDebug(MSXMotherBoard& motherBoard);
 		byte read(unsigned address, EmuTime::param time) override;
 		void write(unsigned address, byte value, EmuTime::param time) override;
+		void readBlock(unsigned start, byte* output, unsigned num) override;
 	} slottedMemoryDebug;
 
 	struct IODebug final : SimpleDebuggable {
@@ -379,6 +411,14 @@ private:
 	std::bitset<CacheLine::SIZE> readWatchSet [CacheLine::NUM];
 	std::bitset<CacheLine::SIZE> writeWatchSet[CacheLine::NUM];
 
+	// The read_mem (index 0) and write_mem (index 1) watchpoints, sorted
+	// on begin address. memWatchMaxEnd[x][i] is the maximum end address
+	// of the first i+1 watchpoints. Together this forms a (flattened)
+	// interval tree: the watchpoints that contain a given address are
+	// found without scanning all watchpoints.
+	WatchPoints memWatches[2];
+	std::vector<unsigned> memWatchMaxEnd[2];
+
 	struct GlobalRwInfo {
 		MSXDevice* device;
 		word addr;
@@ -404,6 +444,7 @@ private:
 
 	//  All CPUs (Z80 and R800) of all MSX machines share this state.
 	static BreakPoints breakPoints; // sorted on address
+	static std::bitset<0x10000> breakPointAddresses; // addr has >= 1 bp
 	WatchPoints watchPoints; // ordered in creation order,  TODO must also be static
 	static Conditions conditions; // ordered in creation order
 	static bool breaked;
@@ -42,7 +42,7 @@ void WatchIO::doReadCallback(unsigned port)
 	// keep this object alive by holding a shared_ptr to it, for the case
 	// this watchpoint deletes itself in checkAndExecute()
 	auto keepAlive = shared_from_this();
-	checkAndExecute(cliComm, interp);
+	checkAndExecute(cliComm, interp, motherboard);
 
 	interp.unsetVariable("wp_last_address");
 }
@@ -59,7 +59,7 @@ void WatchIO::doWriteCallback(unsigned port, unsigned value)
 
 	// see comment in doReadCallback() above
 	auto keepAlive = shared_from_this();
-	checkAndExecute(cliComm, interp);
+	checkAndExecute(cliComm, interp, motherboard);
 
 	interp.unsetVariable("wp_last_address");
 	interp.unsetVariable("wp_last_value");
@@ -125,6 +125,17 @@ protected:
 		}
 	}
 
+	/** Extra cycles for an opcode or operand fetch that directly follows
+	  * another fetch from the same page (so PRE_MEM() doesn't see a
+	  * page-break). This allows to precompute the cost of instructions
+	  * with operands, see CPUCore::decodeBlock().
+	  */
+	ALWAYS_INLINE unsigned samePageFetchCost(unsigned address) const
+	{
+		unsigned extra = extraMemoryDelay[address >> 14];
+		return extra ? (extra + 1) : 0;
+	}
+
 	ALWAYS_INLINE void R800Refresh(CPURegs& R)
 	{
 		// atoc documentation says refresh every 222 clocks
@@ -0,0 +1,231 @@
+#include "SamplingProfiler.hh"
+#include "MSXCPU.hh"
+#include "MSXCPUInterface.hh"
+#include "MSXDevice.hh"
+#include "MSXMapperIO.hh"
+#include "CPURegs.hh"
+#include "Debugger.hh"
+#include "Debuggable.hh"
+#include "SymbolTable.hh"
+#include "TclObject.hh"
+#include "FileOperations.hh"
+#include "MSXException.hh"
+#include "StringOp.hh"
+#include <algorithm>
+#include <fstream>
+#include <cassert>
+
+using std::string;
+using std::vector;
+
+namespace openmsx {
+
+// Layout of a Location:
+//   bit  0-15: address
+//   bit 16-17: primary slot
+//   bit 18-20: secondary slot + 1    (0 -> not expanded)
+//   bit 21-29: segment + 1           (0 -> no mapper / unknown)
+static int getAddress  (uint32_t loc) { return loc & 0xFFFF; }
+static int getPrimary  (uint32_t loc) { return (loc >> 16) & 3; }
+static int getSecondary(uint32_t loc) { return int((loc >> 18) & 7) - 1; }
+static int getSegment  (uint32_t loc) { return int((loc >> 21) & 0x1FF) - 1; }
+
+SamplingProfiler::SamplingProfiler(
+		Scheduler& scheduler_, MSXCPU& cpu_, MSXCPUInterface& interface_,
+		Debugger& debugger_, const SymbolTable& symbols_)
+	: Schedulable(scheduler_)
+	, cpu(cpu_)
+	, interface(interface_)
+	, debugger(debugger_)
+	, symbols(symbols_)
+	, numSamples(0)
+	, interval(0)
+	, running(false)
+{
+	for (auto& c : pageCache) c.valid = false;
+}
+
+SamplingProfiler::~SamplingProfiler()
+{
+	stop();
+}
+
+void SamplingProfiler::start(unsigned interval_)
+{
+	assert(interval_ != 0);
+	interval = interval_;
+	if (!running) {
+		running = true;
+		callStack.clear();
+		scheduleNext(getCurrentTime());
+	}
+}
+
+void SamplingProfiler::stop()
+{
+	if (running) {
+		running = false;
+		removeSyncPoint();
+	}
+}
+
+void SamplingProfiler::clear()
+{
+	flatSamples.clear();
+	stackSamples.clear();
+	numSamples = 0;
+}
+
+SamplingProfiler::PageCache& SamplingProfiler::getPageCache(int page)
+{
+	auto& cache = pageCache[page];
+	if (!cache.valid) {
+		MSXDevice* device = interface.getVisibleMSXDevice(page);
+		cache.mapper = dynamic_cast<MSXMemoryMapperInterface*>(device);
+		cache.blocks = cache.mapper ? nullptr
+		             : debugger.findDebuggable(device->getName() + " romblocks");
+		cache.valid = true;
+	}
+	return cache;
+}
+
+void SamplingProfiler::transfer(SamplingProfiler& other)
+{
+	// A Location only contains the address, slot and segment, so the
+	// samples are still valid for the (same) machine on the new board.
+	flatSamples  = std::move(other.flatSamples);
+	stackSamples = std::move(other.stackSamples);
+	numSamples = other.numSamples;
+	interval = other.interval;
+	if (other.running) {
+		other.stop();
+		start(interval);
+	}
+	other.clear();
+}
+
+SamplingProfiler::Location SamplingProfiler::getLocation(word address)
+{
+	int page = address >> 14;
+	int ps = interface.getPrimarySlot(page);
+	int ss = interface.getSecondarySlot(page);
+	int segment = -1;
+	auto& cache = getPageCache(page);
+	if (cache.mapper) {
+		segment = cache.mapper->getSelectedSegment(page);
+	} else if (cache.blocks) {
+		byte block = cache.blocks->read(address);
+		if (block != 255) segment = block;
+	}
+	return address | (ps << 16) | ((ss + 1) << 18) | ((segment + 1) << 21);
+}
+
+// E.g. '3-1/5:4000' for address 0x4000 in slot 3-1, segment 5.
+static string formatRaw(uint32_t loc)
+{
+	string result = StringOp::toString(getPrimary(loc));
+	int ss = getSecondary(loc);
+	if (ss != -1) result += '-' + StringOp::toString(ss);
+	int segment = getSegment(loc);
+	if (segment != -1) result += '/' + StringOp::toString(segment);
+	return result + ':' + StringOp::toHexString(getAddress(loc), 4);
+}
+
+string SamplingProfiler::symbolize(Location loc, bool withOffset) const
+{
+	return symbols.symbolize(getAddress(loc), getPrimary(loc),
+	                         getSecondary(loc), getSegment(loc), withOffset);
+}
+
+void SamplingProfiler::call(word sp, word target)
+{
+	// Frames at or above the new SP were left without a RET.
+	while (!callStack.empty() && (callStack.back().sp <= sp)) {
+		callStack.pop_back();
+	}
+	if (callStack.size() == MAX_DEPTH) {
+		callStack.erase(callStack.begin());
+	}
+	callStack.push_back({sp, getLocation(target)});
+}
+
+void SamplingProfiler::ret(word sp)
+{
+	while (!callStack.empty() && (callStack.back().sp < sp)) {
+		callStack.pop_back();
+	}
+}
+
+void SamplingProfiler::executeUntil(EmuTime::param time)
+{
+	CPURegs& regs = cpu.getRegisters();
+	ret(regs.getSP()); // drop frames that are no longer on the stack
+	Location pc = getLocation(regs.getPC());
+
+	++numSamples;
+	++flatSamples[pc];
+	vector<Location> stack;
+	stack.reserve(callStack.size() + 1);
+	for (auto& f : callStack) stack.push_back(f.target);
+	stack.push_back(pc);
+	++stackSamples[stack];
+
+	scheduleNext(time);
+}
+
+void SamplingProfiler::scheduleNext(EmuTime::param time)
+{
+	// The frequency of the active CPU can change at any time, so the
+	// interval is recalculated for each sample.
+	setSyncPoint(time + EmuDuration(double(interval) / cpu.getFreq()));
+}
+
+void SamplingProfiler::report(TclObject& result, unsigned count) const
+{
+	vector<std::pair<Location, uint64_t>> sorted(
+		flatSamples.begin(), flatSamples.end());
+	std::sort(sorted.begin(), sorted.end(),
+		[](const std::pair<Location, uint64_t>& x,
+		   const std::pair<Location, uint64_t>& y) {
+			return (x.second != y.second) ? (x.second > y.second)
+			                              : (x.first  < y.first); });
+	if (sorted.size() > count) sorted.resize(count);
+
+	for (auto& p : sorted) {
+		TclObject line;
+		line.addListElement(formatRaw(p.first));
+		line.addListElement(symbolize(p.first, true));
+		line.addListElement(double(p.second));
+		result.addListElement(line);
+	}
+}
+
+void SamplingProfiler::saveFolded(string_ref filename) const
+{
+	// Multiple stacks can map to the same text (e.g. different addresses
+	// within the same symbol), merge those.
+	std::map<string, uint64_t> folded;
+	for (auto& p : stackSamples) {
+		string line;
+		for (auto& loc : p.first) {
+			if (!line.empty()) line += ';';
+			string sym = symbolize(loc, false);
+			line += sym.empty() ? formatRaw(loc) : sym;
+		}
+		folded[line] += p.second;
+	}
+
+	std::ofstream out;
+	FileOperations::openofstream(out, filename.str());
+	if (!out.is_open()) {
+		throw MSXException("Couldn't open " + filename + " for writing");
+	}
+	for (auto& p : folded) {
+		out << p.first << ' ' << p.second << '\n';
+	}
+	if (!out.good()) {
+		throw MSXException("Error while writing " + filename);
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,123 @@
+#ifndef SAMPLINGPROFILER_HH
+#define SAMPLINGPROFILER_HH
+
+#include "Schedulable.hh"
+#include "openmsx.hh"
+#include "string_ref.hh"
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace openmsx {
+
+class MSXCPU;
+class MSXCPUInterface;
+class Debugger;
+class SymbolTable;
+class MSXMemoryMapperInterface;
+class Debuggable;
+class TclObject;
+
+/** Statistical profiler for the emulated MSX code.
+  *
+  * Every 'interval' CPU cycles the current PC is sampled, together with
+  * the slot and mapper segment (or ROM block) that is selected at that
+  * address. So the same address in different slots/segments is counted
+  * separately.
+  *
+  * The CPU reports executed CALL, RST, RET instructions and interrupts. With
+  * those a shadow call stack is maintained, so that each sample can be
+  * attributed to a full call stack. Code that manipulates the stack
+  * directly (e.g. POP followed by JP) is handled by dropping the frames that
+  * are no longer on the stack (according to the SP register).
+  *
+  * Results can be listed per address (symbolized via a SymbolTable) or
+  * exported as 'folded stacks', the input format for flame graph tools.
+  */
+class SamplingProfiler final : public Schedulable
+{
+public:
+	SamplingProfiler(Scheduler& scheduler, MSXCPU& cpu,
+	                 MSXCPUInterface& interface, Debugger& debugger,
+	                 const SymbolTable& symbols);
+	~SamplingProfiler();
+
+	/** Start sampling (again), take a sample every 'interval' cycles of
+	  * the active CPU. Collected samples are kept. */
+	void start(unsigned interval);
+	void stop();
+	/** Remove all collected samples. */
+	void clear();
+
+	bool isRunning() const { return running; }
+	unsigned getInterval() const { return interval; }
+	uint64_t getNumSamples() const { return numSamples; }
+
+	// called by CPUCore, only while running
+	/** A call (or interrupt) to 'target', 'sp' is the value of SP after
+	  * the return address was pushed. */
+	void call(word sp, word target);
+	/** A return, 'sp' is the value of SP after the return address was
+	  * popped. */
+	void ret(word sp);
+
+	/** The visible device in the given page changed. */
+	void slotChanged(int page) { pageCache[page].valid = false; }
+
+	/** The 'count' most sampled addresses, hottest first. Each element
+	  * is a list {location symbol samples}.*/
+	void report(TclObject& result, unsigned count) const;
+
+	/** Write all samples as folded stacks ('frame;frame;frame count').
+	  * @throws MSXException */
+	void saveFolded(string_ref filename) const;
+
+	/** Take over the samples and interval of the profiler of another
+	  * board, and keep on running if it was running. That profiler is
+	  * stopped and cleared. */
+	void transfer(SamplingProfiler& other);
+
+private:
+	// An address together with the slot and segment that were selected
+	// at that address.
+	using Location = uint32_t;
+	Location getLocation(word address);
+	std::string symbolize(Location loc, bool withOffset) const;
+
+	void executeUntil(EmuTime::param time) override;
+	void scheduleNext(EmuTime::param time);
+
+	struct Frame {
+		word sp;
+		Location target;
+	};
+	static const size_t MAX_DEPTH = 256;
+
+	// Per page, how to find the selected segment of the visible device.
+	// Looked up on the first sample after a slot change.
+	struct PageCache {
+		MSXMemoryMapperInterface* mapper;
+		Debuggable* blocks; // 'romblocks' debuggable
+		bool valid;
+	};
+	PageCache& getPageCache(int page);
+
+	MSXCPU& cpu;
+	MSXCPUInterface& interface;
+	Debugger& debugger;
+	const SymbolTable& symbols;
+
+	PageCache pageCache[4];
+	std::vector<Frame> callStack; // innermost call at the back
+	std::unordered_map<Location, uint64_t> flatSamples;
+	std::map<std::vector<Location>, uint64_t> stackSamples;
+	uint64_t numSamples;
+	unsigned interval;
+	bool running;
+};
+
+} // namespace openmsx
+
+#endif
@@ -0,0 +1,346 @@
+#include "TraceRecorder.hh"
+#include "Dasm.hh"
+#include "FileOperations.hh"
+#include "FileException.hh"
+#include "MSXException.hh"
+#include "StringOp.hh"
+#include "likely.hh"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+using std::string;
+
+namespace openmsx {
+
+// File format: the magic header followed by a sequence of records. Each
+// record starts with a tag byte:
+//   INSTR | flags  varint(time delta)  [pc (2 bytes)]  opcode bytes
+//                  (flags: bit 0-2 = opcode length, bit 3 = pc present)
+//   INTERRUPT | type  varint(time delta)
+//                  (type: 0 = NMI, 1-3 = IRQ in IM 0-2)
+//   MEM_READ       address (2 bytes)  value
+//   MEM_WRITE      address (2 bytes)  value
+//   REGS           varint(mask of changed registers)  2 bytes per register
+// All multi-byte values are little endian. The time delta is in EmuTime
+// units, relative to the previous instruction or interrupt (relative to zero
+// for the first one). The memory and register records belong to the
+// preceding instruction or interrupt.
+static const char MAGIC[8] = { 'O','M','T','R','A','C','E','2' };
+static const byte TAG_INSTR     = 0x10;
+static const byte TAG_PC        = 0x08;
+static const byte TAG_MEM_READ  = 0x20;
+static const byte TAG_MEM_WRITE = 0x21;
+static const byte TAG_REGS      = 0x30;
+static const byte TAG_INTERRUPT = 0x40;
+
+static const char* const regNames[TraceRecorder::NUM_REGS] = {
+	"AF", "BC", "DE", "HL", "AF'", "BC'", "DE'", "HL'",
+	"IX", "IY", "SP", "I"
+};
+
+static const char* const interruptNames[] = {
+	"NMI", "IRQ (IM 0)", "IRQ (IM 1)", "IRQ (IM 2)"
+};
+
+TraceRecorder::TraceRecorder(string_ref filename_)
+	: filename(filename_.str())
+	, file(filename, File::TRUNCATE)
+	, ring(RING_SIZE)
+	, head(0)
+	, tail(0)
+	, stageSize(0)
+	, prevTime(0)
+	, nextPC(0)
+	, numInstructions(0)
+	, bytesWritten(0)
+	, stop(false)
+{
+	memset(prevRegs, 0, sizeof(prevRegs));
+	file.write(MAGIC, sizeof(MAGIC));
+	thread = std::thread([this]() { writerLoop(); });
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	flushStage();
+	stop = true;
+	cond.notify_one();
+	thread.join();
+	try {
+		file.flush();
+	} catch (FileException&) {
+		// ignore
+	}
+}
+
+static inline void put(byte*& p, byte b)
+{
+	*p++ = b;
+}
+
+static inline void putWord(byte*& p, word w)
+{
+	put(p, w & 0xFF);
+	put(p, w >> 8);
+}
+
+static inline void putVarint(byte*& p, uint64_t value)
+{
+	while (value >= 0x80) {
+		put(p, byte(value | 0x80));
+		value >>= 7;
+	}
+	put(p, byte(value));
+}
+
+byte* TraceRecorder::reserve(unsigned num)
+{
+	if (unlikely((stageSize + num) > STAGE_SIZE)) {
+		flushStage();
+	}
+	return stage + stageSize;
+}
+
+void TraceRecorder::flushStage()
+{
+	uint64_t h = head.load(std::memory_order_relaxed);
+	while ((RING_SIZE - (h - tail.load(std::memory_order_acquire))) < stageSize) {
+		// ring buffer is full, wait till the writer thread catches up
+		cond.notify_one();
+		std::this_thread::yield();
+	}
+	size_t begin = h & (RING_SIZE - 1);
+	size_t num1 = std::min<size_t>(stageSize, RING_SIZE - begin);
+	memcpy(ring.data() + begin, stage, num1);
+	memcpy(ring.data(), stage + num1, stageSize - num1);
+	head.store(h + stageSize, std::memory_order_release);
+	stageSize = 0;
+	cond.notify_one();
+}
+
+void TraceRecorder::writerLoop()
+{
+	while (true) {
+		uint64_t t = tail.load(std::memory_order_relaxed);
+		uint64_t h = head.load(std::memory_order_acquire);
+		if (h == t) {
+			if (stop) break;
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait_for(lock, std::chrono::milliseconds(10));
+			continue;
+		}
+		size_t begin = t & (RING_SIZE - 1);
+		size_t num = std::min<size_t>(h - t, RING_SIZE - begin);
+		try {
+			file.write(ring.data() + begin, num);
+			bytesWritten += num;
+		} catch (FileException& e) {
+			// keep consuming, otherwise the emulation thread blocks
+			std::lock_guard<std::mutex> lock(mutex);
+			if (error.empty()) error = e.getMessage();
+		}
+		tail.store(t + num, std::memory_order_release);
+	}
+}
+
+string TraceRecorder::getError()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return error;
+}
+
+// The records are encoded via a local pointer (see put()). When the bytes
+// are stored via a member, the compiler has to assume they can alias the
+// other members (e.g. the stage size), and reload those after each byte.
+void TraceRecorder::instruction(EmuTime::param time, word pc,
+                                const byte* opcode, unsigned len)
+{
+	assert((1 <= len) && (len <= 4));
+	byte* p = reserve(1 + 10 + 2 + 4);
+	bool pcPresent = pc != nextPC;
+	put(p, TAG_INSTR | (pcPresent ? TAG_PC : 0) | len);
+	uint64_t t = (time - EmuTime::zero).length();
+	putVarint(p, t - prevTime);
+	prevTime = t;
+	if (pcPresent) putWord(p, pc);
+	for (unsigned i = 0; i < len; ++i) put(p, opcode[i]);
+	stageSize = p - stage;
+
+	nextPC = pc + len;
+	++numInstructions;
+}
+
+void TraceRecorder::interrupt(EmuTime::param time, Interrupt type)
+{
+	byte* p = reserve(1 + 10);
+	put(p, TAG_INTERRUPT | type);
+	uint64_t t = (time - EmuTime::zero).length();
+	putVarint(p, t - prevTime);
+	prevTime = t;
+	stageSize = p - stage;
+}
+
+void TraceRecorder::memRead(word address, byte value)
+{
+	byte* p = reserve(4);
+	put(p, TAG_MEM_READ);
+	putWord(p, address);
+	put(p, value);
+	stageSize = p - stage;
+}
+
+void TraceRecorder::memWrite(word address, byte value)
+{
+	byte* p = reserve(4);
+	put(p, TAG_MEM_WRITE);
+	putWord(p, address);
+	put(p, value);
+	stageSize = p - stage;
+}
+
+void TraceRecorder::registers(const word regs[NUM_REGS])
+{
+	unsigned mask = 0;
+	for (int i = 0; i < NUM_REGS; ++i) {
+		mask |= unsigned(regs[i] != prevRegs[i]) << i;
+	}
+	if (mask == 0) return;
+	byte* p = reserve(1 + 2 + 2 * NUM_REGS);
+	put(p, TAG_REGS);
+	putVarint(p, mask);
+	for (int i = 0; i < NUM_REGS; ++i) {
+		// branchless: which registers changed is hard to predict
+		p[0] = regs[i] & 0xFF;
+		p[1] = regs[i] >> 8;
+		p += 2 * ((mask >> i) & 1);
+	}
+	stageSize = p - stage;
+	memcpy(prevRegs, regs, sizeof(prevRegs));
+}
+
+
+// Decoder
+
+namespace {
+
+class TraceReader
+{
+public:
+	TraceReader(const byte* data_, size_t size_)
+		: data(data_), size(size_), pos(0) {}
+
+	bool atEnd() const { return pos == size; }
+	byte getByte() {
+		if (pos == size) throw MSXException("Truncated trace file");
+		return data[pos++];
+	}
+	word getWord() {
+		byte l = getByte();
+		return l | (getByte() << 8);
+	}
+	uint64_t getVarint() {
+		uint64_t result = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7) {
+			byte b = getByte();
+			result |= uint64_t(b & 0x7F) << shift;
+			if (!(b & 0x80)) return result;
+		}
+		throw MSXException("Corrupt trace file");
+	}
+
+private:
+	const byte* data;
+	size_t size;
+	size_t pos;
+};
+
+} // namespace
+
+void TraceRecorder::decode(string_ref traceFile, string_ref textFile)
+{
+	File file(traceFile);
+	size_t size;
+	const byte* data = file.mmap(size);
+	if ((size < sizeof(MAGIC)) || memcmp(data, MAGIC, sizeof(MAGIC))) {
+		throw MSXException("Not a CPU trace file: " + traceFile);
+	}
+	TraceReader reader(data + sizeof(MAGIC), size - sizeof(MAGIC));
+
+	std::ofstream out;
+	FileOperations::openofstream(out, textFile.str());
+	if (!out.is_open()) {
+		throw MSXException("Couldn't open " + textFile + " for writing");
+	}
+
+	uint64_t time = 0;
+	word pc = 0;
+	string line;
+	auto flush = [&]() {
+		if (!line.empty()) {
+			out << line << '\n';
+			line.clear();
+		}
+	};
+	auto timeStamp = [&]() {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.9f ",
+		         double(time) / EmuDuration(1.0).length());
+		return string(buf);
+	};
+	while (!reader.atEnd()) {
+		byte tag = reader.getByte();
+		if ((tag & 0xF0) == TAG_INSTR) {
+			flush();
+			unsigned len = tag & 7;
+			if ((len < 1) || (len > 4)) {
+				throw MSXException("Corrupt trace file");
+			}
+			time += reader.getVarint();
+			if (tag & TAG_PC) pc = reader.getWord();
+			byte opcode[4] = { 0, 0, 0, 0 };
+			for (unsigned i = 0; i < len; ++i) {
+				opcode[i] = reader.getByte();
+			}
+			line = timeStamp() + StringOp::toHexString(pc, 4) + " :";
+			for (unsigned i = 0; i < 4; ++i) {
+				line += (i < len)
+				      ? ' ' + StringOp::toHexString(opcode[i], 2)
+				      : string("   ");
+			}
+			string dasmOutput;
+			dasm(opcode, pc, dasmOutput);
+			line += "  " + dasmOutput;
+			pc += len;
+		} else if ((tag & 0xFC) == TAG_INTERRUPT) {
+			flush();
+			time += reader.getVarint();
+			line = timeStamp() + "interrupt: ";
+			line += interruptNames[tag & 3];
+		} else if ((tag == TAG_MEM_READ) || (tag == TAG_MEM_WRITE)) {
+			word address = reader.getWord();
+			byte value = reader.getByte();
+			line += (tag == TAG_MEM_READ) ? " R:" : " W:";
+			line += StringOp::toHexString(address, 4) + '=' +
+			        StringOp::toHexString(value, 2);
+		} else if (tag == TAG_REGS) {
+			uint64_t mask = reader.getVarint();
+			for (int i = 0; i < NUM_REGS; ++i) {
+				if (mask & (1 << i)) {
+					line += ' ';
+					line += regNames[i];
+					line += '=' + StringOp::toHexString(
+						reader.getWord(), 4);
+				}
+			}
+		} else {
+			throw MSXException("Corrupt trace file");
+		}
+	}
+	flush();
+}
+
+} // namespace openmsx
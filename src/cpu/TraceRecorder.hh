@@ -0,0 +1,114 @@
+#ifndef TRACERECORDER_HH
+#define TRACERECORDER_HH
+
+#include "EmuTime.hh"
+#include "File.hh"
+#include "MemBuffer.hh"
+#include "openmsx.hh"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+namespace openmsx {
+
+/** Records an instruction level trace of the CPU in a compact binary file.
+ *
+ * For every executed instruction the trace contains the EmuTime (delta),
+ * the PC (only when it's not the address directly following the previous
+ * instruction), the opcode bytes, the (non-opcode) memory reads and writes
+ * and the registers that were changed by the instruction. Accepted
+ * interrupts get their own record, followed by their own memory accesses
+ * (the stack push, the IM2 vector read) and register changes. Numbers are
+ * varint encoded.
+ *
+ * The emulation thread encodes the records in a lock-free (single
+ * producer, single consumer) ring buffer. A background thread writes the
+ * content of that buffer to disk. When the disk can't keep up, the
+ * emulation thread waits, so no records are ever dropped.
+ *
+ * A trace can be converted to a readable text file with decode().
+ */
+class TraceRecorder
+{
+public:
+	enum Register { AF, BC, DE, HL, AF2, BC2, DE2, HL2, IX, IY, SP, I,
+	                NUM_REGS };
+	enum Interrupt { NMI, IRQ_IM0, IRQ_IM1, IRQ_IM2 };
+
+	/** Start recording to the given file.
+	  * @throws FileException */
+	explicit TraceRecorder(string_ref filename);
+	/** Stops recording, all records are written to disk. */
+	~TraceRecorder();
+
+	// The following methods are called by the emulation thread.
+
+	/** Start of a new instruction. */
+	void instruction(EmuTime::param time, word pc,
+	                 const byte* opcode, unsigned len);
+	/** Start of an interrupt (the CPU is about to jump to the interrupt
+	  * routine). */
+	void interrupt(EmuTime::param time, Interrupt type);
+	/** Memory accesses done by the current instruction or interrupt.
+	  * The CPU doesn't report opcode fetches. */
+	void memRead(word address, byte value);
+	void memWrite(word address, byte value);
+	/** The registers at the end of the current instruction or
+	  * interrupt. */
+	void registers(const word regs[NUM_REGS]);
+
+	const std::string& getFilename() const { return filename; }
+	uint64_t getNumInstructions() const { return numInstructions; }
+	uint64_t getBytesWritten() const { return bytesWritten; }
+	/** Error while writing the file, empty if there was none. */
+	std::string getError();
+
+	/** Convert a binary trace file to text, the instructions are
+	  * disassembled.
+	  * @throws MSXException */
+	static void decode(string_ref traceFile, string_ref textFile);
+
+private:
+	/** Make room for 'num' bytes in the stage buffer, returns the
+	  * position where the next record must be written. */
+	byte* reserve(unsigned num);
+	void flushStage();
+	void writerLoop();
+
+	static const size_t RING_SIZE = 1 << 22; // must be power of 2
+	static const unsigned STAGE_SIZE = 4096;
+
+	const std::string filename;
+	File file;
+
+	// ring buffer, 'head' is only written by the emulation thread, 'tail'
+	// only by the writer thread (both only increase)
+	MemBuffer<byte> ring;
+	std::atomic<uint64_t> head;
+	std::atomic<uint64_t> tail;
+
+	// records are first collected here, to limit the number of accesses
+	// to the (shared) ring buffer
+	byte stage[STAGE_SIZE];
+	unsigned stageSize;
+
+	// encoder state
+	uint64_t prevTime;
+	word nextPC;
+	word prevRegs[NUM_REGS];
+	uint64_t numInstructions;
+
+	std::atomic<uint64_t> bytesWritten;
+	std::atomic<bool> stop;
+	std::mutex mutex; // for 'error' and 'cond'
+	std::condition_variable cond;
+	std::string error;
+	std::thread thread;
+};
+
+} // namespace openmsx
+
+#endif
@@ -7,12 +7,15 @@ unsigned WatchPoint::lastId = 0;
 
 WatchPoint::WatchPoint(TclObject command_, TclObject condition_,
                        Type type_, unsigned beginAddr_, unsigned endAddr_,
-                       unsigned newId /*= -1*/)
+                       unsigned newId /*= -1*/,
+                       int primarySlot_ /*= -1*/, int secondarySlot_ /*= -1*/)
 	: BreakPointBase(command_, condition_)
 	, id((newId == unsigned(-1)) ? ++lastId : newId)
 	, beginAddr(beginAddr_), endAddr(endAddr_), type(type_)
+	, primarySlot(primarySlot_), secondarySlot(secondarySlot_)
 {
 	assert(beginAddr <= endAddr);
+	assert(!hasSlot() || (type == READ_MEM) || (type == WRITE_MEM));
 }
 
 } // namespace openmsx
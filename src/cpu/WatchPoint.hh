@@ -15,22 +15,30 @@ public:
 	enum Type { READ_IO, WRITE_IO, READ_MEM, WRITE_MEM };
 
 	/** Begin and end address are inclusive (IOW range = [begin, end])
+	 *  Memory watchpoints can optionally be restricted to a slot (-1
+	 *  means any slot), see BreakPoint.
 	 */
 	WatchPoint(TclObject command, TclObject condition,
 	           Type type, unsigned beginAddr, unsigned endAddr,
-	           unsigned newId = -1);
+	           unsigned newId = -1,
+	           int primarySlot = -1, int secondarySlot = -1);
 	virtual ~WatchPoint() = default; // needed for dynamic_cast
 
 	unsigned getId()           const { return id; }
 	Type     getType()         const { return type; }
 	unsigned getBeginAddress() const { return beginAddr; }
 	unsigned getEndAddress()   const { return endAddr; }
+	int getPrimarySlot()       const { return primarySlot; }
+	int getSecondarySlot()     const { return secondarySlot; }
+	bool hasSlot()             const { return primarySlot != -1; }
 
 private:
 	unsigned id;
 	unsigned beginAddr;
 	unsigned endAddr;
 	Type type;
+	signed char primarySlot;
+	signed char secondarySlot;
 
 	static unsigned lastId;
 };
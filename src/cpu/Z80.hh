@@ -30,6 +30,8 @@ protected:
 	template <bool, bool> ALWAYS_INLINE void PRE_WORD (unsigned /*address*/) { }
 	template <      bool> ALWAYS_INLINE void POST_WORD(unsigned /*address*/) { }
 
+	ALWAYS_INLINE unsigned samePageFetchCost(unsigned /*address*/) const { return 0; }
+
 	ALWAYS_INLINE void R800Refresh(CPURegs& /*R*/) { }
 	ALWAYS_INLINE void R800ForcePageBreak() { }
 
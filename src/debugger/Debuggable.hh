@@ -14,6 +14,22 @@ public:
 	virtual byte read(unsigned address) = 0;
 	virtual void write(unsigned address, byte value) = 0;
 
+	/** Read/write 'num' bytes starting at 'start'. The whole range must
+	  * lie within [0, getSize()). The default implementation calls
+	  * read()/write() for each byte, debuggables that can access a block
+	  * more efficiently should override these.
+	  */
+	virtual void readBlock(unsigned start, byte* output, unsigned num) {
+		for (unsigned i = 0; i < num; ++i) {
+			output[i] = read(start + i);
+		}
+	}
+	virtual void writeBlock(unsigned start, const byte* input, unsigned num) {
+		for (unsigned i = 0; i < num; ++i) {
+			write(start + i, input[i]);
+		}
+	}
+
 protected:
 	Debuggable() {}
 	~Debuggable() {}
@@ -10,7 +10,6 @@
 #include "MSXWatchIODevice.hh"
 #include "TclObject.hh"
 #include "CommandException.hh"
-#include "MemBuffer.hh"
 #include "StringOp.hh"
 #include "KeyRange.hh"
 #include "stl.hh"
@@ -148,7 +147,9 @@ void Debugger::removeProbeBreakPoint(ProbeBreakPoint& bp)
 unsigned Debugger::setWatchPoint(TclObject command, TclObject condition,
                                  WatchPoint::Type type,
                                  unsigned beginAddr, unsigned endAddr,
-                                 unsigned newId /*= -1*/)
+                                 unsigned newId /*= -1*/,
+                                 int primarySlot /*= -1*/,
+                                 int secondarySlot /*= -1*/)
 {
 	shared_ptr<WatchPoint> wp;
 	if ((type == WatchPoint::READ_IO) || (type == WatchPoint::WRITE_IO)) {
@@ -157,7 +158,8 @@ unsigned Debugger::setWatchPoint(TclObject command, TclObject condition,
 			command, condition, newId);
 	} else {
 		wp = make_shared<WatchPoint>(
-			command, condition, type, beginAddr, endAddr, newId);
+			command, condition, type, beginAddr, endAddr, newId,
+			primarySlot, secondarySlot);
 	}
 	motherBoard.getCPUInterface().setWatchPoint(wp);
 	return wp->getId();
@@ -170,7 +172,8 @@ void Debugger::transfer(Debugger& other)
 	for (auto& wp : other.motherBoard.getCPUInterface().getWatchPoints()) {
 		setWatchPoint(wp->getCommandObj(), wp->getConditionObj(),
 		              wp->getType(),       wp->getBeginAddress(),
-		              wp->getEndAddress(), wp->getId());
+		              wp->getEndAddress(), wp->getId(),
+		              wp->getPrimarySlot(), wp->getSecondarySlot());
 	}
 
 	// Copy probes to new machine.
@@ -270,6 +273,8 @@ void Debugger::Cmd::execute(
 		removeCondition(tokens, result);
 	} else if (subCmd == "list_conditions") {
 		listConditions(tokens, result);
+	} else if (subCmd == "condition_stats") {
+		conditionStats(tokens, result);
 	} else if (subCmd == "probe") {
 		probe(tokens, result);
 	} else {
@@ -330,11 +335,8 @@ void Debugger::Cmd::readBlock(array_ref<TclObject> tokens, TclObject& result)
 		throw CommandException("Invalid size");
 	}
 
-	MemBuffer<byte> buf(num);
-	for (unsigned i = 0; i < num; ++i) {
-		buf[i] = device.read(addr + i);
-	}
-	result.setBinary(buf.data(), num);
+	// read directly into the Tcl object, avoids an extra copy
+	device.readBlock(addr, result.allocBinary(num), num);
 }
 
 void Debugger::Cmd::write(array_ref<TclObject> tokens, TclObject& /*result*/)
@@ -373,15 +375,40 @@ void Debugger::Cmd::writeBlock(array_ref<TclObject> tokens, TclObject& /*result*
 		throw CommandException("Invalid size");
 	}
 
-	for (unsigned i = 0; i < num; ++i) {
-		device.write(addr + i, static_cast<byte>(buf[i]));
+	device.writeBlock(addr, buf, num);
+}
+
+// Parses the argument of the '-slot' option: either a single primary slot
+// or a {<ps> <ss>} pair.
+static void getSlot(Interpreter& interp, const TclObject& token,
+                    int& ps, int& ss)
+{
+	unsigned len = token.getListLength(interp);
+	if ((len != 1) && (len != 2)) {
+		throw CommandException("Invalid slot: " + token.getString());
+	}
+	ps = token.getListIndex(interp, 0).getInt(interp);
+	ss = (len == 2) ? token.getListIndex(interp, 1).getInt(interp) : -1;
+	if ((ps < 0) || (ps > 3) || (ss < -1) || (ss > 3)) {
+		throw CommandException("Invalid slot: " + token.getString());
 	}
 }
 
-void Debugger::Cmd::setBreakPoint(array_ref<TclObject> tokens, TclObject& result)
+void Debugger::Cmd::setBreakPoint(array_ref<TclObject> tokens_, TclObject& result)
 {
 	TclObject command("debug break");
 	TclObject condition;
+	int ps = -1;
+	int ss = -1;
+
+	vector<TclObject> tokens(begin(tokens_), end(tokens_));
+	if ((tokens.size() >= 3) && (tokens[2].getString() == "-slot")) {
+		if (tokens.size() < 4) {
+			throw CommandException("Missing argument for -slot");
+		}
+		getSlot(getInterpreter(), tokens[3], ps, ss);
+		tokens.erase(begin(tokens) + 2, begin(tokens) + 4);
+	}
 
 	switch (tokens.size()) {
 	case 5: // command
@@ -392,7 +419,7 @@ void Debugger::Cmd::setBreakPoint(array_ref<TclObject> tokens, TclObject& result
 		// fall-through
 	case 3: { // address
 		word addr = getAddress(getInterpreter(), tokens);
-		BreakPoint bp(addr, command, condition);
+		BreakPoint bp(addr, command, condition, ps, ss);
 		result.setString(StringOp::Builder() << "bp#" << bp.getId());
 		debugger().motherBoard.getCPUInterface().insertBreakPoint(bp);
 		break;
@@ -457,18 +484,37 @@ void Debugger::Cmd::listBreakPoints(
 		line.addListElement("0x" + StringOp::toHexString(bp.getAddress(), 4));
 		line.addListElement(bp.getCondition());
 		line.addListElement(bp.getCommand());
+		if (bp.hasSlot()) {
+			TclObject slot;
+			slot.addListElement(bp.getPrimarySlot());
+			if (bp.getSecondarySlot() != -1) {
+				slot.addListElement(bp.getSecondarySlot());
+			}
+			line.addListElement(slot);
+		}
 		res += line.getString() + '\n';
 	}
 	result.setString(res);
 }
 
 
-void Debugger::Cmd::setWatchPoint(array_ref<TclObject> tokens, TclObject& result)
+void Debugger::Cmd::setWatchPoint(array_ref<TclObject> tokens_, TclObject& result)
 {
 	TclObject command("debug break");
 	TclObject condition;
 	unsigned beginAddr, endAddr;
 	WatchPoint::Type type;
+	int ps = -1;
+	int ss = -1;
+
+	vector<TclObject> tokens(begin(tokens_), end(tokens_));
+	if ((tokens.size() >= 3) && (tokens[2].getString() == "-slot")) {
+		if (tokens.size() < 4) {
+			throw CommandException("Missing argument for -slot");
+		}
+		getSlot(getInterpreter(), tokens[3], ps, ss);
+		tokens.erase(begin(tokens) + 2, begin(tokens) + 4);
+	}
 
 	switch (tokens.size()) {
 	case 6: // command
@@ -510,6 +556,11 @@ void Debugger::Cmd::setWatchPoint(array_ref<TclObject> tokens, TclObject& result
 		if (endAddr >= max) {
 			throw CommandException("Invalid address: out of range");
 		}
+		if ((ps != -1) && (max != 0x10000)) {
+			throw CommandException(
+				"The -slot option is only valid for memory "
+				"watchpoints.");
+		}
 		break;
 	}
 	default:
@@ -520,7 +571,7 @@ void Debugger::Cmd::setWatchPoint(array_ref<TclObject> tokens, TclObject& result
 		}
 	}
 	unsigned id = debugger().setWatchPoint(
-		command, condition, type, beginAddr, endAddr);
+		command, condition, type, beginAddr, endAddr, -1, ps, ss);
 	result.setString(StringOp::Builder() << "wp#" << id);
 }
 
@@ -587,6 +638,14 @@ void Debugger::Cmd::listWatchPoints(
 		}
 		line.addListElement(wp->getCondition());
 		line.addListElement(wp->getCommand());
+		if (wp->hasSlot()) {
+			TclObject slot;
+			slot.addListElement(wp->getPrimarySlot());
+			if (wp->getSecondarySlot() != -1) {
+				slot.addListElement(wp->getSecondarySlot());
+			}
+			line.addListElement(slot);
+		}
 		res += line.getString() + '\n';
 	}
 	result.setString(res);
@@ -659,6 +718,35 @@ void Debugger::Cmd::listConditions(
 	result.setString(res);
 }
 
+void Debugger::Cmd::conditionStats(
+	array_ref<TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() != 2) {
+		throw SyntaxError();
+	}
+	TclObject native, tcl;
+	auto add = [&](const BreakPointBase& bp, const string& id) {
+		(bp.isNative() ? native : tcl).addListElement(id);
+	};
+	auto& interface = debugger().motherBoard.getCPUInterface();
+	for (auto& bp : interface.getBreakPoints()) {
+		add(bp, StringOp::Builder() << "bp#" << bp.getId());
+	}
+	for (auto& wp : interface.getWatchPoints()) {
+		add(*wp, StringOp::Builder() << "wp#" << wp->getId());
+	}
+	for (auto& c : interface.getConditions()) {
+		add(c, StringOp::Builder() << "cond#" << c.getId());
+	}
+	for (auto& p : debugger().probeBreakPoints) {
+		add(*p, StringOp::Builder() << "pp#" << p->getId());
+	}
+	result.addListElement("native");
+	result.addListElement(native);
+	result.addListElement("tcl");
+	result.addListElement(tcl);
+}
+
 
 void Debugger::Cmd::probe(array_ref<TclObject> tokens, TclObject& result)
 {
@@ -776,6 +864,7 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"    set_condition     insert a new condition\n"
 		"    remove_condition  remove a certain condition\n"
 		"    list_conditions   list the active conditions\n"
+		"    condition_stats   show which conditions are evaluated natively\n"
 		"    probe             probe related subcommands\n"
 		"    cont              continue execution after break\n"
 		"    step              execute one instruction\n"
@@ -827,7 +916,7 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"complete block must fit in the debuggable (see the 'size' "
 		"subcommand).\n";
 	static const string setBpHelp =
-		"debug set_bp <addr> [<cond>] [<cmd>]\n"
+		"debug set_bp [-slot <slot>] <addr> [<cond>] [<cmd>]\n"
 		"  Insert a new breakpoint at given address. When the CPU is about "
 		"to execute the instruction at this address, execution will be "
 		"breaked. At least this is the default behaviour, see next "
@@ -842,6 +931,11 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"  Also optionally you can specify a command that should be "
 		"executed when the breakpoint is reached (and condition is true). "
 		"By default this command is 'debug break'.\n"
+		"  With the -slot option the breakpoint only triggers when the "
+		"given slot is selected in the page of the address. The slot is "
+		"either a primary slot or a {<ps> <ss>} pair. For example\n"
+		"     debug set_bp -slot {3 1} 0x4010\n"
+		"  only breaks when address 0x4010 is executed in slot 3-1.\n"
 		"  The result of this command is a breakpoint ID. This ID can "
 		"later be used to remove this breakpoint again.\n";
 	static const string removeBpHelp =
@@ -854,9 +948,11 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"columns. The first column contains the breakpoint ID. The "
 		"second one has the address. The third has the condition "
 		"(default condition is empty). And the last column contains "
-		"the command that will be executed (default is 'debug break').\n";
+		"the command that will be executed (default is 'debug break'). "
+		"Breakpoints that were set with the -slot option have an extra "
+		"5th column with that slot.\n";
 	static const string setWatchPointHelp =
-		"debug set_watchpoint <type> <region> [<cond>] [<cmd>]\n"
+		"debug set_watchpoint [-slot <slot>] <type> <region> [<cond>] [<cmd>]\n"
 		"  Insert a new watchpoint of given type on the given region, "
 		"there can be an optional condition and alternative command. See "
 		"the 'set_bp' subcommand for details about these last two.\n"
@@ -869,6 +965,10 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"memory location or IO port. Otherwise region must be a list of "
 		"two values (enclosed in braces) that specify a begin and end "
 		"point of a whole memory region or a range of IO ports.\n"
+		"  Memory watchpoints can be restricted to a slot with the -slot "
+		"option, like in the 'set_bp' subcommand. The watchpoint then only "
+		"triggers for accesses to that slot, not for accesses to the same "
+		"CPU address in other slots.\n"
 		"During the execution of <cmd>, the following global Tcl "
 		"variables are set:\n"
 		"  ::wp_last_address   this is the actual address of the mem/io "
@@ -877,7 +977,8 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"by the mem/io write that triggered the watchpoint\n"
 		"Examples:\n"
 		"  debug set_watchpoint write_io 0x99 {[reg A] == 0x81}\n"
-		"  debug set_watchpoint read_mem {0xfbe5 0xfbef}\n";
+		"  debug set_watchpoint read_mem {0xfbe5 0xfbef}\n"
+		"  debug set_watchpoint -slot {3 2} write_mem {0x4000 0x7fff}\n";
 	static const string removeWatchPointHelp =
 		"debug remove_watchpoint <id>\n"
 		"  Remove the watchpoint with given ID again. You can use the "
@@ -895,7 +996,8 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"  Conditions will slow down simulation MUCH more than "
 		"breakpoints. So only use them when you don't care about "
 		"simulation speed (when you're debugging this is usually not "
-		"a problem).\n"
+		"a problem). Conditions that can be evaluated natively (see "
+		"'help debug condition_stats') are a lot cheaper.\n"
 		"  See 'help debug set_bp' for more details.\n";
 	static const string removeCondHelp =
 		"debug remove_condition <id>\n"
@@ -906,6 +1008,17 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"  Lists all active conditions. The result is similar to the "
 		"'list_bp' subcommand, but without the 2nd column that would "
 		"show the address.\n";
+	static const string condStatsHelp =
+		"debug condition_stats\n"
+		"  Shows how the conditions of all breakpoints, watchpoints, "
+		"conditions and probe breakpoints are evaluated. The result is "
+		"a dictionary with keys 'native' and 'tcl', each containing a "
+		"list of IDs.\n"
+		"  Conditions that only use integer arithmetic, comparisons, "
+		"logic operators and the 'reg', 'peek' (and variants) and "
+		"'debug read' commands are compiled and evaluated natively. Other "
+		"conditions (for example using Tcl variables or other procs) are "
+		"evaluated by the Tcl interpreter, which is a lot slower.\n";
 	static const string probeHelp =
 		"debug probe <subcommand> [<arguments>]\n"
 		"  Possible subcommands are:\n"
@@ -978,6 +1091,8 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		return removeCondHelp;
 	} else if (tokens[1] == "list_conditions") {
 		return listCondHelp;
+	} else if (tokens[1] == "condition_stats") {
+		return condStatsHelp;
 	} else if (tokens[1] == "probe") {
 		return probeHelp;
 	} else if (tokens[1] == "cont") {
@@ -1028,6 +1143,7 @@ void Debugger::Cmd::tabCompletion(vector<string>& tokens) const
 	static const char* const singleArgCmds[] = {
 		"list", "step", "cont", "break", "breaked",
 		"list_bp", "list_watchpoints", "list_conditions",
+		"condition_stats",
 	};
 	static const char* const debuggableArgCmds[] = {
 		"desc", "size", "read", "read_block",
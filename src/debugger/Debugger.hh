@@ -37,6 +37,7 @@ public:
 	ProbeBase* findProbe(string_ref name);
 
 	void removeProbeBreakPoint(ProbeBreakPoint& bp);
+	bool hasProbeBreakPoints() const { return !probeBreakPoints.empty(); }
 	void setCPU(MSXCPU* cpu_) { cpu = cpu_; }
 
 	void transfer(Debugger& other);
@@ -55,7 +56,8 @@ private:
 	unsigned setWatchPoint(TclObject command, TclObject condition,
 	                       WatchPoint::Type type,
 	                       unsigned beginAddr, unsigned endAddr,
-	                       unsigned newId = -1);
+	                       unsigned newId = -1,
+	                       int primarySlot = -1, int secondarySlot = -1);
 
 	MSXMotherBoard& motherBoard;
 
@@ -92,6 +94,7 @@ private:
 		void setCondition(array_ref<TclObject> tokens, TclObject& result);
 		void removeCondition(array_ref<TclObject> tokens, TclObject& result);
 		void listConditions(array_ref<TclObject> tokens, TclObject& result);
+		void conditionStats(array_ref<TclObject> tokens, TclObject& result);
 		void probe(array_ref<TclObject> tokens, TclObject& result);
 		void probeList(array_ref<TclObject> tokens, TclObject& result);
 		void probeDesc(array_ref<TclObject> tokens, TclObject& result);
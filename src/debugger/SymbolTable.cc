@@ -0,0 +1,134 @@
+#include "SymbolTable.hh"
+#include "File.hh"
+#include "FileException.hh"
+#include "MSXException.hh"
+#include "StringOp.hh"
+#include <algorithm>
+#include <cstdlib>
+
+using std::string;
+
+namespace openmsx {
+
+// Parses (16-bit) numbers like '1234', '0x4000', '#4000', '$4000', '&h4000'
+// and '04000h'.
+static bool parseValue(string_ref str, unsigned& result)
+{
+	int base = 10;
+	if (StringOp::startsWith(str, "0x") || StringOp::startsWith(str, "0X") ||
+	    StringOp::startsWith(str, "&h") || StringOp::startsWith(str, "&H")) {
+		str = str.substr(2);
+		base = 16;
+	} else if (StringOp::startsWith(str, '#') ||
+	           StringOp::startsWith(str, '$')) {
+		str = str.substr(1);
+		base = 16;
+	} else if (StringOp::endsWith(str, 'h') || StringOp::endsWith(str, 'H')) {
+		str = str.substr(0, str.size() - 1);
+		base = 16;
+	}
+	if (str.empty()) return false;
+	string s = str.str();
+	char* end;
+	unsigned long value = strtoul(s.c_str(), &end, base);
+	if ((*end != '\0') || (value > 0xFFFF)) return false;
+	result = unsigned(value);
+	return true;
+}
+
+static bool parseLine(string_ref line, string& name, unsigned& value)
+{
+	string_ref code, comment;
+	StringOp::splitOnFirst(line, ';', code, comment);
+	std::vector<string_ref> tokens;
+	for (auto& t : StringOp::split(code, ' ')) {
+		for (auto& t2 : StringOp::split(t, '\t')) {
+			StringOp::trim(t2, "\r\n");
+			if (!t2.empty()) tokens.push_back(t2);
+		}
+	}
+
+	string_ref label;
+	string_ref valueStr;
+	if (tokens.size() == 3) {
+		// label: equ value   label = value
+		string keyword = StringOp::toLower(tokens[1]);
+		if ((keyword != "equ") && (keyword != ".equ") &&
+		    (keyword != "=") && (keyword != "defl")) {
+			return false;
+		}
+		label = tokens[0];
+		valueStr = tokens[2];
+	} else if ((tokens.size() == 2) && StringOp::endsWith(tokens[0], ':')) {
+		// label: value
+		label = tokens[0];
+		valueStr = tokens[1];
+	} else {
+		return false;
+	}
+	StringOp::trimRight(label, ':');
+	if (label.empty()) return false;
+	if (!parseValue(valueStr, value)) return false;
+	name = label.str();
+	return true;
+}
+
+unsigned SymbolTable::load(string_ref filename, int primarySlot,
+                           int secondarySlot, int segment)
+{
+	std::vector<Symbol> newSymbols;
+	try {
+		File file(filename);
+		size_t size;
+		const byte* data = file.mmap(size);
+		string_ref content(reinterpret_cast<const char*>(data), size);
+		for (auto& line : StringOp::split(content, '\n')) {
+			Symbol sym;
+			unsigned value;
+			if (!parseLine(line, sym.name, value)) continue;
+			sym.address = value;
+			sym.primarySlot = primarySlot;
+			sym.secondarySlot = secondarySlot;
+			sym.segment = segment;
+			newSymbols.push_back(std::move(sym));
+		}
+	} catch (FileException& e) {
+		throw MSXException("Couldn't read symbol file: " + e.getMessage());
+	}
+
+	auto numNew = unsigned(newSymbols.size());
+	symbols.insert(symbols.end(),
+	               std::make_move_iterator(newSymbols.begin()),
+	               std::make_move_iterator(newSymbols.end()));
+	std::stable_sort(symbols.begin(), symbols.end(),
+		[](const Symbol& x, const Symbol& y) {
+			return x.address < y.address; });
+	return numNew;
+}
+
+const SymbolTable::Symbol* SymbolTable::lookup(
+	word address, int primarySlot, int secondarySlot, int segment) const
+{
+	auto it = std::upper_bound(symbols.begin(), symbols.end(), address,
+		[](word addr, const Symbol& sym) { return addr < sym.address; });
+	while (it != symbols.begin()) {
+		--it;
+		if (((it->primarySlot   == -1) || (it->primarySlot   == primarySlot)) &&
+		    ((it->secondarySlot == -1) || (it->secondarySlot == secondarySlot)) &&
+		    ((it->segment       == -1) || (it->segment       == segment))) {
+			return &*it;
+		}
+	}
+	return nullptr;
+}
+
+string SymbolTable::symbolize(word address, int primarySlot, int secondarySlot,
+                              int segment, bool withOffset) const
+{
+	auto* sym = lookup(address, primarySlot, secondarySlot, segment);
+	if (!sym) return string();
+	if (!withOffset || (sym->address == address)) return sym->name;
+	return sym->name + '+' + StringOp::toString(address - sym->address);
+}
+
+} // namespace openmsx
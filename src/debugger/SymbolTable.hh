@@ -0,0 +1,61 @@
+#ifndef SYMBOLTABLE_HH
+#define SYMBOLTABLE_HH
+
+#include "openmsx.hh"
+#include "string_ref.hh"
+#include <string>
+#include <vector>
+
+namespace openmsx {
+
+/** Symbols (labels) read from assembler symbol files, used to translate
+  * addresses of MSX code into readable names.
+  *
+  * The same address can contain different code depending on the selected
+  * slot and mapper segment. So a symbol can optionally be restricted to a
+  * primary slot, a secondary slot and/or a segment.
+  */
+class SymbolTable
+{
+public:
+	struct Symbol {
+		std::string name;
+		word address;
+		signed char primarySlot;   // -1 = any slot
+		signed char secondarySlot; // -1 = any slot
+		short segment;             // -1 = any segment
+	};
+
+	/** Load all symbols from the given file. The file can contain lines
+	  * like 'label: equ 0x4000', 'label EQU 04000h' or 'label = #4000'
+	  * (the formats produced by the common MSX assemblers). Lines that
+	  * are not recognized are skipped.
+	  * @return The number of symbols that were loaded.
+	  * @throws MSXException */
+	unsigned load(string_ref filename, int primarySlot = -1,
+	              int secondarySlot = -1, int segment = -1);
+
+	void clear() { symbols.clear(); }
+	size_t size() const { return symbols.size(); }
+
+	/** Find the symbol with the highest address that is lower than or
+	  * equal to the given address and that is valid for the given slot
+	  * and segment (-1 when the slot is not expanded, or when the segment
+	  * is unknown).
+	  * @return The symbol or nullptr when there's none. */
+	const Symbol* lookup(word address, int primarySlot,
+	                     int secondarySlot, int segment) const;
+
+	/** Same as lookup(), but formatted as 'name' or 'name+offset'.
+	  * Returns an empty string when there's no matching symbol.
+	  * @param withOffset Whether to include the offset. */
+	std::string symbolize(word address, int primarySlot, int secondarySlot,
+	                      int segment, bool withOffset) const;
+
+private:
+	std::vector<Symbol> symbols; // sorted on address
+};
+
+} // namespace openmsx
+
+#endif
@@ -1,6 +1,8 @@
 #include "MSXCliComm.hh"
 #include "GlobalCliComm.hh"
 #include "MSXMotherBoard.hh"
+#include "Reactor.hh"
+#include "Thread.hh"
 
 namespace openmsx {
 
@@ -12,6 +14,14 @@ MSXCliComm::MSXCliComm(MSXMotherBoard& motherBoard_, GlobalCliComm& cliComm_)
 
 void MSXCliComm::log(LogLevel level, string_ref message)
 {
+	if (!Thread::isMainThread()) {
+		// Machine runs in a worker thread (see Reactor::runMachines()),
+		// pass the message to the main thread.
+		motherBoard.getReactor().invokeInMainThread(
+			[this, level, msg = message.str()] {
+				cliComm.log(level, msg); });
+		return;
+	}
 	cliComm.log(level, message);
 }
 
@@ -27,6 +37,13 @@ void MSXCliComm::update(UpdateType type, string_ref name, string_ref value)
 	} else {
 		prevValues[type].emplace_noDuplicateCheck(name.str(), value.str());
 	}
+	if (!Thread::isMainThread()) {
+		motherBoard.getReactor().invokeInMainThread(
+			[this, type, n = name.str(), v = value.str()] {
+				cliComm.updateHelper(
+					type, motherBoard.getMachineID(), n, v); });
+		return;
+	}
 	cliComm.updateHelper(type, motherBoard.getMachineID(), name, value);
 }
 
@@ -15,6 +15,7 @@ void Disk::writeTrack(byte track, byte side, const RawTrack& input)
 	if (isWriteProtected()) {
 		throw WriteProtectedException({});
 	}
+	if (dropWrite()) return;
 	writeTrackImpl(track, side, input);
 	flushCaches();
 }
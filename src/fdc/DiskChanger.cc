@@ -53,6 +53,8 @@ DiskChanger::DiskChanger(MSXMotherBoard& board,
 	, controller(board.getCommandController())
 	, stateChangeDistributor(&board.getStateChangeDistributor())
 	, scheduler(&board.getScheduler())
+	, discardedWrites(board.isReplayHelper()
+	                  ? &board.getDiscardedWritesFlag() : nullptr)
 	, preChangeCallback(preChangeCallback_)
 	, driveName(std::move(driveName_))
 	, doubleSidedDrive(doubleSidedDrive_)
@@ -65,6 +67,7 @@ DiskChanger::DiskChanger(Reactor& reactor_, string driveName_)
 	, controller(reactor.getCommandController())
 	, stateChangeDistributor(nullptr)
 	, scheduler(nullptr)
+	, discardedWrites(nullptr)
 	, driveName(std::move(driveName_))
 	, doubleSidedDrive(true) // irrelevant, but needs a value
 {
@@ -189,6 +192,7 @@ void DiskChanger::changeDisk(std::unique_ptr<Disk> newDisk)
 {
 	if (preChangeCallback) preChangeCallback();
 	disk = std::move(newDisk);
+	if (discardedWrites) disk->discardWrites(*discardedWrites);
 	diskChangedFlag = true;
 	controller.getCliComm().update(CliComm::MEDIA, getDriveName(),
 	                               getDiskName().getResolved());
@@ -71,6 +71,7 @@ private:
 	CommandController& controller;
 	StateChangeDistributor* stateChangeDistributor;
 	Scheduler* scheduler;
+	bool* discardedWrites; // see MSXMotherBoard::setReplayHelper()
 	std::function<void()> preChangeCallback;
 
 	const std::string driveName;
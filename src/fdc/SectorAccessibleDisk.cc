@@ -17,6 +17,7 @@ const size_t SectorAccessibleDisk::SECTOR_SIZE;
 
 SectorAccessibleDisk::SectorAccessibleDisk()
 	: patch(make_unique<EmptyDiskPatch>(*this))
+	, discardedWrites(nullptr)
 	, forcedWriteProtect(false)
 	, peekMode(false)
 {
@@ -50,6 +51,7 @@ void SectorAccessibleDisk::writeSector(size_t sector, const SectorBuffer& buf)
 	if (!isDummyDisk() && (getNbSectors() <= sector)) {
 		throw NoSuchSectorException("No such sector");
 	}
+	if (dropWrite()) return;
 	try {
 		writeSectorImpl(sector, buf);
 	} catch (MSXException& e) {
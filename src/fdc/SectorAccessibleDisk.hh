@@ -28,6 +28,12 @@ public:
 
 	virtual bool isDummyDisk() const;
 
+	/** From now on, don't write to the image anymore: writes are silently
+	  * dropped and 'flag' is set when that happens. Used for the helper
+	  * machine of the reverse Filler (see MSXMotherBoard::setReplayHelper).
+	  */
+	void discardWrites(bool& flag) { discardedWrites = &flag; }
+
 	// patch stuff
 	void applyPatch(Filename patchFile);
 	std::vector<Filename> getPatches() const;
@@ -57,6 +63,14 @@ protected:
 	void setPeekMode(bool peek) { peekMode = peek; }
 	bool isPeekMode() const { return peekMode; }
 
+	/** Returns true (and sets the flag) when the current write must be
+	  * dropped, see discardWrites(). */
+	bool dropWrite() {
+		if (!discardedWrites) return false;
+		*discardedWrites = true;
+		return true;
+	}
+
 	virtual void checkCaches();
 	virtual void flushCaches();
 	virtual Sha1Sum getSha1SumImpl(FilePool& filepool);
@@ -69,6 +83,7 @@ private:
 
 	std::unique_ptr<const PatchInterface> patch;
 	Sha1Sum sha1cache;
+	bool* discardedWrites; // nullptr when writes are not discarded
 	bool forcedWriteProtect;
 	bool peekMode;
 
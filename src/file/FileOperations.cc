@@ -52,6 +52,7 @@
 #include "AndroidApiWrapper.hh"
 #include <sstream>
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <stdexcept>
 #include <cassert>
@@ -282,6 +283,15 @@ int unlink(const std::string& path)
 #endif
 }
 
+int rename(const std::string& oldPath, const std::string& newPath)
+{
+#ifdef _WIN32
+	return _wrename(utf8to16(oldPath).c_str(), utf8to16(newPath).c_str());
+#else
+	return ::rename(oldPath.c_str(), newPath.c_str());
+#endif
+}
+
 int rmdir(const std::string& path)
 {
 #ifdef _WIN32
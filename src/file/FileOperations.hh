@@ -56,6 +56,11 @@ namespace FileOperations {
 	 */
 	int unlink(const std::string& path);
 
+	/**
+	 * Call rename() in a platform-independent manner
+	 */
+	int rename(const std::string& oldPath, const std::string& newPath);
+
 	/**
 	 * Call rmdir() in a platform-independent manner
 	 */
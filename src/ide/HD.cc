@@ -61,6 +61,9 @@ HD::HD(const DeviceConfig& config)
 	}
 	tigerTree = make_unique<TigerTree>(
 		*this, filesize, filename.getResolved());
+	if (motherBoard.isReplayHelper()) {
+		discardWrites(motherBoard.getDiscardedWritesFlag());
+	}
 
 	(*hdInUse)[id] = true;
 	hdCommand = make_unique<HDCommand>(
@@ -113,6 +113,9 @@ SCSILS120::SCSILS120(const DeviceConfig& targetconfig,
 	}
 	name[2] = char('a' + id);
 	(*lsInUse)[id] = true;
+	if (motherBoard.isReplayHelper()) {
+		discardWrites(motherBoard.getDiscardedWritesFlag());
+	}
 	lsxCommand = make_unique<LSXCommand>(
 		motherBoard.getCommandController(),
 		motherBoard.getStateChangeDistributor(),
@@ -419,8 +422,10 @@ unsigned SCSILS120::writeSector(unsigned& blocks)
 
 	// TODO: somehow map this to SectorAccessibleDisk::writeSector?
 	try {
-		file.seek(SECTOR_SIZE * currentSector);
-		file.write(buffer, SECTOR_SIZE * numSectors);
+		if (!dropWrite()) {
+			file.seek(SECTOR_SIZE * currentSector);
+			file.write(buffer, SECTOR_SIZE * numSectors);
+		}
 		currentSector += numSectors;
 		currentLength -= numSectors;
 
@@ -451,8 +456,10 @@ void SCSILS120::formatUnit()
 	if (getReady() && !checkReadOnly()) {
 		memset(buffer, 0, SECTOR_SIZE);
 		try {
-			file.seek(0);
-			file.write(buffer, SECTOR_SIZE);
+			if (!dropWrite()) {
+				file.seek(0);
+				file.write(buffer, SECTOR_SIZE);
+			}
 			unitAttention = true;
 			mediaChanged = true;
 		} catch (FileException&) {
@@ -4,6 +4,7 @@
 #include "DeviceConfig.hh"
 #include "GlobalSettings.hh"
 #include "StringSetting.hh"
+#include "serialize.hh"
 #include "likely.hh"
 #include <cassert>
 
@@ -21,9 +22,11 @@ CheckedRam::CheckedRam(const DeviceConfig& config, const std::string& name,
 	: completely_initialized_cacheline(size / CacheLine::SIZE, false)
 	, uninitialized(size / CacheLine::SIZE, getBitSetAllTrue())
 	, ram(config, name, description, size)
+	, dirtyPages(size)
 	, msxcpu(config.getMotherBoard().getCPU())
 	, umrCallback(config.getGlobalSettings().getUMRCallBackSetting())
 {
+	ram.setDirtyPages(&dirtyPages);
 	umrCallback.getSetting().attach(*this);
 	init();
 }
@@ -52,8 +55,12 @@ const byte* CheckedRam::getReadCacheLine(unsigned addr) const
 
 byte* CheckedRam::getWriteCacheLine(unsigned addr) const
 {
-	return (completely_initialized_cacheline[addr >> CacheLine::BITS])
-	     ? const_cast<byte*>(&ram[addr]) : nullptr;
+	if (!completely_initialized_cacheline[addr >> CacheLine::BITS]) {
+		return nullptr;
+	}
+	// The CPU writes via this pointer until the cache is invalidated.
+	dirtyPages.mark(addr, CacheLine::SIZE);
+	return const_cast<byte*>(&ram[addr]);
 }
 
 void CheckedRam::write(unsigned addr, const byte value)
@@ -67,11 +74,13 @@ void CheckedRam::write(unsigned addr, const byte value)
 			                          CacheLine::SIZE);
 		}
 	}
+	dirtyPages.mark(addr);
 	ram[addr] = value;
 }
 
 void CheckedRam::clear()
 {
+	dirtyPages.markAll();
 	ram.clear();
 	init();
 }
@@ -102,4 +111,23 @@ void CheckedRam::update(const Setting& setting)
 	init();
 }
 
+template<typename Archive>
+void CheckedRam::serialize(Archive& ar, unsigned /*version*/)
+{
+	if (!tracked) {
+		ar.serialize_blob("ram", &ram[0], getSize());
+		return;
+	}
+	ar.serialize_blob("ram", &ram[0], getSize(), dirtyPages);
+	if (ar.isLoader()) {
+		dirtyPages.markAll();
+	} else if (ar.isReverseSnapshot()) {
+		dirtyPages.clear();
+		// Write cache lines that were handed out before are now clean,
+		// force the CPU to request them again.
+		msxcpu.invalidateMemCache(0x0000, 0x10000);
+	}
+}
+INSTANTIATE_SERIALIZE_METHODS(CheckedRam);
+
 } // namespace openmsx
@@ -2,6 +2,7 @@
 #define CHECKEDRAM_HH
 
 #include "Ram.hh"
+#include "DirtyPages.hh"
 #include "TclCallback.hh"
 #include "CacheLine.hh"
 #include "Observer.hh"
@@ -23,6 +24,11 @@ class Setting;
  * the turboR, only the normal memory mapper runs via CheckedRam. The RAM
  * accessed in DRAM mode or via the ROM mapper are unchecked! Note that there
  * is basically no overhead for using CheckedRam over Ram, thanks to Wouter.
+ *
+ * It also keeps track of the pages that were modified since the previous
+ * reverse snapshot (like TrackedRam). Writes via the CPU cache lines can't be
+ * seen, so a page is marked as soon as a write cache line for it is handed
+ * out, and the CPU cache is flushed after each reverse snapshot.
  */
 class CheckedRam final : private Observer<Setting>
 {
@@ -45,13 +51,15 @@ public:
 	 * Give access to the unchecked Ram. No problem to use it, but there
 	 * will just be no checking done! Keep in mind that you should use this
 	 * consistently, so that the initialized-administration will be always
-	 * up to date!
+	 * up to date! This also disables the dirty page tracking (from now on
+	 * reverse snapshots always compare the full content).
 	 */
-	Ram& getUncheckedRam() { return ram; }
+	Ram& getUncheckedRam() { tracked = false; return ram; }
 
-	// TODO
-	//template<typename Archive>
-	//void serialize(Archive& ar, unsigned version);
+	/** Serializes the content in the same format as Ram (the
+	  * initialized-administration is not serialized). */
+	template<typename Archive>
+	void serialize(Archive& ar, unsigned version);
 
 private:
 	void init();
@@ -62,6 +70,8 @@ private:
 	std::vector<bool> completely_initialized_cacheline;
 	std::vector<std::bitset<CacheLine::SIZE>> uninitialized;
 	Ram ram;
+	mutable DirtyPages dirtyPages; // modified since last reverse snapshot
+	bool tracked = true;
 	MSXCPU& msxcpu;
 	TclCallback umrCallback;
 };
@@ -69,10 +69,19 @@ byte MSXMapperIO::peekIO(word port, EmuTime::param time) const
 
 void MSXMapperIO::writeIO(word port, byte value, EmuTime::param time)
 {
+	// Programs often select the same segment again (e.g. interrupt
+	// handlers that restore the mapper state). Only invalidate the memory
+	// cache when one of the mappers actually switched.
+	byte page = port & 0x03;
+	bool changed = false;
 	for (auto* mapper : mappers) {
+		byte oldSegment = mapper->getSelectedSegment(page);
 		mapper->writeIO(port, value, time);
+		changed |= mapper->getSelectedSegment(page) != oldSegment;
+	}
+	if (changed) {
+		invalidateMemCache(0x4000 * page, 0x4000);
 	}
-	invalidateMemCache(0x4000 * (port & 0x03), 0x4000);
 }
 
 
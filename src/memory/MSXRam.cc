@@ -1,6 +1,5 @@
 #include "MSXRam.hh"
 #include "CheckedRam.hh"
-#include "Ram.hh" // because we serialize Ram instead of CheckedRam
 #include "XMLElement.hh"
 #include "serialize.hh"
 #include "memory.hh"
@@ -74,8 +73,8 @@ template<typename Archive>
 void MSXRam::serialize(Archive& ar, unsigned /*version*/)
 {
 	ar.template serializeBase<MSXDevice>(*this);
-	// TODO ar.serialize("checkedRam", checkedRam);
-	ar.serialize("ram", checkedRam->getUncheckedRam());
+	// Same format as Ram, the tag name is kept for compatibility.
+	ar.serialize("ram", *checkedRam);
 }
 INSTANTIATE_SERIALIZE_METHODS(MSXRam);
 REGISTER_MSXDEVICE(MSXRam, "Ram");
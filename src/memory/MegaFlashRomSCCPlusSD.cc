@@ -912,8 +912,8 @@ void MegaFlashRomSCCPlusSD::serialize(Archive& ar, unsigned /*version*/)
 	}
 
 	// subslot 2 stuff
-	// TODO ar.serialize("checkedRam", checkedRam);
-	if (checkedRam) ar.serialize("ram", checkedRam->getUncheckedRam());
+	// Same format as Ram, the tag name is kept for compatibility.
+	if (checkedRam) ar.serialize("ram", *checkedRam);
 	ar.serialize("memMapperRegs", memMapperRegs);
 
 	// subslot 3 stuff
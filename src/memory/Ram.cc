@@ -22,6 +22,8 @@ public:
 	              const string& description, Ram& ram);
 	byte read(unsigned address) override;
 	void write(unsigned address, byte value) override;
+	void readBlock(unsigned start, byte* output, unsigned num) override;
+	void writeBlock(unsigned start, const byte* input, unsigned num) override;
 private:
 	Ram& ram;
 };
@@ -108,9 +110,21 @@ byte RamDebuggable::read(unsigned address)
 
 void RamDebuggable::write(unsigned address, byte value)
 {
+	ram.markDirty(address, 1);
 	ram[address] = value;
 }
 
+void RamDebuggable::readBlock(unsigned start, byte* output, unsigned num)
+{
+	memcpy(output, &ram[start], num);
+}
+
+void RamDebuggable::writeBlock(unsigned start, const byte* input, unsigned num)
+{
+	ram.markDirty(start, num);
+	memcpy(&ram[start], input, num);
+}
+
 
 template<typename Archive>
 void Ram::serialize(Archive& ar, unsigned /*version*/)
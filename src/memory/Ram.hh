@@ -2,6 +2,7 @@
 #define RAM_HH
 
 #include "MemBuffer.hh"
+#include "DirtyPages.hh"
 #include "openmsx.hh"
 #include <string>
 #include <memory>
@@ -37,6 +38,13 @@ public:
 	const std::string& getName() const;
 	void clear(byte c = 0xff);
 
+	/** The owner can keep track of the modified pages (see TrackedRam and
+	  * CheckedRam), also mark the pages written via the debuggable. */
+	void setDirtyPages(DirtyPages* dirty) { dirtyPages = dirty; }
+	void markDirty(unsigned addr, unsigned num) {
+		if (dirtyPages) dirtyPages->mark(addr, num);
+	}
+
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -45,6 +53,7 @@ private:
 	MemBuffer<byte> ram;
 	unsigned size; // must come before debuggable
 	const std::unique_ptr<RamDebuggable> debuggable; // can be nullptr
+	DirtyPages* dirtyPages = nullptr;
 };
 
 } // namespace openmsx
@@ -36,6 +36,8 @@ public:
 	const std::string& getDescription() const override;
 	byte read(unsigned address) override;
 	void write(unsigned address, byte value) override;
+	void readBlock(unsigned start, byte* output, unsigned num) override;
+	void writeBlock(unsigned start, const byte* input, unsigned num) override;
 	void moved(Rom& r);
 private:
 	Debugger& debugger;
@@ -415,6 +417,18 @@ void RomDebuggable::write(unsigned /*address*/, byte /*value*/)
 	// ignore
 }
 
+void RomDebuggable::readBlock(unsigned start, byte* output, unsigned num)
+{
+	assert((start + num) <= getSize());
+	memcpy(output, &(*rom)[start], num);
+}
+
+void RomDebuggable::writeBlock(unsigned /*start*/, const byte* /*input*/,
+                               unsigned /*num*/)
+{
+	// ignore
+}
+
 void RomDebuggable::moved(Rom& r)
 {
 	rom = &r;
@@ -65,8 +65,14 @@ void RomAscii16_2::writeMem(word address, byte value, EmuTime::param /*time*/)
 			invalidateMemCache(0x4000 * region, 0x4000);
 		} else {
 			// ROM block
-			setRom(region, value);
+			bool wasSram = (sramEnabled & (1 << region)) != 0;
 			sramEnabled &= ~(1 << region);
+			setRom(region, value);
+			if (wasSram) {
+				// setRom() only refills the read cache, but
+				// getWriteCacheLine() depends on sramEnabled.
+				invalidateMemCache(0x4000 * region, 0x4000);
+			}
 		}
 	} else {
 		// write sram
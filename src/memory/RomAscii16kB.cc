@@ -16,6 +16,7 @@ namespace openmsx {
 RomAscii16kB::RomAscii16kB(const DeviceConfig& config, Rom&& rom_)
 	: Rom16kBBlocks(config, std::move(rom_))
 {
+	enableReadCacheFill();
 	reset(EmuTime::dummy());
 }
 
@@ -17,6 +17,7 @@ namespace openmsx {
 RomAscii8kB::RomAscii8kB(const DeviceConfig& config, Rom&& rom_)
 	: Rom8kBBlocks(config, std::move(rom_))
 {
+	enableReadCacheFill();
 	reset(EmuTime::dummy());
 }
 
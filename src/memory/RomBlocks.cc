@@ -49,6 +49,7 @@ RomBlocks<BANK_SIZE>::RomBlocks(
 
 	// Default mask: wraps at end of ROM image.
 	blockMask = nrBlocks - 1;
+	readCacheFill = false;
 	for (unsigned i = 0; i < NUM_BANKS; i++) {
 		setRom(i, 0);
 	}
@@ -86,7 +87,11 @@ void RomBlocks<BANK_SIZE>::setBank(byte region, const byte* adr, int block)
 	        ((extraMem <= adr) && (adr <= &extraMem[extraSize - 1]))));
 	bankPtr[region] = adr;
 	blockNr[region] = block; // only for debuggable
-	invalidateMemCache(region * BANK_SIZE, BANK_SIZE);
+	if (readCacheFill) {
+		fillMemReadCache(region * BANK_SIZE, BANK_SIZE, adr);
+	} else {
+		invalidateMemCache(region * BANK_SIZE, BANK_SIZE);
+	}
 }
 
 template <unsigned BANK_SIZE>
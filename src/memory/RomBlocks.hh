@@ -78,6 +78,18 @@ protected:
 	 */
 	void setExtraMemory(const byte* mem, unsigned size);
 
+	/** Bank switches directly update the CPU read cache instead of
+	 * invalidating the CPU cache for that region (much cheaper for
+	 * mappers that switch banks very often).
+	 * Should only be called from subclass constructor, and only when:
+	 * - reads return the selected bank (apart from regions that the
+	 *   subclass itself invalidates again after a bank switch), and
+	 * - getWriteCacheLine() doesn't depend on the selected banks (or
+	 *   the subclass invalidates the CPU cache itself when it does,
+	 *   e.g. RomAscii16_2 when switching from SRAM back to ROM).
+	 */
+	void enableReadCacheFill() { readCacheFill = true; }
+
 	const byte* bankPtr[NUM_BANKS];
 	std::unique_ptr<SRAM> sram; // can be nullptr
 	byte blockNr[NUM_BANKS];
@@ -88,6 +100,7 @@ private:
 	unsigned extraSize;
 	/*const*/ int nrBlocks;
 	int blockMask;
+	bool readCacheFill;
 };
 
 using Rom4kBBlocks  = RomBlocks<0x1000>;
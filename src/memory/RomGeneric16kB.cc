@@ -6,6 +6,7 @@ namespace openmsx {
 RomGeneric16kB::RomGeneric16kB(const DeviceConfig& config, Rom&& rom_)
 	: Rom16kBBlocks(config, std::move(rom_))
 {
+	enableReadCacheFill();
 	reset(EmuTime::dummy());
 }
 
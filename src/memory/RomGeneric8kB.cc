@@ -6,6 +6,7 @@ namespace openmsx {
 RomGeneric8kB::RomGeneric8kB(const DeviceConfig& config, Rom&& rom_)
 	: Rom8kBBlocks(config, std::move(rom_))
 {
+	enableReadCacheFill();
 	reset(EmuTime::dummy());
 }
 
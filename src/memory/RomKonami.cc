@@ -19,6 +19,8 @@ namespace openmsx {
 RomKonami::RomKonami(const DeviceConfig& config, Rom&& rom_)
 	: Rom8kBBlocks(config, std::move(rom_))
 {
+	enableReadCacheFill();
+
 	// Konami mapper is 256kB in size, even if ROM is smaller.
 	setBlockMask(31);
 
@@ -27,6 +27,9 @@ RomKonamiSCC::RomKonamiSCC(const DeviceConfig& config, Rom&& rom_)
 	: Rom8kBBlocks(config, std::move(rom_))
 	, scc("SCC", config, getCurrentTime())
 {
+	// (the SCC area is excluded again in writeMem())
+	enableReadCacheFill();
+
 	// warn if a ROM is used that would not work on a real KonamiSCC mapper
 	if ((rom.getSize() > 512 * 1024) && alreadyWarnedForSha1Sum != rom.getOriginalSHA1()) {
 		getMotherBoard().getMSXCliComm().printWarning(
@@ -104,6 +107,11 @@ void RomKonamiSCC::writeMem(word address, byte value, EmuTime::param time)
 	if ((address & 0x1800) == 0x1000) {
 		// page selection
 		setRom(address >> 13, value);
+		if (sccEnabled && ((address >> 13) == 4)) {
+			// the bank switch filled the read cache for the
+			// whole region, but the SCC isn't cacheable
+			fillMemReadCache(0x9800, 0x0800, nullptr);
+		}
 	}
 }
 
@@ -5,7 +5,9 @@
 #include "FileException.hh"
 #include "FileNotFoundException.hh"
 #include "Reactor.hh"
+#include "MSXMotherBoard.hh"
 #include "CliComm.hh"
+#include "Thread.hh"
 #include "serialize.hh"
 #include "openmsx.hh"
 #include "vla.hh"
@@ -23,6 +25,7 @@ namespace openmsx {
 SRAM::SRAM(int size, const XMLElement& xml, DontLoad)
 	: ram(xml, size)
 	, header(nullptr) // not used
+	, saveRequested(false)
 {
 }
 
@@ -34,25 +37,38 @@ SRAM::SRAM(const std::string& name, const std::string& description,
            int size, const DeviceConfig& config_, DontLoad)
 	: ram(config_, name, description, size)
 	, header(nullptr) // not used
+	, saveRequested(false)
 {
 }
 
+// The helper machine that recreates reverse snapshots must not write to the
+// SRAM file (see MSXMotherBoard::setReplayHelper()).
+std::unique_ptr<SRAM::SRAMSchedulable> SRAM::createSchedulable(
+	const DeviceConfig& config)
+{
+	if (config.getMotherBoard().isReplayHelper()) return nullptr;
+	return make_unique<SRAMSchedulable>(
+		config.getReactor().getRTScheduler(), *this);
+}
+
 SRAM::SRAM(const string& name, int size,
            const DeviceConfig& config_, const char* header_, bool* loaded)
-	: schedulable(make_unique<SRAMSchedulable>(config_.getReactor().getRTScheduler(), *this))
+	: schedulable(createSchedulable(config_))
 	, config(config_)
 	, ram(config, name, "sram", size)
 	, header(header_)
+	, saveRequested(false)
 {
 	load(loaded);
 }
 
 SRAM::SRAM(const string& name, const string& description, int size,
 	   const DeviceConfig& config_, const char* header_, bool* loaded)
-	: schedulable(make_unique<SRAMSchedulable>(config_.getReactor().getRTScheduler(), *this))
+	: schedulable(createSchedulable(config_))
 	, config(config_)
 	, ram(config, name, description, size)
 	, header(header_)
+	, saveRequested(false)
 {
 	load(loaded);
 }
@@ -66,20 +82,34 @@ SRAM::~SRAM()
 
 void SRAM::write(unsigned addr, byte value)
 {
-	if (schedulable && !schedulable->isPendingRT()) {
-		schedulable->scheduleRT(5000000); // sync to disk after 5s
-	}
+	scheduleSave();
 	assert(addr < getSize());
 	ram.write(addr, value);
 }
 
 void SRAM::memset(unsigned addr, byte c, unsigned size)
 {
-	if (schedulable && !schedulable->isPendingRT()) {
+	scheduleSave();
+	assert((addr + size) <= getSize());
+	::memset(ram.getWriteBackdoor(addr, size), c, size);
+}
+
+void SRAM::scheduleSave()
+{
+	if (!schedulable) return;
+	if (!Thread::isMainThread()) {
+		// The RTScheduler can only be used from the main thread.
+		if (!saveRequested.exchange(true)) {
+			config.getReactor().invokeInMainThread([this] {
+				saveRequested = false;
+				scheduleSave();
+			});
+		}
+		return;
+	}
+	if (!schedulable->isPendingRT()) {
 		schedulable->scheduleRT(5000000); // sync to disk after 5s
 	}
-	assert((addr + size) <= getSize());
-	::memset(ram.getWriteBackdoor() + addr, c, size);
 }
 
 void SRAM::load(bool* loaded)
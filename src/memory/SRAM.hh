@@ -4,6 +4,7 @@
 #include "TrackedRam.hh"
 #include "DeviceConfig.hh"
 #include "RTSchedulable.hh"
+#include <atomic>
 #include <memory>
 
 namespace openmsx {
@@ -50,6 +51,9 @@ private:
 	};
 	std::unique_ptr<SRAMSchedulable> schedulable;
 
+	std::unique_ptr<SRAMSchedulable> createSchedulable(
+		const DeviceConfig& config);
+	void scheduleSave();
 	void load(bool* loaded);
 	void save();
 
@@ -58,6 +62,10 @@ private:
 	const char* const header;
 
 	std::string loadedFilename;
+
+	// A worker thread (see Reactor::runMachines()) asked the main thread
+	// to schedule a save.
+	std::atomic<bool> saveRequested;
 };
 
 } // namespace openmsx
@@ -2,6 +2,7 @@
 #define TRACKED_RAM_HH
 
 #include "Ram.hh"
+#include "DirtyPages.hh"
 
 namespace openmsx {
 
@@ -12,10 +13,18 @@ public:
 	// Most methods simply delegate to the internal 'ram' object.
 	TrackedRam(const DeviceConfig& config, const std::string& name,
 	           const std::string& description, unsigned size)
-		: ram(config, name, description, size) {}
+		: ram(config, name, description, size)
+		, dirtyPages(size)
+	{
+		ram.setDirtyPages(&dirtyPages);
+	}
 
 	TrackedRam(const XMLElement& xml, unsigned size)
-		: ram(xml, size) {}
+		: ram(xml, size)
+		, dirtyPages(size)
+	{
+		ram.setDirtyPages(&dirtyPages);
+	}
 
 	unsigned getSize() const {
 		return ram.getSize();
@@ -36,12 +45,12 @@ public:
 
 	// Only allow write/clear via an explicit method.
 	void write(unsigned addr, byte value) {
-		writeSinceLastReverseSnapshot = true;
+		dirtyPages.mark(addr);
 		ram[addr] = value;
 	}
 
 	void clear(byte c = 0xff) {
-		writeSinceLastReverseSnapshot = true;
+		dirtyPages.markAll();
 		ram.clear(c);
 	}
 
@@ -50,16 +59,23 @@ public:
 	// invocation, so the resulting pointer (although the same each time)
 	// should not be reused for multiple (distinct) bulk write operations.
 	byte* getWriteBackdoor() {
-		writeSinceLastReverseSnapshot = true;
+		dirtyPages.markAll();
 		return &ram[0];
 	}
 
+	// Like above, but only the range [addr, addr + size) is marked as
+	// dirty (and may be written via the returned pointer).
+	byte* getWriteBackdoor(unsigned addr, unsigned size) {
+		dirtyPages.mark(addr, size);
+		return &ram[addr];
+	}
+
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
 private:
 	Ram ram;
-	bool writeSinceLastReverseSnapshot = true;
+	DirtyPages dirtyPages; // modified since last reverse snapshot
 };
 
 } // namespace openmsx
@@ -6,11 +6,15 @@
 #include "ConfigException.hh"
 #include "XMLException.hh"
 #include "DeltaBlock.hh"
+#include "DirtyPages.hh"
 #include "MemBuffer.hh"
 #include "StringOp.hh"
 #include "FileOperations.hh"
 #include "Version.hh"
 #include "Date.hh"
+#include "MSXException.hh"
+#include "snappy.hh"
+#include "build-info.hh"
 #include "cstdiop.hh" // for dup()
 #include <cstring>
 #include <limits>
@@ -233,6 +237,24 @@ void MemOutputArchive::serialize_blob(const char*, const void* data, size_t len,
 
 }
 
+void MemOutputArchive::serialize_blob(const char* tag, const void* data,
+                                      size_t len, const DirtyPages& dirty)
+{
+	if (!reverseSnapshot || (len <= SMALL_SIZE)) {
+		// The dirty info is relative to the previous reverse snapshot,
+		// it can't be used for other archives.
+		serialize_blob(tag, data, len);
+		return;
+	}
+	unsigned deltaBlockIdx = unsigned(deltaBlocks.size());
+	save(deltaBlockIdx); // see comment below in MemInputArchive
+	deltaBlocks.push_back(dirty.any()
+		? lastDeltaBlocks.createNew(
+			data, static_cast<const uint8_t*>(data), len, &dirty)
+		: lastDeltaBlocks.createNullDiff(
+			data, static_cast<const uint8_t*>(data), len));
+}
+
 void MemInputArchive::serialize_blob(const char*, void* data, size_t len, bool /*diff*/)
 {
 	if (len > SMALL_SIZE) {
@@ -542,4 +564,323 @@ int XmlInputArchive::countChildren() const
 	return int(elems.back().first->getChildren().size());
 }
 
+////
+
+// Layout of a binary savestate file:
+//  - header: the magic string, format version, host properties (endianess,
+//    size of 'long' and 'size_t') and the openMSX version, date and platform
+//    (as strings, each prefixed with a 32-bit length).
+//  - a sequence of blocks, each block is:
+//      uint32 raw size (0 marks the end of the stream)
+//      uint32 stored size (equal to the raw size for uncompressed blocks)
+//      uint32 adler32 checksum of the stored data
+//      the stored (possibly snappy compressed) data
+static const char BIN_MAGIC[] = "openMSX-bin-state";
+static const size_t BIN_MAGIC_SIZE = sizeof(BIN_MAGIC) - 1;
+static const uint8_t BIN_FORMAT_VERSION = 1;
+static const uint32_t BIN_MAX_BLOCK_SIZE = 64 * 1024 * 1024; // sanity check
+
+static void writeBinString(File& file, const string& str)
+{
+	auto len = uint32_t(str.size());
+	file.write(&len, sizeof(len));
+	file.write(str.data(), len);
+}
+
+void BinOutputArchive::writeHeader(File& file, string_ref magic)
+{
+	file.write(magic.data(), magic.size());
+	uint8_t props[4] = {
+		BIN_FORMAT_VERSION,
+		OPENMSX_BIGENDIAN ? uint8_t(1) : uint8_t(0),
+		uint8_t(sizeof(long)),
+		uint8_t(sizeof(size_t)),
+	};
+	file.write(props, sizeof(props));
+	writeBinString(file, Version::full());
+	writeBinString(file, Date::toString(time(nullptr)));
+	writeBinString(file, TARGET_PLATFORM);
+}
+
+BinOutputArchive::BinOutputArchive(const string& filename)
+	: ownFile(filename, "wb")
+	, file(ownFile)
+{
+	writeHeader(file, string_ref(BIN_MAGIC, BIN_MAGIC_SIZE));
+	staging.reserve(BLOCK_SIZE + BLOCK_SIZE / 4);
+}
+
+BinOutputArchive::BinOutputArchive(File& file_)
+	: file(file_)
+{
+	staging.reserve(BLOCK_SIZE + BLOCK_SIZE / 4);
+}
+
+BinOutputArchive::~BinOutputArchive()
+{
+	// Only possible when serialization was aborted by an exception. The
+	// file is incomplete anyway (it lacks the end marker).
+	if (!openSections.empty()) return;
+
+	// Like in XmlOutputArchive, errors can't be reported from here. Though
+	// (because data is streamed) most errors are already reported earlier.
+	try {
+		flush();
+		uint32_t end[3] = { 0, 0, 0 };
+		file.write(end, sizeof(end));
+	} catch (MSXException&) {
+		// ignore
+	}
+}
+
+void BinOutputArchive::save(const string& s)
+{
+	auto size = uint32_t(s.size());
+	save(size);
+	put(s.data(), size);
+}
+
+void BinOutputArchive::serialize_blob(const char*, const void* data, size_t len,
+                                      bool /*diff*/)
+{
+	if ((len < BLOCK_SIZE) || !openSections.empty()) {
+		put(data, len);
+		return;
+	}
+	// Big blobs (e.g. RAM) are compressed directly from the source buffer.
+	flush();
+	auto* p = static_cast<const byte*>(data);
+	while (len) {
+		size_t chunk = std::min<size_t>(len, BLOCK_SIZE);
+		writeBlock(p, chunk);
+		p   += chunk;
+		len -= chunk;
+	}
+}
+
+void BinOutputArchive::beginSection()
+{
+	uint64_t skip = 0; // filled in later
+	save(skip);
+	openSections.push_back(staging.size());
+}
+
+void BinOutputArchive::endSection()
+{
+	assert(!openSections.empty());
+	size_t beginPos = openSections.back();
+	openSections.pop_back();
+	uint64_t skip = staging.size() - beginPos;
+	memcpy(&staging[beginPos - sizeof(skip)], &skip, sizeof(skip));
+	if ((staging.size() >= BLOCK_SIZE) && openSections.empty()) {
+		flush();
+	}
+}
+
+void BinOutputArchive::flush()
+{
+	assert(openSections.empty());
+	if (staging.empty()) return;
+	writeBlock(staging.data(), staging.size());
+	staging.clear();
+}
+
+void BinOutputArchive::writeBlock(const byte* data, size_t len)
+{
+	assert(len && (len <= BIN_MAX_BLOCK_SIZE));
+	size_t maxLen = snappy::maxCompressedLength(len);
+	compressed.resize(maxLen);
+	size_t compLen = maxLen;
+	snappy::compress(reinterpret_cast<const char*>(data), len,
+	                 compressed.data(), compLen);
+	const void* stored = compressed.data();
+	if (compLen >= len) {
+		// compression isn't beneficial
+		stored = data;
+		compLen = len;
+	}
+	uint32_t header[3] = {
+		uint32_t(len),
+		uint32_t(compLen),
+		uint32_t(adler32(adler32(0, nullptr, 0),
+		                 static_cast<const Bytef*>(stored), uInt(compLen))),
+	};
+	file.write(header, sizeof(header));
+	file.write(stored, compLen);
+}
+
+////
+
+static void binFormatError(const string& msg)
+{
+	throw MSXException("Bad binary savestate: " + msg);
+}
+
+bool BinInputArchive::isBinArchive(const string& filename)
+{
+	return hasMagic(filename, string_ref(BIN_MAGIC, BIN_MAGIC_SIZE));
+}
+
+bool BinInputArchive::hasMagic(const string& filename, string_ref magic)
+{
+	try {
+		File file(filename, "rb");
+		if (file.getSize() < magic.size()) return false;
+		string buf(magic.size(), '\0');
+		file.read(&buf[0], buf.size());
+		return buf == magic;
+	} catch (MSXException&) {
+		return false;
+	}
+}
+
+size_t BinInputArchive::checkHeader(const byte* data, size_t size,
+                                    string_ref magic)
+{
+	const byte* pos = data;
+	const byte* end = data + size;
+	auto readHeader = [&](void* dst, size_t len) {
+		if (size_t(end - pos) < len) {
+			binFormatError("file truncated");
+		}
+		memcpy(dst, pos, len);
+		pos += len;
+	};
+	auto skipString = [&]() {
+		uint32_t len;
+		readHeader(&len, sizeof(len));
+		if (size_t(end - pos) < len) {
+			binFormatError("file truncated");
+		}
+		pos += len;
+	};
+
+	if ((size < magic.size()) ||
+	    (memcmp(data, magic.data(), magic.size()) != 0)) {
+		binFormatError("wrong file type");
+	}
+	pos += magic.size();
+	uint8_t props[4];
+	readHeader(props, sizeof(props));
+	if (props[0] != BIN_FORMAT_VERSION) {
+		binFormatError("unsupported format version");
+	}
+	if ((props[1] != (OPENMSX_BIGENDIAN ? 1 : 0)) ||
+	    (props[2] != sizeof(long)) ||
+	    (props[3] != sizeof(size_t))) {
+		binFormatError("it was created on an incompatible platform, "
+		               "use an XML savestate instead");
+	}
+	skipString(); // openMSX version
+	skipString(); // date/time
+	skipString(); // platform
+	return pos - data;
+}
+
+BinInputArchive::BinInputArchive(const string& filename)
+	: file(filename, "rb")
+	, blockPos(nullptr)
+	, blockEnd(nullptr)
+{
+	size_t size;
+	filePos = file.mmap(size);
+	fileEnd = filePos + size;
+	filePos += checkHeader(filePos, size,
+	                       string_ref(BIN_MAGIC, BIN_MAGIC_SIZE));
+}
+
+BinInputArchive::BinInputArchive(const byte* data, size_t size)
+	: filePos(data)
+	, fileEnd(data + size)
+	, blockPos(nullptr)
+	, blockEnd(nullptr)
+{
+}
+
+void BinInputArchive::nextBlock()
+{
+	uint32_t header[3];
+	if (size_t(fileEnd - filePos) < sizeof(header)) {
+		binFormatError("file truncated");
+	}
+	memcpy(header, filePos, sizeof(header));
+	filePos += sizeof(header);
+	uint32_t rawLen    = header[0];
+	uint32_t storedLen = header[1];
+	if (rawLen == 0) {
+		binFormatError("unexpected end of data");
+	}
+	if ((rawLen > BIN_MAX_BLOCK_SIZE) || (storedLen > rawLen) ||
+	    (size_t(fileEnd - filePos) < storedLen)) {
+		binFormatError("corrupt block header");
+	}
+	// The checksum only detects accidental corruption (e.g. a damaged
+	// file). It's trivial to forge, so the decompression itself must
+	// still validate its input.
+	auto sum = uint32_t(adler32(adler32(0, nullptr, 0),
+	                            filePos, uInt(storedLen)));
+	if (sum != header[2]) {
+		binFormatError("checksum mismatch");
+	}
+
+	block.resize(rawLen);
+	if (storedLen == rawLen) {
+		memcpy(block.data(), filePos, rawLen);
+	} else if (!snappy::uncompressChecked(
+			reinterpret_cast<const char*>(filePos), storedLen,
+			reinterpret_cast<char*>(block.data()), rawLen)) {
+		binFormatError("corrupt compressed block");
+	}
+	filePos += storedLen;
+	blockPos = block.data();
+	blockEnd = blockPos + rawLen;
+}
+
+void BinInputArchive::getSlow(byte* data, size_t len)
+{
+	while (len) {
+		if (blockPos == blockEnd) nextBlock();
+		size_t chunk = std::min<size_t>(len, blockEnd - blockPos);
+		memcpy(data, blockPos, chunk);
+		blockPos += chunk;
+		data     += chunk;
+		len      -= chunk;
+	}
+}
+
+void BinInputArchive::skip(size_t len)
+{
+	while (len) {
+		if (blockPos == blockEnd) nextBlock();
+		size_t chunk = std::min<size_t>(len, blockEnd - blockPos);
+		blockPos += chunk;
+		len      -= chunk;
+	}
+}
+
+void BinInputArchive::load(string& s)
+{
+	uint32_t size;
+	load(size);
+	s.resize(size);
+	if (size) {
+		get(&s[0], size);
+	}
+}
+
+void BinInputArchive::serialize_blob(const char*, void* data, size_t len,
+                                     bool /*diff*/)
+{
+	get(data, len);
+}
+
+void BinInputArchive::skipSection(bool doSkip)
+{
+	uint64_t num;
+	load(num);
+	if (doSkip) {
+		skip(num);
+	}
+}
+
 } // namespace openmsx
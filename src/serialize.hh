@@ -4,9 +4,11 @@
 #include "serialize_core.hh"
 #include "SerializeBuffer.hh"
 #include "XMLElement.hh"
+#include "File.hh"
 #include "MemBuffer.hh"
 #include "StringOp.hh"
 #include "inline.hh"
+#include "likely.hh"
 #include "unreachable.hh"
 #include <zlib.h>
 #include <string>
@@ -22,6 +24,7 @@ namespace openmsx {
 
 class LastDeltaBlocks;
 class DeltaBlock;
+class DirtyPages;
 
 template<typename T> struct SerializeClassVersion;
 
@@ -135,6 +138,15 @@ public:
 	//   type).
 	//
 	//
+	// void serialize_blob(const char* tag, const void* data, size_t len,
+	//                     const DirtyPages& dirty)
+	//
+	//   Like above, but additionally tells which pages of the blob were
+	//   modified since the previous reverse snapshot. Memory archives use
+	//   this to only copy and compare those pages, all other archives
+	//   ignore this information.
+	//
+	//
 	// template<typename T> void serialize(const char* tag, const T& t)
 	//
 	//   This is much like the serializeWithID() method above, but it doesn't
@@ -439,6 +451,11 @@ public:
 	// the resulting string. But memory archives will memcpy the blob.
 	void serialize_blob(const char* tag, const void* data, size_t len,
 	                    bool diff = true);
+	void serialize_blob(const char* tag, const void* data, size_t len,
+	                    const DirtyPages& /*dirty*/)
+	{
+		this->self().serialize_blob(tag, data, len);
+	}
 
 	template<typename T> void serialize(const char* tag, const T& t)
 	{
@@ -534,6 +551,11 @@ public:
 	}
 	void serialize_blob(const char* tag, void* data, size_t len,
 	                    bool diff = true);
+	void serialize_blob(const char* tag, void* data, size_t len,
+	                    const DirtyPages& /*dirty*/)
+	{
+		this->self().serialize_blob(tag, data, len);
+	}
 
 	template<typename T>
 	void serialize(const char* tag, T& t)
@@ -624,6 +646,8 @@ public:
 	void save(const std::string& s);
 	void serialize_blob(const char*, const void* data, size_t len,
 	                    bool diff = true);
+	void serialize_blob(const char*, const void* data, size_t len,
+	                    const DirtyPages& dirty);
 
 	void beginSection()
 	{
@@ -692,6 +716,11 @@ public:
 	string_ref loadStr();
 	void serialize_blob(const char*, void* data, size_t len,
 	                    bool diff = true);
+	void serialize_blob(const char* tag, void* data, size_t len,
+	                    const DirtyPages& /*dirty*/)
+	{
+		serialize_blob(tag, data, len);
+	}
 
 	void skipSection(bool skip)
 	{
@@ -837,11 +866,167 @@ private:
 	std::vector<std::pair<const XMLElement*, size_t>> elems;
 };
 
+////
+
+/** Binary savestate files.
+  *
+  * Unlike the XML archives, no intermediate (XML) tree is build in memory.
+  * The data is stored much like in the memory archives (so without tag
+  * names), but in addition with version information and enums as strings
+  * (so it can be loaded by later openMSX versions). The stream is split in
+  * blocks that are compressed with snappy and written to disk as soon as
+  * they're full.
+  *
+  * Primitive types are stored in the native format of the host, so these
+  * files can only be loaded on a host with the same endianess and data type
+  * sizes (this is checked while loading). For portable savestates use the
+  * XML archives.
+  */
+class BinOutputArchive final : public OutputArchiveBase<BinOutputArchive>
+{
+public:
+	/** Create a binary savestate file. */
+	explicit BinOutputArchive(const std::string& filename);
+
+	/** Append a stream of blocks (without file header) at the current
+	  * position of an already opened file. This is used to combine several
+	  * streams in one container file, see ReplayFile. */
+	explicit BinOutputArchive(File& file);
+
+	~BinOutputArchive();
+
+	/** Write a file header (with the given magic string) like the one
+	  * at the start of a binary savestate. */
+	static void writeHeader(File& file, string_ref magic);
+
+	template <typename T> void save(const T& t)
+	{
+		put(&t, sizeof(t));
+	}
+	inline void saveChar(char c)
+	{
+		save(c);
+	}
+	void save(const std::string& s);
+	void serialize_blob(const char*, const void* data, size_t len,
+	                    bool diff = true);
+	void serialize_blob(const char* tag, const void* data, size_t len,
+	                    const DirtyPages& /*dirty*/)
+	{
+		serialize_blob(tag, data, len);
+	}
+
+	void beginSection();
+	void endSection();
+
+//internal:
+	inline bool translateEnumToString() const { return true; }
+
+private:
+	void put(const void* data, size_t len)
+	{
+		if (len) {
+			auto* p = static_cast<const byte*>(data);
+			staging.insert(staging.end(), p, p + len);
+			if ((staging.size() >= BLOCK_SIZE) &&
+			    openSections.empty()) {
+				flush();
+			}
+		}
+	}
+	void flush();
+	void writeBlock(const byte* data, size_t len);
+
+	static const size_t BLOCK_SIZE = 256 * 1024;
+
+	File ownFile;
+	File& file;
+	std::vector<byte> staging;
+	std::vector<size_t> openSections;
+	MemBuffer<char> compressed;
+};
+
+class BinInputArchive final : public InputArchiveBase<BinInputArchive>
+{
+public:
+	explicit BinInputArchive(const std::string& filename);
+
+	/** Read a stream of blocks (without file header) from memory. The
+	  * memory must remain valid during the lifetime of this archive. */
+	BinInputArchive(const byte* data, size_t size);
+
+	/** Does the given file look like a binary savestate? */
+	static bool isBinArchive(const std::string& filename);
+
+	/** Does the given file start with the given magic string? */
+	static bool hasMagic(const std::string& filename, string_ref magic);
+
+	/** Verify a file header written by BinOutputArchive::writeHeader().
+	  * Returns the size of the header.
+	  * @throw MSXException when it's not a valid header. */
+	static size_t checkHeader(const byte* data, size_t size,
+	                          string_ref magic);
+
+	inline bool versionAtLeast(unsigned actual, unsigned required) const
+	{
+		return actual >= required;
+	}
+	inline bool versionBelow(unsigned actual, unsigned required) const
+	{
+		return actual < required;
+	}
+
+	template<typename T> void load(T& t)
+	{
+		get(&t, sizeof(t));
+	}
+	inline void loadChar(char& c)
+	{
+		load(c);
+	}
+	void load(std::string& s);
+	void serialize_blob(const char*, void* data, size_t len,
+	                    bool diff = true);
+	void serialize_blob(const char* tag, void* data, size_t len,
+	                    const DirtyPages& /*dirty*/)
+	{
+		serialize_blob(tag, data, len);
+	}
+
+	void skipSection(bool skip);
+
+//internal:
+	inline bool translateEnumToString() const { return true; }
+
+private:
+	void get(void* data, size_t len)
+	{
+		if (likely(len <= size_t(blockEnd - blockPos))) {
+			memcpy(data, blockPos, len);
+			blockPos += len;
+		} else {
+			getSlow(static_cast<byte*>(data), len);
+		}
+	}
+	void getSlow(byte* data, size_t len);
+	void skip(size_t len);
+	void nextBlock();
+
+	File file;
+	const byte* filePos;
+	const byte* fileEnd;
+	MemBuffer<byte> block;
+	const byte* blockPos;
+	const byte* blockEnd;
+};
+
 #define INSTANTIATE_SERIALIZE_METHODS(CLASS) \
 template void CLASS::serialize(MemInputArchive&,   unsigned); \
 template void CLASS::serialize(MemOutputArchive&,  unsigned); \
 template void CLASS::serialize(XmlInputArchive&,   unsigned); \
-template void CLASS::serialize(XmlOutputArchive&,  unsigned);
+template void CLASS::serialize(XmlOutputArchive&,  unsigned); \
+template void CLASS::serialize(BinInputArchive&,   unsigned); \
+template void CLASS::serialize(BinOutputArchive&,  unsigned);
 
 } // namespace openmsx
 
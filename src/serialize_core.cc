@@ -49,4 +49,17 @@ unsigned loadVersionHelper(XmlInputArchive& ar, const char* className,
 	return version;
 }
 
+unsigned loadVersionHelper(BinInputArchive& ar, const char* className,
+                           unsigned latestVersion)
+{
+	// Binary archives can't have optional attributes, so the version is
+	// always present.
+	unsigned version;
+	ar.attribute("version", version);
+	if (unlikely(version > latestVersion)) {
+		versionError(className, latestVersion, version);
+	}
+	return version;
+}
+
 } // namespace openmsx
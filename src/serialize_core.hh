@@ -497,6 +497,8 @@ unsigned loadVersionHelper(MemInputArchive& ar, const char* className,
                            unsigned latestVersion);
 unsigned loadVersionHelper(XmlInputArchive& ar, const char* className,
                            unsigned latestVersion);
+unsigned loadVersionHelper(BinInputArchive& ar, const char* className,
+                           unsigned latestVersion);
 template<typename T, typename Archive> unsigned loadVersion(Archive& ar)
 {
 	unsigned latestVersion = SerializeClassVersion<T>::value;
@@ -56,6 +56,7 @@ void PolymorphicSaverRegistry<Archive>::save(
 
 template class PolymorphicSaverRegistry<MemOutputArchive>;
 template class PolymorphicSaverRegistry<XmlOutputArchive>;
+template class PolymorphicSaverRegistry<BinOutputArchive>;
 
 ////
 
@@ -89,6 +90,7 @@ void* PolymorphicLoaderRegistry<Archive>::load(
 
 template class PolymorphicLoaderRegistry<MemInputArchive>;
 template class PolymorphicLoaderRegistry<XmlInputArchive>;
+template class PolymorphicLoaderRegistry<BinInputArchive>;
 
 ////
 
@@ -135,5 +137,6 @@ void PolymorphicInitializerRegistry<Archive>::init(
 
 template class PolymorphicInitializerRegistry<MemInputArchive>;
 template class PolymorphicInitializerRegistry<XmlInputArchive>;
+template class PolymorphicInitializerRegistry<BinInputArchive>;
 
 } // namespace openmsx
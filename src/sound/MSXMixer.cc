@@ -11,6 +11,8 @@
 #include "BooleanSetting.hh"
 #include "CommandException.hh"
 #include "AviRecorder.hh"
+#include "WorkerPool.hh"
+#include "HostProfiler.hh"
 #include "Filename.hh"
 #include "CliComm.hh"
 #include "Math.hh"
@@ -43,12 +45,14 @@ MSXMixer::MSXMixer(Mixer& mixer_, MSXMotherBoard& motherBoard_,
 	, motherBoard(motherBoard_)
 	, commandController(motherBoard.getMSXCommandController())
 	, masterVolume(mixer.getMasterVolume())
+	, renderThreadsSetting(mixer.getRenderThreadsSetting())
 	, speedSetting(globalSettings.getSpeedSetting())
 	, throttleManager(globalSettings.getThrottleManager())
 	, prevTime(getCurrentTime(), 44100)
 	, soundDeviceInfo(commandController.getMachineInfoCommand())
 	, recorder(nullptr)
 	, synchronousCounter(0)
+	, parallelStride(0)
 {
 	hostSampleRate = 44100;
 	fragmentSize = 0;
@@ -457,9 +461,18 @@ static inline std::tuple<int32_t, int32_t> filterBothStereo(
 	return std::make_tuple(tl0, tr0);
 }
 
+// Let the device generate its samples, measured by the HostProfiler.
+static bool updateBuffer(SoundDevice& device, unsigned samples, int32_t* buf,
+                         EmuTime::param time)
+{
+	HostTimer timer(device.getProfileSection());
+	return device.updateBuffer(samples, buf, time);
+}
 
 void MSXMixer::generate(int16_t* output, EmuTime::param time, unsigned samples)
 {
+	HostTimer timer(HostProfiler::MIXER);
+
 	// The code below is specialized for a lot of cases (before this
 	// routine was _much_ shorter). This is done because this routine
 	// ends up relatively high (top 5) in a profile run.
@@ -472,7 +485,7 @@ void MSXMixer::generate(int16_t* output, EmuTime::param time, unsigned samples)
 	if (samples == 0) {
 		SSE_ALIGNED(int32_t dummyBuf[4]);
 		for (auto& info : infos) {
-			info.device->updateBuffer(0, dummyBuf, time);
+			updateBuffer(*info.device, 0, dummyBuf, time);
 		}
 		return;
 	}
@@ -488,33 +501,53 @@ void MSXMixer::generate(int16_t* output, EmuTime::param time, unsigned samples)
 	static const unsigned HAS_STEREO_FLAG = 2;
 	unsigned usedBuffers = 0;
 
+	// Either let the device generate its samples now (in 'buf'), or fetch
+	// the samples that were already generated in parallel. Returns a
+	// pointer to the samples or nullptr when the device is silent.
+	bool parallel = generateParallel(time, samples);
+	auto render = [&](unsigned i, int32_t* buf) -> const int32_t* {
+		if (parallel) {
+			return parallelValid[i] ? &parallelBuf[i * parallelStride]
+			                        : nullptr;
+		}
+		return updateBuffer(*infos[i].device, samples, buf, time)
+		     ? buf : nullptr;
+	};
+	// Like render(), but the result must end up in 'buf'.
+	auto renderInto = [&](unsigned i, int32_t* buf, unsigned num) {
+		auto* p = render(i, buf);
+		if (p && (p != buf)) memcpy(buf, p, num * sizeof(int32_t));
+		return p != nullptr;
+	};
+
 	// FIXME: The Infos should be ordered such that all the mono
 	// devices are handled first
-	for (auto& info : infos) {
+	for (unsigned i = 0; i < infos.size(); ++i) {
+		auto& info = infos[i];
 		SoundDevice& device = *info.device;
 		int l1 = info.left1;
 		int r1 = info.right1;
 		if (!device.isStereo()) {
 			if (l1 == r1) {
 				if (!(usedBuffers & HAS_MONO_FLAG)) {
-					if (device.updateBuffer(samples, monoBuf, time)) {
+					if (renderInto(i, monoBuf, samples)) {
 						usedBuffers |= HAS_MONO_FLAG;
 						mul(monoBuf, samples, l1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
-						mulAcc(monoBuf, tmpBuf, samples, l1);
+					if (auto* buf = render(i, tmpBuf)) {
+						mulAcc(monoBuf, buf, samples, l1);
 					}
 				}
 			} else {
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (renderInto(i, stereoBuf, samples)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mulExpand(stereoBuf, samples, l1, r1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
-						mulExpandAcc(stereoBuf, tmpBuf, samples, l1, r1);
+					if (auto* buf = render(i, tmpBuf)) {
+						mulExpandAcc(stereoBuf, buf, samples, l1, r1);
 					}
 				}
 			}
@@ -525,24 +558,24 @@ void MSXMixer::generate(int16_t* output, EmuTime::param time, unsigned samples)
 				assert(l2 == 0);
 				assert(r1 == 0);
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (renderInto(i, stereoBuf, 2 * samples)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mul(stereoBuf, 2 * samples, l1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
-						mulAcc(stereoBuf, tmpBuf, 2 * samples, l1);
+					if (auto* buf = render(i, tmpBuf)) {
+						mulAcc(stereoBuf, buf, 2 * samples, l1);
 					}
 				}
 			} else {
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (renderInto(i, stereoBuf, 2 * samples)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mulMix2(stereoBuf, samples, l1, l2, r1, r2);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
-						mulMix2Acc(stereoBuf, tmpBuf, samples, l1, l2, r1, r2);
+					if (auto* buf = render(i, tmpBuf)) {
+						mulMix2Acc(stereoBuf, buf, samples, l1, l2, r1, r2);
 					}
 				}
 			}
@@ -590,6 +623,44 @@ void MSXMixer::generate(int16_t* output, EmuTime::param time, unsigned samples)
 	}
 }
 
+bool MSXMixer::generateParallel(EmuTime::param time, unsigned samples)
+{
+	unsigned numThreads = renderThreadsSetting.getInt();
+	if ((numThreads == 0) || (infos.size() < 2)) {
+		workerPool.reset();
+		return false;
+	}
+	if (!workerPool || (workerPool->getNumThreads() != numThreads)) {
+		workerPool = make_unique<WorkerPool>(numThreads);
+	}
+
+	// Each device gets its own (SSE aligned) buffer and the mixing (in
+	// generate()) is done serially. The state that is touched while the
+	// devices generate their samples concurrently:
+	//  - the device itself (including its resampler and wav writers),
+	//    each device is handled by exactly one worker
+	//  - SoundDevice's temporary mix buffer, this is per thread
+	//  - HostProfiler, its counters are atomic and the timer stack is
+	//    per thread
+	//  - 'prevTime' (via getHostSampleClock()) and the settings (channel
+	//    mute/balance), only read, they're changed in between two calls
+	// updateBuffer() (unlike the emulation part of the devices) must not
+	// call the Scheduler, IRQ lines, CliComm or Tcl: e.g. Y8950Adpcm only
+	// updates its status in the emulation (not the audio) path.
+	unsigned num = unsigned(infos.size());
+	unsigned stride = (2 * samples + 3 + 3) & ~3;
+	if ((stride > parallelStride) || (parallelValid.size() < num)) {
+		parallelStride = std::max(stride, parallelStride);
+		parallelBuf.resize(num * parallelStride);
+		parallelValid.resize(num);
+	}
+	workerPool->execute(num, [&](unsigned i) {
+		parallelValid[i] = updateBuffer(*infos[i].device,
+			samples, &parallelBuf[i * parallelStride], time);
+	});
+	return true;
+}
+
 bool MSXMixer::needStereoRecording() const
 {
 	return any_of(begin(infos), end(infos),
@@ -6,6 +6,7 @@
 #include "InfoTopic.hh"
 #include "EmuTime.hh"
 #include "DynamicClock.hh"
+#include "MemBuffer.hh"
 #include <cstdint>
 #include <vector>
 #include <memory>
@@ -23,6 +24,7 @@ class StringSetting;
 class BooleanSetting;
 class Setting;
 class AviRecorder;
+class WorkerPool;
 
 class MSXMixer final : private Schedulable, private Observer<Setting>
                      , private Observer<ThrottleManager>
@@ -133,6 +135,7 @@ private:
 	void reschedule();
 	void reschedule2();
 	void generate(int16_t* buffer, EmuTime::param time, unsigned samples);
+	bool generateParallel(EmuTime::param time, unsigned samples);
 
 	// Schedulable
 	void executeUntil(EmuTime::param time) override;
@@ -156,6 +159,7 @@ private:
 	MSXCommandController& commandController;
 
 	IntegerSetting& masterVolume;
+	IntegerSetting& renderThreadsSetting;
 	IntegerSetting& speedSetting;
 	ThrottleManager& throttleManager;
 
@@ -172,6 +176,13 @@ private:
 	AviRecorder* recorder;
 	unsigned synchronousCounter;
 
+	// Only used when sound devices are generated in parallel, see
+	// generateParallel().
+	std::unique_ptr<WorkerPool> workerPool;
+	MemBuffer<int32_t, SSE2_ALIGNMENT> parallelBuf;
+	unsigned parallelStride; // distance between two devices in parallelBuf
+	std::vector<char> parallelValid; // did device produce output
+
 	unsigned muteCount;
 	int32_t tl0, tr0; // internal DC-filter state
 };
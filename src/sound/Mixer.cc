@@ -49,6 +49,11 @@ Mixer::Mixer(Reactor& reactor_, CommandController& commandController_)
 	, samplesSetting(
 		commandController, "samples",
 		"mixer samples", defaultsamples, 64, 8192)
+	, renderThreadsSetting(
+		commandController, "sound_render_threads",
+		"number of extra threads used to generate the sound of the "
+		"sound chips in parallel, 0 means generate all sound in the "
+		"emulation thread", 0, 0, 16)
 	, muteCount(0)
 {
 	muteSetting       .attach(*this);
@@ -46,6 +46,7 @@ public:
 	void uploadBuffer(MSXMixer& msxMixer, int16_t* buffer, unsigned len);
 
 	IntegerSetting& getMasterVolume() { return masterVolume; }
+	IntegerSetting& getRenderThreadsSetting() { return renderThreadsSetting; }
 
 private:
 	void reloadDriver();
@@ -65,6 +66,7 @@ private:
 	IntegerSetting masterVolume;
 	IntegerSetting frequencySetting;
 	IntegerSetting samplesSetting;
+	IntegerSetting renderThreadsSetting;
 
 	int muteCount;
 };
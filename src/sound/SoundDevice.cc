@@ -8,6 +8,7 @@
 #include "MemoryOps.hh"
 #include "MemBuffer.hh"
 #include "MSXException.hh"
+#include "HostProfiler.hh"
 #include "likely.hh"
 #include "vla.hh"
 #include "memory.hh"
@@ -17,8 +18,10 @@ using std::string;
 
 namespace openmsx {
 
-static MemBuffer<int, SSE2_ALIGNMENT> mixBuffer;
-static unsigned mixBufferSize = 0;
+// Per thread, because MSXMixer can let the devices generate their samples
+// concurrently (see MSXMixer::generateParallel()).
+static thread_local MemBuffer<int, SSE2_ALIGNMENT> mixBuffer;
+static thread_local unsigned mixBufferSize = 0;
 
 static void allocateMixBuffer(unsigned size)
 {
@@ -98,6 +101,7 @@ SoundDevice::SoundDevice(MSXMixer& mixer_, string_ref name_,
 	, numChannels(numChannels_)
 	, stereo(stereo_ ? 2 : 1)
 	, numRecordChannels(0)
+	, profileSection(HostProfiler::registerSection("sound " + name))
 	, balanceCenter(true)
 {
 	assert(numChannels <= MAX_CHANNELS);
@@ -25,6 +25,9 @@ public:
 	  */
 	const std::string& getName() const { return name; }
 
+	/** The HostProfiler section that measures updateBuffer(). */
+	unsigned getProfileSection() const { return profileSection; }
+
 	/** Gets a description of this sound device,
 	  * to be presented to the user.
 	  */
@@ -193,6 +196,7 @@ private:
 	const unsigned numChannels;
 	const unsigned stereo;
 	unsigned numRecordChannels;
+	const unsigned profileSection;
 	int channelBalance[MAX_CHANNELS];
 	bool channelMuted[MAX_CHANNELS];
 	bool balanceCenter;
@@ -14,6 +14,17 @@ namespace Thread {
 	  */
 	bool isMainThread();
 
+	/** Mark the calling thread as a thread that exclusively executes one
+	  * MSX machine (see Reactor::runMachines()). Such a thread may do
+	  * everything the main thread does for the emulation of that machine.
+	  */
+	void setEmulationThread();
+
+	/** Returns true when called from the main thread or from a thread
+	  * that was marked with setEmulationThread().
+	  */
+	bool isEmulationThread();
+
 } // namespace Thread
 } // namespace openmsx
 
@@ -0,0 +1,94 @@
+#include "WorkerPool.hh"
+#include <cassert>
+
+namespace openmsx {
+
+WorkerPool::WorkerPool(unsigned numThreads)
+	: currentJob(nullptr)
+	, numJobs(0)
+	, nextJob(0)
+	, finishedJobs(0)
+	, generation(0)
+	, stop(false)
+{
+	threads.reserve(numThreads);
+	for (unsigned i = 0; i < numThreads; ++i) {
+		threads.emplace_back([this] { workerLoop(); });
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	startCondition.notify_all();
+	for (auto& t : threads) {
+		t.join();
+	}
+}
+
+void WorkerPool::execute(unsigned num, const Job& job)
+{
+	if (num == 0) return;
+	if (threads.empty() || (num == 1)) {
+		// no need to involve the other threads
+		for (unsigned i = 0; i < num; ++i) job(i);
+		return;
+	}
+
+	std::lock_guard<std::mutex> executeLock(executeMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		currentJob = &job;
+		numJobs = num;
+		nextJob = 0;
+		finishedJobs = 0;
+		++generation;
+	}
+	startCondition.notify_all();
+
+	if (!runJobs()) {
+		// wait till the jobs that are still running on the other
+		// threads are finished
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [&] { return finishedJobs == numJobs; });
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	currentJob = nullptr;
+}
+
+bool WorkerPool::runJobs()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	bool last = false;
+	while (nextJob < numJobs) {
+		unsigned i = nextJob++;
+		const Job& job = *currentJob;
+		lock.unlock();
+		job(i);
+		lock.lock();
+		last = ++finishedJobs == numJobs;
+	}
+	return last;
+}
+
+void WorkerPool::workerLoop()
+{
+	unsigned seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			startCondition.wait(lock, [&] {
+				return stop || (generation != seen); });
+			if (stop) return;
+			seen = generation;
+		}
+		if (runJobs()) {
+			doneCondition.notify_one();
+		}
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,53 @@
+#ifndef WORKERPOOL_HH
+#define WORKERPOOL_HH
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace openmsx {
+
+/** A small pool of threads to execute a batch of independent jobs in
+  * parallel. The thread that calls execute() also participates in the work,
+  * so a pool with N threads runs (at most) N+1 jobs concurrently.
+  *
+  * Only one batch is executed at a time: concurrent calls to execute() (from
+  * different threads) are serialized.
+  */
+class WorkerPool
+{
+public:
+	using Job = std::function<void(unsigned)>;
+
+	explicit WorkerPool(unsigned numThreads);
+	~WorkerPool();
+
+	/** Execute job(0), job(1), ..., job(num - 1). The order in which these
+	  * jobs start is unspecified. Returns when all jobs have finished.
+	  */
+	void execute(unsigned num, const Job& job);
+
+	unsigned getNumThreads() const { return unsigned(threads.size()); }
+
+private:
+	void workerLoop();
+	bool runJobs(); // returns true when the last job was finished
+
+	std::vector<std::thread> threads;
+	std::mutex executeMutex; // serializes calls to execute()
+	std::mutex mutex;        // protects the fields below
+	std::condition_variable startCondition;
+	std::condition_variable doneCondition;
+	const Job* currentJob;
+	unsigned numJobs;
+	unsigned nextJob;
+	unsigned finishedJobs;
+	unsigned generation;
+	bool stop;
+};
+
+} // namespace openmsx
+
+#endif
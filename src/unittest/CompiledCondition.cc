@@ -0,0 +1,395 @@
+#include "catch.hpp"
+#include "CompiledCondition.hh"
+#include "CPURegs.hh"
+#include "xrange.hh"
+#include <tcl.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace openmsx;
+using std::string;
+
+// A fake machine: fixed register values, a 64kB memory and one extra
+// debuggable. Tcl sees the same state via a 'debug read' command.
+class TestContext final : public CompiledCondition::Context
+{
+public:
+	TestContext()
+		: regs(false)
+	{
+		// The 'CPU regs' debuggable (same layout as in MSXCPU), the
+		// values are chosen so that the high and low bytes differ.
+		static const uint8_t values[28] = {
+			0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0, // AF..HL
+			0x21, 0x43, 0x65, 0x87, 0xA9, 0xCB, 0xED, 0x0F, // AF2..HL2
+			0x80, 0x7F, 0x01, 0xFE, 0x40, 0x02, 0xF3, 0x10, // IX..SP
+			0x3F, 0x55, 0x01, 0x07,                         // I R IM IFF
+		};
+		regBytes.assign(values, values + 28);
+		regs.setAF (0x1234); regs.setBC (0x5678);
+		regs.setDE (0x9ABC); regs.setHL (0xDEF0);
+		regs.setAF2(0x2143); regs.setBC2(0x6587);
+		regs.setDE2(0xA9CB); regs.setHL2(0xED0F);
+		regs.setIX (0x807F); regs.setIY (0x01FE);
+		regs.setPC (0x4002); regs.setSP (0xF310);
+		regs.setI(0x3F); regs.setR(0x55); regs.setIM(1);
+		regs.setIFF1(true); regs.setIFF2(true);
+		regs.clearPrevious();
+
+		memory.resize(0x10000);
+		for (auto i : xrange(0x10000)) {
+			memory[i] = uint8_t(i * 37 + 11);
+		}
+		std::vector<uint8_t> vram(0x100);
+		for (auto i : xrange(0x100)) vram[i] = uint8_t(0xFF - i);
+		debuggables["VRAM"] = vram;
+	}
+
+	const CPURegs& getRegisters() override { return regs; }
+
+	bool peek(const string& name, int64_t address, int64_t& value) override
+	{
+		const std::vector<uint8_t>* data;
+		if (name.empty()) {
+			data = &memory;
+		} else if (name == "CPU regs") {
+			data = &regBytes;
+		} else {
+			auto it = debuggables.find(name);
+			if (it == debuggables.end()) return false;
+			data = &it->second;
+		}
+		if ((address < 0) || (address >= int64_t(data->size()))) {
+			return false;
+		}
+		value = (*data)[address];
+		return true;
+	}
+
+private:
+	CPURegs regs;
+	std::vector<uint8_t> regBytes;
+	std::vector<uint8_t> memory;
+	std::map<string, std::vector<uint8_t>> debuggables;
+};
+
+// debug read <debuggable> <address>
+static int debugCmd(ClientData clientData, Tcl_Interp* interp,
+                    int objc, Tcl_Obj* const objv[])
+{
+	auto& context = *static_cast<TestContext*>(clientData);
+	Tcl_WideInt address;
+	if ((objc != 4) || (string(Tcl_GetString(objv[1])) != "read") ||
+	    (Tcl_GetWideIntFromObj(interp, objv[3], &address) != TCL_OK)) {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("bad debug command", -1));
+		return TCL_ERROR;
+	}
+	string name = Tcl_GetString(objv[2]);
+	if (name == "memory") name.clear();
+	int64_t value;
+	if (!context.peek(name, address, value)) {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("bad address", -1));
+		return TCL_ERROR;
+	}
+	Tcl_SetObjResult(interp, Tcl_NewWideIntObj(value));
+	return TCL_OK;
+}
+
+// The procs that the compiled commands replace, copied from _cpuregs.tcl
+// and _disasm.tcl.
+static const char* const procs = R"(
+proc reg {name} {
+	set regB [dict create \
+		A    0    F    1    B    2    C    3 \
+		D    4    E    5    H    6    L    7 \
+		A2   8    F2   9    B2  10    C2  11 \
+		D2  12    E2  13    H2  14    L2  15 \
+		IXH 16    IXL 17    IYH 18    IYL 19 \
+		PCH 20    PCL 21    SPH 22    SPL 23 \
+		I   24    R   25    IM  26    IFF 27 ]
+	set regW [dict create \
+		AF   0    BC   2    DE   4    HL   6 \
+		AF2  8    BC2 10    DE2 12    HL2 14 \
+		IX  16    IY  18    PC  20    SP  22 ]
+	set name [string toupper $name]
+	if {[dict exists $regB $name]} {
+		return [debug read "CPU regs" [dict get $regB $name]]
+	} elseif {[dict exists $regW $name]} {
+		set i [dict get $regW $name]
+		return [expr {256 * [debug read "CPU regs" $i] + [debug read "CPU regs" [expr {$i + 1}]]}]
+	} else {
+		error "Unknown Z80 register: $name"
+	}
+}
+proc peek {addr {m memory}} {
+	debug read $m $addr
+}
+proc peek8 {addr {m memory}} {
+	peek $addr $m
+}
+proc peek_u8 {addr {m memory}} {
+	peek $addr $m
+}
+proc peek_s8 {addr {m memory}} {
+	set b [peek $addr $m]
+	expr {($b < 128) ? $b : ($b - 256)}
+}
+proc peek16 {addr {m memory}} {
+	expr {[peek $addr $m] + 256 * [peek [expr {$addr + 1}] $m]}
+}
+proc peek16_LE {addr {m memory}} {
+	peek16 $addr $m
+}
+proc peek16_BE {addr {m memory}} {
+	expr {256 * [peek $addr $m] + [peek [expr {$addr + 1}] $m]}
+}
+proc peek_u16 {addr {m memory}} {
+	peek16 $addr $m
+}
+proc peek_u16LE {addr {m memory}} {
+	peek16 $addr $m
+}
+proc peek_u16BE {addr {m memory}} {
+	peek16_BE $addr $m
+}
+proc peek_s16 {addr {m memory}} {
+	set w [peek16 $addr $m]
+	expr {($w < 32768) ? $w : ($w - 65536)}
+}
+proc peek_s16LE {addr {m memory}} {
+	peek_s16 $addr $m
+}
+proc peek_s16BE {addr {m memory}} {
+	set w [peek16_BE $addr $m]
+	expr {($w < 32768) ? $w : ($w - 65536)}
+}
+)";
+
+struct Fixture
+{
+	Fixture()
+		: interp(Tcl_CreateInterp())
+	{
+		Tcl_CreateObjCommand(interp, "debug", debugCmd, &context, nullptr);
+		REQUIRE(Tcl_Eval(interp, procs) == TCL_OK);
+	}
+	~Fixture()
+	{
+		Tcl_DeleteInterp(interp);
+	}
+
+	// Evaluate the expression like a condition is evaluated by Tcl.
+	bool tclBool(const string& expression, bool& result)
+	{
+		int b;
+		Tcl_Obj* obj = Tcl_NewStringObj(expression.data(), -1);
+		Tcl_IncrRefCount(obj);
+		bool ok = Tcl_ExprBooleanObj(interp, obj, &b) == TCL_OK;
+		Tcl_DecrRefCount(obj);
+		result = b != 0;
+		return ok;
+	}
+	string tclValue(const string& expression)
+	{
+		string command = "expr {" + expression + '}';
+		REQUIRE(Tcl_Eval(interp, command.c_str()) == TCL_OK);
+		return Tcl_GetStringResult(interp);
+	}
+
+	// The expression must be compiled and give the same result as Tcl,
+	// both the (integer) value and the boolean result.
+	void check(const string& expression)
+	{
+		INFO(expression);
+		auto compiled = CompiledCondition::compile(expression);
+		REQUIRE(compiled);
+		bool expected;
+		REQUIRE(tclBool(expression, expected));
+		bool result;
+		REQUIRE(compiled->evaluate(context, result));
+		CHECK(result == expected);
+
+		string value = tclValue(expression);
+		INFO(value);
+		for (auto& op : { "==", "!=" }) {
+			string e = '(' + expression + ") " + op + ' ' + value;
+			auto c = CompiledCondition::compile(e);
+			REQUIRE(c);
+			REQUIRE(c->evaluate(context, result));
+			CHECK(result == (string(op) == "=="));
+		}
+	}
+
+	// The expression is not in the supported subset, Tcl evaluates it.
+	void checkNotCompiled(const string& expression)
+	{
+		INFO(expression);
+		CHECK(!CompiledCondition::compile(expression));
+	}
+
+	// The expression is compiled, but the evaluation falls back to Tcl:
+	// because Tcl reports an error or because the result doesn't fit.
+	void checkFallback(const string& expression)
+	{
+		INFO(expression);
+		auto compiled = CompiledCondition::compile(expression);
+		REQUIRE(compiled);
+		bool result;
+		CHECK(!compiled->evaluate(context, result));
+	}
+
+	TestContext context;
+	Tcl_Interp* interp;
+};
+
+TEST_CASE("CompiledCondition")
+{
+	Fixture f;
+
+	SECTION("literals") {
+		f.check("0");
+		f.check("1");
+		f.check("12345");
+		f.check("0x1F");
+		f.check("0XaB");
+		f.check("0o17");
+		f.check("0b1011");
+		f.check("  42  ");
+	}
+	SECTION("unary operators") {
+		f.check("-5");
+		f.check("+5");
+		f.check("!0");
+		f.check("!7");
+		f.check("~0x55");
+		f.check("- -3");
+		f.check("!!3");
+	}
+	SECTION("arithmetic") {
+		f.check("3 + 4 * 5");
+		f.check("(3 + 4) * 5");
+		f.check("10 - 20");
+		f.check("7 / 2");
+		f.check("-7 / 2");
+		f.check("7 / -2");
+		f.check("-7 / -2");
+		f.check("7 % 3");
+		f.check("-7 % 3");
+		f.check("7 % -3");
+		f.check("-7 % -3");
+		f.check("1 << 20");
+		f.check("-1 << 4");
+		f.check("0x8000 >> 3");
+		f.check("-100 >> 2");
+		f.check("-1 >> 70");
+		f.check("100000 * 100000");
+	}
+	SECTION("comparison and logic") {
+		f.check("3 < 4");
+		f.check("4 < 3");
+		f.check("3 > -4");
+		f.check("3 <= 3");
+		f.check("3 >= 4");
+		f.check("5 == 5");
+		f.check("5 != 5");
+		f.check("0x0F & 0x3C");
+		f.check("0x0F | 0x30");
+		f.check("0x0F ^ 0x3C");
+		f.check("1 && 0");
+		f.check("2 && 3");
+		f.check("0 || 0");
+		f.check("0 || 5");
+		f.check("1 ? 10 : 20");
+		f.check("0 ? 10 : 20");
+		f.check("0 ? 1 : 0 ? 2 : 3");
+		f.check("1 | 2 ^ 3 & 4 == 4");
+		f.check("1 + 2 << 3 < 4 + 100");
+	}
+	SECTION("reg") {
+		for (auto* name : { "A", "F", "B", "C", "D", "E", "H", "L",
+		                    "A2", "F2", "B2", "C2", "D2", "E2", "H2", "L2",
+		                    "IXH", "IXL", "IYH", "IYL", "PCH", "PCL",
+		                    "SPH", "SPL", "I", "R", "IM", "IFF",
+		                    "AF", "BC", "DE", "HL", "AF2", "BC2", "DE2",
+		                    "HL2", "IX", "IY", "PC", "SP",
+		                    "a", "hl", "ixl", "Sp" }) {
+			f.check(string("[reg ") + name + ']');
+		}
+		f.check("[reg PC] == 0x4002");
+		f.check("[reg A] == 0x12 && [reg HL] > 0x8000");
+		f.check("[reg {SP}]");
+	}
+	SECTION("peek") {
+		for (auto* proc : { "peek", "peek8", "peek_u8", "peek_s8",
+		                    "peek16", "peek16_LE", "peek16_BE",
+		                    "peek_u16", "peek_u16LE", "peek_u16BE",
+		                    "peek_s16", "peek_s16LE", "peek_s16BE" }) {
+			for (auto* addr : { "0", "0x1234", "0xC000", "7" }) {
+				f.check(string("[") + proc + ' ' + addr + ']');
+			}
+			f.check(string("[") + proc + " 0x10 VRAM]");
+			f.check(string("[") + proc + " 0x10 {VRAM}]");
+			f.check(string("[") + proc + " 0x20 memory]");
+			f.check(string("[") + proc + " [reg HL]]");
+		}
+		f.check("[peek [peek16 [reg SP]]]");
+		f.check("[peek [expr {[reg IX] + 5}]] == 3");
+		f.check("[debug read memory 0x100]");
+		f.check("[debug read VRAM 0x80]");
+		f.check("[debug read {CPU regs} 3]");
+		f.check("[debug read \"CPU regs\" 4]");
+		f.check("[debug read memory [reg BC]]");
+	}
+	SECTION("expr") {
+		f.check("[expr {1 + 2}]");
+		f.check("[expr {[reg A] & 0x0F}] == 2");
+		f.check("[expr {[peek 0x10] ? 3 : 4}]");
+	}
+	SECTION("fallback: not compiled") {
+		f.checkNotCompiled("");
+		f.checkNotCompiled("$x");
+		f.checkNotCompiled("$x == 1");
+		f.checkNotCompiled("1.5 > 1");
+		f.checkNotCompiled("1e3");
+		f.checkNotCompiled("010");
+		f.checkNotCompiled("2 ** 3");
+		f.checkNotCompiled("\"abc\" eq \"abc\"");
+		f.checkNotCompiled("1 in {1 2}");
+		f.checkNotCompiled("abs(-1)");
+		f.checkNotCompiled("[foo]");
+		f.checkNotCompiled("[reg XYZ]");
+		f.checkNotCompiled("[reg]");
+		f.checkNotCompiled("[reg A 1]");
+		f.checkNotCompiled("[peek]");
+		f.checkNotCompiled("[peek 1 VRAM 2]");
+		f.checkNotCompiled("[peek $addr]");
+		f.checkNotCompiled("[peek 1.0]");
+		f.checkNotCompiled("[debug write memory 0 1]");
+		f.checkNotCompiled("[expr $x]");
+		f.checkNotCompiled("[expr {$x}]");
+		f.checkNotCompiled("[reg A];[reg B]");
+		f.checkNotCompiled("(1 + 2");
+		f.checkNotCompiled("1 ? 2");
+		f.checkNotCompiled("99999999999999999999");
+	}
+	SECTION("fallback: evaluation") {
+		// Tcl reports an error
+		bool result;
+		for (auto* e : { "1 / 0", "1 % 0", "[peek 0x10000]",
+		                 "[peek [expr {-1}]]", "[peek16 0xFFFF]",
+		                 "[peek 0x100 VRAM]", "[peek 0 nonexistent]",
+		                 "[debug read nonexistent 0]", "1 << -1" }) {
+			INFO(e);
+			CHECK(!f.tclBool(e, result));
+			f.checkFallback(e);
+		}
+		// Tcl has arbitrary precision integers, the compiled code
+		// doesn't
+		for (auto* e : { "0x7FFFFFFF * 0x7FFFFFFF * 0x7FFFFFFF",
+		                 "(1 << 31) * (1 << 31)", "1 << 40" }) {
+			INFO(e);
+			f.checkFallback(e);
+		}
+	}
+}
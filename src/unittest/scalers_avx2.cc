@@ -0,0 +1,225 @@
+#include "catch.hpp"
+#include "LineScalers.hh"
+#include "Scanline.hh"
+#include "HQCommon.hh"
+#include "HostCPU.hh"
+#include "ScalersAVX2.hh"
+#include "MemBuffer.hh"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#ifdef __SSE2__
+
+// The AVX2 routines must give exactly the same result as the generic (C++ or
+// SSE2) routines. Most routines are tested by running the normal entry point
+// (e.g. Scale_1on2) once with and once without AVX2.
+
+using namespace openmsx;
+
+static const unsigned WIDTHS[] = { 16, 33, 64, 100, 256, 272, 320, 512, 513, 640 };
+
+static SDL_PixelFormat format32()
+{
+	SDL_PixelFormat format;
+	memset(&format, 0, sizeof(format));
+	format.BitsPerPixel = 32; format.BytesPerPixel = 4;
+	format.Rmask = 0x00FF0000; format.Rshift = 16;
+	format.Gmask = 0x0000FF00; format.Gshift =  8;
+	format.Bmask = 0x000000FF; format.Bshift =  0;
+	format.Amask = 0xFF000000; format.Ashift = 24;
+	return format;
+}
+
+static SDL_PixelFormat format16()
+{
+	SDL_PixelFormat format;
+	memset(&format, 0, sizeof(format));
+	format.BitsPerPixel = 16; format.BytesPerPixel = 2;
+	format.Rmask = 0xF800; format.Rshift = 11; format.Rloss = 3;
+	format.Gmask = 0x07E0; format.Gshift =  5; format.Gloss = 2;
+	format.Bmask = 0x001F; format.Bshift =  0; format.Bloss = 3;
+	format.Aloss = 8;
+	return format;
+}
+
+template<typename Pixel>
+static MemBuffer<Pixel, SSE2_ALIGNMENT> randomLine(unsigned width, std::minstd_rand& rng)
+{
+	// Only a few different colors, so that there are both equal and
+	// different neighbours (matters for the HQ edge detection).
+	MemBuffer<Pixel, SSE2_ALIGNMENT> line(width + 1);
+	for (unsigned i = 0; i < width + 1; ++i) {
+		line[i] = Pixel((rng() & 1) ? rng() : (rng() % 4) * 0x37373737);
+	}
+	return line;
+}
+
+// Run 'op' with and without AVX2 and compare the 'width' output pixels.
+// Without AVX2 this would compare the generic code with itself.
+template<typename T, typename Op>
+static void compareAVX2(unsigned width, Op op)
+{
+	REQUIRE(HostCPU::hasAVX2());
+	MemBuffer<T, SSE2_ALIGNMENT> expected(width);
+	MemBuffer<T, SSE2_ALIGNMENT> actual(width);
+	HostCPU::forceDisableAVX2(true);
+	op(expected.data());
+	HostCPU::forceDisableAVX2(false);
+	op(actual.data());
+	CHECK(std::equal(expected.data(), expected.data() + width, actual.data()));
+}
+
+template<typename Pixel>
+static void testLineScalers(const SDL_PixelFormat& format)
+{
+	PixelOperations<Pixel> pixelOps(format);
+	std::minstd_rand rng(12345);
+	for (auto w : WIDTHS) {
+		INFO("width " << w);
+		auto in1 = randomLine<Pixel>(w, rng);
+		auto in2 = randomLine<Pixel>(w, rng);
+		const Pixel* p1 = in1.data();
+		const Pixel* p2 = in2.data();
+		if (w >= 64) { // minimum width of the SSE2 routine
+			compareAVX2<Pixel>(2 * w, [&](Pixel* out) {
+				Scale_1on2<Pixel> scale;
+				scale(p1, out, 2 * w);
+			});
+		}
+		for (unsigned extra = 0; extra < 3; ++extra) {
+			compareAVX2<Pixel>(3 * w + extra, [&](Pixel* out) {
+				Scale_1on3<Pixel> scale;
+				scale(p1, out, 3 * w + extra);
+			});
+		}
+		compareAVX2<Pixel>(w, [&](Pixel* out) {
+			BlendLines<Pixel> blend(pixelOps);
+			blend(p1, p2, out, w);
+		});
+		compareAVX2<Pixel>(w, [&](Pixel* out) {
+			AlphaBlendLines<Pixel> blend(pixelOps);
+			blend(p1, p2, out, w);
+		});
+		if (sizeof(Pixel) == 4) {
+			for (unsigned outWidth : { w / 2, w + 7, 3 * w / 2, 2 * w }) {
+				compareAVX2<Pixel>(outWidth, [&](Pixel* out) {
+					ZoomLine<Pixel> zoom(pixelOps);
+					zoom(p1, w, out, outWidth);
+				});
+			}
+			compareAVX2<Pixel>(w, [&](Pixel* out) {
+				AlphaBlendLines<Pixel> blend(pixelOps);
+				blend(Pixel(0x80123456), p2, out, w);
+			});
+		}
+		if ((w % 16) == 0) {
+			for (unsigned factor : { 0, 1, 100, 254 }) {
+				compareAVX2<Pixel>(w, [&](Pixel* out) {
+					Scanline<Pixel> scanline(pixelOps);
+					scanline.draw(p1, p2, out, factor, w);
+				});
+			}
+		}
+		EdgeHQ edgeOp = createEdgeHQ(pixelOps);
+		compareAVX2<unsigned>(w, [&](unsigned* edges) {
+			calcEdgesHQ(p1, p2, w, edges, edgeOp);
+		});
+	}
+}
+
+TEST_CASE("ScalersAVX2: line scalers")
+{
+	if (!HostCPU::hasAVX2()) {
+		WARN("AVX2 not available, skipped");
+		return;
+	}
+	testLineScalers<uint32_t>(format32());
+	testLineScalers<uint16_t>(format16());
+}
+
+
+// The blur routines of Simple2xScaler and Simple3xScaler are not accessible
+// from here. Instead compare with the reference loops documented in those
+// scalers (calculated per color component).
+
+static unsigned comp(uint32_t p, unsigned shift)
+{
+	return (p >> shift) & 0xFF;
+}
+
+TEST_CASE("ScalersAVX2: blur")
+{
+	if (!HostCPU::hasAVX2()) {
+		WARN("AVX2 not available, skipped");
+		return;
+	}
+	std::minstd_rand rng(12345);
+	for (auto w : WIDTHS) {
+		if ((w % 8) != 0) continue;
+		INFO("width " << w);
+		auto in = randomLine<uint32_t>(w, rng);
+		auto pixel = [&](int x) {
+			return in[std::min<int>(std::max(x, 0), w - 1)];
+		};
+		MemBuffer<uint32_t> out(3 * w);
+
+		for (unsigned alpha : { 1, 64, 200, 256 }) {
+			unsigned c1 = alpha / 4;
+			unsigned c2 = 256 - c1;
+			avx2::blur1on2(in.data(), out.data(), c1, c2, w);
+			for (unsigned x = 0; x < w; ++x) {
+				uint32_t even = 0, odd = 0;
+				for (unsigned s = 0; s < 32; s += 8) {
+					unsigned p = comp(pixel(x - 1), s);
+					unsigned c = comp(pixel(x + 0), s);
+					unsigned n = comp(pixel(x + 1), s);
+					even |= ((c1 * p + c2 * c) >> 8) << s;
+					odd  |= ((c1 * n + c2 * c) >> 8) << s;
+				}
+				CHECK(out[2 * x + 0] == even);
+				CHECK(out[2 * x + 1] == odd);
+			}
+
+			c2 = 256 - alpha / 2;
+			avx2::blur1on1(in.data(), out.data(), c1, c2, w);
+			for (unsigned x = 0; x < w; ++x) {
+				uint32_t expected = 0;
+				for (unsigned s = 0; s < 32; s += 8) {
+					unsigned p = comp(pixel(x - 1), s);
+					unsigned c = comp(pixel(x + 0), s);
+					unsigned n = comp(pixel(x + 1), s);
+					expected |= ((c1 * p + c2 * c + c1 * n) >> 8) << s;
+				}
+				CHECK(out[x] == expected);
+			}
+		}
+
+		for (unsigned blur : { 1, 42, 85 }) {
+			// 16-bit fixed point factors, see Blur_1on3::blur_SSE()
+			unsigned alpha = blur * 256;
+			unsigned c0 = alpha / 2;
+			unsigned c1 = alpha + c0;
+			unsigned c2 = 0x10000 - c1;
+			unsigned c3 = 0x10000 - alpha;
+			auto mul = [](unsigned c, unsigned f) { return (c * f) >> 16; };
+			avx2::blur1on3(in.data(), out.data(), blur, w);
+			for (unsigned x = 0; x < w; ++x) {
+				uint32_t e0 = 0, e1 = 0, e2 = 0;
+				for (unsigned s = 0; s < 32; s += 8) {
+					unsigned p = comp(pixel(x - 1), s);
+					unsigned c = comp(pixel(x + 0), s);
+					unsigned n = comp(pixel(x + 1), s);
+					e0 |= (mul(p, c1) + mul(c, c2)) << s;
+					e1 |= (mul(p, c0) + mul(c, c3) + mul(n, c0)) << s;
+					e2 |= (mul(c, c2) + mul(n, c1)) << s;
+				}
+				CHECK(out[3 * x + 0] == e0);
+				CHECK(out[3 * x + 1] == e1);
+				CHECK(out[3 * x + 2] == e2);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,316 @@
+#include "catch.hpp"
+#include "Scheduler.hh"
+#include "Schedulable.hh"
+#include "SchedulerTrace.hh"
+#include "File.hh"
+#include "FileOperations.hh"
+#include "Thread.hh"
+#include "memory.hh"
+#ifdef OPENMSX_SCHEDULER_HEAP
+#include "SchedulerHeap.hh"
+#include "SchedulerQueue.hh"
+#include <algorithm>
+#endif
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace openmsx;
+
+// The Scheduler may only be used from the emulation (or main) thread.
+static void initThread()
+{
+	static bool done = false;
+	if (!done) {
+		Thread::setMainThread();
+		done = true;
+	}
+}
+
+// Records a (deterministic) pseudo-random scheduler trace. Sync point times
+// are chosen from a small range, so there are many sync points with the same
+// time, both within one device and between devices. Like on a real machine,
+// there's always at least one sync point pending.
+class TraceGenerator
+{
+public:
+	class Device final : public Schedulable
+	{
+	public:
+		Device(TraceGenerator& generator_)
+			: Schedulable(generator_.scheduler), generator(generator_) {}
+
+		void set(EmuTime::param time) { setSyncPoint(time); }
+		void remove() { removeSyncPoint(); }
+		void removeAll() { removeSyncPoints(); }
+		void pending() { pendingSyncPoint(); }
+
+		void executeUntil(EmuTime::param time) override {
+			generator.randomAction(time);
+			generator.randomAction(time);
+		}
+
+	private:
+		TraceGenerator& generator;
+	};
+
+	TraceGenerator(unsigned numDevices, uint32_t seed)
+		: random(seed)
+	{
+		initThread();
+		idle = make_unique<Device>(*this);
+		idle->set(EmuTime::makeEmuTime(uint64_t(1) << 48));
+		for (unsigned i = 0; i < numDevices; ++i) {
+			devices.push_back(make_unique<Device>(*this));
+		}
+		scheduler.setTrace(&trace);
+	}
+
+	~TraceGenerator()
+	{
+		scheduler.setTrace(nullptr);
+		devices.clear();
+		idle.reset();
+	}
+
+	void run(unsigned steps)
+	{
+		EmuTime time = EmuTime::zero;
+		for (unsigned i = 0; i < steps; ++i) {
+			randomAction(time);
+			if (next(4) == 0) {
+				time += EmuDuration(uint64_t(next(3)));
+				scheduler.schedule(time);
+			}
+		}
+		scheduler.schedule(time + EmuDuration(uint64_t(10)));
+	}
+
+	const SchedulerTrace& getTrace() const { return trace; }
+
+private:
+	unsigned next(unsigned n)
+	{
+		random = random * 1103515245 + 12345;
+		return (random >> 16) % n;
+	}
+
+	void randomAction(EmuTime::param time)
+	{
+		auto& device = *devices[next(unsigned(devices.size()))];
+		switch (next(8)) {
+		case 0: case 1: case 2: case 3:
+			device.set(time + EmuDuration(uint64_t(next(4))));
+			break;
+		case 4: case 5:
+			device.remove();
+			break;
+		case 6:
+			device.removeAll();
+			break;
+		case 7:
+			device.pending();
+			break;
+		}
+	}
+
+	Scheduler scheduler;
+	SchedulerTrace trace;
+	std::unique_ptr<Device> idle;
+	std::vector<std::unique_ptr<Device>> devices;
+	uint32_t random;
+};
+
+static void checkEqual(const SchedulerTrace& a, const SchedulerTrace& b)
+{
+	REQUIRE(a.getNumDevices() == b.getNumDevices());
+	auto& ea = a.getEntries();
+	auto& eb = b.getEntries();
+	REQUIRE(ea.size() == eb.size());
+	for (size_t i = 0; i < ea.size(); ++i) {
+		CHECK(ea[i].time   == eb[i].time);
+		CHECK(ea[i].device == eb[i].device);
+		CHECK(ea[i].op     == eb[i].op);
+	}
+}
+
+TEST_CASE("SchedulerTrace: save/load")
+{
+	TraceGenerator generator(5, 1);
+	generator.run(1000);
+	auto& trace = generator.getTrace();
+	REQUIRE(!trace.getEntries().empty());
+
+	std::string filename;
+	FileOperations::openUniqueFile(FileOperations::getTempDir(), filename);
+	trace.save(filename);
+	// magic, header, and 13 bytes per entry (no struct padding)
+	File file(filename);
+	CHECK(file.getSize() == 8 + 8 + 13 * trace.getEntries().size());
+	file.close();
+
+	SchedulerTrace loaded;
+	loaded.load(filename);
+	FileOperations::unlink(filename);
+	checkEqual(trace, loaded);
+}
+
+#ifdef OPENMSX_SCHEDULER_HEAP
+
+namespace {
+
+class DummyDevice final : public Schedulable
+{
+public:
+	DummyDevice(Scheduler& scheduler) : Schedulable(scheduler) {}
+	void executeUntil(EmuTime::param /*time*/) override {}
+};
+
+struct EqualDevice {
+	EqualDevice(const Schedulable* device_) : device(device_) {}
+	bool operator()(const SynchronizationPoint& sp) const {
+		return sp.getDevice() == device;
+	}
+	const Schedulable* device;
+};
+
+// Replays a trace on both SchedulerHeap and SchedulerQueue (the same way
+// the Scheduler uses them), and checks that after each step both contain
+// the same sync points in the same order. The EXECUTE entries in the trace
+// must also match the front of both.
+class Replayer
+{
+public:
+	Replayer(unsigned numDevices)
+	{
+		for (unsigned i = 0; i < numDevices; ++i) {
+			devices.push_back(make_unique<DummyDevice>(scheduler));
+		}
+	}
+
+	~Replayer()
+	{
+		for (auto& d : devices) heap.removeAll(*d);
+	}
+
+	void replay(const SchedulerTrace& trace)
+	{
+		for (auto& entry : trace.getEntries()) {
+			step(entry);
+			checkContents();
+		}
+	}
+
+private:
+	void step(const SchedulerTrace::Entry& entry)
+	{
+		auto time = EmuTime::makeEmuTime(entry.time);
+		switch (entry.op) {
+		case SchedulerTrace::SET: {
+			auto& device = getDevice(entry);
+			heap.insert(time, device);
+			queue.insert(SynchronizationPoint(time, &device),
+			             [](SynchronizationPoint& sp) { sp.setTime(EmuTime::infinity); },
+			             [](const SynchronizationPoint& x, const SynchronizationPoint& y) {
+			                     return x.getTime() < y.getTime(); });
+			break;
+		}
+		case SchedulerTrace::REMOVE: {
+			auto& device = getDevice(entry);
+			CHECK(heap.removeOne(device) == queue.remove(EqualDevice(&device)));
+			break;
+		}
+		case SchedulerTrace::REMOVE_ALL: {
+			auto& device = getDevice(entry);
+			heap.removeAll(device);
+			queue.remove_all(EqualDevice(&device));
+			break;
+		}
+		case SchedulerTrace::PENDING: {
+			auto& device = getDevice(entry);
+			EmuTime heapTime = EmuTime::zero;
+			bool heapFound = heap.findFirst(device, heapTime);
+			auto it = std::find_if(queue.begin(), queue.end(), EqualDevice(&device));
+			REQUIRE(heapFound == (it != queue.end()));
+			if (heapFound) CHECK(heapTime == it->getTime());
+			break;
+		}
+		case SchedulerTrace::GET: {
+			auto& device = getDevice(entry);
+			std::vector<EmuTime> queueTimes;
+			for (auto& sp : queue) {
+				if (sp.getDevice() == &device) queueTimes.push_back(sp.getTime());
+			}
+			CHECK(heap.getTimes(device) == queueTimes);
+			break;
+		}
+		case SchedulerTrace::EXECUTE: {
+			auto& device = getDevice(entry);
+			REQUIRE(!heap.empty());
+			REQUIRE(queue.begin() != queue.end());
+			CHECK(heap.getNextTime() == time);
+			CHECK(heap.getNextDevice() == &device);
+			CHECK(queue.front().getTime() == time);
+			CHECK(queue.front().getDevice() == &device);
+			heap.removeFront();
+			queue.remove_front();
+			break;
+		}
+		case SchedulerTrace::SCHEDULE:
+		case SchedulerTrace::EXECUTE_END:
+			break;
+		}
+	}
+
+	void checkContents()
+	{
+		auto all = heap.getAll();
+		REQUIRE(all.size() == size_t(queue.end() - queue.begin()));
+		auto it = queue.begin();
+		for (auto& p : all) {
+			CHECK(p.first  == it->getTime());
+			CHECK(p.second == it->getDevice());
+			++it;
+		}
+	}
+
+	Schedulable& getDevice(const SchedulerTrace::Entry& entry)
+	{
+		REQUIRE(entry.device < devices.size());
+		return *devices[entry.device];
+	}
+
+	Scheduler scheduler;
+	std::vector<std::unique_ptr<DummyDevice>> devices;
+	SchedulerHeap heap;
+	SchedulerQueue<SynchronizationPoint> queue;
+};
+
+} // namespace
+
+TEST_CASE("SchedulerHeap: same order as SchedulerQueue")
+{
+	SECTION("generated traces") {
+		for (uint32_t seed : {1, 2, 3}) {
+			for (unsigned numDevices : {1, 3, 20}) {
+				TraceGenerator generator(numDevices, seed);
+				generator.run(3000);
+				auto& trace = generator.getTrace();
+				Replayer replayer(trace.getNumDevices());
+				replayer.replay(trace);
+			}
+		}
+	}
+	SECTION("recorded trace") {
+		// A trace of a real session, recorded with the benchmark
+		// harness (--record-scheduler), if available.
+		if (const char* filename = getenv("OPENMSX_SCHEDULER_TRACE")) {
+			SchedulerTrace trace;
+			trace.load(filename);
+			Replayer replayer(trace.getNumDevices());
+			replayer.replay(trace);
+		}
+	}
+}
+
+#endif // OPENMSX_SCHEDULER_HEAP
@@ -0,0 +1,83 @@
+#include "catch.hpp"
+#include "snappy.hh"
+#include <vector>
+#include <cstring>
+
+static std::vector<char> makeInput(size_t len)
+{
+	// mix of repeated patterns and 'random' bytes
+	std::vector<char> result(len);
+	unsigned r = 12345;
+	for (size_t i = 0; i < len; ++i) {
+		r = r * 1103515245 + 12345;
+		result[i] = ((i / 64) & 1) ? char(r >> 16) : char(i % 5);
+	}
+	return result;
+}
+
+static std::vector<char> compress(const std::vector<char>& input)
+{
+	size_t len = snappy::maxCompressedLength(input.size());
+	std::vector<char> result(len);
+	snappy::compress(input.data(), input.size(), result.data(), len);
+	result.resize(len);
+	return result;
+}
+
+TEST_CASE("snappy: round trip")
+{
+	for (size_t len : {1, 15, 16, 17, 100, 1000, 70000}) {
+		auto input = makeInput(len);
+		auto comp = compress(input);
+
+		std::vector<char> out1(len);
+		snappy::uncompress(comp.data(), comp.size(), out1.data(), len);
+		CHECK(out1 == input);
+
+		std::vector<char> out2(len);
+		CHECK(snappy::uncompressChecked(
+			comp.data(), comp.size(), out2.data(), len));
+		CHECK(out2 == input);
+	}
+}
+
+TEST_CASE("snappy: reject invalid input")
+{
+	auto input = makeInput(1000);
+	auto comp = compress(input);
+	std::vector<char> out(input.size());
+
+	SECTION("wrong output size") {
+		std::vector<char> small(input.size() - 1);
+		CHECK(!snappy::uncompressChecked(
+			comp.data(), comp.size(), small.data(), small.size()));
+		std::vector<char> big(input.size() + 1);
+		CHECK(!snappy::uncompressChecked(
+			comp.data(), comp.size(), big.data(), big.size()));
+	}
+	SECTION("truncated") {
+		for (size_t len = 0; len < comp.size(); len += 7) {
+			std::vector<char> trunc(comp.begin(), comp.begin() + len);
+			CHECK(!snappy::uncompressChecked(
+				trunc.data(), trunc.size(), out.data(), out.size()));
+		}
+	}
+	SECTION("copy before start of output") {
+		// tag byte for a copy (1-byte offset, length 4) of offset 1, as
+		// first element: there's no output yet to copy from
+		std::vector<char> bad(2 + 16, 0);
+		bad[0] = 0x01;
+		bad[1] = 0x01;
+		CHECK(!snappy::uncompressChecked(
+			bad.data(), bad.size(), out.data(), 4));
+	}
+	SECTION("corrupted bytes") {
+		// must never crash, the result itself doesn't matter
+		for (size_t i = 0; i < comp.size(); ++i) {
+			auto bad = comp;
+			bad[i] ^= 0xA5;
+			snappy::uncompressChecked(
+				bad.data(), bad.size(), out.data(), out.size());
+		}
+	}
+}
@@ -181,10 +181,13 @@ static std::pair<const uint8_t*, const uint8_t*> scan_match(
 //   n2 number of bytes are different, and here are the bytes
 //   n3 number of bytes are equal
 //   ...
-static vector<uint8_t> calcDelta(const uint8_t* oldBuf, const uint8_t* newBuf, size_t size)
+// This routine can be called for several consecutive ranges of the buffers,
+// 'equal' is the number of equal bytes that still need to be stored in the
+// result. So the caller can also account for ranges that are known to be
+// equal without scanning them.
+static void calcDelta(vector<uint8_t>& result, size_t& equal,
+                      const uint8_t* oldBuf, const uint8_t* newBuf, size_t size)
 {
-	vector<uint8_t> result;
-
 	auto* p = oldBuf;
 	auto* q = newBuf;
 	auto* p_end = p + size;
@@ -193,8 +196,7 @@ static vector<uint8_t> calcDelta(const uint8_t* oldBuf, const uint8_t* newBuf, s
 	// scan equal bytes (possibly zero)
 	auto* q1 = q;
 	std::tie(p, q) = scan_mismatch(p, p_end, q, q_end);
-	auto n1 = q - q1;
-	storeUleb(result, n1);
+	equal += q - q1;
 
 	while (q != q_end) {
 		assert(*p != *q);
@@ -202,21 +204,25 @@ static vector<uint8_t> calcDelta(const uint8_t* oldBuf, const uint8_t* newBuf, s
 		auto* q2 = q;
 	different:
 		std::tie(p, q) = scan_match(p + 1, p_end, q + 1, q_end);
-		auto n2 = q - q2;
 
 		auto* q3 = q;
 		std::tie(p, q) = scan_mismatch(p, p_end, q, q_end);
 		auto n3 = q - q3;
 		if ((q != q_end) && (n3 <= 2)) goto different;
 
-		storeUleb(result, n2);
+		storeUleb(result, equal);
+		storeUleb(result, q3 - q2);
 		result.insert(result.end(), q2, q3);
 
-		if (n3 != 0) storeUleb(result, n3);
+		equal = n3;
 	}
+}
 
+// Store the remaining equal bytes (if any) at the end of the delta.
+static void finishDelta(vector<uint8_t>& result, size_t equal)
+{
+	if ((equal != 0) || result.empty()) storeUleb(result, equal);
 	result.shrink_to_fit();
-	return result;
 }
 
 // Apply a previously calculated 'delta' to 'oldBuf' to get 'newbuf'.
@@ -241,6 +247,8 @@ static void applyDeltaInPlace(uint8_t* buf, size_t size, const uint8_t* delta)
 // class DeltaBlock
 
 size_t DeltaBlock::globalAllocSize = 0;
+size_t DeltaBlock::globalScannedSize = 0;
+size_t DeltaBlock::globalChangedSize = 0;
 
 DeltaBlock::~DeltaBlock()
 {
@@ -254,7 +262,8 @@ DeltaBlock::~DeltaBlock()
 // class DeltaBlockCopy
 
 DeltaBlockCopy::DeltaBlockCopy(const uint8_t* data, size_t size)
-	: block(size)
+	: DeltaBlock(size)
+	, block(size)
 	, compressedSize(0)
 {
 #ifdef DEBUG
@@ -284,6 +293,11 @@ void DeltaBlockCopy::apply(uint8_t* dst, size_t size) const
 #endif
 }
 
+size_t DeltaBlockCopy::getMemUsage() const
+{
+	return compressed() ? compressedSize : getSize();
+}
+
 void DeltaBlockCopy::compress(size_t size)
 {
 	if (compressed()) return;
@@ -325,19 +339,48 @@ const uint8_t* DeltaBlockCopy::getData()
 
 DeltaBlockDiff::DeltaBlockDiff(
 		const std::shared_ptr<DeltaBlockCopy>& prev_,
-		const uint8_t* data, size_t size)
-	: prev(prev_)
-	, delta(calcDelta(prev->getData(), data, size))
+		const uint8_t* data, size_t size, const DirtyPages* dirty)
+	: DeltaBlock(size)
+	, prev(prev_)
 {
 #ifdef DEBUG
 	sha1 = SHA1::calc(data, size);
-
-	MemBuffer<uint8_t> buf(size);
-	apply(buf.data(), size);
-	assert(memcmp(buf.data(), data, size) == 0);
 #endif
+	// Collect the ranges of consecutive dirty pages.
+	size_t total = 0;
+	if (dirty) {
+		size_t numPages = dirty->getNumPages();
+		size_t page = 0;
+		while (page < numPages) {
+			if (!dirty->isDirty(page)) { ++page; continue; }
+			size_t first = page;
+			do { ++page; } while ((page < numPages) && dirty->isDirty(page));
+			size_t offset = first * DirtyPages::SIZE;
+			size_t length = std::min(page * DirtyPages::SIZE, size) - offset;
+			ranges.push_back({offset, length});
+			total += length;
+		}
+	} else {
+		ranges.push_back({0, size});
+		total = size;
+	}
+
+	if (total == 0) {
+		// Can only happen when the caller passes an all-clean
+		// DirtyPages object, handle it anyway: store an empty delta.
+		ranges.clear();
+		finishDelta(delta, size);
+	} else {
+		pending.resize(total);
+		auto* dst = pending.data();
+		for (auto& r : ranges) {
+			memcpy(dst, data + r.offset, r.length);
+			dst += r.length;
+		}
+		assert(!finalized());
+	}
 #if STATISTICS
-	allocSize = delta.size();
+	allocSize = total;
 	globalAllocSize += allocSize;
 	std::cout << "stat: DeltaBlockDiff " << globalAllocSize
 	          << " (+" << allocSize << ')' << std::endl;
@@ -347,22 +390,92 @@ DeltaBlockDiff::DeltaBlockDiff(
 void DeltaBlockDiff::apply(uint8_t* dst, size_t size) const
 {
 	prev->apply(dst, size);
-	applyDeltaInPlace(dst, size, delta.data());
+	if (finalized()) {
+		applyDeltaInPlace(dst, size, delta.data());
+	} else {
+		auto* src = pending.data();
+		for (auto& r : ranges) {
+			memcpy(dst + r.offset, src, r.length);
+			src += r.length;
+		}
+	}
 #ifdef DEBUG
 	assert(SHA1::calc(dst, size) == sha1);
 #endif
 }
 
+void DeltaBlockDiff::finalize(size_t size)
+{
+	if (finalized()) return;
+
+	const uint8_t* ref = prev->getData();
+	size_t equal = 0;
+	size_t pos = 0;
+	const uint8_t* src = pending.data();
+	for (auto& r : ranges) {
+		equal += r.offset - pos;
+		calcDelta(delta, equal, ref + r.offset, src, r.length);
+		src += r.length;
+		pos = r.offset + r.length;
+	}
+	equal += size - pos;
+	finishDelta(delta, equal);
+#ifdef DEBUG
+	MemBuffer<uint8_t> buf(size);
+	prev->apply(buf.data(), size);
+	applyDeltaInPlace(buf.data(), size, delta.data());
+	assert(SHA1::calc(buf.data(), size) == sha1);
+#endif
+#if STATISTICS
+	size_t scanned = 0;
+	for (auto& r : ranges) scanned += r.length;
+	size_t changed = 0;
+	const uint8_t* d = delta.data();
+	for (size_t n = 0; n != size; ) {
+		n += loadUleb(d);
+		if (n == size) break;
+		auto n2 = loadUleb(d);
+		changed += n2;
+		d += n2;
+		n += n2;
+	}
+	globalScannedSize += scanned;
+	globalChangedSize += changed;
+	std::cout << "stat: scanned " << scanned << " changed " << changed
+	          << " (total scanned " << globalScannedSize << " changed "
+	          << globalChangedSize << ')' << std::endl;
+#endif
+	MemBuffer<uint8_t>().swap(pending);
+	vector<Range>().swap(ranges);
+	assert(finalized());
+#if STATISTICS
+	int diff = delta.size() - allocSize;
+	allocSize = delta.size();
+	globalAllocSize += diff;
+	std::cout << "stat: finalize " << globalAllocSize
+	          << " (" << diff << ')' << std::endl;
+#endif
+}
+
+size_t DeltaBlockDiff::getMemUsage() const
+{
+	if (finalized()) return delta.size();
+	size_t total = 0;
+	for (auto& r : ranges) total += r.length;
+	return total;
+}
+
 size_t DeltaBlockDiff::getDeltaSize() const
 {
+	assert(finalized());
 	return delta.size();
 }
 
 
 // class LastDeltaBlocks
 
-std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
-		const void* id, const uint8_t* data, size_t size)
+std::vector<LastDeltaBlocks::Info>::iterator LastDeltaBlocks::findInfo(
+		const void* id, size_t size)
 {
 	auto it = std::lower_bound(begin(infos), end(infos), std::make_tuple(id, size),
 		[](const Info& info, const std::tuple<const void*, size_t>& info2) {
@@ -373,13 +486,21 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 	}
 	assert(it->id   == id);
 	assert(it->size == size);
+	return it;
+}
+
+std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
+		const void* id, const uint8_t* data, size_t size,
+		const DirtyPages* dirty)
+{
+	auto it = findInfo(id, size);
 
 	auto ref = it->ref.lock();
 	if (it->accSize >= size || !ref) {
 		if (ref) {
 			// We will switch to a new DeltaBlockCopy object. So
-			// now is a good time to compress the old one.
-			ref->compress(size);
+			// the old one can be compressed (in finalize()).
+			pendingCompress.push_back({ref, size});
 		}
 		// Heuristic: create a new block when too many small
 		// differences have accumulated.
@@ -387,13 +508,24 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 		it->ref = b;
 		it->last = b;
 		it->accSize = 0;
+		it->sinceRef = DirtyPages(size);
+		it->sinceRef.clear();
 		return b;
 	} else {
 		// Create diff based on earlier reference block.
-		// Reference remains unchanged.
-		auto b = std::make_shared<DeltaBlockDiff>(ref, data, size);
+		// Reference remains unchanged. The actual delta is only
+		// calculated in finalize(), accSize gets updated there.
+		// The diff is against 'ref', so it has to include all pages
+		// that changed since 'ref' was created.
+		if (dirty) {
+			it->sinceRef.merge(*dirty);
+		} else {
+			it->sinceRef.markAll();
+		}
+		auto b = std::make_shared<DeltaBlockDiff>(
+			ref, data, size, &it->sinceRef);
 		it->last = b;
-		it->accSize += b->getDeltaSize();
+		pendingDiffs.push_back({b, id, size});
 		return b;
 	}
 }
@@ -416,6 +548,8 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNullDiff(
 		it->ref = b;
 		it->last = b;
 		it->accSize = 0;
+		it->sinceRef = DirtyPages(size);
+		it->sinceRef.clear();
 		return b;
 	} else {
 #ifdef DEBUG
@@ -425,8 +559,28 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNullDiff(
 	}
 }
 
+vector<std::shared_ptr<DeltaBlock>> LastDeltaBlocks::finalize()
+{
+	// First calculate all deltas, only then compress the reference
+	// blocks (the deltas need the uncompressed data).
+	for (auto& p : pendingDiffs) {
+		p.block->finalize(p.size);
+		findInfo(p.id, p.size)->accSize += p.block->getDeltaSize();
+	}
+	pendingDiffs.clear();
+
+	vector<std::shared_ptr<DeltaBlock>> result;
+	for (auto& p : pendingCompress) {
+		p.block->compress(p.size);
+		result.push_back(p.block);
+	}
+	pendingCompress.clear();
+	return result;
+}
+
 void LastDeltaBlocks::clear()
 {
+	finalize();
 	for (const Info& info : infos) {
 		if (auto ref = info.ref.lock()) {
 			ref->compress(info.size);
@@ -4,6 +4,7 @@
 #define STATISTICS 0
 
 #include "MemBuffer.hh"
+#include "DirtyPages.hh"
 #include <cstdint>
 #include <memory>
 #include <vector>
@@ -23,8 +24,21 @@ public:
 #endif
 	virtual void apply(uint8_t* dst, size_t size) const = 0;
 
+	/** The size of the (uncompressed) data in this block. */
+	size_t getSize() const { return size; }
+
+	/** The amount of memory used by this block. This doesn't include the
+	  * block(s) this block refers to, see getReference(). */
+	virtual size_t getMemUsage() const = 0;
+
+	/** The block this block depends on, or nullptr. */
+	virtual const DeltaBlock* getReference() const { return nullptr; }
+
 protected:
-	DeltaBlock() = default;
+	explicit DeltaBlock(size_t size_) : size(size_) {}
+
+private:
+	const size_t size;
 
 #ifdef DEBUG
 public:
@@ -34,6 +48,8 @@ public:
 #if STATISTICS
 protected:
 	static size_t globalAllocSize;
+	static size_t globalScannedSize;
+	static size_t globalChangedSize;
 	size_t allocSize;
 #endif
 };
@@ -44,6 +60,7 @@ class DeltaBlockCopy final : public DeltaBlock
 public:
 	DeltaBlockCopy(const uint8_t* data, size_t size);
 	void apply(uint8_t* dst, size_t size) const override;
+	size_t getMemUsage() const override;
 	void compress(size_t size);
 	const uint8_t* getData();
 
@@ -58,24 +75,61 @@ private:
 class DeltaBlockDiff final : public DeltaBlock
 {
 public:
+	/** The constructor only makes a (plain) copy of the given data. The
+	  * (expensive) delta calculation is postponed till finalize().
+	  * When 'dirty' is given, only those pages can differ from 'prev',
+	  * then only those pages are copied and compared. */
 	DeltaBlockDiff(const std::shared_ptr<DeltaBlockCopy>& prev_,
-	               const uint8_t* data, size_t size);
+	               const uint8_t* data, size_t size,
+	               const DirtyPages* dirty);
 	void apply(uint8_t* dst, size_t size) const override;
+	size_t getMemUsage() const override;
+	const DeltaBlock* getReference() const override { return prev.get(); }
+	void finalize(size_t size);
 	size_t getDeltaSize() const;
 
 private:
+	bool finalized() const { return pending.empty(); }
+
+	struct Range {
+		size_t offset;
+		size_t length;
+	};
+
 	const std::shared_ptr<DeltaBlockCopy> prev;
-	const std::vector<uint8_t> delta; // TODO could be tweaked to use OutputBuffer
+	// Till finalize() is called: copy of the (possibly) changed ranges.
+	MemBuffer<uint8_t> pending;
+	std::vector<Range> ranges;
+	std::vector<uint8_t> delta; // TODO could be tweaked to use OutputBuffer
 };
 
 
+/** Creating a new DeltaBlock is split in two phases:
+  * - createNew() and createNullDiff() are cheap: at most they copy the given
+  *   data. They're called from the emulation thread while a snapshot is
+  *   being taken.
+  * - finalize() does the expensive work: calculating the deltas and
+  *   compressing the reference blocks that are no longer used as the base
+  *   for new deltas. It only touches the blocks created since the previous
+  *   finalize() call (and their reference blocks), so it can run in a
+  *   background thread. Though it must be finished before any of these
+  *   blocks is applied and before any other method of this class is called
+  *   again.
+  */
 class LastDeltaBlocks
 {
 public:
+	/** Create a new block for the given data. Optionally 'dirty' tells
+	  * which pages changed since the previous block with the same id was
+	  * created (via createNew() or createNullDiff()). */
 	std::shared_ptr<DeltaBlock> createNew(
-		const void* id, const uint8_t* data, size_t size);
+		const void* id, const uint8_t* data, size_t size,
+		const DirtyPages* dirty = nullptr);
 	std::shared_ptr<DeltaBlock> createNullDiff(
 		const void* id, const uint8_t* data, size_t size);
+	/** Returns the reference blocks that were compressed (so their
+	  * getMemUsage() changed). */
+	std::vector<std::shared_ptr<DeltaBlock>> finalize();
 	void clear();
 
 private:
@@ -88,9 +142,24 @@ private:
 		std::weak_ptr<DeltaBlockCopy> ref;
 		std::weak_ptr<DeltaBlock> last;
 		size_t accSize;
+		DirtyPages sinceRef; // pages changed since 'ref' was created
+	};
+
+	struct PendingDiff {
+		std::shared_ptr<DeltaBlockDiff> block;
+		const void* id;
+		size_t size;
+	};
+	struct PendingCompress {
+		std::shared_ptr<DeltaBlockCopy> block;
+		size_t size;
 	};
 
+	std::vector<Info>::iterator findInfo(const void* id, size_t size);
+
 	std::vector<Info> infos;
+	std::vector<PendingDiff> pendingDiffs;
+	std::vector<PendingCompress> pendingCompress;
 };
 
 } // namespace openmsx
@@ -0,0 +1,82 @@
+#ifndef DIRTYPAGES_HH
+#define DIRTYPAGES_HH
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace openmsx {
+
+/** Keeps track of which pages of a memory block were modified.
+  *
+  * This is used to speed up taking reverse snapshots: only the pages that
+  * changed since the previous snapshot have to be copied and compared (see
+  * LastDeltaBlocks). We store one flag per page (instead of one bit) so that
+  * marking a page is a single store, this matters because it's done on each
+  * write to the tracked memory.
+  */
+class DirtyPages
+{
+public:
+	static const unsigned BITS = 8;
+	static const unsigned SIZE = 1 << BITS; // in bytes
+
+	DirtyPages() = default;
+
+	/** Track a memory block of the given size (in bytes). Initially all
+	  * pages are marked as dirty. */
+	explicit DirtyPages(size_t size)
+		: flags((size + SIZE - 1) >> BITS, 1)
+	{
+	}
+
+	size_t getNumPages() const { return flags.size(); }
+	bool isDirty(size_t page) const { return flags[page] != 0; }
+
+	/** Is at least one page dirty? */
+	bool any() const
+	{
+		return std::find(begin(flags), end(flags), 1) != end(flags);
+	}
+
+	void mark(size_t addr)
+	{
+		flags[addr >> BITS] = 1;
+	}
+
+	void mark(size_t addr, size_t num)
+	{
+		if (num == 0) return;
+		auto first = addr >> BITS;
+		auto last = (addr + num - 1) >> BITS;
+		assert(last < flags.size());
+		std::fill(begin(flags) + first, begin(flags) + last + 1, 1);
+	}
+
+	void markAll()
+	{
+		std::fill(begin(flags), end(flags), 1);
+	}
+
+	void clear()
+	{
+		std::fill(begin(flags), end(flags), 0);
+	}
+
+	/** Also mark all pages that are dirty in 'other'. */
+	void merge(const DirtyPages& other)
+	{
+		assert(other.flags.size() == flags.size());
+		for (size_t i = 0; i < flags.size(); ++i) {
+			flags[i] |= other.flags[i];
+		}
+	}
+
+private:
+	std::vector<uint8_t> flags;
+};
+
+} // namespace openmsx
+
+#endif
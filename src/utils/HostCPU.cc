@@ -0,0 +1,45 @@
+#include "HostCPU.hh"
+#if defined(__SSE2__) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace openmsx {
+
+const bool HostCPU::avx2Detected = HostCPU::detectAVX2();
+bool HostCPU::avx2 = HostCPU::avx2Detected;
+
+bool HostCPU::detectAVX2()
+{
+#ifdef __SSE2__
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	// The CPU must support AVX and the OS must save the XMM and YMM
+	// registers (XCR0 bits 1 and 2).
+	__cpuid(info, 1);
+	const int OSXSAVE = 1 << 27;
+	const int AVX     = 1 << 28;
+	if ((info[2] & (OSXSAVE | AVX)) != (OSXSAVE | AVX)) return false;
+	if ((_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0; // AVX2
+#else
+	// gcc and clang also check for OS support of the YMM registers.
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+#else
+	return false;
+#endif
+}
+
+void HostCPU::forceDisableAVX2(bool disable)
+{
+	avx2 = !disable && avx2Detected;
+}
+
+} // namespace openmsx
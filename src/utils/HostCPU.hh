@@ -0,0 +1,36 @@
+#ifndef HOSTCPU_HH
+#define HOSTCPU_HH
+
+namespace openmsx {
+
+/** Information about the instruction set extensions of the host CPU.
+  *
+  * Code that is compiled for the baseline instruction set (e.g. SSE2 on x86)
+  * can use this to select (at run time) a faster code path that requires a
+  * newer extension. The detection only happens once, at startup.
+  */
+class HostCPU
+{
+public:
+	/** Can AVX2 instructions be used? (This also checks that the OS saves
+	  * the 256-bit registers on a context switch.) Always false on non-x86
+	  * CPUs.
+	  */
+	static bool hasAVX2() { return avx2; }
+
+	/** Pretend the CPU doesn't support AVX2 (when 'disable' is true), or
+	  * go back to the detected value. Meant for tests that compare the
+	  * AVX2 and the generic code paths.
+	  */
+	static void forceDisableAVX2(bool disable);
+
+private:
+	static bool detectAVX2();
+
+	static const bool avx2Detected;
+	static bool avx2;
+};
+
+} // namespace openmsx
+
+#endif
@@ -5,6 +5,7 @@
 #include "Math.hh"
 #include "stl.hh"
 #include "unreachable.hh"
+#include <mutex>
 #include <utility>
 #include <vector>
 #include <cassert>
@@ -264,6 +265,7 @@ public:
 
 	void insert(void* aligned, void* unaligned) {
 		if (!aligned) return;
+		std::lock_guard<std::mutex> lock(mutex);
 		assert(none_of(begin(allocMap), end(allocMap),
 		               EqualTupleValue<0>(aligned)));
 		allocMap.emplace_back(aligned, unaligned);
@@ -271,6 +273,7 @@ public:
 
 	void* remove(void* aligned) {
 		if (!aligned) return nullptr;
+		std::lock_guard<std::mutex> lock(mutex);
 		// LIFO order is more likely than FIFO -> search backwards
 		auto it = rfind_if_unguarded(allocMap,
 		               EqualTupleValue<0>(aligned));
@@ -288,6 +291,9 @@ private:
 
 	// typically contains 5-10 items, so (unsorted) vector is fine
 	std::vector<std::pair<void*, void*>> allocMap;
+	// (de)allocations also happen in worker threads (e.g. sound devices
+	// that are generated in parallel)
+	std::mutex mutex;
 };
 
 void* mallocAligned(size_t alignment, size_t size)
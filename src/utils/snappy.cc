@@ -163,20 +163,26 @@ static const uint16_t charTable[256] = {
 
 static const size_t SCRATCH_SIZE = 16;
 
-void uncompress(const char* input, size_t inLen,
-                char* output, size_t outLen)
+// When CHECKED is true, all lengths and copy offsets are verified and false
+// is returned for invalid input. Otherwise the input is trusted (and the
+// result is always true).
+template<bool CHECKED>
+static inline bool uncompressImpl(const char* input, size_t inLen,
+                                  char* output, size_t outLen)
 {
+	if (CHECKED && (inLen < SCRATCH_SIZE)) return false;
 	const char* ip = input;
 	const char* ipLimit = input + inLen - SCRATCH_SIZE;
 	char* op = output;;
 	char* opLimit = output + outLen;
 
-	while (ip != ipLimit) {
+	while (CHECKED ? (ip < ipLimit) : (ip != ipLimit)) {
 		unsigned char c = *ip++;
 		if ((c & 0x3) == LITERAL) {
 			size_t literalLen = (c >> 2) + 1;
 			size_t outLeft = opLimit - op;
-			if (literalLen <= 16 && outLeft >= 16) {
+			if (literalLen <= 16 && outLeft >= 16 &&
+			    (!CHECKED || (literalLen <= size_t(ipLimit - ip)))) {
 				// Fast path, used for the majority (about 95%)
 				// of invocations.
 				unalignedCopy128(ip, op);
@@ -190,6 +196,11 @@ void uncompress(const char* input, size_t inLen,
 				literalLen = loadNBytes(ip, unsigned(literalLenLen)) + 1;
 				ip += literalLenLen;
 			}
+			if (CHECKED && ((ip > ipLimit) ||
+			                (literalLen > size_t(ipLimit - ip)) ||
+			                (literalLen > outLeft))) {
+				return false;
+			}
 			memcpy(op, ip, literalLen);
 			op += literalLen;
 			ip += literalLen;
@@ -204,6 +215,11 @@ void uncompress(const char* input, size_t inLen,
 			// bit-field starts at bit 8).
 			size_t offset = (entry & 0x700) + trailer;
 			size_t outLeft = opLimit - op;
+			if (CHECKED && ((ip > ipLimit) || (offset == 0) ||
+			                (offset > size_t(op - output)) ||
+			                (length > outLeft))) {
+				return false;
+			}
 			const char* src = op - offset;
 			if (length <= 16 && offset >= 8 && outLeft >= 16) {
 				// Fast path, used for the majority (70-80%) of
@@ -219,6 +235,19 @@ void uncompress(const char* input, size_t inLen,
 			op += length;
 		}
 	}
+	return !CHECKED || ((ip == ipLimit) && (op == opLimit));
+}
+
+void uncompress(const char* input, size_t inLen,
+                char* output, size_t outLen)
+{
+	uncompressImpl<false>(input, inLen, output, outLen);
+}
+
+bool uncompressChecked(const char* input, size_t inLen,
+                       char* output, size_t outLen)
+{
+	return uncompressImpl<true>(input, inLen, output, outLen);
 }
 
 
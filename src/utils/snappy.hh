@@ -48,11 +48,12 @@
 // - Rewritten to reuse existing openMSX helper functions and style.
 // - Removed possibility to operate on chunks of data, the current code
 //   requires the full to-be-(de)compressed memory block in one go.
-// - Removed all safety checks during decompression. The original code
+// - Removed all safety checks from uncompress(). The original code
 //   would return an error on invalid input, this code will crash on
 //   such input (but that shouldn't happen because we only feed input
 //   that was previously produced by the compression routine (and always
-//   keeping that compressed block in memory).
+//   keeping that compressed block in memory). Input that is read from
+//   disk must go via uncompressChecked() instead.
 // The motivation for this rewrite is to:
 // - Reduce code duplication between the snappy code and the rest of
 //   openMSX.
@@ -71,6 +72,11 @@ namespace snappy {
 	              char* output, size_t& outLen);
 	void uncompress(const char* input, size_t inLen,
 	                char* output, size_t outLen);
+	// Like uncompress(), but verifies all lengths and copy offsets.
+	// Returns false (and leaves 'output' in an undefined state) when
+	// 'input' is not a valid compressed block of exactly 'outLen' bytes.
+	bool uncompressChecked(const char* input, size_t inLen,
+	                       char* output, size_t outLen);
 	size_t maxCompressedLength(size_t inLen);
 }
 
@@ -10,9 +10,11 @@ TODO:
 #include "CharacterConverter.hh"
 #include "VDP.hh"
 #include "VDPVRAM.hh"
+#include "likely.hh"
 #include "build-info.hh"
 #include "components.hh"
 #include <cstdint>
+#include <cstring>
 
 #ifdef __SSE2__
 #include "emmintrin.h" // SSE2
@@ -20,12 +22,31 @@ TODO:
 
 namespace openmsx {
 
+// Number of entries in the pattern cache: one for each position in the
+// (up to 3 * 2kB) pattern table of Graphic2/3.
+static const unsigned PATTERN_CACHE_SIZE = 0x2000;
+// Number of entries in the Text2 cache: each pattern byte with and without
+// the blink attribute.
+static const unsigned TEXT_CACHE_SIZE = 256 * 2;
+
 template <class Pixel>
 CharacterConverter<Pixel>::CharacterConverter(
 	VDP& vdp_, const Pixel* palFg_, const Pixel* palBg_)
 	: vdp(vdp_), vram(vdp.getVRAM()), palFg(palFg_), palBg(palBg_)
+	, patternPixels(USE_CACHE ? PATTERN_CACHE_SIZE * 8 : 0)
+	, patternKeys  (USE_CACHE ? PATTERN_CACHE_SIZE     : 0)
+	, patternGeneration(0)
+	, textPixels(USE_CACHE ? TEXT_CACHE_SIZE * 6 : 0)
+	, textKeys  (USE_CACHE ? TEXT_CACHE_SIZE     : 0)
+	, textGeneration(0)
 {
 	modeBase = 0; // not strictly needed, but avoids Coverity warning
+
+	if (USE_CACHE) {
+		// The generations start at 1, so key 0 never matches.
+		memset(patternKeys.data(), 0, PATTERN_CACHE_SIZE * sizeof(uint32_t));
+		memset(textKeys   .data(), 0, TEXT_CACHE_SIZE    * sizeof(uint32_t));
+	}
 }
 
 template <class Pixel>
@@ -236,6 +257,56 @@ template<typename Pixel> static inline void draw8(
 	pixelPtr += 8;
 }
 
+template <class Pixel>
+inline uint32_t CharacterConverter<Pixel>::getPatternGeneration()
+{
+	if (!USE_CACHE) return 0;
+
+	// The palette is updated from several places (and color 0 also
+	// depends on the background color), so simply compare with the
+	// palette that was used for the current generation.
+	if ((patternGeneration == 0) ||
+	    (memcmp(patternPalette, palFg, sizeof(patternPalette)) != 0)) {
+		memcpy(patternPalette, palFg, sizeof(patternPalette));
+		patternGeneration += 1 << 16;
+		if (patternGeneration == 0) {
+			// Wrapped around, old entries could match again.
+			memset(patternKeys.data(), 0,
+			       PATTERN_CACHE_SIZE * sizeof(uint32_t));
+			patternGeneration = 1 << 16;
+		}
+	}
+	return patternGeneration;
+}
+
+template <class Pixel>
+inline void CharacterConverter<Pixel>::drawPattern(
+	Pixel* __restrict & pixelPtr, unsigned index, uint32_t generation,
+	unsigned color, unsigned pattern, bool misAligned, uint32_t& partial)
+{
+	if (!USE_CACHE) {
+		draw8(pixelPtr, palFg[color >> 4], palFg[color & 0x0F], pattern,
+		      misAligned, partial);
+		return;
+	}
+	uint32_t key = generation | (color << 8) | pattern;
+	index &= PATTERN_CACHE_SIZE - 1;
+	Pixel* cached = &patternPixels[index * 8];
+	if (likely(patternKeys[index] == key) && !misAligned) {
+		memcpy(pixelPtr, cached, 8 * sizeof(Pixel));
+		pixelPtr += 8;
+	} else {
+		Pixel* start = pixelPtr;
+		draw8(pixelPtr, palFg[color >> 4], palFg[color & 0x0F], pattern,
+		      misAligned, partial);
+		if (!misAligned) {
+			// (misaligned: the pixels are shifted, don't cache)
+			memcpy(cached, start, 8 * sizeof(Pixel));
+			patternKeys[index] = key;
+		}
+	}
+}
+
 template <class Pixel>
 void CharacterConverter<Pixel>::renderText1(
 	Pixel* __restrict pixelPtr, int line)
@@ -303,6 +374,18 @@ void CharacterConverter<Pixel>::renderText2(
 	const byte* patternArea = vram.patternTable.getReadArea(0, 256 * 8);
 	patternArea += (line + vdp.getVerticalScroll()) & 7;
 
+	Pixel colors[4] = { plainFg, plainBg, blinkFg, blinkBg };
+	if (USE_CACHE && ((textGeneration == 0) ||
+	    (memcmp(textColors, colors, sizeof(colors)) != 0))) {
+		memcpy(textColors, colors, sizeof(colors));
+		if (++textGeneration == 0) {
+			// Wrapped around, old entries could match again.
+			memset(textKeys.data(), 0,
+			       TEXT_CACHE_SIZE * sizeof(uint32_t));
+			textGeneration = 1;
+		}
+	}
+
 	unsigned colorStart = (line / 8) * (80 / 8);
 	unsigned nameStart  = (line / 8) * 80;
 	for (unsigned i = 0; i < (80 / 8); ++i) {
@@ -310,38 +393,31 @@ void CharacterConverter<Pixel>::renderText2(
 			(colorStart + i) | (~0u << 9));
 		const byte* nameArea = vram.nameTable.getReadArea(
 			(nameStart + 8 * i) | (~0u << 12), 8);
-		draw6(pixelPtr,
-		      (colorPattern & 0x80) ? blinkFg : plainFg,
-		      (colorPattern & 0x80) ? blinkBg : plainBg,
-		      patternArea[nameArea[0] * 8]);
-		draw6(pixelPtr,
-		      (colorPattern & 0x40) ? blinkFg : plainFg,
-		      (colorPattern & 0x40) ? blinkBg : plainBg,
-		      patternArea[nameArea[1] * 8]);
-		draw6(pixelPtr,
-		      (colorPattern & 0x20) ? blinkFg : plainFg,
-		      (colorPattern & 0x20) ? blinkBg : plainBg,
-		      patternArea[nameArea[2] * 8]);
-		draw6(pixelPtr,
-		      (colorPattern & 0x10) ? blinkFg : plainFg,
-		      (colorPattern & 0x10) ? blinkBg : plainBg,
-		      patternArea[nameArea[3] * 8]);
-		draw6(pixelPtr,
-		      (colorPattern & 0x08) ? blinkFg : plainFg,
-		      (colorPattern & 0x08) ? blinkBg : plainBg,
-		      patternArea[nameArea[4] * 8]);
-		draw6(pixelPtr,
-		      (colorPattern & 0x04) ? blinkFg : plainFg,
-		      (colorPattern & 0x04) ? blinkBg : plainBg,
-		      patternArea[nameArea[5] * 8]);
-		draw6(pixelPtr,
-		      (colorPattern & 0x02) ? blinkFg : plainFg,
-		      (colorPattern & 0x02) ? blinkBg : plainBg,
-		      patternArea[nameArea[6] * 8]);
-		draw6(pixelPtr,
-		      (colorPattern & 0x01) ? blinkFg : plainFg,
-		      (colorPattern & 0x01) ? blinkBg : plainBg,
-		      patternArea[nameArea[7] * 8]);
+		for (unsigned j = 0; j < 8; ++j) {
+			unsigned blink = (colorPattern >> (7 - j)) & 1;
+			unsigned pattern = patternArea[nameArea[j] * 8];
+			unsigned index = 2 * pattern + blink;
+			if (!USE_CACHE) {
+				draw6(pixelPtr,
+				      blink ? blinkFg : plainFg,
+				      blink ? blinkBg : plainBg,
+				      pattern);
+				continue;
+			}
+			Pixel* cached = &textPixels[index * 6];
+			if (likely(textKeys[index] == textGeneration)) {
+				memcpy(pixelPtr, cached, 6 * sizeof(Pixel));
+				pixelPtr += 6;
+			} else {
+				Pixel* start = pixelPtr;
+				draw6(pixelPtr,
+				      blink ? blinkFg : plainFg,
+				      blink ? blinkBg : plainBg,
+				      pattern);
+				memcpy(cached, start, 6 * sizeof(Pixel));
+				textKeys[index] = textGeneration;
+			}
+		}
 	}
 }
 
@@ -369,15 +445,15 @@ void CharacterConverter<Pixel>::renderGraphic1(
 	patternArea += line & 7;
 	const byte* colorArea = vram.colorTable.getReadArea(0, 256 / 8);
 
+	uint32_t generation = getPatternGeneration();
 	int scroll = vdp.getHorizontalScrollHigh();
 	const byte* namePtr = getNamePtr(line, scroll);
 	for (unsigned n = 0; n < 32; ++n) {
 		unsigned charcode = namePtr[scroll & 0x1F];
 		unsigned pattern = patternArea[charcode * 8];
 		unsigned color = colorArea[charcode / 8];
-		Pixel fg = palFg[color >> 4];
-		Pixel bg = palFg[color & 0x0F];
-		draw8(pixelPtr, fg, bg, pattern, misAligned, partial);
+		drawPattern(pixelPtr, (charcode * 8) | (line & 7), generation,
+		            color, pattern, misAligned, partial);
 		if (!(++scroll & 0x1F)) namePtr = getNamePtr(line, scroll);
 	}
 
@@ -402,6 +478,7 @@ void CharacterConverter<Pixel>::renderGraphic2(
 	int line7 = line & 7;
 	int scroll = vdp.getHorizontalScrollHigh();
 	const byte* namePtr = getNamePtr(line, scroll);
+	uint32_t generation = getPatternGeneration();
 
 	if (vram.colorTable  .isContinuous((8 * 256) - 1) &&
 	    vram.patternTable.isContinuous((8 * 256) - 1) &&
@@ -415,9 +492,9 @@ void CharacterConverter<Pixel>::renderGraphic2(
 			unsigned charCode8 = namePtr[n] * 8;
 			unsigned pattern = patternArea[charCode8];
 			unsigned color   = colorArea  [charCode8];
-			Pixel fg = palFg[color >> 4];
-			Pixel bg = palFg[color & 0x0F];
-			draw8(pixelPtr, fg, bg, pattern, misAligned, partial);
+			drawPattern(pixelPtr, quarter8 | charCode8 | line7,
+			            generation, color, pattern,
+			            misAligned, partial);
 		}
 	} else {
 		// Slower variant, also works when:
@@ -430,9 +507,8 @@ void CharacterConverter<Pixel>::renderGraphic2(
 			unsigned index = charCode8 | baseLine;
 			unsigned pattern = vram.patternTable.readNP(index);
 			unsigned color   = vram.colorTable  .readNP(index);
-			Pixel fg = palFg[color >> 4];
-			Pixel bg = palFg[color & 0x0F];
-			draw8(pixelPtr, fg, bg, pattern, misAligned, partial);
+			drawPattern(pixelPtr, index, generation, color, pattern,
+			            misAligned, partial);
 			if (!(++scroll & 0x1F)) namePtr = getNamePtr(line, scroll);
 		}
 	}
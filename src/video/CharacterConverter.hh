@@ -2,6 +2,8 @@
 #define CHARACTERCONVERTER_HH
 
 #include "openmsx.hh"
+#include "MemBuffer.hh"
+#include <cstdint>
 
 namespace openmsx {
 
@@ -56,6 +58,21 @@ private:
 
 	const byte* getNamePtr(int line, int scroll);
 
+	/** Returns the palette generation (already shifted to its position in
+	  * the pattern cache key). Starts a new generation when the palette
+	  * changed since the previous call.
+	  */
+	inline uint32_t getPatternGeneration();
+
+	/** Draw the 8 pixels of a Graphic1/2/3 pattern, from the pattern
+	  * cache when possible.
+	  * @param index Position in the pattern table (the entry in the cache).
+	  */
+	inline void drawPattern(Pixel* __restrict & pixelPtr, unsigned index,
+	                        uint32_t generation, unsigned color,
+	                        unsigned pattern, bool misAligned,
+	                        uint32_t& partial);
+
 	VDP& vdp;
 	VDPVRAM& vram;
 
@@ -63,6 +80,32 @@ private:
 	const Pixel* const palBg;
 
 	unsigned modeBase;
+
+	/** The pattern caches are only used for 16bpp. For 32bpp, copying the
+	  * cached pixels is not faster than expanding the pattern (SSE2).
+	  */
+	static const bool USE_CACHE = sizeof(Pixel) == 2;
+
+	/** Cache of expanded patterns for Graphic1, 2 and 3: the 8 host pixels
+	  * for each position in the pattern table (the lower 13 bits of the
+	  * VRAM address). The key of an entry is the combination of palette
+	  * generation, color byte and pattern byte (see getPatternGeneration()),
+	  * so changes in VRAM don't need to be tracked separately.
+	  */
+	MemBuffer<Pixel, 32> patternPixels;
+	MemBuffer<uint32_t> patternKeys;
+	Pixel patternPalette[16];
+	uint32_t patternGeneration;
+
+	/** Similar cache for Text2: the 6 host pixels for each pattern byte,
+	  * both without and with the blink attribute. Entries are valid when
+	  * their key equals 'textGeneration', that changes when one of the
+	  * 4 text colors changes.
+	  */
+	MemBuffer<Pixel> textPixels;
+	MemBuffer<uint32_t> textKeys;
+	Pixel textColors[4];
+	uint32_t textGeneration;
 };
 
 } // namespace openmsx
@@ -10,6 +10,7 @@
 #include "InputEvents.hh"
 #include "CliComm.hh"
 #include "Timer.hh"
+#include "HostProfiler.hh"
 #include "BooleanSetting.hh"
 #include "IntegerSetting.hh"
 #include "EnumSetting.hh"
@@ -343,6 +344,8 @@ void Display::repaint()
 	prevTimeStamp = now;
 	frameDurationSum += duration - frameDurations.removeBack();
 	frameDurations.addFront(duration);
+
+	HostProfiler::endFrame();
 }
 
 void Display::repaint(OutputSurface& surface)
@@ -3,8 +3,7 @@
 #include "StretchScalerOutput.hh"
 #include "ScalerOutput.hh"
 #include "RenderSettings.hh"
-#include "Scaler.hh"
-#include "ScalerFactory.hh"
+#include "HostProfiler.hh"
 #include "OutputSurface.hh"
 #include "IntegerSetting.hh"
 #include "FloatSetting.hh"
@@ -14,10 +13,12 @@
 #include "aligned.hh"
 #include "random.hh"
 #include "xrange.hh"
+#include "vla.hh"
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 #ifdef __SSE2__
 #include <emmintrin.h>
 #endif
@@ -28,6 +29,11 @@ static const unsigned NOISE_SHIFT = 8192;
 static const unsigned NOISE_BUF_SIZE = 2 * NOISE_SHIFT;
 SSE_ALIGNED(static signed char noiseBuf[NOISE_BUF_SIZE]);
 
+// The scalers read at most 1 line above and 2 lines below (SaI) the line
+// they're scaling, also when those lines lay outside the scaled range.
+static const unsigned NEIGHBOURS_ABOVE = 1;
+static const unsigned NEIGHBOURS_BELOW = 2;
+
 template <class Pixel>
 void FBPostProcessor<Pixel>::preCalcNoise(float factor)
 {
@@ -220,6 +226,114 @@ void FBPostProcessor<Pixel>::drawNoise(OutputSurface& output)
 	}
 }
 
+template <class Pixel>
+bool FBPostProcessor<Pixel>::ScaleParams::operator==(
+	const ScaleParams& other) const
+{
+	return (algo      == other.algo)      &&
+	       (factor    == other.factor)    &&
+	       (scanline  == other.scanline)  &&
+	       (blur      == other.blur)      &&
+	       (inWidth   == other.inWidth)   &&
+	       (srcHeight == other.srcHeight) &&
+	       (dstWidth  == other.dstWidth)  &&
+	       (dstHeight == other.dstHeight);
+}
+
+template <class Pixel>
+void FBPostProcessor<Pixel>::findChangedLines()
+{
+	unsigned srcHeight = paintFrame->getHeight();
+	unsigned maxLineWidth = 0;
+	for (unsigned y = 0; y < srcHeight; ++y) {
+		maxLineWidth = std::max(maxLineWidth, paintFrame->getLineWidth(y));
+	}
+	if ((prevWidths.size() != srcHeight) || (prevPitch < maxLineWidth)) {
+		prevPitch = std::max(prevPitch, maxLineWidth);
+		prevLines.resize(srcHeight * prevPitch);
+		prevWidths.assign(srcHeight, 0); // all lines are changed
+	}
+
+	lineChanged.resize(srcHeight);
+	VLA_SSE_ALIGNED(Pixel, buf, prevPitch);
+	for (unsigned y = 0; y < srcHeight; ++y) {
+		unsigned width = paintFrame->getLineWidth(y);
+		const Pixel* line = paintFrame->getLinePtr(y, width, buf);
+		Pixel* prev = &prevLines[y * prevPitch];
+		bool changed = (prevWidths[y] != width) ||
+		               (memcmp(prev, line, width * sizeof(Pixel)) != 0);
+		if (changed) {
+			memcpy(prev, line, width * sizeof(Pixel));
+			prevWidths[y] = width;
+		}
+		lineChanged[y] = changed;
+	}
+}
+
+template <class Pixel>
+bool FBPostProcessor<Pixel>::isChanged(unsigned srcStartY, unsigned srcEndY) const
+{
+	unsigned begin = (srcStartY > NEIGHBOURS_ABOVE)
+	               ? (srcStartY - NEIGHBOURS_ABOVE) : 0;
+	unsigned end = std::min<unsigned>(srcEndY + NEIGHBOURS_BELOW,
+	                                  unsigned(lineChanged.size()));
+	for (unsigned y = begin; y < end; ++y) {
+		if (lineChanged[y]) return true;
+	}
+	return false;
+}
+
+template <class Pixel>
+unsigned FBPostProcessor<Pixel>::skipUnchangedLines(
+	OutputSurface& output, unsigned srcStep, unsigned dstStep)
+{
+	dirtyRegions.clear();
+	unsigned skipped = 0;
+	unsigned width = output.getWidth();
+	for (auto& r : regions) {
+		unsigned srcY = r.srcStartY;
+		unsigned dstY = r.dstStartY;
+		while (srcY < r.srcEndY) {
+			// collect blocks that are all changed or all unchanged
+			bool changed = isChanged(srcY, srcY + srcStep);
+			unsigned srcEndY = srcY + srcStep;
+			unsigned dstEndY = dstY + dstStep;
+			while ((srcEndY < r.srcEndY) &&
+			       (isChanged(srcEndY, srcEndY + srcStep) == changed)) {
+				srcEndY += srcStep;
+				dstEndY += dstStep;
+			}
+			if (changed) {
+				dirtyRegions.push_back({srcY, srcEndY, r.srcWidth,
+				                        dstY, dstEndY});
+			} else {
+				for (unsigned y = dstY; y < dstEndY; ++y) {
+					memcpy(output.getLinePtrDirect<Pixel>(y),
+					       &scaledLines[y * width],
+					       width * sizeof(Pixel));
+				}
+				skipped += srcEndY - srcY;
+			}
+			srcY = srcEndY;
+			dstY = dstEndY;
+		}
+	}
+	return skipped;
+}
+
+template <class Pixel>
+void FBPostProcessor<Pixel>::storeScaledLines(OutputSurface& output)
+{
+	unsigned width = output.getWidth();
+	for (auto& r : dirtyRegions) {
+		for (unsigned y = r.dstStartY; y < r.dstEndY; ++y) {
+			memcpy(&scaledLines[y * width],
+			       output.getLinePtrDirect<Pixel>(y),
+			       width * sizeof(Pixel));
+		}
+	}
+}
+
 template <class Pixel>
 void FBPostProcessor<Pixel>::update(const Setting& setting)
 {
@@ -238,12 +352,12 @@ FBPostProcessor<Pixel>::FBPostProcessor(MSXMotherBoard& motherBoard_,
 	: PostProcessor(
 		motherBoard_, display_, screen_, videoSource, maxWidth_, height_,
 		canDoInterlace_)
+	, scaler(renderSettings)
+	, prevPitch(0)
 	, noiseShift(screen.getHeight())
 	, pixelOps(screen.getSDLFormat())
 {
-	scaleAlgorithm = RenderSettings::NO_SCALER;
-	scaleFactor = unsigned(-1);
-
+	scaledParams = ScaleParams{RenderSettings::NO_SCALER, -1, 0, 0, 0, 0, 0, 0};
 	auto& noiseSetting = renderSettings.getNoiseSetting();
 	noiseSetting.attach(*this);
 	preCalcNoise(noiseSetting.getDouble());
@@ -259,6 +373,7 @@ FBPostProcessor<Pixel>::~FBPostProcessor()
 template <class Pixel>
 void FBPostProcessor<Pixel>::paint(OutputSurface& output)
 {
+	HostTimer timer(HostProfiler::POST_PROCESS);
 	if (renderSettings.getInterleaveBlackFrame()) {
 		interleaveCount ^= 1;
 		if (interleaveCount) {
@@ -269,17 +384,6 @@ void FBPostProcessor<Pixel>::paint(OutputSurface& output)
 
 	if (!paintFrame) return;
 
-	// New scaler algorithm selected?
-	auto algo = renderSettings.getScaleAlgorithm();
-	unsigned factor = renderSettings.getScaleFactor();
-	if ((scaleAlgorithm != algo) || (scaleFactor != factor)) {
-		scaleAlgorithm = algo;
-		scaleFactor = factor;
-		currScaler = ScalerFactory<Pixel>::createScaler(
-			PixelOperations<Pixel>(output.getSDLFormat()),
-			renderSettings);
-	}
-
 	// Scale image.
 	const unsigned srcHeight = paintFrame->getHeight();
 	const unsigned dstHeight = output.getHeight();
@@ -290,6 +394,7 @@ void FBPostProcessor<Pixel>::paint(OutputSurface& output)
 
 	// TODO: Store all MSX lines in RawFrame and only scale the ones that fit
 	//       on the PC screen, as a preparation for resizable output window.
+	regions.clear();
 	unsigned srcStartY = 0;
 	unsigned dstStartY = 0;
 	while (dstStartY < dstHeight) {
@@ -306,26 +411,56 @@ void FBPostProcessor<Pixel>::paint(OutputSurface& output)
 			srcEndY += srcStep;
 			dstEndY += dstStep;
 		}
-
-		// fill region
 		//fprintf(stderr, "post processing lines %d-%d: %d\n",
 		//	srcStartY, srcEndY, lineWidth );
-		output.lock();
-		float horStretch = renderSettings.getHorizontalStretch();
-		unsigned inWidth = unsigned(horStretch + 0.5f);
-		std::unique_ptr<ScalerOutput<Pixel>> dst(
-			StretchScalerOutputFactory<Pixel>::create(
-				output, pixelOps, inWidth));
-		currScaler->scaleImage(
-			*paintFrame, superImposeVideoFrame,
-			srcStartY, srcEndY, lineWidth, // source
-			*dst, dstStartY, dstEndY); // dest
+		regions.push_back({srcStartY, srcEndY, lineWidth,
+		                   dstStartY, dstEndY});
 
 		// next region
 		srcStartY = srcEndY;
 		dstStartY = dstEndY;
 	}
 
+	// fill regions
+	output.lock();
+	float horStretch = renderSettings.getHorizontalStretch();
+	unsigned inWidth = unsigned(horStretch + 0.5f);
+
+	// Only scale the lines that changed since the previous frame, the
+	// other lines are copied from the previous output. Not possible when
+	// a video frame is superimposed (that changes every frame) or with
+	// MLAA (that analyses complete regions at once).
+	ScaleParams params = {
+		renderSettings.getScaleAlgorithm(),
+		renderSettings.getScaleFactor(),
+		renderSettings.getScanlineFactor(),
+		renderSettings.getBlurFactor(),
+		inWidth, srcHeight, output.getWidth(), dstHeight };
+	bool skipLines = !superImposeVideoFrame &&
+	                 (params.algo != RenderSettings::SCALER_MLAA);
+	if (skipLines) {
+		findChangedLines();
+		if (!(params == scaledParams)) {
+			scaledParams = params;
+			scaledLines.resize(params.dstWidth * params.dstHeight);
+			lineChanged.assign(srcHeight, true);
+		}
+		unsigned skipped = skipUnchangedLines(output, srcStep, dstStep);
+		HostProfiler::count(HostProfiler::SCALE_SKIPPED_LINES, skipped);
+	} else {
+		scaledParams.factor = -1; // invalidate 'scaledLines'
+	}
+	auto& toScale = skipLines ? dirtyRegions : regions;
+	if (!toScale.empty()) {
+		scaler.scaleImage(
+			*paintFrame, superImposeVideoFrame, toScale,
+			srcStep, dstStep,
+			PixelOperations<Pixel>(output.getSDLFormat()),
+			[&] { return StretchScalerOutputFactory<Pixel>::create(
+			              output, pixelOps, inWidth); });
+	}
+	if (skipLines) storeScaledLines(output);
+
 	drawNoise(output);
 
 	output.flushFrameBuffer(); // for SDLGL-FBxx
@@ -2,15 +2,15 @@
 #define FBPOSTPROCESSOR_HH
 
 #include "PostProcessor.hh"
-#include "RenderSettings.hh"
+#include "ParallelScaler.hh"
 #include "PixelOperations.hh"
+#include "MemBuffer.hh"
 #include <vector>
 
 namespace openmsx {
 
 class MSXMotherBoard;
 class Display;
-template<typename Pixel> class Scaler;
 
 /** Rasterizer using SDL.
   */
@@ -36,20 +36,69 @@ private:
 	void drawNoiseLine(Pixel* buf, signed char* noise,
 	                   size_t width);
 
+	/** Compare the lines of 'paintFrame' with the lines of the previously
+	  * painted frame (and remember the new lines), see 'lineChanged'.
+	  */
+	void findChangedLines();
+
+	/** Can the scaled output of source lines [srcStartY, srcEndY) be
+	  * different from the previous frame? This also checks the
+	  * neighbouring lines that the scalers read.
+	  */
+	bool isChanged(unsigned srcStartY, unsigned srcEndY) const;
+
+	/** Split 'regions' in the parts that need to be scaled (stored in
+	  * 'dirtyRegions') and the parts that didn't change since the previous
+	  * frame, those are copied from 'scaledLines' to the output.
+	  * @return The number of skipped source lines.
+	  */
+	unsigned skipUnchangedLines(OutputSurface& output,
+	                            unsigned srcStep, unsigned dstStep);
+
+	/** Copy the lines of 'dirtyRegions' from the output to 'scaledLines'.
+	  */
+	void storeScaledLines(OutputSurface& output);
+
 	// Observer<Setting>
 	void update(const Setting& setting) override;
 
-	/** The currently active scaler.
+	/** Runs the currently active scaler (possibly in parallel).
+	  */
+	ParallelScaler<Pixel> scaler;
+
+	/** The regions of the current frame (reused to avoid allocations).
+	  */
+	std::vector<typename ParallelScaler<Pixel>::Region> regions;
+
+	/** The parts of 'regions' that actually need to be scaled.
+	  */
+	std::vector<typename ParallelScaler<Pixel>::Region> dirtyRegions;
+
+	/** Everything (except for the source lines) that influences the
+	  * scaled image. When any of this changes all lines are scaled again.
+	  */
+	struct ScaleParams {
+		bool operator==(const ScaleParams& other) const;
+		RenderSettings::ScaleAlgorithm algo;
+		int factor, scanline, blur;
+		unsigned inWidth, srcHeight, dstWidth, dstHeight;
+	};
+	ScaleParams scaledParams;
+
+	/** Copy of the (unscaled) lines of the previously painted frame,
+	  * 'prevPitch' pixels per line.
 	  */
-	std::unique_ptr<Scaler<Pixel>> currScaler;
+	MemBuffer<Pixel> prevLines;
+	std::vector<unsigned> prevWidths;
+	unsigned prevPitch;
 
-	/** Currently active scale algorithm, used to detect scaler changes.
+	/** Per source line: is it different from the previous frame?
 	  */
-	RenderSettings::ScaleAlgorithm scaleAlgorithm;
+	std::vector<bool> lineChanged;
 
-	/** Currently active scale factor, used to detect scaler changes.
+	/** The scaled lines of the previously painted frame (without noise).
 	  */
-	unsigned scaleFactor;
+	MemBuffer<Pixel> scaledLines;
 
 	/** Remember the noise values to get a stable image when paused.
 	 */
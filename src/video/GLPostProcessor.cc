@@ -10,6 +10,7 @@
 #include "RawFrame.hh"
 #include "Math.hh"
 #include "InitException.hh"
+#include "HostProfiler.hh"
 #include "gl_transform.hh"
 #include "random.hh"
 #include "stl.hh"
@@ -125,6 +126,7 @@ void GLPostProcessor::createRegions()
 
 void GLPostProcessor::paint(OutputSurface& /*output*/)
 {
+	HostTimer timer(HostProfiler::POST_PROCESS);
 	if (renderSettings.getInterleaveBlackFrame()) {
 		interleaveCount ^= 1;
 		if (interleaveCount) {
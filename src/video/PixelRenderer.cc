@@ -17,9 +17,12 @@ TODO:
 #include "EventDistributor.hh"
 #include "FinishFrameEvent.hh"
 #include "RealTime.hh"
+#include "RasterizerThread.hh"
 #include "MSXMotherBoard.hh"
 #include "Reactor.hh"
 #include "Timer.hh"
+#include "HostProfiler.hh"
+#include "memory.hh"
 #include "unreachable.hh"
 #include <algorithm>
 #include <cassert>
@@ -30,7 +33,11 @@ void PixelRenderer::draw(
 	int startX, int startY, int endX, int endY, DrawType drawType, bool atEnd)
 {
 	if (drawType == DRAW_BORDER) {
-		rasterizer->drawBorder(startX, startY, endX, endY);
+		if (rasterizerThread) {
+			rasterizerThread->drawBorder(startX, startY, endX, endY);
+		} else {
+			rasterizer->drawBorder(startX, startY, endX, endY);
+		}
 	} else {
 		assert(drawType == DRAW_DISPLAY);
 
@@ -58,16 +65,31 @@ void PixelRenderer::draw(
 		assert(0 <= displayX);
 		assert(displayX + displayWidth <= 512);
 
-		rasterizer->drawDisplay(
-			startX, startY,
-			displayX - vdp.getHorizontalScrollLow() * 2, displayY,
-			displayWidth, displayHeight
-			);
-		if (vdp.spritesEnabled() && !renderSettings.getDisableSprites()) {
-			rasterizer->drawSprites(
+		if (rasterizerThread) {
+			if (pendingDisplayY == -1) pendingDisplayY = startY;
+			rasterizerThread->drawDisplay(
 				startX, startY,
-				displayX / 2, displayY,
-				(displayWidth + 1) / 2, displayHeight);
+				displayX - vdp.getHorizontalScrollLow() * 2, displayY,
+				displayWidth, displayHeight);
+		} else {
+			rasterizer->drawDisplay(
+				startX, startY,
+				displayX - vdp.getHorizontalScrollLow() * 2, displayY,
+				displayWidth, displayHeight
+				);
+		}
+		if (vdp.spritesEnabled() && !renderSettings.getDisableSprites()) {
+			if (rasterizerThread) {
+				rasterizerThread->drawSprites(
+					startX, startY,
+					displayX / 2, displayY,
+					(displayWidth + 1) / 2, displayHeight);
+			} else {
+				rasterizer->drawSprites(
+					startX, startY,
+					displayX / 2, displayY,
+					(displayWidth + 1) / 2, displayHeight);
+			}
 		}
 	}
 }
@@ -122,17 +144,39 @@ PixelRenderer::PixelRenderer(VDP& vdp_, Display& display)
 	finishFrameDuration = 0;
 	frameSkipCounter = 999; // force drawing of frame
 	prevRenderFrame = false;
+	pendingDisplayY = -1;
+	if (renderSettings.getRenderThread()) {
+		rasterizerThread = make_unique<RasterizerThread>(*rasterizer);
+	}
 
 	renderSettings.getMaxFrameSkipSetting().attach(*this);
 	renderSettings.getMinFrameSkipSetting().attach(*this);
+	renderSettings.getRenderThreadSetting().attach(*this);
+	renderSettings.getGammaSetting()       .attach(*this);
+	renderSettings.getBrightnessSetting()  .attach(*this);
+	renderSettings.getContrastSetting()    .attach(*this);
+	renderSettings.getColorMatrixSetting() .attach(*this);
 }
 
 PixelRenderer::~PixelRenderer()
 {
+	renderSettings.getColorMatrixSetting() .detach(*this);
+	renderSettings.getContrastSetting()    .detach(*this);
+	renderSettings.getBrightnessSetting()  .detach(*this);
+	renderSettings.getGammaSetting()       .detach(*this);
+	renderSettings.getRenderThreadSetting().detach(*this);
 	renderSettings.getMinFrameSkipSetting().detach(*this);
 	renderSettings.getMaxFrameSkipSetting().detach(*this);
 }
 
+inline void PixelRenderer::waitRasterizer()
+{
+	if (rasterizerThread) {
+		rasterizerThread->flush();
+		pendingDisplayY = -1;
+	}
+}
+
 PostProcessor* PixelRenderer::getPostProcessor() const
 {
 	return rasterizer->getPostProcessor();
@@ -145,6 +189,7 @@ void PixelRenderer::reInit()
 	// renderer in the middle of a frame.
 	renderFrame = false;
 
+	waitRasterizer();
 	rasterizer->reset();
 	displayEnabled = vdp.isDisplayEnabled();
 }
@@ -152,11 +197,14 @@ void PixelRenderer::reInit()
 void PixelRenderer::updateDisplayEnabled(bool enabled, EmuTime::param time)
 {
 	sync(time, true);
+	// No need to wait for the rasterizer: this flag is only used by
+	// PixelRenderer itself, the rasterizer doesn't depend on it.
 	displayEnabled = enabled;
 }
 
 void PixelRenderer::frameStart(EmuTime::param time)
 {
+	waitRasterizer();
 	if (!rasterizer->isActive()) {
 		frameSkipCounter = 999;
 		renderFrame = false;
@@ -206,6 +254,7 @@ void PixelRenderer::frameEnd(EmuTime::param time)
 	if (renderFrame) {
 		// Render changes from this last frame.
 		sync(time, true);
+		waitRasterizer();
 
 		// Let underlying graphics system finish rendering this frame.
 		auto time1 = Timer::getTime();
@@ -238,6 +287,7 @@ void PixelRenderer::updateHorizontalScrollLow(
 	byte scroll, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 	rasterizer->setHorizontalScrollLow(scroll);
 }
 
@@ -245,12 +295,14 @@ void PixelRenderer::updateHorizontalScrollHigh(
 	byte /*scroll*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updateBorderMask(
 	bool masked, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 	rasterizer->setBorderMask(masked);
 }
 
@@ -258,12 +310,14 @@ void PixelRenderer::updateMultiPage(
 	bool /*multiPage*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updateTransparency(
 	bool enabled, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 	rasterizer->setTransparency(enabled);
 }
 
@@ -271,6 +325,7 @@ void PixelRenderer::updateSuperimposing(
 	const RawFrame* videoSource, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 	rasterizer->setSuperimposeVideoFrame(videoSource);
 }
 
@@ -278,12 +333,14 @@ void PixelRenderer::updateForegroundColor(
 	int /*color*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updateBackgroundColor(
 	int color, EmuTime::param time)
 {
 	sync(time);
+	waitRasterizer();
 	rasterizer->setBackgroundColor(color);
 }
 
@@ -291,12 +348,14 @@ void PixelRenderer::updateBlinkForegroundColor(
 	int /*color*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updateBlinkBackgroundColor(
 	int /*color*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updateBlinkState(
@@ -307,6 +366,9 @@ void PixelRenderer::updateBlinkState(
 	//       I don't know why exactly, but it's probably related to
 	//       being called at frame start.
 	//sync(time);
+
+	// But the rasterizer does read the blink state.
+	waitRasterizer();
 }
 
 void PixelRenderer::updatePalette(
@@ -328,6 +390,7 @@ void PixelRenderer::updatePalette(
 			}
 		}
 	}
+	waitRasterizer();
 	rasterizer->setPalette(index, grb);
 }
 
@@ -335,12 +398,14 @@ void PixelRenderer::updateVerticalScroll(
 	int /*scroll*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updateHorizontalAdjust(
 	int adjust, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 	rasterizer->setHorizontalAdjust(adjust);
 }
 
@@ -356,6 +421,7 @@ void PixelRenderer::updateDisplayMode(
 	|| mode.getByte() == DisplayMode::GRAPHIC7) {
 		sync(time, true);
 	}
+	waitRasterizer();
 	rasterizer->setDisplayMode(mode);
 }
 
@@ -363,24 +429,28 @@ void PixelRenderer::updateNameBase(
 	int /*addr*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updatePatternBase(
 	int /*addr*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updateColorBase(
 	int /*addr*/, EmuTime::param time)
 {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 void PixelRenderer::updateSpritesEnabled(
 	bool /*enabled*/, EmuTime::param time
 ) {
 	if (displayEnabled) sync(time);
+	waitRasterizer();
 }
 
 static inline bool overlap(
@@ -415,10 +485,15 @@ inline bool PixelRenderer::checkSync(int offset, EmuTime::param time)
 
 	// Calculate what display lines are scanned between current
 	// renderer time and update-to time.
+	int limitY = vdp.getTicksThisFrame(time) / VDP::TICKS_PER_LINE;
+	return affectsLines(offset, nextY, limitY);
+}
+
+bool PixelRenderer::affectsLines(int offset, int fromY, int limitY) const
+{
 	// Note: displayY1 is inclusive.
 	int deltaY = vdp.getVerticalScroll() - vdp.getLineZero();
-	int limitY = vdp.getTicksThisFrame(time) / VDP::TICKS_PER_LINE;
-	int displayY0 = (nextY + deltaY) & 255;
+	int displayY0 = (fromY  + deltaY) & 255;
 	int displayY1 = (limitY + deltaY) & 255;
 
 	switch(vdp.getDisplayMode().getBase()) {
@@ -495,6 +570,14 @@ void PixelRenderer::updateVRAM(unsigned offset, EmuTime::param time)
 		//fprintf(stderr, "vram sync @ line %d\n",
 		//	vdp.getTicksThisFrame(time) / VDP::TICKS_PER_LINE);
 		renderUntil(time);
+		// The lines that were just drawn need the old VRAM content.
+		waitRasterizer();
+	} else if ((pendingDisplayY != -1) &&
+	           affectsLines(offset, pendingDisplayY, nextY)) {
+		// Lines that are still being drawn (in the rasterizer thread)
+		// need the old VRAM content. Other VRAM changes (e.g. in a
+		// non-visible page or in the sprite tables) don't have to wait.
+		waitRasterizer();
 	}
 }
 
@@ -530,6 +613,8 @@ void PixelRenderer::sync(EmuTime::param time, bool force)
 
 void PixelRenderer::renderUntil(EmuTime::param time)
 {
+	HostTimer timer(HostProfiler::RENDER);
+
 	// Translate from time to pixel position.
 	int limitTicks = vdp.getTicksThisFrame(time);
 	assert(limitTicks <= vdp.getTicksPerFrame());
@@ -598,6 +683,8 @@ void PixelRenderer::renderUntil(EmuTime::param time)
 
 	nextX = limitX;
 	nextY = limitY;
+
+	if (rasterizerThread) rasterizerThread->submit();
 }
 
 void PixelRenderer::update(const Setting& setting)
@@ -606,6 +693,23 @@ void PixelRenderer::update(const Setting& setting)
 	    &setting == &renderSettings.getMaxFrameSkipSetting()) {
 		// Force drawing of frame.
 		frameSkipCounter = 999;
+	} else if (&setting == &renderSettings.getRenderThreadSetting()) {
+		waitRasterizer();
+		if (renderSettings.getRenderThread()) {
+			if (!rasterizerThread) {
+				rasterizerThread = make_unique<RasterizerThread>(
+					*rasterizer);
+			}
+		} else {
+			rasterizerThread.reset();
+		}
+	} else if (&setting == &renderSettings.getGammaSetting() ||
+	           &setting == &renderSettings.getBrightnessSetting() ||
+	           &setting == &renderSettings.getContrastSetting() ||
+	           &setting == &renderSettings.getColorMatrixSetting()) {
+		// The rasterizer thread may be using the palette.
+		waitRasterizer();
+		rasterizer->colorSettingsChanged();
 	} else {
 		UNREACHABLE;
 	}
@@ -13,6 +13,7 @@ class EventDistributor;
 class RealTime;
 class Display;
 class Rasterizer;
+class RasterizerThread;
 class VDP;
 class VDPVRAM;
 class SpriteChecker;
@@ -84,6 +85,18 @@ private:
 
 	inline bool checkSync(int offset, EmuTime::param time);
 
+	/** Does a change of the given VRAM address affect the (display)
+	  * lines [fromY, limitY]?
+	  */
+	bool affectsLines(int offset, int fromY, int limitY) const;
+
+	/** Wait until the rasterizer thread (if any) has finished all drawing.
+	  * Must be called before anything that the rasterizer reads while
+	  * drawing changes (VDP registers, VRAM, sprites, palette) and before
+	  * calling any other rasterizer method.
+	  */
+	inline void waitRasterizer();
+
 	/** Update renderer state to specified moment in time.
 	  * @param time Moment in emulated time to update to.
 	  * @param force When screen accuracy is used,
@@ -118,6 +131,16 @@ private:
 
 	const std::unique_ptr<Rasterizer> rasterizer;
 
+	/** When the 'render_thread' setting is enabled, the draw calls are
+	  * executed by this thread, in parallel with the emulation.
+	  */
+	std::unique_ptr<RasterizerThread> rasterizerThread;
+
+	/** First line of the display area that was drawn via the rasterizer
+	  * thread and that is possibly not finished yet, -1 if none.
+	  */
+	int pendingDisplayY;
+
 	float finishFrameDuration;
 	int frameSkipCounter;
 
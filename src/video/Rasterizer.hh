@@ -51,6 +51,11 @@ public:
 	  */
 	virtual void setPalette(int index, int grb) = 0;
 
+	/** The gamma, brightness, contrast or color matrix setting changed,
+	  * recalculate the host colors of the palette.
+	  */
+	virtual void colorSettingsChanged() = 0;
+
 	/** Changes the background color.
 	  * @param index Palette index of the new background color.
 	  */
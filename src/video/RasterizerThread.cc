@@ -0,0 +1,112 @@
+#include "RasterizerThread.hh"
+#include "Rasterizer.hh"
+#include "HostProfiler.hh"
+#include "unreachable.hh"
+
+namespace openmsx {
+
+RasterizerThread::RasterizerThread(Rasterizer& rasterizer_)
+	: rasterizer(rasterizer_)
+	, pending(0)
+	, stop(false)
+{
+	// Only start the thread when all other members are initialized.
+	thread = std::thread([this] { run(); });
+}
+
+RasterizerThread::~RasterizerThread()
+{
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	workCondition.notify_one();
+	thread.join();
+}
+
+void RasterizerThread::drawBorder(int fromX, int fromY, int limitX, int limitY)
+{
+	recorded.push_back({BORDER, {fromX, fromY, limitX, limitY, 0, 0}});
+}
+
+void RasterizerThread::drawDisplay(
+	int fromX, int fromY, int displayX, int displayY,
+	int displayWidth, int displayHeight)
+{
+	recorded.push_back({DISPLAY, {fromX, fromY, displayX, displayY,
+	                              displayWidth, displayHeight}});
+}
+
+void RasterizerThread::drawSprites(
+	int fromX, int fromY, int displayX, int displayY,
+	int displayWidth, int displayHeight)
+{
+	recorded.push_back({SPRITES, {fromX, fromY, displayX, displayY,
+	                              displayWidth, displayHeight}});
+}
+
+void RasterizerThread::submit()
+{
+	if (recorded.empty()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.fetch_add(unsigned(recorded.size()));
+		queue.insert(queue.end(), recorded.begin(), recorded.end());
+	}
+	recorded.clear();
+	workCondition.notify_one();
+}
+
+void RasterizerThread::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [&] { return pending.load() == 0; });
+}
+
+void RasterizerThread::run()
+{
+	std::vector<Command> commands;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workCondition.wait(lock, [&] {
+				return stop || !queue.empty(); });
+			if (queue.empty()) return; // stop
+			swap(commands, queue);
+		}
+
+		{
+			HostTimer timer(HostProfiler::RENDER);
+			for (auto& c : commands) {
+				switch (c.type) {
+				case BORDER:
+					rasterizer.drawBorder(
+						c.p[0], c.p[1], c.p[2], c.p[3]);
+					break;
+				case DISPLAY:
+					rasterizer.drawDisplay(
+						c.p[0], c.p[1], c.p[2], c.p[3],
+						c.p[4], c.p[5]);
+					break;
+				case SPRITES:
+					rasterizer.drawSprites(
+						c.p[0], c.p[1], c.p[2], c.p[3],
+						c.p[4], c.p[5]);
+					break;
+				default:
+					UNREACHABLE;
+				}
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending.fetch_sub(unsigned(commands.size()));
+		}
+		commands.clear();
+		doneCondition.notify_all();
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,72 @@
+#ifndef RASTERIZERTHREAD_HH
+#define RASTERIZERTHREAD_HH
+
+#include "likely.hh"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace openmsx {
+
+class Rasterizer;
+
+/** Executes the draw calls (drawBorder(), drawDisplay() and drawSprites())
+  * of a Rasterizer in a separate thread.
+  *
+  * The draw calls are only recorded in a command list, submit() hands that
+  * list to the thread. The rasterizer reads the VDP registers, VRAM and the
+  * sprite checker while it draws, so the owner must call flush() before any
+  * of those change (or before it calls any other Rasterizer method). See
+  * PixelRenderer for the details.
+  */
+class RasterizerThread
+{
+public:
+	explicit RasterizerThread(Rasterizer& rasterizer);
+	~RasterizerThread();
+
+	// Same parameters as the corresponding Rasterizer methods.
+	void drawBorder(int fromX, int fromY, int limitX, int limitY);
+	void drawDisplay(int fromX, int fromY, int displayX, int displayY,
+	                 int displayWidth, int displayHeight);
+	void drawSprites(int fromX, int fromY, int displayX, int displayY,
+	                 int displayWidth, int displayHeight);
+
+	/** Start executing the recorded draw calls. */
+	void submit();
+
+	/** Execute the draw calls that are not yet submitted and wait until
+	  * all draw calls are finished. */
+	void flush() {
+		if (!recorded.empty()) submit();
+		if (unlikely(pending.load(std::memory_order_acquire) != 0)) {
+			wait();
+		}
+	}
+
+private:
+	enum Type { BORDER, DISPLAY, SPRITES };
+	struct Command {
+		Type type;
+		int p[6];
+	};
+
+	void wait();
+	void run();
+
+	Rasterizer& rasterizer;
+	std::vector<Command> recorded; // only used by the owner
+	std::vector<Command> queue;    // protected by mutex
+	std::atomic<unsigned> pending; // submitted but not finished commands
+	std::mutex mutex;
+	std::condition_variable workCondition;
+	std::condition_variable doneCondition;
+	bool stop; // protected by mutex
+	std::thread thread;
+};
+
+} // namespace openmsx
+
+#endif
@@ -126,6 +126,13 @@ RenderSettings::RenderSettings(CommandController& commandController)
 		"scale_factor", "scale factor",
 		std::min(2, MAX_SCALE_FACTOR), MIN_SCALE_FACTOR, MAX_SCALE_FACTOR)
 
+	, scaleThreadsSetting(commandController,
+		"scale_threads",
+		"number of extra threads used to scale the MSX screen in "
+		"parallel (only for the SDL and SDLGL-FBxx renderers), 0 means "
+		"scale in the main thread",
+		0, 0, 16)
+
 	, scanlineAlphaSetting(commandController,
 		"scanline", "amount of scanline effect: 0 = none, 100 = full",
 		20, 0, 100)
@@ -186,6 +193,12 @@ RenderSettings::RenderSettings(CommandController& commandController)
 		"Useful on (100Hz+) lightboost enabled monitors to reduce "
 		"motion blur and double frame artifacts.",
 		false)
+
+	, renderThreadSetting(commandController,
+		"render_thread",
+		"draw the MSX screen in a separate thread, in parallel with "
+		"the emulation of the MSX",
+		false)
 {
 	brightnessSetting.attach(*this);
 	contrastSetting  .attach(*this);
@@ -93,20 +93,11 @@ SDLRasterizer<Pixel>::SDLRasterizer(
 				V9938_COLORS[0][0][0];
 		}
 	}
-
-	renderSettings.getGammaSetting()      .attach(*this);
-	renderSettings.getBrightnessSetting() .attach(*this);
-	renderSettings.getContrastSetting()   .attach(*this);
-	renderSettings.getColorMatrixSetting().attach(*this);
 }
 
 template <class Pixel>
 SDLRasterizer<Pixel>::~SDLRasterizer()
 {
-	renderSettings.getColorMatrixSetting().detach(*this);
-	renderSettings.getGammaSetting()      .detach(*this);
-	renderSettings.getBrightnessSetting() .detach(*this);
-	renderSettings.getContrastSetting()   .detach(*this);
 }
 
 template <class Pixel>
@@ -676,15 +667,10 @@ bool SDLRasterizer<Pixel>::isRecording() const
 }
 
 template <class Pixel>
-void SDLRasterizer<Pixel>::update(const Setting& setting)
+void SDLRasterizer<Pixel>::colorSettingsChanged()
 {
-	if ((&setting == &renderSettings.getGammaSetting()) ||
-	    (&setting == &renderSettings.getBrightnessSetting()) ||
-	    (&setting == &renderSettings.getContrastSetting()) ||
-	    (&setting == &renderSettings.getColorMatrixSetting())) {
-		precalcPalette();
-		resetPalette();
-	}
+	precalcPalette();
+	resetPalette();
 }
 
 
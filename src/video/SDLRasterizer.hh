@@ -5,7 +5,6 @@
 #include "BitmapConverter.hh"
 #include "CharacterConverter.hh"
 #include "SpriteConverter.hh"
-#include "Observer.hh"
 #include "openmsx.hh"
 #include <memory>
 
@@ -18,7 +17,6 @@ class OutputSurface;
 class VisibleSurface;
 class RawFrame;
 class RenderSettings;
-class Setting;
 class PostProcessor;
 
 /** Rasterizer using a frame buffer approach: it writes pixels to a single
@@ -26,7 +24,6 @@ class PostProcessor;
   */
 template <class Pixel>
 class SDLRasterizer final : public Rasterizer
-                          , private Observer<Setting>
 {
 public:
 	SDLRasterizer(const SDLRasterizer&) = delete;
@@ -45,6 +42,7 @@ public:
 	void frameEnd() override;
 	void setDisplayMode(DisplayMode mode) override;
 	void setPalette(int index, int grb) override;
+	void colorSettingsChanged() override;
 	void setBackgroundColor(int index) override;
 	void setHorizontalAdjust(int adjust) override;
 	void setHorizontalScrollLow(byte scroll) override;
@@ -88,9 +86,6 @@ private:
 	// Get the border color(s). These are 16bpp or 32bpp host pixels.
 	void getBorderColors(Pixel& border0, Pixel& border1);
 
-	// Observer<Setting>
-	void update(const Setting& setting) override;
-
 	/** The VDP of which the video output is being rendered.
 	  */
 	VDP& vdp;
@@ -1,6 +1,7 @@
 #include "VDPVRAM.hh"
 #include "SpriteChecker.hh"
 #include "Renderer.hh"
+#include "MSXMotherBoard.hh"
 #include "Math.hh"
 #include "outer.hh"
 #include "serialize.hh"
@@ -69,6 +70,18 @@ void VDPVRAM::LogicalVRAMDebuggable::write(
 	vram.cpuWrite(transform(address), value, time);
 }
 
+// Unlike read(), this doesn't steal VDP access slots: the debugger (e.g. a
+// VRAM viewer that polls every frame) shouldn't influence the emulation.
+void VDPVRAM::LogicalVRAMDebuggable::readBlock(
+	unsigned start, byte* output, unsigned num)
+{
+	auto& vram = OUTER(VDPVRAM, logicalVRAMDebug);
+	vram.cmdEngine->sync(getMotherBoard().getCurrentTime());
+	for (unsigned i = 0; i < num; ++i) {
+		output[i] = vram.data[transform(start + i) & vram.sizeMask];
+	}
+}
+
 
 // class PhysicalVRAMDebuggable
 
@@ -94,6 +107,14 @@ void VDPVRAM::PhysicalVRAMDebuggable::write(
 	vram.cpuWrite(address, value, time);
 }
 
+void VDPVRAM::PhysicalVRAMDebuggable::readBlock(
+	unsigned start, byte* output, unsigned num)
+{
+	auto& vram = OUTER(VDPVRAM, physicalVRAMDebug);
+	vram.cmdEngine->sync(getMotherBoard().getCurrentTime());
+	memcpy(output, &vram.data[start], num);
+}
+
 
 // class VDPVRAM
 
@@ -615,6 +615,7 @@ private:
 		explicit LogicalVRAMDebuggable(VDP& vdp);
 		byte read(unsigned address, EmuTime::param time) override;
 		void write(unsigned address, byte value, EmuTime::param time) override;
+		void readBlock(unsigned start, byte* output, unsigned num) override;
 	private:
 		unsigned transform(unsigned address);
 	} logicalVRAMDebug;
@@ -627,6 +628,7 @@ private:
 		PhysicalVRAMDebuggable(VDP& vdp, unsigned actualSize);
 		byte read(unsigned address, EmuTime::param time) override;
 		void write(unsigned address, byte value, EmuTime::param time) override;
+		void readBlock(unsigned start, byte* output, unsigned num) override;
 	} physicalVRAMDebug;
 
 	// TODO: Renderer field can be removed, if updateDisplayMode
@@ -39,6 +39,9 @@ void HQ_1x1on3x3<Pixel>::operator()(
 	c5 = c6 = readPixel(in1[0]);
 	c8 = c9 = readPixel(in2[0]);
 
+	VLA(unsigned, edges, srcWidth);
+	calcEdgesHQ(in1, in2, srcWidth, edges, edgeOp);
+
 	unsigned pattern = 0;
 	if (edgeOp(c5, c8)) pattern |= 3 <<  6;
 	if (edgeOp(c5, c2)) pattern |= 3 <<  9;
@@ -60,11 +63,8 @@ void HQ_1x1on3x3<Pixel>::operator()(
 		// overlaps with top and left
 		//if (edgeOp(c5, c1)) pattern |= 1 <<  3; //     l: c2-c6 9,  t: c4-c8 0
 		//if (edgeOp(c4, c2)) pattern |= 1 <<  4; //     l: c5-c3 10, t: c5-c7 1
-		// non-overlapping pixels
-		if (edgeOp(c5, c8)) pattern |= 1 <<  5; // B
-		if (edgeOp(c5, c9)) pattern |= 1 <<  6; // BR
-		if (edgeOp(c6, c8)) pattern |= 1 <<  7; // BR
-		if (edgeOp(c5, c6)) pattern |= 1 <<  8; // R
+		// non-overlapping pixels (B, BR, BR, R), see calcEdgesHQ()
+		pattern |= edges[x];
 		// overlaps with top
 		//if (edgeOp(c2, c6)) pattern |= 1 <<  9; // R - t: c5-c9 6
 		//if (edgeOp(c5, c3)) pattern |= 1 << 10; // R - t: c6-c8 7
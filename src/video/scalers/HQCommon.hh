@@ -10,6 +10,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#ifdef __SSE2__
+#include "HostCPU.hh"
+#include "ScalersAVX2.hh"
+#endif
 
 namespace openmsx {
 
@@ -74,6 +78,11 @@ public:
 
 		return false;
 	}
+
+	unsigned getShiftR() const { return shiftR; }
+	unsigned getShiftG() const { return shiftG; }
+	unsigned getShiftB() const { return shiftB; }
+
 private:
 	const unsigned shiftR;
 	const unsigned shiftG;
@@ -92,6 +101,39 @@ EdgeHQ createEdgeHQ(const PixelOperations<Pixel>& pixelOps)
 	}
 }
 
+/** Calculates the edges between each pixel of line 'in1', its right neighbour
+  * and the pixels below those (line 'in2'). These are the non-overlapping
+  * edges (bits 5-8) of the HQ pattern of each pixel. The last pixel of a line
+  * is its own right neighbour.
+  */
+template <typename Pixel>
+static void calcEdgesHQ(const Pixel* __restrict in1, const Pixel* __restrict in2,
+                        unsigned srcWidth, unsigned* __restrict edges,
+                        EdgeHQ edgeOp)
+{
+	unsigned x = 0;
+#ifdef __SSE2__
+	if (HostCPU::hasAVX2()) {
+		x = (srcWidth - 1) & ~7;
+		avx2::calcEdgesHQ(in1, in2, edges, x, edgeOp.getShiftR(),
+		                  edgeOp.getShiftG(), edgeOp.getShiftB());
+	}
+#endif
+	for (/* */; x < srcWidth; ++x) {
+		unsigned next = std::min(x + 1, srcWidth - 1);
+		uint32_t c5 = readPixel(in1[x]);
+		uint32_t c6 = readPixel(in1[next]);
+		uint32_t c8 = readPixel(in2[x]);
+		uint32_t c9 = readPixel(in2[next]);
+		unsigned pattern = 0;
+		if (edgeOp(c5, c8)) pattern |= 1 << 5; // B
+		if (edgeOp(c5, c9)) pattern |= 1 << 6; // BR
+		if (edgeOp(c6, c8)) pattern |= 1 << 7; // BR
+		if (edgeOp(c5, c6)) pattern |= 1 << 8; // R
+		edges[x] = pattern;
+	}
+}
+
 struct EdgeHQLite
 {
 	inline bool operator()(uint32_t c1, uint32_t c2) const
@@ -8,6 +8,8 @@
 #include <cassert>
 #ifdef __SSE2__
 #include "emmintrin.h"
+#include "HostCPU.hh"
+#include "ScalersAVX2.hh"
 #endif
 #ifdef __SSSE3__
 #include "tmmintrin.h"
@@ -361,7 +363,7 @@ static inline void scale_1onN(
 	const Pixel* __restrict in, Pixel* __restrict out, size_t width)
 {
 	unsigned i = 0, j = 0;
-	for (/* */; i < (width - (N - 1)); i += N, j += 1) {
+	for (/* */; (i + N) <= width; i += N, j += 1) {
 		Pixel pix = in[j];
 		for (unsigned k = 0; k < N; ++k) {
 			out[i + k] = pix;
@@ -375,6 +377,15 @@ static inline void scale_1onN(
 template <typename Pixel>
 void Scale_1on3<Pixel>::operator()(const Pixel* in, Pixel* out, size_t width)
 {
+#ifdef __SSE2__
+	if (HostCPU::hasAVX2()) {
+		size_t srcWidth = (width / 3) & ~15;
+		avx2::scale_1on3(in, out, srcWidth);
+		in    +=     srcWidth;
+		out   += 3 * srcWidth;
+		width -= 3 * srcWidth;
+	}
+#endif
 	scale_1onN<Pixel, 3>(in, out, width);
 }
 
@@ -473,7 +484,11 @@ void Scale_1on2<Pixel>::operator()(
 #ifdef __SSE2__
 	size_t chunk = 4 * sizeof(__m128i) / sizeof(Pixel);
 	size_t srcWidth2 = srcWidth & ~(chunk - 1);
-	scale_1on2_SSE(in, out, srcWidth2);
+	if (HostCPU::hasAVX2()) {
+		avx2::scale_1on2(in, out, srcWidth2);
+	} else {
+		scale_1on2_SSE(in, out, srcWidth2);
+	}
 	in  +=      srcWidth2;
 	out +=  2 * srcWidth2;
 	srcWidth -= srcWidth2;
@@ -1085,9 +1100,16 @@ void BlendLines<Pixel, w1, w2>::operator()(
 	const Pixel* in1, const Pixel* in2, Pixel* out, unsigned width)
 {
 	// It _IS_ allowed that the output is the same as one of the inputs.
-	// TODO SSE optimizations
+	unsigned i = 0;
+#ifdef __SSE2__
+	if ((w1 == w2) && HostCPU::hasAVX2()) {
+		// blend<1, 1>() is avgDown()
+		i = width & ~15;
+		avx2::blendLines(in1, in2, out, i, pixelOps.getBlendMask());
+	}
+#endif
 	// pure C++ version
-	for (unsigned i = 0; i < width; ++i) {
+	for (/* */; i < width; ++i) {
 		out[i] = pixelOps.template blend<w1, w2>(in1[i], in2[i]);
 	}
 }
@@ -1108,7 +1130,15 @@ void ZoomLine<Pixel>::operator()(
 
 	unsigned step = FACTOR * inWidth / outWidth;
 	unsigned i = 0 * FACTOR;
-	for (unsigned o = 0; o < outWidth; ++o) {
+	unsigned o = 0;
+#ifdef __SSE2__
+	if ((sizeof(Pixel) == 4) && HostCPU::hasAVX2()) {
+		o = outWidth & ~15;
+		avx2::zoomLine(in, out, o, step);
+		i = o * step;
+	}
+#endif
+	for (/* */; o < outWidth; ++o) {
 		Pixel p0 = in[(i / FACTOR) + 0];
 		Pixel p1 = in[(i / FACTOR) + 1];
 		out[o] = pixelOps.lerp(p0, p1, i % FACTOR);
@@ -1128,7 +1158,14 @@ void AlphaBlendLines<Pixel>::operator()(
 	const Pixel* in1, const Pixel* in2, Pixel* out, unsigned width)
 {
 	// It _IS_ allowed that the output is the same as one of the inputs.
-	for (unsigned i = 0; i < width; ++i) {
+	unsigned i = 0;
+#ifdef __SSE2__
+	if (HostCPU::hasAVX2()) {
+		i = width & ~15;
+		avx2::alphaBlendLines(in1, in2, out, i, pixelOps.getAshift());
+	}
+#endif
+	for (/* */; i < width; ++i) {
 		out[i] = pixelOps.alphaBlend(in1[i], in2[i]);
 	}
 }
@@ -1153,7 +1190,14 @@ void AlphaBlendLines<Pixel>::operator()(
 	//    }
 	Pixel in1M = pixelOps.multiply(in1, alpha);
 	unsigned alpha2 = 256 - alpha;
-	for (unsigned i = 0; i < width; ++i) {
+	unsigned i = 0;
+#ifdef __SSE2__
+	if (HostCPU::hasAVX2()) {
+		i = width & ~15;
+		avx2::alphaBlendLines(in1M, alpha2, in2, out, i);
+	}
+#endif
+	for (/* */; i < width; ++i) {
 		out[i] = in1M + pixelOps.multiply(in2[i], alpha2);
 	}
 }
@@ -0,0 +1,109 @@
+#include "ParallelScaler.hh"
+#include "Scaler.hh"
+#include "ScalerFactory.hh"
+#include "ScalerOutput.hh"
+#include "WorkerPool.hh"
+#include "memory.hh"
+#include "build-info.hh"
+#include <cassert>
+#include <cstdint>
+
+namespace openmsx {
+
+template<typename Pixel>
+ParallelScaler<Pixel>::ParallelScaler(RenderSettings& renderSettings_)
+	: renderSettings(renderSettings_)
+	, scaleAlgorithm(RenderSettings::NO_SCALER)
+	, scaleFactor(unsigned(-1))
+{
+}
+
+template<typename Pixel>
+ParallelScaler<Pixel>::~ParallelScaler()
+{
+}
+
+template<typename Pixel>
+unsigned ParallelScaler<Pixel>::getNumBands()
+{
+	unsigned numThreads = renderSettings.getScaleThreads();
+	if ((numThreads == 0) || (scaleAlgorithm == RenderSettings::SCALER_MLAA)) {
+		// MLAA analyses the complete region at once (it looks for
+		// edges of arbitrary length), so it can't be split.
+		workerPool.reset();
+		return 1;
+	}
+	if (!workerPool || (workerPool->getNumThreads() != numThreads)) {
+		workerPool = make_unique<WorkerPool>(numThreads);
+	}
+	return numThreads + 1;
+}
+
+template<typename Pixel>
+void ParallelScaler<Pixel>::scaleImage(
+	FrameSource& src, const RawFrame* superImpose,
+	const std::vector<Region>& regions, unsigned srcStep, unsigned dstStep,
+	const PixelOperations<Pixel>& pixelOps, const OutputFactory& createOutput)
+{
+	// New scaler algorithm selected?
+	auto algo = renderSettings.getScaleAlgorithm();
+	unsigned factor = renderSettings.getScaleFactor();
+	if ((scaleAlgorithm != algo) || (scaleFactor != factor)) {
+		scaleAlgorithm = algo;
+		scaleFactor = factor;
+		scalers.clear();
+	}
+
+	unsigned numBands = getNumBands();
+	while (scalers.size() < numBands) {
+		scalers.push_back(ScalerFactory<Pixel>::createScaler(
+			pixelOps, renderSettings));
+	}
+
+	if (numBands == 1) {
+		auto dst = createOutput();
+		for (auto& r : regions) {
+			scalers[0]->scaleImage(
+				src, superImpose,
+				r.srcStartY, r.srcEndY, r.srcWidth, // source
+				*dst, r.dstStartY, r.dstEndY); // dest
+		}
+		return;
+	}
+
+	std::vector<std::unique_ptr<ScalerOutput<Pixel>>> outputs;
+	outputs.reserve(numBands);
+	for (unsigned i = 0; i < numBands; ++i) {
+		outputs.push_back(createOutput());
+	}
+
+	// Band 'b' gets part 'b' of every region, so each band has (about)
+	// the same amount of work, even when there are multiple regions.
+	workerPool->execute(numBands, [&](unsigned b) {
+		for (auto& r : regions) {
+			assert(((r.srcEndY - r.srcStartY) % srcStep) == 0);
+			unsigned blocks = (r.srcEndY - r.srcStartY) / srcStep;
+			unsigned begin = (blocks * (b + 0)) / numBands;
+			unsigned end   = (blocks * (b + 1)) / numBands;
+			if (begin == end) continue;
+			scalers[b]->scaleImage(
+				src, superImpose,
+				r.srcStartY + begin * srcStep,
+				r.srcStartY + end   * srcStep,
+				r.srcWidth,
+				*outputs[b],
+				r.dstStartY + begin * dstStep,
+				r.dstStartY + end   * dstStep);
+		}
+	});
+}
+
+// Force template instantiation.
+#if HAVE_16BPP
+template class ParallelScaler<uint16_t>;
+#endif
+#if HAVE_32BPP
+template class ParallelScaler<uint32_t>;
+#endif
+
+} // namespace openmsx
@@ -0,0 +1,82 @@
+#ifndef PARALLELSCALER_HH
+#define PARALLELSCALER_HH
+
+#include "RenderSettings.hh"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace openmsx {
+
+class FrameSource;
+class RawFrame;
+class WorkerPool;
+template<typename Pixel> class Scaler;
+template<typename Pixel> class ScalerOutput;
+template<typename Pixel> class PixelOperations;
+
+/** Runs the Scaler selected in the RenderSettings on (a part of) a frame,
+  * possibly split in horizontal bands that are scaled in parallel (see the
+  * 'scale_threads' setting).
+  *
+  * The bands are aligned to blocks of 'srcStep' source and 'dstStep'
+  * destination lines. The scalers read neighbouring lines directly from the
+  * FrameSource (also when those lines lay outside the scaled range), so the
+  * result is the same as when the whole range is scaled at once. Each band
+  * uses its own Scaler and ScalerOutput object, because those have internal
+  * buffers.
+  */
+template<typename Pixel>
+class ParallelScaler
+{
+public:
+	/** A range of lines that all have the same width. */
+	struct Region {
+		unsigned srcStartY, srcEndY, srcWidth;
+		unsigned dstStartY, dstEndY;
+	};
+	using OutputFactory =
+		std::function<std::unique_ptr<ScalerOutput<Pixel>>()>;
+
+	explicit ParallelScaler(RenderSettings& renderSettings);
+	~ParallelScaler();
+
+	/** Scale the given regions.
+	  * @param src Source frame.
+	  * @param superImpose The to-be-superimposed image (can be nullptr).
+	  * @param regions The (non-overlapping) regions to scale, the number
+	  *        of lines in each region must be a multiple of 'srcStep'
+	  *        (source) and 'dstStep' (destination).
+	  * @param srcStep Number of source lines in one block.
+	  * @param dstStep Number of destination lines in one block.
+	  * @param pixelOps Used when a (new) Scaler needs to be created.
+	  * @param createOutput Creates the ScalerOutput for one band. It's
+	  *        only called from the thread that calls this method.
+	  */
+	void scaleImage(FrameSource& src, const RawFrame* superImpose,
+	                const std::vector<Region>& regions,
+	                unsigned srcStep, unsigned dstStep,
+	                const PixelOperations<Pixel>& pixelOps,
+	                const OutputFactory& createOutput);
+
+private:
+	unsigned getNumBands();
+
+	RenderSettings& renderSettings;
+
+	/** One scaler per band, all with the same algorithm and factor. */
+	std::vector<std::unique_ptr<Scaler<Pixel>>> scalers;
+	std::unique_ptr<WorkerPool> workerPool;
+
+	/** Currently active scale algorithm, used to detect scaler changes.
+	  */
+	RenderSettings::ScaleAlgorithm scaleAlgorithm;
+
+	/** Currently active scale factor, used to detect scaler changes.
+	  */
+	unsigned scaleFactor;
+};
+
+} // namespace openmsx
+
+#endif
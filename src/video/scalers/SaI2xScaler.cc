@@ -27,7 +27,10 @@ void SaI2xScaler<Pixel>::scaleBlank1to2(
 		ScalerOutput<Pixel>& dst, unsigned dstStartY, unsigned dstEndY)
 {
 	unsigned dstHeight = dst.getHeight();
-	unsigned stopDstY = (dstEndY == dstHeight)
+	// The last line is scaled together with the next line (see below),
+	// unless that one is blank too (only a part of a blank region).
+	unsigned stopDstY = ((dstEndY == dstHeight) ||
+	                     (src.getLineWidth(srcEndY) == 1))
 	                  ? dstEndY : dstEndY - 2;
 	unsigned srcY = srcStartY, dstY = dstStartY;
 	for (/* */; dstY < stopDstY; srcY += 1, dstY += 2) {
@@ -35,7 +38,7 @@ void SaI2xScaler<Pixel>::scaleBlank1to2(
 		dst.fillLine(dstY + 0, color);
 		dst.fillLine(dstY + 1, color);
 	}
-	if (dstY != dstHeight) {
+	if (dstY != dstEndY) {
 		unsigned nextLineWidth = src.getLineWidth(srcY + 1);
 		assert(src.getLineWidth(srcY) == 1);
 		assert(nextLineWidth != 1);
@@ -0,0 +1,493 @@
+#include "ScalersAVX2.hh"
+
+#ifdef __SSE2__
+
+#include <immintrin.h>
+#include <cassert>
+
+// Only the functions in this file (not the whole file) are compiled for AVX2,
+// so openMSX keeps working on CPUs without AVX2. Visual Studio doesn't need
+// this, it always allows to use the AVX2 intrinsics.
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace openmsx {
+namespace avx2 {
+
+AVX2_TARGET static inline __m256i load(const void* p)
+{
+	return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+}
+AVX2_TARGET static inline void store(void* p, __m256i x)
+{
+	_mm256_storeu_si256(static_cast<__m256i*>(p), x);
+}
+
+// Loads the 8 pixels starting at 'x - 1' or 'x + 1'. The first and the last
+// pixel of the line are duplicated.
+AVX2_TARGET static inline __m256i loadPrev(const uint32_t* in, size_t x)
+{
+	if (x == 0) {
+		return _mm256_permutevar8x32_epi32(
+			load(in), _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6));
+	}
+	return load(in + x - 1);
+}
+AVX2_TARGET static inline __m256i loadNext(const uint32_t* in, size_t x, size_t width)
+{
+	if ((x + 8) == width) {
+		return _mm256_permutevar8x32_epi32(
+			load(in + x), _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 7));
+	}
+	return load(in + x + 1);
+}
+
+
+// Scale_1on2
+
+template<typename Pixel> AVX2_TARGET static inline __m256i unpacklo(__m256i x, __m256i y)
+{
+	return (sizeof(Pixel) == 4) ? _mm256_unpacklo_epi32(x, y)
+	                            : _mm256_unpacklo_epi16(x, y);
+}
+template<typename Pixel> AVX2_TARGET static inline __m256i unpackhi(__m256i x, __m256i y)
+{
+	return (sizeof(Pixel) == 4) ? _mm256_unpackhi_epi32(x, y)
+	                            : _mm256_unpackhi_epi16(x, y);
+}
+
+template<typename Pixel>
+AVX2_TARGET static inline void scale_1on2_impl(
+	const Pixel* __restrict in, Pixel* __restrict out, size_t srcWidth)
+{
+	assert((srcWidth % 16) == 0);
+	const size_t N = sizeof(__m256i) / sizeof(Pixel);
+	for (size_t x = 0; x < srcWidth; x += N) {
+		__m256i a = load(in + x);
+		// unpack works per 128-bit lane, so reorder the lanes
+		__m256i l = unpacklo<Pixel>(a, a);
+		__m256i h = unpackhi<Pixel>(a, a);
+		store(out + 2 * x + 0, _mm256_permute2x128_si256(l, h, 0x20));
+		store(out + 2 * x + N, _mm256_permute2x128_si256(l, h, 0x31));
+	}
+}
+AVX2_TARGET void scale_1on2(const uint16_t* in, uint16_t* out, size_t srcWidth)
+{
+	scale_1on2_impl(in, out, srcWidth);
+}
+AVX2_TARGET void scale_1on2(const uint32_t* in, uint32_t* out, size_t srcWidth)
+{
+	scale_1on2_impl(in, out, srcWidth);
+}
+
+
+// Scale_1on3
+
+// Output pixel 'i' of a group of 24 output pixels is input pixel 'i / 3'.
+AVX2_TARGET static inline void triple(__m256i a, __m256i& t0, __m256i& t1, __m256i& t2)
+{
+	t0 = _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2));
+	t1 = _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5));
+	t2 = _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7));
+}
+
+AVX2_TARGET void scale_1on3(const uint16_t* __restrict in, uint16_t* __restrict out, size_t srcWidth)
+{
+	assert((srcWidth % 16) == 0);
+	for (size_t x = 0; x < srcWidth; x += 8) {
+		// Expand to 32 bit, so that we can use the 32bpp permutations.
+		__m256i a = _mm256_cvtepu16_epi32(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x)));
+		__m256i t0, t1, t2;
+		triple(a, t0, t1, t2);
+		// packus works per 128-bit lane, so reorder the 64-bit parts
+		__m256i t01 = _mm256_permute4x64_epi64(
+			_mm256_packus_epi32(t0, t1), 0xD8);
+		__m256i t22 = _mm256_permute4x64_epi64(
+			_mm256_packus_epi32(t2, t2), 0xD8);
+		store(out + 3 * x, t01);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 3 * x + 16),
+		                 _mm256_castsi256_si128(t22));
+	}
+}
+AVX2_TARGET void scale_1on3(const uint32_t* __restrict in, uint32_t* __restrict out, size_t srcWidth)
+{
+	assert((srcWidth % 16) == 0);
+	for (size_t x = 0; x < srcWidth; x += 8) {
+		__m256i t0, t1, t2;
+		triple(load(in + x), t0, t1, t2);
+		store(out + 3 * x +  0, t0);
+		store(out + 3 * x +  8, t1);
+		store(out + 3 * x + 16, t2);
+	}
+}
+
+
+// BlendLines
+
+// See PixelOperations::avgDown()
+AVX2_TARGET void blendLines(const uint16_t* in1, const uint16_t* in2, uint16_t* out,
+                            size_t width, uint16_t blendMask)
+{
+	assert((width % 16) == 0);
+	__m256i mask = _mm256_set1_epi16(blendMask);
+	for (size_t x = 0; x < width; x += 16) {
+		__m256i a = load(in1 + x);
+		__m256i b = load(in2 + x);
+		store(out + x, _mm256_add_epi16(
+			_mm256_and_si256(a, b),
+			_mm256_srli_epi16(_mm256_and_si256(_mm256_xor_si256(a, b), mask), 1)));
+	}
+}
+AVX2_TARGET void blendLines(const uint32_t* in1, const uint32_t* in2, uint32_t* out,
+                            size_t width, uint32_t blendMask)
+{
+	assert((width % 16) == 0);
+	__m256i mask = _mm256_set1_epi32(blendMask);
+	for (size_t x = 0; x < width; x += 8) {
+		__m256i a = load(in1 + x);
+		__m256i b = load(in2 + x);
+		store(out + x, _mm256_add_epi32(
+			_mm256_and_si256(a, b),
+			_mm256_srli_epi32(_mm256_and_si256(_mm256_xor_si256(a, b), mask), 1)));
+	}
+}
+
+
+// 32bpp versions of PixelOperations::lerp() and multiply()
+
+AVX2_TARGET static inline __m256i lerp(__m256i p1, __m256i p2, __m256i x)
+{
+	__m256i mask = _mm256_set1_epi32(0x00FF00FF);
+	__m256i rb1 = _mm256_and_si256(p1, mask);
+	__m256i ag1 = _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask);
+	__m256i rb2 = _mm256_and_si256(p2, mask);
+	__m256i ag2 = _mm256_and_si256(_mm256_srli_epi32(p2, 8), mask);
+	__m256i trb = _mm256_srli_epi32(
+		_mm256_mullo_epi32(_mm256_sub_epi32(rb2, rb1), x), 8);
+	__m256i tag = _mm256_mullo_epi32(_mm256_sub_epi32(ag2, ag1), x);
+	__m256i rb = _mm256_and_si256(_mm256_add_epi32(trb, rb1), mask);
+	__m256i ag = _mm256_and_si256(
+		_mm256_add_epi32(tag, _mm256_slli_epi32(ag1, 8)),
+		_mm256_set1_epi32(0xFF00FF00));
+	return _mm256_or_si256(rb, ag);
+}
+
+AVX2_TARGET static inline __m256i multiply(__m256i p, __m256i x)
+{
+	__m256i mask = _mm256_set1_epi32(0x00FF00FF);
+	__m256i mask2 = _mm256_set1_epi32(0xFF00FF00);
+	__m256i rb = _mm256_mullo_epi32(_mm256_and_si256(p, mask), x);
+	__m256i ag = _mm256_mullo_epi32(
+		_mm256_and_si256(_mm256_srli_epi32(p, 8), mask), x);
+	return _mm256_or_si256(
+		_mm256_srli_epi32(_mm256_and_si256(rb, mask2), 8),
+		_mm256_and_si256(ag, mask2));
+}
+
+
+// ZoomLine
+
+AVX2_TARGET void zoomLine(const uint32_t* in, uint32_t* out, size_t outWidth,
+                          unsigned step)
+{
+	assert((outWidth % 16) == 0);
+	auto* in0 = reinterpret_cast<const int*>(in);
+	__m256i i = _mm256_mullo_epi32(
+		_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+	__m256i i8 = _mm256_set1_epi32(8 * step);
+	__m256i fracMask = _mm256_set1_epi32(255);
+	for (size_t o = 0; o < outWidth; o += 8) {
+		__m256i idx = _mm256_srli_epi32(i, 8);
+		__m256i p0 = _mm256_i32gather_epi32(in0 + 0, idx, 4);
+		__m256i p1 = _mm256_i32gather_epi32(in0 + 1, idx, 4);
+		store(out + o, lerp(p0, p1, _mm256_and_si256(i, fracMask)));
+		i = _mm256_add_epi32(i, i8);
+	}
+}
+
+
+// AlphaBlendLines
+
+// See PixelOperations::alphaBlend(), 16bpp uses a key color.
+AVX2_TARGET void alphaBlendLines(const uint16_t* in1, const uint16_t* in2, uint16_t* out,
+                                 size_t width, unsigned /*alphaShift*/)
+{
+	assert((width % 16) == 0);
+	__m256i key = _mm256_set1_epi16(0x0001);
+	for (size_t x = 0; x < width; x += 16) {
+		__m256i a = load(in1 + x);
+		__m256i b = load(in2 + x);
+		store(out + x, _mm256_blendv_epi8(a, b, _mm256_cmpeq_epi16(a, key)));
+	}
+}
+AVX2_TARGET void alphaBlendLines(const uint32_t* in1, const uint32_t* in2, uint32_t* out,
+                                 size_t width, unsigned alphaShift)
+{
+	assert((width % 16) == 0);
+	__m128i shift = _mm_cvtsi32_si128(alphaShift);
+	__m256i alphaMask = _mm256_set1_epi32(255);
+	for (size_t x = 0; x < width; x += 8) {
+		__m256i a = load(in1 + x);
+		__m256i b = load(in2 + x);
+		__m256i alpha = _mm256_and_si256(_mm256_srl_epi32(a, shift), alphaMask);
+		store(out + x, lerp(b, a, alpha));
+	}
+}
+
+AVX2_TARGET void alphaBlendLines(uint32_t in1M, unsigned alpha2, const uint32_t* in2,
+                                 uint32_t* out, size_t width)
+{
+	assert((width % 16) == 0);
+	__m256i a = _mm256_set1_epi32(in1M);
+	__m256i x2 = _mm256_set1_epi32(alpha2);
+	for (size_t x = 0; x < width; x += 8) {
+		store(out + x, _mm256_add_epi32(a, multiply(load(in2 + x), x2)));
+	}
+}
+
+
+// Scanline
+
+AVX2_TARGET void drawScanline(const uint32_t* in1, const uint32_t* in2, uint32_t* out,
+                              unsigned factor, size_t width)
+{
+	assert((width % 16) == 0);
+	__m256i zero = _mm256_setzero_si256();
+	__m256i f = _mm256_set1_epi16(factor << 8);
+	for (size_t x = 0; x < width; x += 8) {
+		__m256i c = _mm256_avg_epu8(load(in1 + x), load(in2 + x));
+		__m256i l = _mm256_unpacklo_epi8(c, zero);
+		__m256i h = _mm256_unpackhi_epi8(c, zero);
+		__m256i m = _mm256_mulhi_epu16(l, f);
+		__m256i n = _mm256_mulhi_epu16(h, f);
+		store(out + x, _mm256_packus_epi16(m, n));
+	}
+}
+
+
+// HQ edge detection
+
+// See readPixel() in HQCommon.hh
+AVX2_TARGET static inline __m256i readPixels(const uint16_t* p)
+{
+	__m256i v = _mm256_cvtepu16_epi32(
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+	__m256i r = _mm256_slli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xF800)), 8);
+	__m256i g = _mm256_slli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0x07C0)), 5);
+	__m256i b = _mm256_slli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0x001F)), 3);
+	return _mm256_or_si256(_mm256_or_si256(r, g), b);
+}
+AVX2_TARGET static inline __m256i readPixels(const uint32_t* p)
+{
+	return _mm256_and_si256(load(p), _mm256_set1_epi32(0xF8F8F8F8));
+}
+
+struct EdgeShifts { __m128i r, g, b; };
+
+AVX2_TARGET static inline __m256i component(__m256i c, __m128i shift)
+{
+	return _mm256_and_si256(_mm256_srl_epi32(c, shift), _mm256_set1_epi32(0xFF));
+}
+
+// See EdgeHQ::operator(). Returns all ones for the pixels with an edge.
+// (When c1 == c2 all differences are zero, so no special case is needed.)
+AVX2_TARGET static inline __m256i isEdge(__m256i c1, __m256i c2, const EdgeShifts& s)
+{
+	__m256i dr = _mm256_sub_epi32(component(c1, s.r), component(c2, s.r));
+	__m256i dg = _mm256_sub_epi32(component(c1, s.g), component(c2, s.g));
+	__m256i db = _mm256_sub_epi32(component(c1, s.b), component(c2, s.b));
+	__m256i dy = _mm256_add_epi32(_mm256_add_epi32(dr, dg), db);
+	__m256i du = _mm256_sub_epi32(dr, db);
+	__m256i dv = _mm256_sub_epi32(
+		_mm256_add_epi32(dg, _mm256_add_epi32(dg, dg)), dy);
+	__m256i ey = _mm256_cmpgt_epi32(_mm256_abs_epi32(dy), _mm256_set1_epi32(0xC0));
+	__m256i eu = _mm256_cmpgt_epi32(_mm256_abs_epi32(du), _mm256_set1_epi32(0x1C));
+	__m256i ev = _mm256_cmpgt_epi32(_mm256_abs_epi32(dv), _mm256_set1_epi32(0x30));
+	return _mm256_or_si256(_mm256_or_si256(ey, eu), ev);
+}
+
+template<typename Pixel>
+AVX2_TARGET static inline void calcEdgesHQ_impl(
+	const Pixel* __restrict in1, const Pixel* __restrict in2,
+	unsigned* __restrict edges, size_t width,
+	unsigned shiftR, unsigned shiftG, unsigned shiftB)
+{
+	assert((width % 8) == 0);
+	EdgeShifts s = { _mm_cvtsi32_si128(shiftR),
+	                 _mm_cvtsi32_si128(shiftG),
+	                 _mm_cvtsi32_si128(shiftB) };
+	for (size_t x = 0; x < width; x += 8) {
+		__m256i c5 = readPixels(in1 + x + 0);
+		__m256i c6 = readPixels(in1 + x + 1);
+		__m256i c8 = readPixels(in2 + x + 0);
+		__m256i c9 = readPixels(in2 + x + 1);
+		__m256i e58 = _mm256_and_si256(isEdge(c5, c8, s), _mm256_set1_epi32(1 << 5));
+		__m256i e59 = _mm256_and_si256(isEdge(c5, c9, s), _mm256_set1_epi32(1 << 6));
+		__m256i e68 = _mm256_and_si256(isEdge(c6, c8, s), _mm256_set1_epi32(1 << 7));
+		__m256i e56 = _mm256_and_si256(isEdge(c5, c6, s), _mm256_set1_epi32(1 << 8));
+		store(edges + x, _mm256_or_si256(_mm256_or_si256(e58, e59),
+		                                 _mm256_or_si256(e68, e56)));
+	}
+}
+AVX2_TARGET void calcEdgesHQ(const uint16_t* in1, const uint16_t* in2, unsigned* edges,
+                             size_t width, unsigned shiftR, unsigned shiftG,
+                             unsigned shiftB)
+{
+	calcEdgesHQ_impl(in1, in2, edges, width, shiftR, shiftG, shiftB);
+}
+AVX2_TARGET void calcEdgesHQ(const uint32_t* in1, const uint32_t* in2, unsigned* edges,
+                             size_t width, unsigned shiftR, unsigned shiftG,
+                             unsigned shiftB)
+{
+	calcEdgesHQ_impl(in1, in2, edges, width, shiftR, shiftG, shiftB);
+}
+
+
+// Simple2xScaler and Simple3xScaler blur
+//
+// The color components are expanded to 16 bit. Because the unpack and pack
+// instructions work per 128-bit lane, 'l' holds the components of pixels
+// 0, 1, 4 and 5 and 'h' those of pixels 2, 3, 6 and 7.
+
+AVX2_TARGET void blur1on2(const uint32_t* in, uint32_t* out, unsigned c1_, unsigned c2_,
+                          size_t srcWidth)
+{
+	assert(srcWidth != 0);
+	assert((srcWidth % 8) == 0);
+	__m256i c1 = _mm256_set1_epi16(c1_);
+	__m256i c2 = _mm256_set1_epi16(c2_);
+	__m256i zero = _mm256_setzero_si256();
+	for (size_t x = 0; x < srcWidth; x += 8) {
+		__m256i prev = loadPrev(in, x);
+		__m256i curr = load(in + x);
+		__m256i next = loadNext(in, x, srcWidth);
+
+		__m256i cl = _mm256_mullo_epi16(c2, _mm256_unpacklo_epi8(curr, zero));
+		__m256i ch = _mm256_mullo_epi16(c2, _mm256_unpackhi_epi8(curr, zero));
+		__m256i pl = _mm256_mullo_epi16(c1, _mm256_unpacklo_epi8(prev, zero));
+		__m256i ph = _mm256_mullo_epi16(c1, _mm256_unpackhi_epi8(prev, zero));
+		__m256i nl = _mm256_mullo_epi16(c1, _mm256_unpacklo_epi8(next, zero));
+		__m256i nh = _mm256_mullo_epi16(c1, _mm256_unpackhi_epi8(next, zero));
+		__m256i even = _mm256_packus_epi16(
+			_mm256_srli_epi16(_mm256_add_epi16(pl, cl), 8),
+			_mm256_srli_epi16(_mm256_add_epi16(ph, ch), 8));
+		__m256i odd = _mm256_packus_epi16(
+			_mm256_srli_epi16(_mm256_add_epi16(nl, cl), 8),
+			_mm256_srli_epi16(_mm256_add_epi16(nh, ch), 8));
+
+		__m256i lo = _mm256_unpacklo_epi32(even, odd);
+		__m256i hi = _mm256_unpackhi_epi32(even, odd);
+		store(out + 2 * x + 0, _mm256_permute2x128_si256(lo, hi, 0x20));
+		store(out + 2 * x + 8, _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+}
+
+AVX2_TARGET void blur1on1(const uint32_t* in, uint32_t* out, unsigned c1_, unsigned c2_,
+                          size_t srcWidth)
+{
+	assert(srcWidth != 0);
+	assert((srcWidth % 8) == 0);
+	__m256i c1 = _mm256_set1_epi16(c1_);
+	__m256i c2 = _mm256_set1_epi16(c2_);
+	__m256i zero = _mm256_setzero_si256();
+	for (size_t x = 0; x < srcWidth; x += 8) {
+		__m256i prev = loadPrev(in, x);
+		__m256i curr = load(in + x);
+		__m256i next = loadNext(in, x, srcWidth);
+
+		__m256i pnl = _mm256_add_epi16(_mm256_unpacklo_epi8(prev, zero),
+		                               _mm256_unpacklo_epi8(next, zero));
+		__m256i pnh = _mm256_add_epi16(_mm256_unpackhi_epi8(prev, zero),
+		                               _mm256_unpackhi_epi8(next, zero));
+		__m256i l = _mm256_add_epi16(
+			_mm256_mullo_epi16(c1, pnl),
+			_mm256_mullo_epi16(c2, _mm256_unpacklo_epi8(curr, zero)));
+		__m256i h = _mm256_add_epi16(
+			_mm256_mullo_epi16(c1, pnh),
+			_mm256_mullo_epi16(c2, _mm256_unpackhi_epi8(curr, zero)));
+		store(out + x, _mm256_packus_epi16(_mm256_srli_epi16(l, 8),
+		                                   _mm256_srli_epi16(h, 8)));
+	}
+}
+
+// The three output pixels for one input pixel (see Blur_1on3::operator()).
+AVX2_TARGET static inline void blur1on3_16(
+	__m256i p, __m256i c, __m256i n,
+	__m256i C0, __m256i C1, __m256i C2, __m256i C3,
+	__m256i& r0, __m256i& r1, __m256i& r2)
+{
+	__m256i c2 = _mm256_mulhi_epu16(c, C2);
+	r0 = _mm256_add_epi16(_mm256_mulhi_epu16(p, C1), c2);
+	r1 = _mm256_add_epi16(_mm256_add_epi16(_mm256_mulhi_epu16(p, C0),
+	                                       _mm256_mulhi_epu16(c, C3)),
+	                      _mm256_mulhi_epu16(n, C0));
+	r2 = _mm256_add_epi16(c2, _mm256_mulhi_epu16(n, C1));
+}
+
+AVX2_TARGET void blur1on3(const uint32_t* in, uint32_t* out, unsigned blur,
+                          size_t srcWidth)
+{
+	assert(srcWidth != 0);
+	assert((srcWidth % 8) == 0);
+
+	// Same (16-bit fixed point) factors as Blur_1on3::blur_SSE().
+	unsigned alpha = blur * 256;
+	unsigned c0 = alpha / 2;
+	unsigned c1 = alpha + c0;
+	unsigned c2 = 0x10000 - c1;
+	unsigned c3 = 0x10000 - alpha;
+	__m256i C0 = _mm256_set1_epi16(c0);
+	__m256i C1 = _mm256_set1_epi16(c1);
+	__m256i C2 = _mm256_set1_epi16(c2);
+	__m256i C3 = _mm256_set1_epi16(c3);
+	__m256i zero = _mm256_setzero_si256();
+
+	__m256i idx0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+	__m256i idx1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+	__m256i idx2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+
+	for (size_t x = 0; x < srcWidth; x += 8) {
+		__m256i prev = loadPrev(in, x);
+		__m256i curr = load(in + x);
+		__m256i next = loadNext(in, x, srcWidth);
+
+		__m256i l0, l1, l2, h0, h1, h2;
+		blur1on3_16(_mm256_unpacklo_epi8(prev, zero),
+		            _mm256_unpacklo_epi8(curr, zero),
+		            _mm256_unpacklo_epi8(next, zero),
+		            C0, C1, C2, C3, l0, l1, l2);
+		blur1on3_16(_mm256_unpackhi_epi8(prev, zero),
+		            _mm256_unpackhi_epi8(curr, zero),
+		            _mm256_unpackhi_epi8(next, zero),
+		            C0, C1, C2, C3, h0, h1, h2);
+		__m256i r0 = _mm256_packus_epi16(l0, h0);
+		__m256i r1 = _mm256_packus_epi16(l1, h1);
+		__m256i r2 = _mm256_packus_epi16(l2, h2);
+
+		// Output pixel 'i' (of these 24) is pixel 'i / 3' of 'r<i % 3>'.
+		__m256i a0 = _mm256_permutevar8x32_epi32(r0, idx0);
+		__m256i a1 = _mm256_permutevar8x32_epi32(r1, idx0);
+		__m256i a2 = _mm256_permutevar8x32_epi32(r2, idx0);
+		store(out + 3 * x + 0, _mm256_blend_epi32(
+			_mm256_blend_epi32(a0, a1, 0x92), a2, 0x24));
+		__m256i b0 = _mm256_permutevar8x32_epi32(r0, idx1);
+		__m256i b1 = _mm256_permutevar8x32_epi32(r1, idx1);
+		__m256i b2 = _mm256_permutevar8x32_epi32(r2, idx1);
+		store(out + 3 * x + 8, _mm256_blend_epi32(
+			_mm256_blend_epi32(b0, b1, 0x24), b2, 0x49));
+		__m256i d0 = _mm256_permutevar8x32_epi32(r0, idx2);
+		__m256i d1 = _mm256_permutevar8x32_epi32(r1, idx2);
+		__m256i d2 = _mm256_permutevar8x32_epi32(r2, idx2);
+		store(out + 3 * x + 16, _mm256_blend_epi32(
+			_mm256_blend_epi32(d0, d1, 0x49), d2, 0x92));
+	}
+}
+
+} // namespace avx2
+} // namespace openmsx
+
+#endif // __SSE2__
@@ -0,0 +1,122 @@
+#ifndef SCALERSAVX2_HH
+#define SCALERSAVX2_HH
+
+#ifdef __SSE2__
+
+#include "unreachable.hh"
+#include <cstddef>
+#include <cstdint>
+
+namespace openmsx {
+
+/** AVX2 versions of the inner loops of LineScalers, Scanline, the HQ scalers
+  * and the Simple2x/Simple3x scalers.
+  *
+  * This file is compiled for the baseline instruction set, only these
+  * functions themselves use AVX2. So they may only be called when
+  * HostCPU::hasAVX2() returns true.
+  *
+  * All routines give exactly the same result as the generic (C++ or SSE2)
+  * versions. None of them requires aligned buffers. Unless mentioned
+  * otherwise 'width' must be a multiple of 16, the generic code handles the
+  * remaining pixels.
+  */
+namespace avx2 {
+
+/** See Scale_1on2, 'srcWidth' pixels are scaled to '2 * srcWidth' pixels. */
+void scale_1on2(const uint16_t* in, uint16_t* out, size_t srcWidth);
+void scale_1on2(const uint32_t* in, uint32_t* out, size_t srcWidth);
+
+/** See Scale_1on3, 'srcWidth' pixels are scaled to '3 * srcWidth' pixels. */
+void scale_1on3(const uint16_t* in, uint16_t* out, size_t srcWidth);
+void scale_1on3(const uint32_t* in, uint32_t* out, size_t srcWidth);
+
+/** See BlendLines<Pixel, 1, 1>. The output may be the same as one of the
+  * inputs. */
+void blendLines(const uint16_t* in1, const uint16_t* in2, uint16_t* out,
+                size_t width, uint16_t blendMask);
+void blendLines(const uint32_t* in1, const uint32_t* in2, uint32_t* out,
+                size_t width, uint32_t blendMask);
+
+/** See ZoomLine, only 32bpp. Calculates the first 'outWidth' output pixels,
+  * 'step' is the (fixed point, 8 fractional bits) distance between two output
+  * pixels in the input line. */
+void zoomLine(const uint32_t* in, uint32_t* out, size_t outWidth,
+              unsigned step);
+inline void zoomLine(const uint16_t* /*in*/, uint16_t* /*out*/,
+                     size_t /*outWidth*/, unsigned /*step*/)
+{
+	UNREACHABLE;
+}
+
+/** See AlphaBlendLines, 16bpp uses a key color, 32bpp uses the alpha channel
+  * of 'in1' (at bit position 'alphaShift'). The output may be the same as
+  * one of the inputs. */
+void alphaBlendLines(const uint16_t* in1, const uint16_t* in2, uint16_t* out,
+                     size_t width, unsigned alphaShift);
+void alphaBlendLines(const uint32_t* in1, const uint32_t* in2, uint32_t* out,
+                     size_t width, unsigned alphaShift);
+
+/** See AlphaBlendLines with a constant 'in1', only 32bpp. Calculates
+  * 'in1M + multiply(in2[i], alpha2)', 'in1M' is the pre-multiplied 'in1'. */
+void alphaBlendLines(uint32_t in1M, unsigned alpha2, const uint32_t* in2,
+                     uint32_t* out, size_t width);
+inline void alphaBlendLines(uint16_t /*in1M*/, unsigned /*alpha2*/,
+                            const uint16_t* /*in2*/, uint16_t* /*out*/,
+                            size_t /*width*/)
+{
+	UNREACHABLE;
+}
+
+/** See Scanline::draw(), only 32bpp. */
+void drawScanline(const uint32_t* in1, const uint32_t* in2, uint32_t* out,
+                  unsigned factor, size_t width);
+inline void drawScanline(const uint16_t* /*in1*/, const uint16_t* /*in2*/,
+                         uint16_t* /*out*/, unsigned /*factor*/,
+                         size_t /*width*/)
+{
+	UNREACHABLE;
+}
+
+/** See calcEdgesHQ() in HQCommon.hh. 'width' must be a multiple of 8 and
+  * smaller than the width of the input lines (pixel 'x + 1' is read). */
+void calcEdgesHQ(const uint16_t* in1, const uint16_t* in2, unsigned* edges,
+                 size_t width, unsigned shiftR, unsigned shiftG,
+                 unsigned shiftB);
+void calcEdgesHQ(const uint32_t* in1, const uint32_t* in2, unsigned* edges,
+                 size_t width, unsigned shiftR, unsigned shiftG,
+                 unsigned shiftB);
+
+/** The blur routines of Simple2xScaler and Simple3xScaler, only 32bpp. These
+  * process the complete line (including the border pixels), 'srcWidth' must
+  * be a non-zero multiple of 8. */
+void blur1on2(const uint32_t* in, uint32_t* out, unsigned c1, unsigned c2,
+              size_t srcWidth);
+void blur1on1(const uint32_t* in, uint32_t* out, unsigned c1, unsigned c2,
+              size_t srcWidth);
+void blur1on3(const uint32_t* in, uint32_t* out, unsigned blur,
+              size_t srcWidth);
+
+// no 16bpp versions (the generic code doesn't have SSE2 versions either)
+inline void blur1on2(const uint16_t* /*in*/, uint16_t* /*out*/,
+                     unsigned /*c1*/, unsigned /*c2*/, size_t /*srcWidth*/)
+{
+	UNREACHABLE;
+}
+inline void blur1on1(const uint16_t* /*in*/, uint16_t* /*out*/,
+                     unsigned /*c1*/, unsigned /*c2*/, size_t /*srcWidth*/)
+{
+	UNREACHABLE;
+}
+inline void blur1on3(const uint16_t* /*in*/, uint16_t* /*out*/,
+                     unsigned /*blur*/, size_t /*srcWidth*/)
+{
+	UNREACHABLE;
+}
+
+} // namespace avx2
+} // namespace openmsx
+
+#endif // __SSE2__
+
+#endif
@@ -5,6 +5,8 @@
 #include <cstddef>
 #include <cstring>
 #ifdef __SSE2__
+#include "HostCPU.hh"
+#include "ScalersAVX2.hh"
 #include <emmintrin.h>
 #endif
 
@@ -202,7 +204,12 @@ void Scanline<Pixel>::draw(
 	Pixel* __restrict dst, unsigned factor, size_t width)
 {
 #ifdef __SSE2__
-	drawSSE2(src1, src2, dst, factor, width, pixelOps, darkener);
+	if ((sizeof(Pixel) == 4) && HostCPU::hasAVX2()) {
+		// only 32bpp, 16bpp uses a lookup table
+		avx2::drawScanline(src1, src2, dst, factor, width);
+	} else {
+		drawSSE2(src1, src2, dst, factor, width, pixelOps, darkener);
+	}
 #else
 	// non-SSE2 routine, both 16bpp and 32bpp
 	darkener.setFactor(factor);
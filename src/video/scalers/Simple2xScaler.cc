@@ -10,6 +10,8 @@
 #include <cstddef>
 #include <cstdint>
 #ifdef __SSE2__
+#include "HostCPU.hh"
+#include "ScalersAVX2.hh"
 #include <emmintrin.h>
 #endif
 
@@ -39,7 +41,10 @@ void Simple2xScaler<Pixel>::scaleBlank1to2(
 	int scanlineFactor = settings.getScanlineFactor();
 
 	unsigned dstHeight = dst.getHeight();
-	unsigned stopDstY = (dstEndY == dstHeight)
+	// The last line is scaled together with the next line (see below),
+	// unless that one is blank too (only a part of a blank region).
+	unsigned stopDstY = ((dstEndY == dstHeight) ||
+	                     (src.getLineWidth(srcEndY) == 1))
 	                  ? dstEndY : dstEndY - 2;
 	unsigned srcY = srcStartY, dstY = dstStartY;
 	for (/* */; dstY < stopDstY; srcY += 1, dstY += 2) {
@@ -48,7 +53,7 @@ void Simple2xScaler<Pixel>::scaleBlank1to2(
 		Pixel color1 = scanline.darken(color0, scanlineFactor);
 		dst.fillLine(dstY + 1, color1);
 	}
-	if (dstY != dstHeight) {
+	if (dstY != dstEndY) {
 		unsigned nextLineWidth = src.getLineWidth(srcY + 1);
 		assert(src.getLineWidth(srcY) == 1);
 		assert(nextLineWidth != 1);
@@ -93,7 +98,7 @@ static void blur1on2_SSE2(
 	__m128i c2 = _mm_set1_epi16(c2_);
 	__m128i zero = _mm_setzero_si128();
 
-	__m128i abcd = *reinterpret_cast<const __m128i*>(in);
+	__m128i abcd = *reinterpret_cast<const __m128i*>(in_);
 	__m128i a0b0 = _mm_unpacklo_epi8(abcd, zero);
 	__m128i d0a0 = _mm_shuffle_epi32(a0b0, 0x44);
 	__m128i d1a1 = _mm_mullo_epi16(c1, d0a0);
@@ -193,8 +198,12 @@ void Simple2xScaler<Pixel>::blur1on2(
 
 #ifdef __SSE2__
 	if (sizeof(Pixel) == 4) {
-		// SSE2, only 32bpp
-		blur1on2_SSE2(pIn, pOut, c1, c2, srcWidth);
+		// SSE2 or AVX2, only 32bpp
+		if (HostCPU::hasAVX2() && ((srcWidth % 8) == 0)) {
+			avx2::blur1on2(pIn, pOut, c1, c2, srcWidth);
+		} else {
+			blur1on2_SSE2(pIn, pOut, c1, c2, srcWidth);
+		}
 		return;
 	}
 #endif
@@ -261,7 +270,7 @@ static void blur1on1_SSE2(
 	__m128i c2 = _mm_set1_epi16(c2_);
 	__m128i zero = _mm_setzero_si128();
 
-	__m128i abcd = *reinterpret_cast<const __m128i*>(in);
+	__m128i abcd = *reinterpret_cast<const __m128i*>(in_);
 	__m128i a0b0 = _mm_unpacklo_epi8(abcd, zero);
 	__m128i d0a0 = _mm_shuffle_epi32(a0b0, 0x44);
 
@@ -345,8 +354,12 @@ void Simple2xScaler<Pixel>::blur1on1(
 
 #ifdef __SSE2__
 	if (sizeof(Pixel) == 4) {
-		// SSE2, only 32bpp
-		blur1on1_SSE2(pIn, pOut, c1, c2, srcWidth);
+		// SSE2 or AVX2, only 32bpp
+		if (HostCPU::hasAVX2() && ((srcWidth % 8) == 0)) {
+			avx2::blur1on1(pIn, pOut, c1, c2, srcWidth);
+		} else {
+			blur1on1_SSE2(pIn, pOut, c1, c2, srcWidth);
+		}
 		return;
 	}
 #endif
@@ -9,6 +9,8 @@
 #include "memory.hh"
 #include <cstdint>
 #ifdef __SSE2__
+#include "HostCPU.hh"
+#include "ScalersAVX2.hh"
 #include <emmintrin.h>
 #endif
 
@@ -250,7 +252,10 @@ void Simple3xScaler<Pixel>::scaleBlank1to3(
 	int scanlineFactor = settings.getScanlineFactor();
 
 	unsigned dstHeight = dst.getHeight();
-	unsigned stopDstY = (dstEndY == dstHeight)
+	// The last line is scaled together with the next line (see below),
+	// unless that one is blank too (only a part of a blank region).
+	unsigned stopDstY = ((dstEndY == dstHeight) ||
+	                     (src.getLineWidth(srcEndY) == 1))
 	                  ? dstEndY : dstEndY - 3;
 	unsigned srcY = srcStartY, dstY = dstStartY;
 	for (/* */; dstY < stopDstY; srcY += 1, dstY += 3) {
@@ -260,7 +265,7 @@ void Simple3xScaler<Pixel>::scaleBlank1to3(
 		dst.fillLine(dstY + 1, color0);
 		dst.fillLine(dstY + 2, color1);
 	}
-	if (dstY != dstHeight) {
+	if (dstY != dstEndY) {
 		unsigned nextLineWidth = src.getLineWidth(srcY + 1);
 		assert(src.getLineWidth(srcY) == 1);
 		assert(nextLineWidth != 1);
@@ -468,7 +473,11 @@ void Blur_1on3<Pixel>::operator()(
 	size_t srcWidth = dstWidth / 3;
 #ifdef __SSE2__
 	if (sizeof(Pixel) == 4) {
-		blur_SSE(in, out, srcWidth);
+		if (HostCPU::hasAVX2() && ((srcWidth % 8) == 0)) {
+			avx2::blur1on3(in, out, blur, srcWidth);
+		} else {
+			blur_SSE(in, out, srcWidth);
+		}
 		return;
 	}
 #endif